@@ -63,9 +63,13 @@ typedef struct {
   UINT8   mPTLen[NPT];
   UINT16  mCTable[4096];
   UINT16  mPTTable[256];
-} SCRATCH_DATA;
 
-STATIC UINT16 mPbit = EFIPBIT;
+  //
+  // The length of the position field, EFIPBIT for EFI or MAXPBIT for Tiano
+  // compressed data
+  //
+  UINT8   mPBit;
+} SCRATCH_DATA;
 
 STATIC
 VOID
@@ -556,7 +560,7 @@ Returns:
 
     ReadCLen (Sd);
 
-    Sd->mBadTableFlag = ReadPTLen (Sd, MAXNP, mPbit, (UINT16) (-1));
+    Sd->mBadTableFlag = ReadPTLen (Sd, MAXNP, Sd->mPBit, (UINT16) (-1));
     if (Sd->mBadTableFlag != 0) {
       return 0;
     }
@@ -693,6 +697,7 @@ Returns:
   return EFI_SUCCESS;
 }
 
+STATIC
 EFI_STATUS
 Decompress (
   IN      VOID    *Source,
@@ -700,7 +705,8 @@ Decompress (
   IN OUT  VOID    *Destination,
   IN      UINT32  DstSize,
   IN OUT  VOID    *Scratch,
-  IN      UINT32  ScratchSize
+  IN      UINT32  ScratchSize,
+  IN      UINT8   PBit
   )
 /*++
 
@@ -716,6 +722,7 @@ Arguments:
   DstSize     - The size of destination buffer.
   Scratch     - The buffer used internally by the decompress routine. This  buffer is needed to store intermediate data.
   ScratchSize - The size of scratch buffer.
+  PBit        - The length of the position field, EFIPBIT or MAXPBIT.
 
 Returns:
 
@@ -767,6 +774,7 @@ Returns:
   Sd->mDstBase  = Dst;
   Sd->mCompSize = CompSize;
   Sd->mOrigSize = OrigSize;
+  Sd->mPBit     = PBit;
 
   //
   // Fill the first BITBUFSIZ bits
@@ -879,8 +887,7 @@ Returns:
 
 --*/
 {
-  mPbit = EFIPBIT;
-  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize);
+  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize, EFIPBIT);
 }
 
 EFI_STATUS
@@ -914,8 +921,7 @@ Returns:
 
 --*/
 {
-  mPbit = MAXPBIT;
-  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize);
+  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize, MAXPBIT);
 }
 
 EFI_STATUS
@@ -951,6 +957,9 @@ Extract (
       } else {
         Status = EFI_OUT_OF_RESOURCES;
       }
+      if (Scratch != NULL) {
+        free(Scratch);
+      }
     }
     break;
   case 2:
@@ -963,6 +972,9 @@ Extract (
       } else {
         Status = EFI_OUT_OF_RESOURCES;
       }
+      if (Scratch != NULL) {
+        free(Scratch);
+      }
     }
     break;
   default:
@@ -37,7 +37,7 @@ typedef INT16             NODE;
 #define MAX_HASH_VAL      (3 * WNDSIZ + (WNDSIZ / 512 + 1) * UINT8_MAX)
 #define HASH(p, c)        ((p) + ((c) << (WNDBIT - 9)) + WNDSIZ * 2)
 #define CRCPOLY           0xA001
-#define UPDATE_CRC(c)     mCrc = mCrcTable[(mCrc ^ (c)) & 0xFF] ^ (mCrc >> UINT8_BIT)
+#define UPDATE_CRC(Cd, c) (Cd)->mCrc = (Cd)->mCrcTable[((Cd)->mCrc ^ (c)) & 0xFF] ^ ((Cd)->mCrc >> UINT8_BIT)
 
 //
 // C: the Char&Len Set; P: the Position Set; T: the exTra Set
@@ -55,6 +55,65 @@ typedef INT16             NODE;
   #define                 NPT NP
 #endif
 
+//
+// The state of one compression. Each call to EfiCompress() has its own, so
+// several compressions can run at the same time in one process.
+//
+typedef struct {
+  UINT8   *mSrc;
+  UINT8   *mDst;
+  UINT8   *mSrcUpperLimit;
+  UINT8   *mDstUpperLimit;
+
+  //
+  // String Info Log
+  //
+  UINT8   *mText;
+  UINT8   *mLevel;
+  UINT8   *mChildCount;
+  NODE    *mPosition;
+  NODE    *mParent;
+  NODE    *mPrev;
+  NODE    *mNext;
+  NODE    mPos;
+  NODE    mMatchPos;
+  NODE    mAvail;
+  INT32   mRemainder;
+  INT32   mMatchLen;
+
+  //
+  // Huffman encoding of the blocks
+  //
+  UINT8   *mBuf;
+  UINT32  mBufSiz;
+  UINT32  mOutputPos;
+  UINT32  mOutputMask;
+  UINT32  mCPos;
+  INT32   mBitCount;
+  UINT32  mSubBitBuf;
+  UINT32  mCompSize;
+  UINT32  mOrigSize;
+  UINT32  mCrc;
+  UINT16  mCrcTable[UINT8_MAX + 1];
+  INT32   mN;
+  INT32   mHeapSize;
+  INT32   mDepth;
+  INT16   mHeap[NC + 1];
+  UINT16  *mFreq;
+  UINT16  *mSortPtr;
+  UINT8   *mLen;
+  UINT16  mLenCnt[17];
+  UINT16  mLeft[2 * NC - 1];
+  UINT16  mRight[2 * NC - 1];
+  UINT8   mCLen[NC];
+  UINT8   mPTLen[NPT];
+  UINT16  mCFreq[2 * NC - 1];
+  UINT16  mCCode[NC];
+  UINT16  mPFreq[2 * NP - 1];
+  UINT16  mPTCode[NPT];
+  UINT16  mTFreq[2 * NT - 1];
+} COMPRESS_DATA;
+
 //
 // Function Prototypes
 //
@@ -62,27 +121,32 @@ typedef INT16             NODE;
 STATIC
 VOID 
 PutDword(
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Data
   );
 
 STATIC
 EFI_STATUS 
 AllocateMemory (
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 FreeMemory (
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC 
 VOID 
 InitSlide (
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC 
 NODE 
 Child (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE q, 
   IN UINT8 c
   );
@@ -90,6 +154,7 @@ Child (
 STATIC 
 VOID 
 MakeChild (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE q, 
   IN UINT8 c, 
   IN NODE r
@@ -98,37 +163,44 @@ MakeChild (
 STATIC 
 VOID 
 Split (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE Old
   );
 
 STATIC 
 VOID 
 InsertNode (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 VOID 
 DeleteNode (
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC 
 VOID 
 GetNextMatch (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 EFI_STATUS 
 Encode (
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC 
 VOID 
 CountTFreq (
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC 
 VOID 
 WritePTLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 n, 
   IN INT32 nbit, 
   IN INT32 Special
@@ -137,28 +209,33 @@ WritePTLen (
 STATIC 
 VOID 
 WriteCLen (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 VOID 
 EncodeC (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 c
   );
 
 STATIC 
 VOID 
 EncodeP (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 p
   );
 
 STATIC 
 VOID 
 SendBlock (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 VOID 
 Output (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 c, 
   IN UINT32 p
   );
@@ -166,21 +243,25 @@ Output (
 STATIC 
 VOID 
 HufEncodeStart (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 VOID 
 HufEncodeEnd (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 VOID 
 MakeCrcTable (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 VOID 
 PutBits (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 n, 
   IN UINT32 x
   );
@@ -188,6 +269,7 @@ PutBits (
 STATIC 
 INT32 
 FreadCrc (
+  IN OUT COMPRESS_DATA  *Cd,
   OUT UINT8 *p, 
   IN  INT32 n
   );
@@ -195,29 +277,34 @@ FreadCrc (
 STATIC 
 VOID 
 InitPutBits (
+  IN OUT COMPRESS_DATA  *Cd
   );
   
 STATIC 
 VOID 
 CountLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 i
   );
 
 STATIC 
 VOID 
 MakeLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Root
   );
   
 STATIC 
 VOID 
 DownHeap (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 i
   );
 
 STATIC 
 VOID 
 MakeCode (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32 n, 
   IN  UINT8 Len[], 
   OUT UINT16 Code[]
@@ -226,6 +313,7 @@ MakeCode (
 STATIC 
 INT32 
 MakeTree (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32   NParm, 
   IN  UINT16  FreqParm[], 
   OUT UINT8   LenParm[], 
@@ -233,25 +321,6 @@ MakeTree (
   );
 
 
-//
-//  Global Variables
-//
-
-STATIC UINT8  *mSrc, *mDst, *mSrcUpperLimit, *mDstUpperLimit;
-
-STATIC UINT8  *mLevel, *mText, *mChildCount, *mBuf, mCLen[NC], mPTLen[NPT], *mLen;
-STATIC INT16  mHeap[NC + 1];
-STATIC INT32  mRemainder, mMatchLen, mBitCount, mHeapSize, mN;
-STATIC UINT32 mBufSiz = 0, mOutputPos, mOutputMask, mSubBitBuf, mCrc;
-STATIC UINT32 mCompSize, mOrigSize;
-
-STATIC UINT16 *mFreq, *mSortPtr, mLenCnt[17], mLeft[2 * NC - 1], mRight[2 * NC - 1],
-              mCrcTable[UINT8_MAX + 1], mCFreq[2 * NC - 1],mCCode[NC],
-              mPFreq[2 * NP - 1], mPTCode[NPT], mTFreq[2 * NT - 1];
-
-STATIC NODE   mPos, mMatchPos, mAvail, *mPosition, *mParent, *mPrev, *mNext = NULL;
-
-
 //
 // functions
 //
@@ -285,75 +354,85 @@ Returns:
 
 --*/
 {
-  EFI_STATUS Status = EFI_SUCCESS;
+  EFI_STATUS    Status = EFI_SUCCESS;
+  COMPRESS_DATA *Cd;
+
+  Cd = malloc (sizeof (COMPRESS_DATA));
+  if (Cd == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
   
   //
   // Initializations
   //
-  mBufSiz = 0;
-  mBuf = NULL;
-  mText       = NULL;
-  mLevel      = NULL;
-  mChildCount = NULL;
-  mPosition   = NULL;
-  mParent     = NULL;
-  mPrev       = NULL;
-  mNext       = NULL;
+  Cd->mBufSiz = 0;
+  Cd->mBuf = NULL;
+  Cd->mText       = NULL;
+  Cd->mLevel      = NULL;
+  Cd->mChildCount = NULL;
+  Cd->mPosition   = NULL;
+  Cd->mParent     = NULL;
+  Cd->mPrev       = NULL;
+  Cd->mNext       = NULL;
 
   
-  mSrc = SrcBuffer;
-  mSrcUpperLimit = mSrc + SrcSize;
-  mDst = DstBuffer;
-  mDstUpperLimit = mDst + *DstSize;
+  Cd->mSrc = SrcBuffer;
+  Cd->mSrcUpperLimit = Cd->mSrc + SrcSize;
+  Cd->mDst = DstBuffer;
+  Cd->mDstUpperLimit = Cd->mDst + *DstSize;
+  Cd->mDepth = 0;
 
-  PutDword(0L);
-  PutDword(0L);
+  PutDword(Cd, 0L);
+  PutDword(Cd, 0L);
   
-  MakeCrcTable ();
+  MakeCrcTable (Cd);
 
-  mOrigSize = mCompSize = 0;
-  mCrc = INIT_CRC;
+  Cd->mOrigSize = Cd->mCompSize = 0;
+  Cd->mCrc = INIT_CRC;
   
   //
   // Compress it
   //
   
-  Status = Encode();
+  Status = Encode(Cd);
   if (EFI_ERROR (Status)) {
+    free (Cd);
     return EFI_OUT_OF_RESOURCES;
   }
   
   //
   // Null terminate the compressed data
   //
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = 0;
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = 0;
   }
   
   //
   // Fill in compressed size and original size
   //
-  mDst = DstBuffer;
-  PutDword(mCompSize+1);
-  PutDword(mOrigSize);
+  Cd->mDst = DstBuffer;
+  PutDword(Cd, Cd->mCompSize+1);
+  PutDword(Cd, Cd->mOrigSize);
 
   //
   // Return
   //
   
-  if (mCompSize + 1 + 8 > *DstSize) {
-    *DstSize = mCompSize + 1 + 8;
-    return EFI_BUFFER_TOO_SMALL;
+  if (Cd->mCompSize + 1 + 8 > *DstSize) {
+    Status = EFI_BUFFER_TOO_SMALL;
   } else {
-    *DstSize = mCompSize + 1 + 8;
-    return EFI_SUCCESS;
+    Status = EFI_SUCCESS;
   }
+  *DstSize = Cd->mCompSize + 1 + 8;
 
+  free (Cd);
+  return Status;
 }
 
 STATIC 
 VOID 
 PutDword(
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Data
   )
 /*++
@@ -364,39 +443,44 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Data    - the dword to put
   
 Returns: (VOID)
   
 --*/
 {
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data        )) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8)(((UINT8)(Data        )) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data >> 0x08)) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8)(((UINT8)(Data >> 0x08)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data >> 0x10)) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8)(((UINT8)(Data >> 0x10)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data >> 0x18)) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8)(((UINT8)(Data >> 0x18)) & 0xff);
   }
 }
 
 STATIC
 EFI_STATUS
-AllocateMemory ()
+AllocateMemory (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   Allocate memory spaces for data structures used in compression process
   
-Argements: (VOID)
+Argements:
+
+  Cd      - The compression context
 
 Returns:
 
@@ -407,74 +491,78 @@ Returns:
 {
   UINT32      i;
   
-  mText       = malloc (WNDSIZ * 2 + MAXMATCH);
+  Cd->mText       = malloc (WNDSIZ * 2 + MAXMATCH);
   for (i = 0 ; i < WNDSIZ * 2 + MAXMATCH; i ++) {
-    mText[i] = 0;
+    Cd->mText[i] = 0;
   }
 
-  mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*mLevel));
-  mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*mChildCount));
-  mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*mPosition));
-  mParent     = malloc (WNDSIZ * 2 * sizeof(*mParent));
-  mPrev       = malloc (WNDSIZ * 2 * sizeof(*mPrev));
-  mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof(*mNext));
-  
-  mBufSiz = 16 * 1024U;
-  while ((mBuf = malloc(mBufSiz)) == NULL) {
-    mBufSiz = (mBufSiz / 10U) * 9U;
-    if (mBufSiz < 4 * 1024U) {
+  Cd->mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*Cd->mLevel));
+  Cd->mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*Cd->mChildCount));
+  Cd->mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*Cd->mPosition));
+  Cd->mParent     = malloc (WNDSIZ * 2 * sizeof(*Cd->mParent));
+  Cd->mPrev       = malloc (WNDSIZ * 2 * sizeof(*Cd->mPrev));
+  Cd->mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof(*Cd->mNext));
+  
+  Cd->mBufSiz = 16 * 1024U;
+  while ((Cd->mBuf = malloc(Cd->mBufSiz)) == NULL) {
+    Cd->mBufSiz = (Cd->mBufSiz / 10U) * 9U;
+    if (Cd->mBufSiz < 4 * 1024U) {
       return EFI_OUT_OF_RESOURCES;
     }
   }
-  mBuf[0] = 0;
+  Cd->mBuf[0] = 0;
   
   return EFI_SUCCESS;
 }
 
 VOID
-FreeMemory ()
+FreeMemory (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   Called when compression is completed to free memory previously allocated.
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
 --*/
 {
-  if (mText) {
-    free (mText);
+  if (Cd->mText) {
+    free (Cd->mText);
   }
   
-  if (mLevel) {
-    free (mLevel);
+  if (Cd->mLevel) {
+    free (Cd->mLevel);
   }
   
-  if (mChildCount) {
-    free (mChildCount);
+  if (Cd->mChildCount) {
+    free (Cd->mChildCount);
   }
   
-  if (mPosition) {
-    free (mPosition);
+  if (Cd->mPosition) {
+    free (Cd->mPosition);
   }
   
-  if (mParent) {
-    free (mParent);
+  if (Cd->mParent) {
+    free (Cd->mParent);
   }
   
-  if (mPrev) {
-    free (mPrev);
+  if (Cd->mPrev) {
+    free (Cd->mPrev);
   }
   
-  if (mNext) {
-    free (mNext);
+  if (Cd->mNext) {
+    free (Cd->mNext);
   }
   
-  if (mBuf) {
-    free (mBuf);
+  if (Cd->mBuf) {
+    free (Cd->mBuf);
   }  
 
   return;
@@ -483,14 +571,18 @@ Returns: (VOID)
 
 STATIC 
 VOID 
-InitSlide ()
+InitSlide (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   Initialize String Info Log data structures
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -499,20 +591,20 @@ Returns: (VOID)
   NODE i;
 
   for (i = WNDSIZ; i <= WNDSIZ + UINT8_MAX; i++) {
-    mLevel[i] = 1;
-    mPosition[i] = NIL;  /* sentinel */
+    Cd->mLevel[i] = 1;
+    Cd->mPosition[i] = NIL;  /* sentinel */
   }
   for (i = WNDSIZ; i < WNDSIZ * 2; i++) {
-    mParent[i] = NIL;
+    Cd->mParent[i] = NIL;
   }  
-  mAvail = 1;
+  Cd->mAvail = 1;
   for (i = 1; i < WNDSIZ - 1; i++) {
-    mNext[i] = (NODE)(i + 1);
+    Cd->mNext[i] = (NODE)(i + 1);
   }
   
-  mNext[WNDSIZ - 1] = NIL;
+  Cd->mNext[WNDSIZ - 1] = NIL;
   for (i = WNDSIZ * 2; i <= MAX_HASH_VAL; i++) {
-    mNext[i] = NIL;
+    Cd->mNext[i] = NIL;
   }  
 }
 
@@ -520,6 +612,7 @@ Returns: (VOID)
 STATIC 
 NODE 
 Child (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE q, 
   IN UINT8 c
   )
@@ -531,6 +624,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   q       - the parent node
   c       - the edge character
   
@@ -542,10 +636,10 @@ Returns:
 {
   NODE r;
   
-  r = mNext[HASH(q, c)];
-  mParent[NIL] = q;  /* sentinel */
-  while (mParent[r] != q) {
-    r = mNext[r];
+  r = Cd->mNext[HASH(q, c)];
+  Cd->mParent[NIL] = q;  /* sentinel */
+  while (Cd->mParent[r] != q) {
+    r = Cd->mNext[r];
   }
   
   return r;
@@ -554,6 +648,7 @@ Returns:
 STATIC 
 VOID 
 MakeChild (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE q, 
   IN UINT8 c, 
   IN NODE r
@@ -566,6 +661,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   q       - the parent node
   c       - the edge character
   r       - the child node
@@ -577,18 +673,19 @@ Returns: (VOID)
   NODE h, t;
   
   h = (NODE)HASH(q, c);
-  t = mNext[h];
-  mNext[h] = r;
-  mNext[r] = t;
-  mPrev[t] = r;
-  mPrev[r] = h;
-  mParent[r] = q;
-  mChildCount[q]++;
+  t = Cd->mNext[h];
+  Cd->mNext[h] = r;
+  Cd->mNext[r] = t;
+  Cd->mPrev[t] = r;
+  Cd->mPrev[r] = h;
+  Cd->mParent[r] = q;
+  Cd->mChildCount[q]++;
 }
 
 STATIC 
 VOID 
 Split (
+  IN OUT COMPRESS_DATA  *Cd,
   NODE Old
   )
 /*++
@@ -599,6 +696,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Old     - the node to split
   
 Returns: (VOID)
@@ -607,32 +705,36 @@ Returns: (VOID)
 {
   NODE New, t;
 
-  New = mAvail;
-  mAvail = mNext[New];
-  mChildCount[New] = 0;
-  t = mPrev[Old];
-  mPrev[New] = t;
-  mNext[t] = New;
-  t = mNext[Old];
-  mNext[New] = t;
-  mPrev[t] = New;
-  mParent[New] = mParent[Old];
-  mLevel[New] = (UINT8)mMatchLen;
-  mPosition[New] = mPos;
-  MakeChild(New, mText[mMatchPos + mMatchLen], Old);
-  MakeChild(New, mText[mPos + mMatchLen], mPos);
+  New = Cd->mAvail;
+  Cd->mAvail = Cd->mNext[New];
+  Cd->mChildCount[New] = 0;
+  t = Cd->mPrev[Old];
+  Cd->mPrev[New] = t;
+  Cd->mNext[t] = New;
+  t = Cd->mNext[Old];
+  Cd->mNext[New] = t;
+  Cd->mPrev[t] = New;
+  Cd->mParent[New] = Cd->mParent[Old];
+  Cd->mLevel[New] = (UINT8)Cd->mMatchLen;
+  Cd->mPosition[New] = Cd->mPos;
+  MakeChild(Cd, New, Cd->mText[Cd->mMatchPos + Cd->mMatchLen], Old);
+  MakeChild(Cd, New, Cd->mText[Cd->mPos + Cd->mMatchLen], Cd->mPos);
 }
 
 STATIC 
 VOID 
-InsertNode ()
+InsertNode (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   Insert string info for current position into the String Info Log
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -641,31 +743,31 @@ Returns: (VOID)
   NODE q, r, j, t;
   UINT8 c, *t1, *t2;
 
-  if (mMatchLen >= 4) {
+  if (Cd->mMatchLen >= 4) {
     
     //
     // We have just got a long match, the target tree
     // can be located by MatchPos + 1. Travese the tree
     // from bottom up to get to a proper starting point.
     // The usage of PERC_FLAG ensures proper node deletion
-    // in DeleteNode() later.
+    // in DeleteNode(Cd) later.
     //
     
-    mMatchLen--;
-    r = (INT16)((mMatchPos + 1) | WNDSIZ);
-    while ((q = mParent[r]) == NIL) {
-      r = mNext[r];
+    Cd->mMatchLen--;
+    r = (INT16)((Cd->mMatchPos + 1) | WNDSIZ);
+    while ((q = Cd->mParent[r]) == NIL) {
+      r = Cd->mNext[r];
     }
-    while (mLevel[q] >= mMatchLen) {
-      r = q;  q = mParent[q];
+    while (Cd->mLevel[q] >= Cd->mMatchLen) {
+      r = q;  q = Cd->mParent[q];
     }
     t = q;
-    while (mPosition[t] < 0) {
-      mPosition[t] = mPos;
-      t = mParent[t];
+    while (Cd->mPosition[t] < 0) {
+      Cd->mPosition[t] = Cd->mPos;
+      t = Cd->mParent[t];
     }
     if (t < WNDSIZ) {
-      mPosition[t] = (NODE)(mPos | PERC_FLAG);
+      Cd->mPosition[t] = (NODE)(Cd->mPos | PERC_FLAG);
     }    
   } else {
     
@@ -673,14 +775,14 @@ Returns: (VOID)
     // Locate the target tree
     //
     
-    q = (INT16)(mText[mPos] + WNDSIZ);
-    c = mText[mPos + 1];
-    if ((r = Child(q, c)) == NIL) {
-      MakeChild(q, c, mPos);
-      mMatchLen = 1;
+    q = (INT16)(Cd->mText[Cd->mPos] + WNDSIZ);
+    c = Cd->mText[Cd->mPos + 1];
+    if ((r = Child(Cd, q, c)) == NIL) {
+      MakeChild(Cd, q, c, Cd->mPos);
+      Cd->mMatchLen = 1;
       return;
     }
-    mMatchLen = 2;
+    Cd->mMatchLen = 2;
   }
   
   //
@@ -692,55 +794,57 @@ Returns: (VOID)
   for ( ; ; ) {
     if (r >= WNDSIZ) {
       j = MAXMATCH;
-      mMatchPos = r;
+      Cd->mMatchPos = r;
     } else {
-      j = mLevel[r];
-      mMatchPos = (NODE)(mPosition[r] & ~PERC_FLAG);
+      j = Cd->mLevel[r];
+      Cd->mMatchPos = (NODE)(Cd->mPosition[r] & ~PERC_FLAG);
     }
-    if (mMatchPos >= mPos) {
-      mMatchPos -= WNDSIZ;
+    if (Cd->mMatchPos >= Cd->mPos) {
+      Cd->mMatchPos -= WNDSIZ;
     }    
-    t1 = &mText[mPos + mMatchLen];
-    t2 = &mText[mMatchPos + mMatchLen];
-    while (mMatchLen < j) {
+    t1 = &Cd->mText[Cd->mPos + Cd->mMatchLen];
+    t2 = &Cd->mText[Cd->mMatchPos + Cd->mMatchLen];
+    while (Cd->mMatchLen < j) {
       if (*t1 != *t2) {
-        Split(r);
+        Split(Cd, r);
         return;
       }
-      mMatchLen++;
+      Cd->mMatchLen++;
       t1++;
       t2++;
     }
-    if (mMatchLen >= MAXMATCH) {
+    if (Cd->mMatchLen >= MAXMATCH) {
       break;
     }
-    mPosition[r] = mPos;
+    Cd->mPosition[r] = Cd->mPos;
     q = r;
-    if ((r = Child(q, *t1)) == NIL) {
-      MakeChild(q, *t1, mPos);
+    if ((r = Child(Cd, q, *t1)) == NIL) {
+      MakeChild(Cd, q, *t1, Cd->mPos);
       return;
     }
-    mMatchLen++;
+    Cd->mMatchLen++;
   }
-  t = mPrev[r];
-  mPrev[mPos] = t;
-  mNext[t] = mPos;
-  t = mNext[r];
-  mNext[mPos] = t;
-  mPrev[t] = mPos;
-  mParent[mPos] = q;
-  mParent[r] = NIL;
+  t = Cd->mPrev[r];
+  Cd->mPrev[Cd->mPos] = t;
+  Cd->mNext[t] = Cd->mPos;
+  t = Cd->mNext[r];
+  Cd->mNext[Cd->mPos] = t;
+  Cd->mPrev[t] = Cd->mPos;
+  Cd->mParent[Cd->mPos] = q;
+  Cd->mParent[r] = NIL;
   
   //
   // Special usage of 'next'
   //
-  mNext[r] = mPos;
+  Cd->mNext[r] = Cd->mPos;
   
 }
 
 STATIC 
 VOID 
-DeleteNode ()
+DeleteNode (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
@@ -748,7 +852,9 @@ Routine Description:
   Delete outdated string info. (The Usage of PERC_FLAG
   ensures a clean deletion)
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -756,65 +862,67 @@ Returns: (VOID)
 {
   NODE q, r, s, t, u;
 
-  if (mParent[mPos] == NIL) {
+  if (Cd->mParent[Cd->mPos] == NIL) {
     return;
   }
   
-  r = mPrev[mPos];
-  s = mNext[mPos];
-  mNext[r] = s;
-  mPrev[s] = r;
-  r = mParent[mPos];
-  mParent[mPos] = NIL;
-  if (r >= WNDSIZ || --mChildCount[r] > 1) {
+  r = Cd->mPrev[Cd->mPos];
+  s = Cd->mNext[Cd->mPos];
+  Cd->mNext[r] = s;
+  Cd->mPrev[s] = r;
+  r = Cd->mParent[Cd->mPos];
+  Cd->mParent[Cd->mPos] = NIL;
+  if (r >= WNDSIZ || --Cd->mChildCount[r] > 1) {
     return;
   }
-  t = (NODE)(mPosition[r] & ~PERC_FLAG);
-  if (t >= mPos) {
+  t = (NODE)(Cd->mPosition[r] & ~PERC_FLAG);
+  if (t >= Cd->mPos) {
     t -= WNDSIZ;
   }
   s = t;
-  q = mParent[r];
-  while ((u = mPosition[q]) & PERC_FLAG) {
+  q = Cd->mParent[r];
+  while ((u = Cd->mPosition[q]) & PERC_FLAG) {
     u &= ~PERC_FLAG;
-    if (u >= mPos) {
+    if (u >= Cd->mPos) {
       u -= WNDSIZ;
     }
     if (u > s) {
       s = u;
     }
-    mPosition[q] = (INT16)(s | WNDSIZ);
-    q = mParent[q];
+    Cd->mPosition[q] = (INT16)(s | WNDSIZ);
+    q = Cd->mParent[q];
   }
   if (q < WNDSIZ) {
-    if (u >= mPos) {
+    if (u >= Cd->mPos) {
       u -= WNDSIZ;
     }
     if (u > s) {
       s = u;
     }
-    mPosition[q] = (INT16)(s | WNDSIZ | PERC_FLAG);
-  }
-  s = Child(r, mText[t + mLevel[r]]);
-  t = mPrev[s];
-  u = mNext[s];
-  mNext[t] = u;
-  mPrev[u] = t;
-  t = mPrev[r];
-  mNext[t] = s;
-  mPrev[s] = t;
-  t = mNext[r];
-  mPrev[t] = s;
-  mNext[s] = t;
-  mParent[s] = mParent[r];
-  mParent[r] = NIL;
-  mNext[r] = mAvail;
-  mAvail = r;
+    Cd->mPosition[q] = (INT16)(s | WNDSIZ | PERC_FLAG);
+  }
+  s = Child(Cd, r, Cd->mText[t + Cd->mLevel[r]]);
+  t = Cd->mPrev[s];
+  u = Cd->mNext[s];
+  Cd->mNext[t] = u;
+  Cd->mPrev[u] = t;
+  t = Cd->mPrev[r];
+  Cd->mNext[t] = s;
+  Cd->mPrev[s] = t;
+  t = Cd->mNext[r];
+  Cd->mPrev[t] = s;
+  Cd->mNext[s] = t;
+  Cd->mParent[s] = Cd->mParent[r];
+  Cd->mParent[r] = NIL;
+  Cd->mNext[r] = Cd->mAvail;
+  Cd->mAvail = r;
 }
 
 STATIC 
 VOID 
-GetNextMatch ()
+GetNextMatch (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
@@ -822,7 +930,9 @@ Routine Description:
   Advance the current position (read in new data if needed).
   Delete outdated string info. Find a match string for current position.
 
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -830,27 +940,31 @@ Returns: (VOID)
 {
   INT32 n;
 
-  mRemainder--;
-  if (++mPos == WNDSIZ * 2) {
-    memmove(&mText[0], &mText[WNDSIZ], WNDSIZ + MAXMATCH);
-    n = FreadCrc(&mText[WNDSIZ + MAXMATCH], WNDSIZ);
-    mRemainder += n;
-    mPos = WNDSIZ;
+  Cd->mRemainder--;
+  if (++Cd->mPos == WNDSIZ * 2) {
+    memmove(&Cd->mText[0], &Cd->mText[WNDSIZ], WNDSIZ + MAXMATCH);
+    n = FreadCrc(Cd, &Cd->mText[WNDSIZ + MAXMATCH], WNDSIZ);
+    Cd->mRemainder += n;
+    Cd->mPos = WNDSIZ;
   }
-  DeleteNode();
-  InsertNode();
+  DeleteNode(Cd);
+  InsertNode(Cd);
 }
 
 STATIC
 EFI_STATUS
-Encode ()
+Encode (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   The main controlling routine for compression process.
 
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns:
   
@@ -863,72 +977,76 @@ Returns:
   INT32       LastMatchLen;
   NODE        LastMatchPos;
 
-  Status = AllocateMemory();
+  Status = AllocateMemory(Cd);
   if (EFI_ERROR(Status)) {
-    FreeMemory();
+    FreeMemory(Cd);
     return Status;
   }
 
-  InitSlide();
+  InitSlide(Cd);
   
-  HufEncodeStart();
+  HufEncodeStart(Cd);
 
-  mRemainder = FreadCrc(&mText[WNDSIZ], WNDSIZ + MAXMATCH);
+  Cd->mRemainder = FreadCrc(Cd, &Cd->mText[WNDSIZ], WNDSIZ + MAXMATCH);
   
-  mMatchLen = 0;
-  mPos = WNDSIZ;
-  InsertNode();
-  if (mMatchLen > mRemainder) {
-    mMatchLen = mRemainder;
+  Cd->mMatchLen = 0;
+  Cd->mPos = WNDSIZ;
+  InsertNode(Cd);
+  if (Cd->mMatchLen > Cd->mRemainder) {
+    Cd->mMatchLen = Cd->mRemainder;
   }
-  while (mRemainder > 0) {
-    LastMatchLen = mMatchLen;
-    LastMatchPos = mMatchPos;
-    GetNextMatch();
-    if (mMatchLen > mRemainder) {
-      mMatchLen = mRemainder;
+  while (Cd->mRemainder > 0) {
+    LastMatchLen = Cd->mMatchLen;
+    LastMatchPos = Cd->mMatchPos;
+    GetNextMatch(Cd);
+    if (Cd->mMatchLen > Cd->mRemainder) {
+      Cd->mMatchLen = Cd->mRemainder;
     }
     
-    if (mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
+    if (Cd->mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
       
       //
       // Not enough benefits are gained by outputting a pointer,
       // so just output the original character
       //
       
-      Output(mText[mPos - 1], 0);
+      Output(Cd, Cd->mText[Cd->mPos - 1], 0);
     } else {
       
       //
       // Outputting a pointer is beneficial enough, do it.
       //
       
-      Output(LastMatchLen + (UINT8_MAX + 1 - THRESHOLD),
-             (mPos - LastMatchPos - 2) & (WNDSIZ - 1));
+      Output(Cd, LastMatchLen + (UINT8_MAX + 1 - THRESHOLD),
+             (Cd->mPos - LastMatchPos - 2) & (WNDSIZ - 1));
       while (--LastMatchLen > 0) {
-        GetNextMatch();
+        GetNextMatch(Cd);
       }
-      if (mMatchLen > mRemainder) {
-        mMatchLen = mRemainder;
+      if (Cd->mMatchLen > Cd->mRemainder) {
+        Cd->mMatchLen = Cd->mRemainder;
       }
     }
   }
   
-  HufEncodeEnd();
-  FreeMemory();
+  HufEncodeEnd(Cd);
+  FreeMemory(Cd);
   return EFI_SUCCESS;
 }
 
 STATIC 
 VOID 
-CountTFreq ()
+CountTFreq (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   Count the frequencies for the Extra Set
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -937,33 +1055,33 @@ Returns: (VOID)
   INT32 i, k, n, Count;
 
   for (i = 0; i < NT; i++) {
-    mTFreq[i] = 0;
+    Cd->mTFreq[i] = 0;
   }
   n = NC;
-  while (n > 0 && mCLen[n - 1] == 0) {
+  while (n > 0 && Cd->mCLen[n - 1] == 0) {
     n--;
   }
   i = 0;
   while (i < n) {
-    k = mCLen[i++];
+    k = Cd->mCLen[i++];
     if (k == 0) {
       Count = 1;
-      while (i < n && mCLen[i] == 0) {
+      while (i < n && Cd->mCLen[i] == 0) {
         i++;
         Count++;
       }
       if (Count <= 2) {
-        mTFreq[0] = (UINT16)(mTFreq[0] + Count);
+        Cd->mTFreq[0] = (UINT16)(Cd->mTFreq[0] + Count);
       } else if (Count <= 18) {
-        mTFreq[1]++;
+        Cd->mTFreq[1]++;
       } else if (Count == 19) {
-        mTFreq[0]++;
-        mTFreq[1]++;
+        Cd->mTFreq[0]++;
+        Cd->mTFreq[1]++;
       } else {
-        mTFreq[2]++;
+        Cd->mTFreq[2]++;
       }
     } else {
-      mTFreq[k + 2]++;
+      Cd->mTFreq[k + 2]++;
     }
   }
 }
@@ -971,6 +1089,7 @@ Returns: (VOID)
 STATIC 
 VOID 
 WritePTLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 n, 
   IN INT32 nbit, 
   IN INT32 Special
@@ -983,6 +1102,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   n       - the number of symbols
   nbit    - the number of bits needed to represent 'n'
   Special - the special symbol that needs to be take care of
@@ -993,37 +1113,41 @@ Returns: (VOID)
 {
   INT32 i, k;
 
-  while (n > 0 && mPTLen[n - 1] == 0) {
+  while (n > 0 && Cd->mPTLen[n - 1] == 0) {
     n--;
   }
-  PutBits(nbit, n);
+  PutBits(Cd, nbit, n);
   i = 0;
   while (i < n) {
-    k = mPTLen[i++];
+    k = Cd->mPTLen[i++];
     if (k <= 6) {
-      PutBits(3, k);
+      PutBits(Cd, 3, k);
     } else {
-      PutBits(k - 3, (1U << (k - 3)) - 2);
+      PutBits(Cd, k - 3, (1U << (k - 3)) - 2);
     }
     if (i == Special) {
-      while (i < 6 && mPTLen[i] == 0) {
+      while (i < 6 && Cd->mPTLen[i] == 0) {
         i++;
       }
-      PutBits(2, (i - 3) & 3);
+      PutBits(Cd, 2, (i - 3) & 3);
     }
   }
 }
 
 STATIC 
 VOID 
-WriteCLen ()
+WriteCLen (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   Outputs the code length array for Char&Length Set
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -1032,36 +1156,36 @@ Returns: (VOID)
   INT32 i, k, n, Count;
 
   n = NC;
-  while (n > 0 && mCLen[n - 1] == 0) {
+  while (n > 0 && Cd->mCLen[n - 1] == 0) {
     n--;
   }
-  PutBits(CBIT, n);
+  PutBits(Cd, CBIT, n);
   i = 0;
   while (i < n) {
-    k = mCLen[i++];
+    k = Cd->mCLen[i++];
     if (k == 0) {
       Count = 1;
-      while (i < n && mCLen[i] == 0) {
+      while (i < n && Cd->mCLen[i] == 0) {
         i++;
         Count++;
       }
       if (Count <= 2) {
         for (k = 0; k < Count; k++) {
-          PutBits(mPTLen[0], mPTCode[0]);
+          PutBits(Cd, Cd->mPTLen[0], Cd->mPTCode[0]);
         }
       } else if (Count <= 18) {
-        PutBits(mPTLen[1], mPTCode[1]);
-        PutBits(4, Count - 3);
+        PutBits(Cd, Cd->mPTLen[1], Cd->mPTCode[1]);
+        PutBits(Cd, 4, Count - 3);
       } else if (Count == 19) {
-        PutBits(mPTLen[0], mPTCode[0]);
-        PutBits(mPTLen[1], mPTCode[1]);
-        PutBits(4, 15);
+        PutBits(Cd, Cd->mPTLen[0], Cd->mPTCode[0]);
+        PutBits(Cd, Cd->mPTLen[1], Cd->mPTCode[1]);
+        PutBits(Cd, 4, 15);
       } else {
-        PutBits(mPTLen[2], mPTCode[2]);
-        PutBits(CBIT, Count - 20);
+        PutBits(Cd, Cd->mPTLen[2], Cd->mPTCode[2]);
+        PutBits(Cd, CBIT, Count - 20);
       }
     } else {
-      PutBits(mPTLen[k + 2], mPTCode[k + 2]);
+      PutBits(Cd, Cd->mPTLen[k + 2], Cd->mPTCode[k + 2]);
     }
   }
 }
@@ -1069,15 +1193,17 @@ Returns: (VOID)
 STATIC 
 VOID 
 EncodeC (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 c
   )
 {
-  PutBits(mCLen[c], mCCode[c]);
+  PutBits(Cd, Cd->mCLen[c], Cd->mCCode[c]);
 }
 
 STATIC 
 VOID 
 EncodeP (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 p
   )
 {
@@ -1089,22 +1215,26 @@ EncodeP (
     q >>= 1;
     c++;
   }
-  PutBits(mPTLen[c], mPTCode[c]);
+  PutBits(Cd, Cd->mPTLen[c], Cd->mPTCode[c]);
   if (c > 1) {
-    PutBits(c - 1, p & (0xFFFFU >> (17 - c)));
+    PutBits(Cd, c - 1, p & (0xFFFFU >> (17 - c)));
   }
 }
 
 STATIC 
 VOID 
-SendBlock ()
+SendBlock (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 /*++
 
 Routine Description:
 
   Huffman code the block and output it.
   
-Argument: (VOID)
+Argument:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -1113,53 +1243,53 @@ Returns: (VOID)
   UINT32 i, k, Flags, Root, Pos, Size;
   Flags = 0;
 
-  Root = MakeTree(NC, mCFreq, mCLen, mCCode);
-  Size = mCFreq[Root];
-  PutBits(16, Size);
+  Root = MakeTree(Cd, NC, Cd->mCFreq, Cd->mCLen, Cd->mCCode);
+  Size = Cd->mCFreq[Root];
+  PutBits(Cd, 16, Size);
   if (Root >= NC) {
-    CountTFreq();
-    Root = MakeTree(NT, mTFreq, mPTLen, mPTCode);
+    CountTFreq(Cd);
+    Root = MakeTree(Cd, NT, Cd->mTFreq, Cd->mPTLen, Cd->mPTCode);
     if (Root >= NT) {
-      WritePTLen(NT, TBIT, 3);
+      WritePTLen(Cd, NT, TBIT, 3);
     } else {
-      PutBits(TBIT, 0);
-      PutBits(TBIT, Root);
+      PutBits(Cd, TBIT, 0);
+      PutBits(Cd, TBIT, Root);
     }
-    WriteCLen();
+    WriteCLen(Cd);
   } else {
-    PutBits(TBIT, 0);
-    PutBits(TBIT, 0);
-    PutBits(CBIT, 0);
-    PutBits(CBIT, Root);
+    PutBits(Cd, TBIT, 0);
+    PutBits(Cd, TBIT, 0);
+    PutBits(Cd, CBIT, 0);
+    PutBits(Cd, CBIT, Root);
   }
-  Root = MakeTree(NP, mPFreq, mPTLen, mPTCode);
+  Root = MakeTree(Cd, NP, Cd->mPFreq, Cd->mPTLen, Cd->mPTCode);
   if (Root >= NP) {
-    WritePTLen(NP, PBIT, -1);
+    WritePTLen(Cd, NP, PBIT, -1);
   } else {
-    PutBits(PBIT, 0);
-    PutBits(PBIT, Root);
+    PutBits(Cd, PBIT, 0);
+    PutBits(Cd, PBIT, Root);
   }
   Pos = 0;
   for (i = 0; i < Size; i++) {
     if (i % UINT8_BIT == 0) {
-      Flags = mBuf[Pos++];
+      Flags = Cd->mBuf[Pos++];
     } else {
       Flags <<= 1;
     }
     if (Flags & (1U << (UINT8_BIT - 1))) {
-      EncodeC(mBuf[Pos++] + (1U << UINT8_BIT));
-      k = mBuf[Pos++] << UINT8_BIT;
-      k += mBuf[Pos++];
-      EncodeP(k);
+      EncodeC(Cd, Cd->mBuf[Pos++] + (1U << UINT8_BIT));
+      k = Cd->mBuf[Pos++] << UINT8_BIT;
+      k += Cd->mBuf[Pos++];
+      EncodeP(Cd, k);
     } else {
-      EncodeC(mBuf[Pos++]);
+      EncodeC(Cd, Cd->mBuf[Pos++]);
     }
   }
   for (i = 0; i < NC; i++) {
-    mCFreq[i] = 0;
+    Cd->mCFreq[i] = 0;
   }
   for (i = 0; i < NP; i++) {
-    mPFreq[i] = 0;
+    Cd->mPFreq[i] = 0;
   }
 }
 
@@ -1167,6 +1297,7 @@ Returns: (VOID)
 STATIC 
 VOID 
 Output (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 c, 
   IN UINT32 p
   )
@@ -1178,6 +1309,7 @@ Routine Description:
 
 Arguments:
 
+  Cd      - The compression context
   c     - The original character or the 'String Length' element of a Pointer
   p     - The 'Position' field of a Pointer
 
@@ -1185,59 +1317,62 @@ Returns: (VOID)
 
 --*/
 {
-  STATIC UINT32 CPos;
 
-  if ((mOutputMask >>= 1) == 0) {
-    mOutputMask = 1U << (UINT8_BIT - 1);
-    if (mOutputPos >= mBufSiz - 3 * UINT8_BIT) {
-      SendBlock();
-      mOutputPos = 0;
+  if ((Cd->mOutputMask >>= 1) == 0) {
+    Cd->mOutputMask = 1U << (UINT8_BIT - 1);
+    if (Cd->mOutputPos >= Cd->mBufSiz - 3 * UINT8_BIT) {
+      SendBlock(Cd);
+      Cd->mOutputPos = 0;
     }
-    CPos = mOutputPos++;  
-    mBuf[CPos] = 0;
+    Cd->mCPos = Cd->mOutputPos++;  
+    Cd->mBuf[Cd->mCPos] = 0;
   }
-  mBuf[mOutputPos++] = (UINT8) c;
-  mCFreq[c]++;
+  Cd->mBuf[Cd->mOutputPos++] = (UINT8) c;
+  Cd->mCFreq[c]++;
   if (c >= (1U << UINT8_BIT)) {
-    mBuf[CPos] |= mOutputMask;
-    mBuf[mOutputPos++] = (UINT8)(p >> UINT8_BIT);
-    mBuf[mOutputPos++] = (UINT8) p;
+    Cd->mBuf[Cd->mCPos] |= Cd->mOutputMask;
+    Cd->mBuf[Cd->mOutputPos++] = (UINT8)(p >> UINT8_BIT);
+    Cd->mBuf[Cd->mOutputPos++] = (UINT8) p;
     c = 0;
     while (p) {
       p >>= 1;
       c++;
     }
-    mPFreq[c]++;
+    Cd->mPFreq[c]++;
   }
 }
 
 STATIC
 VOID
-HufEncodeStart ()
+HufEncodeStart (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 {
   INT32 i;
 
   for (i = 0; i < NC; i++) {
-    mCFreq[i] = 0;
+    Cd->mCFreq[i] = 0;
   }
   for (i = 0; i < NP; i++) {
-    mPFreq[i] = 0;
+    Cd->mPFreq[i] = 0;
   }
-  mOutputPos = mOutputMask = 0;
-  InitPutBits();
+  Cd->mOutputPos = Cd->mOutputMask = 0;
+  InitPutBits(Cd);
   return;
 }
 
 STATIC 
 VOID 
-HufEncodeEnd ()
+HufEncodeEnd (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 {
-  SendBlock();
+  SendBlock(Cd);
   
   //
   // Flush remaining bits
   //
-  PutBits(UINT8_BIT - 1, 0);
+  PutBits(Cd, UINT8_BIT - 1, 0);
   
   return;
 }
@@ -1245,7 +1380,9 @@ HufEncodeEnd ()
 
 STATIC 
 VOID 
-MakeCrcTable ()
+MakeCrcTable (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 {
   UINT32 i, j, r;
 
@@ -1258,13 +1395,14 @@ MakeCrcTable ()
         r >>= 1;
       }
     }
-    mCrcTable[i] = (UINT16)r;    
+    Cd->mCrcTable[i] = (UINT16)r;    
   }
 }
 
 STATIC 
 VOID 
 PutBits (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 n, 
   IN UINT32 x
   )
@@ -1276,6 +1414,7 @@ Routine Description:
 
 Argments:
 
+  Cd      - The compression context
   n   - the rightmost n bits of the data is used
   x   - the data 
 
@@ -1285,27 +1424,27 @@ Returns: (VOID)
 {
   UINT8 Temp;  
   
-  if (n < mBitCount) {
-    mSubBitBuf |= x << (mBitCount -= n);
+  if (n < Cd->mBitCount) {
+    Cd->mSubBitBuf |= x << (Cd->mBitCount -= n);
   } else {
       
-    Temp = (UINT8)(mSubBitBuf | (x >> (n -= mBitCount)));
-    if (mDst < mDstUpperLimit) {
-      *mDst++ = Temp;
+    Temp = (UINT8)(Cd->mSubBitBuf | (x >> (n -= Cd->mBitCount)));
+    if (Cd->mDst < Cd->mDstUpperLimit) {
+      *Cd->mDst++ = Temp;
     }
-    mCompSize++;
+    Cd->mCompSize++;
 
     if (n < UINT8_BIT) {
-      mSubBitBuf = x << (mBitCount = UINT8_BIT - n);
+      Cd->mSubBitBuf = x << (Cd->mBitCount = UINT8_BIT - n);
     } else {
         
       Temp = (UINT8)(x >> (n - UINT8_BIT));
-      if (mDst < mDstUpperLimit) {
-        *mDst++ = Temp;
+      if (Cd->mDst < Cd->mDstUpperLimit) {
+        *Cd->mDst++ = Temp;
       }
-      mCompSize++;
+      Cd->mCompSize++;
       
-      mSubBitBuf = x << (mBitCount = 2 * UINT8_BIT - n);
+      Cd->mSubBitBuf = x << (Cd->mBitCount = 2 * UINT8_BIT - n);
     }
   }
 }
@@ -1313,6 +1452,7 @@ Returns: (VOID)
 STATIC 
 INT32 
 FreadCrc (
+  IN OUT COMPRESS_DATA  *Cd,
   OUT UINT8 *p, 
   IN  INT32 n
   )
@@ -1324,6 +1464,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   p   - the buffer to hold the data
   n   - number of bytes to read
 
@@ -1335,15 +1476,15 @@ Returns:
 {
   INT32 i;
 
-  for (i = 0; mSrc < mSrcUpperLimit && i < n; i++) {
-    *p++ = *mSrc++;
+  for (i = 0; Cd->mSrc < Cd->mSrcUpperLimit && i < n; i++) {
+    *p++ = *Cd->mSrc++;
   }
   n = i;
 
   p -= n;
-  mOrigSize += n;
+  Cd->mOrigSize += n;
   while (--i >= 0) {
-    UPDATE_CRC(*p++);
+    UPDATE_CRC(Cd, *p++);
   }
   return n;
 }
@@ -1351,15 +1492,18 @@ Returns:
 
 STATIC 
 VOID 
-InitPutBits ()
+InitPutBits (
+  IN OUT COMPRESS_DATA  *Cd
+  )
 {
-  mBitCount = UINT8_BIT;  
-  mSubBitBuf = 0;
+  Cd->mBitCount = UINT8_BIT;  
+  Cd->mSubBitBuf = 0;
 }
 
 STATIC 
 VOID 
 CountLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 i
   )
 /*++
@@ -1370,27 +1514,28 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   i   - the top node
   
 Returns: (VOID)
 
 --*/
 {
-  STATIC INT32 Depth = 0;
 
-  if (i < mN) {
-    mLenCnt[(Depth < 16) ? Depth : 16]++;
+  if (i < Cd->mN) {
+    Cd->mLenCnt[(Cd->mDepth < 16) ? Cd->mDepth : 16]++;
   } else {
-    Depth++;
-    CountLen(mLeft [i]);
-    CountLen(mRight[i]);
-    Depth--;
+    Cd->mDepth++;
+    CountLen(Cd, Cd->mLeft [i]);
+    CountLen(Cd, Cd->mRight[i]);
+    Cd->mDepth--;
   }
 }
 
 STATIC 
 VOID 
 MakeLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Root
   )
 /*++
@@ -1401,6 +1546,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Root   - the root of the tree
 
 --*/
@@ -1409,9 +1555,9 @@ Arguments:
   UINT32 Cum;
 
   for (i = 0; i <= 16; i++) {
-    mLenCnt[i] = 0;
+    Cd->mLenCnt[i] = 0;
   }
-  CountLen(Root);
+  CountLen(Cd, Root);
   
   //
   // Adjust the length count array so that
@@ -1420,23 +1566,23 @@ Arguments:
   
   Cum = 0;
   for (i = 16; i > 0; i--) {
-    Cum += mLenCnt[i] << (16 - i);
+    Cum += Cd->mLenCnt[i] << (16 - i);
   }
   while (Cum != (1U << 16)) {
-    mLenCnt[16]--;
+    Cd->mLenCnt[16]--;
     for (i = 15; i > 0; i--) {
-      if (mLenCnt[i] != 0) {
-        mLenCnt[i]--;
-        mLenCnt[i+1] += 2;
+      if (Cd->mLenCnt[i] != 0) {
+        Cd->mLenCnt[i]--;
+        Cd->mLenCnt[i+1] += 2;
         break;
       }
     }
     Cum--;
   }
   for (i = 16; i > 0; i--) {
-    k = mLenCnt[i];
+    k = Cd->mLenCnt[i];
     while (--k >= 0) {
-      mLen[*mSortPtr++] = (UINT8)i;
+      Cd->mLen[*Cd->mSortPtr++] = (UINT8)i;
     }
   }
 }
@@ -1444,6 +1590,7 @@ Arguments:
 STATIC 
 VOID 
 DownHeap (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 i
   )
 {
@@ -1453,23 +1600,24 @@ DownHeap (
   // priority queue: send i-th entry down heap
   //
   
-  k = mHeap[i];
-  while ((j = 2 * i) <= mHeapSize) {
-    if (j < mHeapSize && mFreq[mHeap[j]] > mFreq[mHeap[j + 1]]) {
+  k = Cd->mHeap[i];
+  while ((j = 2 * i) <= Cd->mHeapSize) {
+    if (j < Cd->mHeapSize && Cd->mFreq[Cd->mHeap[j]] > Cd->mFreq[Cd->mHeap[j + 1]]) {
       j++;
     }
-    if (mFreq[k] <= mFreq[mHeap[j]]) {
+    if (Cd->mFreq[k] <= Cd->mFreq[Cd->mHeap[j]]) {
       break;
     }
-    mHeap[i] = mHeap[j];
+    Cd->mHeap[i] = Cd->mHeap[j];
     i = j;
   }
-  mHeap[i] = (INT16)k;
+  Cd->mHeap[i] = (INT16)k;
 }
 
 STATIC 
 VOID 
 MakeCode (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32 n, 
   IN  UINT8 Len[], 
   OUT UINT16 Code[]
@@ -1482,6 +1630,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   n     - number of symbols
   Len   - the code length array
   Code  - stores codes for each symbol
@@ -1495,7 +1644,7 @@ Returns: (VOID)
 
   Start[1] = 0;
   for (i = 1; i <= 16; i++) {
-    Start[i + 1] = (UINT16)((Start[i] + mLenCnt[i]) << 1);
+    Start[i + 1] = (UINT16)((Start[i] + Cd->mLenCnt[i]) << 1);
   }
   for (i = 0; i < n; i++) {
     Code[i] = Start[Len[i]]++;
@@ -1505,6 +1654,7 @@ Returns: (VOID)
 STATIC 
 INT32 
 MakeTree (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32   NParm, 
   IN  UINT16  FreqParm[], 
   OUT UINT8   LenParm[], 
@@ -1518,6 +1668,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   NParm    - number of symbols
   FreqParm - frequency of each symbol
   LenParm  - code length for each symbol
@@ -1535,52 +1686,52 @@ Returns:
   // make tree, calculate len[], return root
   //
 
-  mN = NParm;
-  mFreq = FreqParm;
-  mLen = LenParm;
-  Avail = mN;
-  mHeapSize = 0;
-  mHeap[1] = 0;
-  for (i = 0; i < mN; i++) {
-    mLen[i] = 0;
-    if (mFreq[i]) {
-      mHeap[++mHeapSize] = (INT16)i;
+  Cd->mN = NParm;
+  Cd->mFreq = FreqParm;
+  Cd->mLen = LenParm;
+  Avail = Cd->mN;
+  Cd->mHeapSize = 0;
+  Cd->mHeap[1] = 0;
+  for (i = 0; i < Cd->mN; i++) {
+    Cd->mLen[i] = 0;
+    if (Cd->mFreq[i]) {
+      Cd->mHeap[++Cd->mHeapSize] = (INT16)i;
     }    
   }
-  if (mHeapSize < 2) {
-    CodeParm[mHeap[1]] = 0;
-    return mHeap[1];
+  if (Cd->mHeapSize < 2) {
+    CodeParm[Cd->mHeap[1]] = 0;
+    return Cd->mHeap[1];
   }
-  for (i = mHeapSize / 2; i >= 1; i--) {
+  for (i = Cd->mHeapSize / 2; i >= 1; i--) {
     
     //
     // make priority queue 
     //
-    DownHeap(i);
+    DownHeap(Cd, i);
   }
-  mSortPtr = CodeParm;
+  Cd->mSortPtr = CodeParm;
   do {
-    i = mHeap[1];
-    if (i < mN) {
-      *mSortPtr++ = (UINT16)i;
+    i = Cd->mHeap[1];
+    if (i < Cd->mN) {
+      *Cd->mSortPtr++ = (UINT16)i;
     }
-    mHeap[1] = mHeap[mHeapSize--];
-    DownHeap(1);
-    j = mHeap[1];
-    if (j < mN) {
-      *mSortPtr++ = (UINT16)j;
+    Cd->mHeap[1] = Cd->mHeap[Cd->mHeapSize--];
+    DownHeap(Cd, 1);
+    j = Cd->mHeap[1];
+    if (j < Cd->mN) {
+      *Cd->mSortPtr++ = (UINT16)j;
     }
     k = Avail++;
-    mFreq[k] = (UINT16)(mFreq[i] + mFreq[j]);
-    mHeap[1] = (INT16)k;
-    DownHeap(1);
-    mLeft[k] = (UINT16)i;
-    mRight[k] = (UINT16)j;
-  } while (mHeapSize > 1);
-  
-  mSortPtr = CodeParm;
-  MakeLen(k);
-  MakeCode(NParm, LenParm, CodeParm);
+    Cd->mFreq[k] = (UINT16)(Cd->mFreq[i] + Cd->mFreq[j]);
+    Cd->mHeap[1] = (INT16)k;
+    DownHeap(Cd, 1);
+    Cd->mLeft[k] = (UINT16)i;
+    Cd->mRight[k] = (UINT16)j;
+  } while (Cd->mHeapSize > 1);
+  
+  Cd->mSortPtr = CodeParm;
+  MakeLen(Cd, k);
+  MakeCode(Cd, NParm, LenParm, CodeParm);
   
   //
   // return root
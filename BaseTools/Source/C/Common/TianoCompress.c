@@ -36,7 +36,7 @@ typedef INT32 NODE;
 #define MAX_HASH_VAL  (3 * WNDSIZ + (WNDSIZ / 512 + 1) * UINT8_MAX)
 #define HASH(p, c)    ((p) + ((c) << (WNDBIT - 9)) + WNDSIZ * 2)
 #define CRCPOLY       0xA001
-#define UPDATE_CRC(c) mCrc = mCrcTable[(mCrc ^ (c)) & 0xFF] ^ (mCrc >> UINT8_BIT)
+#define UPDATE_CRC(Cd, c) (Cd)->mCrc = (Cd)->mCrcTable[((Cd)->mCrc ^ (c)) & 0xFF] ^ ((Cd)->mCrc >> UINT8_BIT)
 
 //
 // C: the Char&Len Set; P: the Position Set; T: the exTra Set
@@ -52,6 +52,65 @@ typedef INT32 NODE;
 #else
 #define NPT NP
 #endif
+//
+// The state of one compression. Each call to TianoCompress() has its own, so
+// several compressions can run at the same time in one process.
+//
+typedef struct {
+  UINT8   *mSrc;
+  UINT8   *mDst;
+  UINT8   *mSrcUpperLimit;
+  UINT8   *mDstUpperLimit;
+
+  //
+  // String Info Log
+  //
+  UINT8   *mText;
+  UINT8   *mLevel;
+  UINT8   *mChildCount;
+  NODE    *mPosition;
+  NODE    *mParent;
+  NODE    *mPrev;
+  NODE    *mNext;
+  NODE    mPos;
+  NODE    mMatchPos;
+  NODE    mAvail;
+  INT32   mRemainder;
+  INT32   mMatchLen;
+
+  //
+  // Huffman encoding of the blocks
+  //
+  UINT8   *mBuf;
+  UINT32  mBufSiz;
+  UINT32  mOutputPos;
+  UINT32  mOutputMask;
+  UINT32  mCPos;
+  INT32   mBitCount;
+  UINT32  mSubBitBuf;
+  UINT32  mCompSize;
+  UINT32  mOrigSize;
+  UINT32  mCrc;
+  UINT16  mCrcTable[UINT8_MAX + 1];
+  INT32   mN;
+  INT32   mHeapSize;
+  INT32   mDepth;
+  INT16   mHeap[NC + 1];
+  UINT16  *mFreq;
+  UINT16  *mSortPtr;
+  UINT8   *mLen;
+  UINT16  mLenCnt[17];
+  UINT16  mLeft[2 * NC - 1];
+  UINT16  mRight[2 * NC - 1];
+  UINT8   mCLen[NC];
+  UINT8   mPTLen[NPT];
+  UINT16  mCFreq[2 * NC - 1];
+  UINT16  mCCode[NC];
+  UINT16  mPFreq[2 * NP - 1];
+  UINT16  mPTCode[NPT];
+  UINT16  mTFreq[2 * NT - 1];
+} COMPRESS_DATA;
+
 //
 // Function Prototypes
 //
@@ -59,30 +118,32 @@ typedef INT32 NODE;
 STATIC
 VOID
 PutDword(
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Data
   );
 
 STATIC
 EFI_STATUS
 AllocateMemory (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 FreeMemory (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 InitSlide (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 NODE
 Child (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE   NodeQ,
   IN UINT8  CharC
   );
@@ -90,6 +151,7 @@ Child (
 STATIC
 VOID
 MakeChild (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE  NodeQ,
   IN UINT8 CharC,
   IN NODE  NodeR
@@ -98,42 +160,44 @@ MakeChild (
 STATIC
 VOID
 Split (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE Old
   );
 
 STATIC
 VOID
 InsertNode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 DeleteNode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 GetNextMatch (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 EFI_STATUS
 Encode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 CountTFreq (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 WritePTLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Number,
   IN INT32 nbit,
   IN INT32 Special
@@ -142,30 +206,33 @@ WritePTLen (
 STATIC
 VOID
 WriteCLen (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 EncodeC (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Value
   );
 
 STATIC
 VOID
 EncodeP (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Value
   );
 
 STATIC
 VOID
 SendBlock (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 Output (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 c,
   IN UINT32 p
   );
@@ -173,24 +240,25 @@ Output (
 STATIC
 VOID
 HufEncodeStart (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 HufEncodeEnd (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 MakeCrcTable (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 PutBits (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32  Number,
   IN UINT32 Value
   );
@@ -198,6 +266,7 @@ PutBits (
 STATIC
 INT32
 FreadCrc (
+  IN OUT COMPRESS_DATA  *Cd,
   OUT UINT8 *Pointer,
   IN  INT32 Number
   );
@@ -205,30 +274,34 @@ FreadCrc (
 STATIC
 VOID
 InitPutBits (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 CountLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Index
   );
 
 STATIC
 VOID
 MakeLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Root
   );
 
 STATIC
 VOID
 DownHeap (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Index
   );
 
 STATIC
 VOID
 MakeCode (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32       Number,
   IN  UINT8 Len[  ],
   OUT UINT16 Code[]
@@ -237,28 +310,13 @@ MakeCode (
 STATIC
 INT32
 MakeTree (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32            NParm,
   IN  UINT16  FreqParm[],
   OUT UINT8   LenParm[ ],
   OUT UINT16  CodeParm[]
   );
 
-//
-//  Global Variables
-//
-STATIC UINT8  *mSrc, *mDst, *mSrcUpperLimit, *mDstUpperLimit;
-
-STATIC UINT8  *mLevel, *mText, *mChildCount, *mBuf, mCLen[NC], mPTLen[NPT], *mLen;
-STATIC INT16  mHeap[NC + 1];
-STATIC INT32  mRemainder, mMatchLen, mBitCount, mHeapSize, mN;
-STATIC UINT32 mBufSiz = 0, mOutputPos, mOutputMask, mSubBitBuf, mCrc;
-STATIC UINT32 mCompSize, mOrigSize;
-
-STATIC UINT16 *mFreq, *mSortPtr, mLenCnt[17], mLeft[2 * NC - 1], mRight[2 * NC - 1], mCrcTable[UINT8_MAX + 1],
-  mCFreq[2 * NC - 1], mCCode[NC], mPFreq[2 * NP - 1], mPTCode[NPT], mTFreq[2 * NT - 1];
-
-STATIC NODE   mPos, mMatchPos, mAvail, *mPosition, *mParent, *mPrev, *mNext = NULL;
-
 //
 // functions
 //
@@ -296,70 +354,81 @@ Returns:
 
 --*/
 {
-  EFI_STATUS  Status;
+  EFI_STATUS     Status;
+  COMPRESS_DATA  *Cd;
+
+  Cd = malloc (sizeof (COMPRESS_DATA));
+  if (Cd == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
 
   //
   // Initializations
   //
-  mBufSiz         = 0;
-  mBuf            = NULL;
-  mText           = NULL;
-  mLevel          = NULL;
-  mChildCount     = NULL;
-  mPosition       = NULL;
-  mParent         = NULL;
-  mPrev           = NULL;
-  mNext           = NULL;
-
-  mSrc            = SrcBuffer;
-  mSrcUpperLimit  = mSrc + SrcSize;
-  mDst            = DstBuffer;
-  mDstUpperLimit  = mDst +*DstSize;
-
-  PutDword (0L);
-  PutDword (0L);
-
-  MakeCrcTable ();
-
-  mOrigSize             = mCompSize = 0;
-  mCrc                  = INIT_CRC;
+  Cd->mBufSiz         = 0;
+  Cd->mBuf            = NULL;
+  Cd->mText           = NULL;
+  Cd->mLevel          = NULL;
+  Cd->mChildCount     = NULL;
+  Cd->mPosition       = NULL;
+  Cd->mParent         = NULL;
+  Cd->mPrev           = NULL;
+  Cd->mNext           = NULL;
+
+  Cd->mSrc            = SrcBuffer;
+  Cd->mSrcUpperLimit  = Cd->mSrc + SrcSize;
+  Cd->mDst            = DstBuffer;
+  Cd->mDstUpperLimit  = Cd->mDst +*DstSize;
+  Cd->mDepth          = 0;
+
+  PutDword (Cd, 0L);
+  PutDword (Cd, 0L);
+
+  MakeCrcTable (Cd);
+
+  Cd->mOrigSize             = Cd->mCompSize = 0;
+  Cd->mCrc                  = INIT_CRC;
 
   //
   // Compress it
   //
-  Status = Encode ();
+  Status = Encode (Cd);
   if (EFI_ERROR (Status)) {
+    free (Cd);
     return EFI_OUT_OF_RESOURCES;
   }
   //
   // Null terminate the compressed data
   //
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = 0;
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = 0;
   }
   //
   // Fill in compressed size and original size
   //
-  mDst = DstBuffer;
-  PutDword (mCompSize + 1);
-  PutDword (mOrigSize);
+  Cd->mDst = DstBuffer;
+  PutDword (Cd, Cd->mCompSize + 1);
+  PutDword (Cd, Cd->mOrigSize);
 
   //
   // Return
   //
-  if (mCompSize + 1 + 8 > *DstSize) {
-    *DstSize = mCompSize + 1 + 8;
-    return EFI_BUFFER_TOO_SMALL;
+  if (Cd->mCompSize + 1 + 8 > *DstSize) {
+    Status = EFI_BUFFER_TOO_SMALL;
   } else {
-    *DstSize = mCompSize + 1 + 8;
-    return EFI_SUCCESS;
+    Status = EFI_SUCCESS;
   }
+  *DstSize = Cd->mCompSize + 1 + 8;
+
+  free (Cd);
+  return Status;
 
 }
 
 STATIC
 VOID
 PutDword (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Data
   )
 /*++
@@ -370,33 +439,34 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Data    - the dword to put
   
 Returns: (VOID)
   
 --*/
 {
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data)) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8) (((UINT8) (Data)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x08)) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8) (((UINT8) (Data >> 0x08)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x10)) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8) (((UINT8) (Data >> 0x10)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x18)) & 0xff);
+  if (Cd->mDst < Cd->mDstUpperLimit) {
+    *Cd->mDst++ = (UINT8) (((UINT8) (Data >> 0x18)) & 0xff);
   }
 }
 
 STATIC
 EFI_STATUS
 AllocateMemory (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -405,7 +475,7 @@ Routine Description:
   Allocate memory spaces for data structures used in compression process
   
 Argements: 
-  VOID
+  Cd      - The compression context
 
 Returns:
 
@@ -416,37 +486,37 @@ Returns:
 {
   UINT32  Index;
 
-  mText = malloc (WNDSIZ * 2 + MAXMATCH);
+  Cd->mText = malloc (WNDSIZ * 2 + MAXMATCH);
   for (Index = 0; Index < WNDSIZ * 2 + MAXMATCH; Index++) {
-    mText[Index] = 0;
+    Cd->mText[Index] = 0;
   }
 
-  mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*mLevel));
-  mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*mChildCount));
-  mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*mPosition));
-  mParent     = malloc (WNDSIZ * 2 * sizeof (*mParent));
-  mPrev       = malloc (WNDSIZ * 2 * sizeof (*mPrev));
-  mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof (*mNext));
+  Cd->mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*Cd->mLevel));
+  Cd->mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*Cd->mChildCount));
+  Cd->mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*Cd->mPosition));
+  Cd->mParent     = malloc (WNDSIZ * 2 * sizeof (*Cd->mParent));
+  Cd->mPrev       = malloc (WNDSIZ * 2 * sizeof (*Cd->mPrev));
+  Cd->mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof (*Cd->mNext));
 
-  mBufSiz     = BLKSIZ;
-  mBuf        = malloc (mBufSiz);
-  while (mBuf == NULL) {
-    mBufSiz = (mBufSiz / 10U) * 9U;
-    if (mBufSiz < 4 * 1024U) {
+  Cd->mBufSiz     = BLKSIZ;
+  Cd->mBuf        = malloc (Cd->mBufSiz);
+  while (Cd->mBuf == NULL) {
+    Cd->mBufSiz = (Cd->mBufSiz / 10U) * 9U;
+    if (Cd->mBufSiz < 4 * 1024U) {
       return EFI_OUT_OF_RESOURCES;
     }
 
-    mBuf = malloc (mBufSiz);
+    Cd->mBuf = malloc (Cd->mBufSiz);
   }
 
-  mBuf[0] = 0;
+  Cd->mBuf[0] = 0;
 
   return EFI_SUCCESS;
 }
 
 VOID
 FreeMemory (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -454,42 +524,44 @@ Routine Description:
 
   Called when compression is completed to free memory previously allocated.
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
 --*/
 {
-  if (mText != NULL) {
-    free (mText);
+  if (Cd->mText != NULL) {
+    free (Cd->mText);
   }
 
-  if (mLevel != NULL) {
-    free (mLevel);
+  if (Cd->mLevel != NULL) {
+    free (Cd->mLevel);
   }
 
-  if (mChildCount != NULL) {
-    free (mChildCount);
+  if (Cd->mChildCount != NULL) {
+    free (Cd->mChildCount);
   }
 
-  if (mPosition != NULL) {
-    free (mPosition);
+  if (Cd->mPosition != NULL) {
+    free (Cd->mPosition);
   }
 
-  if (mParent != NULL) {
-    free (mParent);
+  if (Cd->mParent != NULL) {
+    free (Cd->mParent);
   }
 
-  if (mPrev != NULL) {
-    free (mPrev);
+  if (Cd->mPrev != NULL) {
+    free (Cd->mPrev);
   }
 
-  if (mNext != NULL) {
-    free (mNext);
+  if (Cd->mNext != NULL) {
+    free (Cd->mNext);
   }
 
-  if (mBuf != NULL) {
-    free (mBuf);
+  if (Cd->mBuf != NULL) {
+    free (Cd->mBuf);
   }
 
   return ;
@@ -498,7 +570,7 @@ Returns: (VOID)
 STATIC
 VOID
 InitSlide (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -506,7 +578,9 @@ Routine Description:
 
   Initialize String Info Log data structures
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -515,28 +589,29 @@ Returns: (VOID)
   NODE  Index;
 
   for (Index = WNDSIZ; Index <= WNDSIZ + UINT8_MAX; Index++) {
-    mLevel[Index]     = 1;
-    mPosition[Index]  = NIL;  /* sentinel */
+    Cd->mLevel[Index]     = 1;
+    Cd->mPosition[Index]  = NIL;  /* sentinel */
   }
 
   for (Index = WNDSIZ; Index < WNDSIZ * 2; Index++) {
-    mParent[Index] = NIL;
+    Cd->mParent[Index] = NIL;
   }
 
-  mAvail = 1;
+  Cd->mAvail = 1;
   for (Index = 1; Index < WNDSIZ - 1; Index++) {
-    mNext[Index] = (NODE) (Index + 1);
+    Cd->mNext[Index] = (NODE) (Index + 1);
   }
 
-  mNext[WNDSIZ - 1] = NIL;
+  Cd->mNext[WNDSIZ - 1] = NIL;
   for (Index = WNDSIZ * 2; Index <= MAX_HASH_VAL; Index++) {
-    mNext[Index] = NIL;
+    Cd->mNext[Index] = NIL;
   }
 }
 
 STATIC
 NODE
 Child (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE  NodeQ,
   IN UINT8 CharC
   )
@@ -548,6 +623,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   NodeQ       - the parent node
   CharC       - the edge character
   
@@ -559,13 +635,13 @@ Returns:
 {
   NODE  NodeR;
 
-  NodeR = mNext[HASH (NodeQ, CharC)];
+  NodeR = Cd->mNext[HASH (NodeQ, CharC)];
   //
   // sentinel
   //
-  mParent[NIL] = NodeQ;
-  while (mParent[NodeR] != NodeQ) {
-    NodeR = mNext[NodeR];
+  Cd->mParent[NIL] = NodeQ;
+  while (Cd->mParent[NodeR] != NodeQ) {
+    NodeR = Cd->mNext[NodeR];
   }
 
   return NodeR;
@@ -574,6 +650,7 @@ Returns:
 STATIC
 VOID
 MakeChild (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE  Parent,
   IN UINT8 CharC,
   IN NODE  Child
@@ -586,6 +663,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Parent       - the parent node
   CharC   - the edge character
   Child       - the child node
@@ -598,18 +676,19 @@ Returns: (VOID)
   NODE  Node2;
 
   Node1           = (NODE) HASH (Parent, CharC);
-  Node2           = mNext[Node1];
-  mNext[Node1]    = Child;
-  mNext[Child]    = Node2;
-  mPrev[Node2]    = Child;
-  mPrev[Child]    = Node1;
-  mParent[Child]  = Parent;
-  mChildCount[Parent]++;
+  Node2           = Cd->mNext[Node1];
+  Cd->mNext[Node1]    = Child;
+  Cd->mNext[Child]    = Node2;
+  Cd->mPrev[Node2]    = Child;
+  Cd->mPrev[Child]    = Node1;
+  Cd->mParent[Child]  = Parent;
+  Cd->mChildCount[Parent]++;
 }
 
 STATIC
 VOID
 Split (
+  IN OUT COMPRESS_DATA  *Cd,
   NODE Old
   )
 /*++
@@ -620,6 +699,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Old     - the node to split
   
 Returns: (VOID)
@@ -629,26 +709,26 @@ Returns: (VOID)
   NODE  New;
   NODE  TempNode;
 
-  New               = mAvail;
-  mAvail            = mNext[New];
-  mChildCount[New]  = 0;
-  TempNode          = mPrev[Old];
-  mPrev[New]        = TempNode;
-  mNext[TempNode]   = New;
-  TempNode          = mNext[Old];
-  mNext[New]        = TempNode;
-  mPrev[TempNode]   = New;
-  mParent[New]      = mParent[Old];
-  mLevel[New]       = (UINT8) mMatchLen;
-  mPosition[New]    = mPos;
-  MakeChild (New, mText[mMatchPos + mMatchLen], Old);
-  MakeChild (New, mText[mPos + mMatchLen], mPos);
+  New               = Cd->mAvail;
+  Cd->mAvail            = Cd->mNext[New];
+  Cd->mChildCount[New]  = 0;
+  TempNode          = Cd->mPrev[Old];
+  Cd->mPrev[New]        = TempNode;
+  Cd->mNext[TempNode]   = New;
+  TempNode          = Cd->mNext[Old];
+  Cd->mNext[New]        = TempNode;
+  Cd->mPrev[TempNode]   = New;
+  Cd->mParent[New]      = Cd->mParent[Old];
+  Cd->mLevel[New]       = (UINT8) Cd->mMatchLen;
+  Cd->mPosition[New]    = Cd->mPos;
+  MakeChild (Cd, New, Cd->mText[Cd->mMatchPos + Cd->mMatchLen], Old);
+  MakeChild (Cd, New, Cd->mText[Cd->mPos + Cd->mMatchLen], Cd->mPos);
 }
 
 STATIC
 VOID
 InsertNode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -656,7 +736,9 @@ Routine Description:
 
   Insert string info for current position into the String Info Log
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -670,50 +752,50 @@ Returns: (VOID)
   UINT8 *t1;
   UINT8 *t2;
 
-  if (mMatchLen >= 4) {
+  if (Cd->mMatchLen >= 4) {
     //
     // We have just got a long match, the target tree
     // can be located by MatchPos + 1. Travese the tree
     // from bottom up to get to a proper starting point.
     // The usage of PERC_FLAG ensures proper node deletion
-    // in DeleteNode() later.
+    // in DeleteNode(Cd) later.
     //
-    mMatchLen--;
-    NodeR = (NODE) ((mMatchPos + 1) | WNDSIZ);
-    NodeQ = mParent[NodeR];
+    Cd->mMatchLen--;
+    NodeR = (NODE) ((Cd->mMatchPos + 1) | WNDSIZ);
+    NodeQ = Cd->mParent[NodeR];
     while (NodeQ == NIL) {
-      NodeR = mNext[NodeR];
-      NodeQ = mParent[NodeR];
+      NodeR = Cd->mNext[NodeR];
+      NodeQ = Cd->mParent[NodeR];
     }
 
-    while (mLevel[NodeQ] >= mMatchLen) {
+    while (Cd->mLevel[NodeQ] >= Cd->mMatchLen) {
       NodeR = NodeQ;
-      NodeQ = mParent[NodeQ];
+      NodeQ = Cd->mParent[NodeQ];
     }
 
     NodeT = NodeQ;
-    while (mPosition[NodeT] < 0) {
-      mPosition[NodeT]  = mPos;
-      NodeT             = mParent[NodeT];
+    while (Cd->mPosition[NodeT] < 0) {
+      Cd->mPosition[NodeT]  = Cd->mPos;
+      NodeT             = Cd->mParent[NodeT];
     }
 
     if (NodeT < WNDSIZ) {
-      mPosition[NodeT] = (NODE) (mPos | (UINT32) PERC_FLAG);
+      Cd->mPosition[NodeT] = (NODE) (Cd->mPos | (UINT32) PERC_FLAG);
     }
   } else {
     //
     // Locate the target tree
     //
-    NodeQ = (NODE) (mText[mPos] + WNDSIZ);
-    CharC = mText[mPos + 1];
-    NodeR = Child (NodeQ, CharC);
+    NodeQ = (NODE) (Cd->mText[Cd->mPos] + WNDSIZ);
+    CharC = Cd->mText[Cd->mPos + 1];
+    NodeR = Child (Cd, NodeQ, CharC);
     if (NodeR == NIL) {
-      MakeChild (NodeQ, CharC, mPos);
-      mMatchLen = 1;
+      MakeChild (Cd, NodeQ, CharC, Cd->mPos);
+      Cd->mMatchLen = 1;
       return ;
     }
 
-    mMatchLen = 2;
+    Cd->mMatchLen = 2;
   }
   //
   // Traverse down the tree to find a match.
@@ -723,64 +805,64 @@ Returns: (VOID)
   for (;;) {
     if (NodeR >= WNDSIZ) {
       Index2    = MAXMATCH;
-      mMatchPos = NodeR;
+      Cd->mMatchPos = NodeR;
     } else {
-      Index2    = mLevel[NodeR];
-      mMatchPos = (NODE) (mPosition[NodeR] & (UINT32)~PERC_FLAG);
+      Index2    = Cd->mLevel[NodeR];
+      Cd->mMatchPos = (NODE) (Cd->mPosition[NodeR] & (UINT32)~PERC_FLAG);
     }
 
-    if (mMatchPos >= mPos) {
-      mMatchPos -= WNDSIZ;
+    if (Cd->mMatchPos >= Cd->mPos) {
+      Cd->mMatchPos -= WNDSIZ;
     }
 
-    t1  = &mText[mPos + mMatchLen];
-    t2  = &mText[mMatchPos + mMatchLen];
-    while (mMatchLen < Index2) {
+    t1  = &Cd->mText[Cd->mPos + Cd->mMatchLen];
+    t2  = &Cd->mText[Cd->mMatchPos + Cd->mMatchLen];
+    while (Cd->mMatchLen < Index2) {
       if (*t1 != *t2) {
-        Split (NodeR);
+        Split (Cd, NodeR);
         return ;
       }
 
-      mMatchLen++;
+      Cd->mMatchLen++;
       t1++;
       t2++;
     }
 
-    if (mMatchLen >= MAXMATCH) {
+    if (Cd->mMatchLen >= MAXMATCH) {
       break;
     }
 
-    mPosition[NodeR]  = mPos;
+    Cd->mPosition[NodeR]  = Cd->mPos;
     NodeQ             = NodeR;
-    NodeR             = Child (NodeQ, *t1);
+    NodeR             = Child (Cd, NodeQ, *t1);
     if (NodeR == NIL) {
-      MakeChild (NodeQ, *t1, mPos);
+      MakeChild (Cd, NodeQ, *t1, Cd->mPos);
       return ;
     }
 
-    mMatchLen++;
+    Cd->mMatchLen++;
   }
 
-  NodeT           = mPrev[NodeR];
-  mPrev[mPos]     = NodeT;
-  mNext[NodeT]    = mPos;
-  NodeT           = mNext[NodeR];
-  mNext[mPos]     = NodeT;
-  mPrev[NodeT]    = mPos;
-  mParent[mPos]   = NodeQ;
-  mParent[NodeR]  = NIL;
+  NodeT           = Cd->mPrev[NodeR];
+  Cd->mPrev[Cd->mPos]     = NodeT;
+  Cd->mNext[NodeT]    = Cd->mPos;
+  NodeT           = Cd->mNext[NodeR];
+  Cd->mNext[Cd->mPos]     = NodeT;
+  Cd->mPrev[NodeT]    = Cd->mPos;
+  Cd->mParent[Cd->mPos]   = NodeQ;
+  Cd->mParent[NodeR]  = NIL;
 
   //
   // Special usage of 'next'
   //
-  mNext[NodeR] = mPos;
+  Cd->mNext[NodeR] = Cd->mPos;
 
 }
 
 STATIC
 VOID
 DeleteNode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -789,7 +871,9 @@ Routine Description:
   Delete outdated string info. (The Usage of PERC_FLAG
   ensures a clean deletion)
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -801,36 +885,36 @@ Returns: (VOID)
   NODE  NodeT;
   NODE  NodeU;
 
-  if (mParent[mPos] == NIL) {
+  if (Cd->mParent[Cd->mPos] == NIL) {
     return ;
   }
 
-  NodeR         = mPrev[mPos];
-  NodeS         = mNext[mPos];
-  mNext[NodeR]  = NodeS;
-  mPrev[NodeS]  = NodeR;
-  NodeR         = mParent[mPos];
-  mParent[mPos] = NIL;
+  NodeR         = Cd->mPrev[Cd->mPos];
+  NodeS         = Cd->mNext[Cd->mPos];
+  Cd->mNext[NodeR]  = NodeS;
+  Cd->mPrev[NodeS]  = NodeR;
+  NodeR         = Cd->mParent[Cd->mPos];
+  Cd->mParent[Cd->mPos] = NIL;
   if (NodeR >= WNDSIZ) {
     return ;
   }
 
-  mChildCount[NodeR]--;
-  if (mChildCount[NodeR] > 1) {
+  Cd->mChildCount[NodeR]--;
+  if (Cd->mChildCount[NodeR] > 1) {
     return ;
   }
 
-  NodeT = (NODE) (mPosition[NodeR] & (UINT32)~PERC_FLAG);
-  if (NodeT >= mPos) {
+  NodeT = (NODE) (Cd->mPosition[NodeR] & (UINT32)~PERC_FLAG);
+  if (NodeT >= Cd->mPos) {
     NodeT -= WNDSIZ;
   }
 
   NodeS = NodeT;
-  NodeQ = mParent[NodeR];
-  NodeU = mPosition[NodeQ];
+  NodeQ = Cd->mParent[NodeR];
+  NodeU = Cd->mPosition[NodeQ];
   while (NodeU & (UINT32) PERC_FLAG) {
     NodeU &= (UINT32)~PERC_FLAG;
-    if (NodeU >= mPos) {
+    if (NodeU >= Cd->mPos) {
       NodeU -= WNDSIZ;
     }
 
@@ -838,13 +922,13 @@ Returns: (VOID)
       NodeS = NodeU;
     }
 
-    mPosition[NodeQ]  = (NODE) (NodeS | WNDSIZ);
-    NodeQ             = mParent[NodeQ];
-    NodeU             = mPosition[NodeQ];
+    Cd->mPosition[NodeQ]  = (NODE) (NodeS | WNDSIZ);
+    NodeQ             = Cd->mParent[NodeQ];
+    NodeU             = Cd->mPosition[NodeQ];
   }
 
   if (NodeQ < WNDSIZ) {
-    if (NodeU >= mPos) {
+    if (NodeU >= Cd->mPos) {
       NodeU -= WNDSIZ;
     }
 
@@ -852,30 +936,30 @@ Returns: (VOID)
       NodeS = NodeU;
     }
 
-    mPosition[NodeQ] = (NODE) (NodeS | WNDSIZ | (UINT32) PERC_FLAG);
-  }
-
-  NodeS           = Child (NodeR, mText[NodeT + mLevel[NodeR]]);
-  NodeT           = mPrev[NodeS];
-  NodeU           = mNext[NodeS];
-  mNext[NodeT]    = NodeU;
-  mPrev[NodeU]    = NodeT;
-  NodeT           = mPrev[NodeR];
-  mNext[NodeT]    = NodeS;
-  mPrev[NodeS]    = NodeT;
-  NodeT           = mNext[NodeR];
-  mPrev[NodeT]    = NodeS;
-  mNext[NodeS]    = NodeT;
-  mParent[NodeS]  = mParent[NodeR];
-  mParent[NodeR]  = NIL;
-  mNext[NodeR]    = mAvail;
-  mAvail          = NodeR;
+    Cd->mPosition[NodeQ] = (NODE) (NodeS | WNDSIZ | (UINT32) PERC_FLAG);
+  }
+
+  NodeS           = Child (Cd, NodeR, Cd->mText[NodeT + Cd->mLevel[NodeR]]);
+  NodeT           = Cd->mPrev[NodeS];
+  NodeU           = Cd->mNext[NodeS];
+  Cd->mNext[NodeT]    = NodeU;
+  Cd->mPrev[NodeU]    = NodeT;
+  NodeT           = Cd->mPrev[NodeR];
+  Cd->mNext[NodeT]    = NodeS;
+  Cd->mPrev[NodeS]    = NodeT;
+  NodeT           = Cd->mNext[NodeR];
+  Cd->mPrev[NodeT]    = NodeS;
+  Cd->mNext[NodeS]    = NodeT;
+  Cd->mParent[NodeS]  = Cd->mParent[NodeR];
+  Cd->mParent[NodeR]  = NIL;
+  Cd->mNext[NodeR]    = Cd->mAvail;
+  Cd->mAvail          = NodeR;
 }
 
 STATIC
 VOID
 GetNextMatch (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -884,7 +968,9 @@ Routine Description:
   Advance the current position (read in new data if needed).
   Delete outdated string info. Find a match string for current position.
 
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -892,23 +978,23 @@ Returns: (VOID)
 {
   INT32 Number;
 
-  mRemainder--;
-  mPos++;
-  if (mPos == WNDSIZ * 2) {
-    memmove (&mText[0], &mText[WNDSIZ], WNDSIZ + MAXMATCH);
-    Number = FreadCrc (&mText[WNDSIZ + MAXMATCH], WNDSIZ);
-    mRemainder += Number;
-    mPos = WNDSIZ;
+  Cd->mRemainder--;
+  Cd->mPos++;
+  if (Cd->mPos == WNDSIZ * 2) {
+    memmove (&Cd->mText[0], &Cd->mText[WNDSIZ], WNDSIZ + MAXMATCH);
+    Number = FreadCrc (Cd, &Cd->mText[WNDSIZ + MAXMATCH], WNDSIZ);
+    Cd->mRemainder += Number;
+    Cd->mPos = WNDSIZ;
   }
 
-  DeleteNode ();
-  InsertNode ();
+  DeleteNode (Cd);
+  InsertNode (Cd);
 }
 
 STATIC
 EFI_STATUS
 Encode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -916,7 +1002,9 @@ Routine Description:
 
   The main controlling routine for compression process.
 
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns:
   
@@ -929,76 +1017,75 @@ Returns:
   INT32       LastMatchLen;
   NODE        LastMatchPos;
 
-  Status = AllocateMemory ();
+  Status = AllocateMemory (Cd);
   if (EFI_ERROR (Status)) {
-    FreeMemory ();
+    FreeMemory (Cd);
     return Status;
   }
 
-  InitSlide ();
+  InitSlide (Cd);
 
-  HufEncodeStart ();
+  HufEncodeStart (Cd);
 
-  mRemainder  = FreadCrc (&mText[WNDSIZ], WNDSIZ + MAXMATCH);
+  Cd->mRemainder  = FreadCrc (Cd, &Cd->mText[WNDSIZ], WNDSIZ + MAXMATCH);
 
-  mMatchLen   = 0;
-  mPos        = WNDSIZ;
-  InsertNode ();
-  if (mMatchLen > mRemainder) {
-    mMatchLen = mRemainder;
+  Cd->mMatchLen   = 0;
+  Cd->mPos        = WNDSIZ;
+  InsertNode (Cd);
+  if (Cd->mMatchLen > Cd->mRemainder) {
+    Cd->mMatchLen = Cd->mRemainder;
   }
 
-  while (mRemainder > 0) {
-    LastMatchLen  = mMatchLen;
-    LastMatchPos  = mMatchPos;
-    GetNextMatch ();
-    if (mMatchLen > mRemainder) {
-      mMatchLen = mRemainder;
+  while (Cd->mRemainder > 0) {
+    LastMatchLen  = Cd->mMatchLen;
+    LastMatchPos  = Cd->mMatchPos;
+    GetNextMatch (Cd);
+    if (Cd->mMatchLen > Cd->mRemainder) {
+      Cd->mMatchLen = Cd->mRemainder;
     }
 
-    if (mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
+    if (Cd->mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
       //
       // Not enough benefits are gained by outputting a pointer,
       // so just output the original character
       //
-      Output (mText[mPos - 1], 0);
+      Output (Cd, Cd->mText[Cd->mPos - 1], 0);
 
     } else {
 
       if (LastMatchLen == THRESHOLD) {
-        if (((mPos - LastMatchPos - 2) & (WNDSIZ - 1)) > (1U << 11)) {
-          Output (mText[mPos - 1], 0);
+        if (((Cd->mPos - LastMatchPos - 2) & (WNDSIZ - 1)) > (1U << 11)) {
+          Output (Cd, Cd->mText[Cd->mPos - 1], 0);
           continue;
         }
       }
       //
       // Outputting a pointer is beneficial enough, do it.
       //
-      Output (
-        LastMatchLen + (UINT8_MAX + 1 - THRESHOLD),
-        (mPos - LastMatchPos - 2) & (WNDSIZ - 1)
+      Output (Cd, LastMatchLen + (UINT8_MAX + 1 - THRESHOLD),
+        (Cd->mPos - LastMatchPos - 2) & (WNDSIZ - 1)
         );
       LastMatchLen--;
       while (LastMatchLen > 0) {
-        GetNextMatch ();
+        GetNextMatch (Cd);
         LastMatchLen--;
       }
 
-      if (mMatchLen > mRemainder) {
-        mMatchLen = mRemainder;
+      if (Cd->mMatchLen > Cd->mRemainder) {
+        Cd->mMatchLen = Cd->mRemainder;
       }
     }
   }
 
-  HufEncodeEnd ();
-  FreeMemory ();
+  HufEncodeEnd (Cd);
+  FreeMemory (Cd);
   return EFI_SUCCESS;
 }
 
 STATIC
 VOID
 CountTFreq (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -1006,7 +1093,9 @@ Routine Description:
 
   Count the frequencies for the Extra Set
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -1018,36 +1107,36 @@ Returns: (VOID)
   INT32 Count;
 
   for (Index = 0; Index < NT; Index++) {
-    mTFreq[Index] = 0;
+    Cd->mTFreq[Index] = 0;
   }
 
   Number = NC;
-  while (Number > 0 && mCLen[Number - 1] == 0) {
+  while (Number > 0 && Cd->mCLen[Number - 1] == 0) {
     Number--;
   }
 
   Index = 0;
   while (Index < Number) {
-    Index3 = mCLen[Index++];
+    Index3 = Cd->mCLen[Index++];
     if (Index3 == 0) {
       Count = 1;
-      while (Index < Number && mCLen[Index] == 0) {
+      while (Index < Number && Cd->mCLen[Index] == 0) {
         Index++;
         Count++;
       }
 
       if (Count <= 2) {
-        mTFreq[0] = (UINT16) (mTFreq[0] + Count);
+        Cd->mTFreq[0] = (UINT16) (Cd->mTFreq[0] + Count);
       } else if (Count <= 18) {
-        mTFreq[1]++;
+        Cd->mTFreq[1]++;
       } else if (Count == 19) {
-        mTFreq[0]++;
-        mTFreq[1]++;
+        Cd->mTFreq[0]++;
+        Cd->mTFreq[1]++;
       } else {
-        mTFreq[2]++;
+        Cd->mTFreq[2]++;
       }
     } else {
-      mTFreq[Index3 + 2]++;
+      Cd->mTFreq[Index3 + 2]++;
     }
   }
 }
@@ -1055,6 +1144,7 @@ Returns: (VOID)
 STATIC
 VOID
 WritePTLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Number,
   IN INT32 nbit,
   IN INT32 Special
@@ -1067,6 +1157,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Number       - the number of symbols
   nbit    - the number of bits needed to represent 'n'
   Special - the special symbol that needs to be take care of
@@ -1078,26 +1169,26 @@ Returns: (VOID)
   INT32 Index;
   INT32 Index3;
 
-  while (Number > 0 && mPTLen[Number - 1] == 0) {
+  while (Number > 0 && Cd->mPTLen[Number - 1] == 0) {
     Number--;
   }
 
-  PutBits (nbit, Number);
+  PutBits (Cd, nbit, Number);
   Index = 0;
   while (Index < Number) {
-    Index3 = mPTLen[Index++];
+    Index3 = Cd->mPTLen[Index++];
     if (Index3 <= 6) {
-      PutBits (3, Index3);
+      PutBits (Cd, 3, Index3);
     } else {
-      PutBits (Index3 - 3, (1U << (Index3 - 3)) - 2);
+      PutBits (Cd, Index3 - 3, (1U << (Index3 - 3)) - 2);
     }
 
     if (Index == Special) {
-      while (Index < 6 && mPTLen[Index] == 0) {
+      while (Index < 6 && Cd->mPTLen[Index] == 0) {
         Index++;
       }
 
-      PutBits (2, (Index - 3) & 3);
+      PutBits (Cd, 2, (Index - 3) & 3);
     }
   }
 }
@@ -1105,7 +1196,7 @@ Returns: (VOID)
 STATIC
 VOID
 WriteCLen (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -1113,7 +1204,9 @@ Routine Description:
 
   Outputs the code length array for Char&Length Set
   
-Arguments: (VOID)
+Arguments:
+
+  Cd      - The compression context
 
 Returns: (VOID)
 
@@ -1125,38 +1218,38 @@ Returns: (VOID)
   INT32 Count;
 
   Number = NC;
-  while (Number > 0 && mCLen[Number - 1] == 0) {
+  while (Number > 0 && Cd->mCLen[Number - 1] == 0) {
     Number--;
   }
 
-  PutBits (CBIT, Number);
+  PutBits (Cd, CBIT, Number);
   Index = 0;
   while (Index < Number) {
-    Index3 = mCLen[Index++];
+    Index3 = Cd->mCLen[Index++];
     if (Index3 == 0) {
       Count = 1;
-      while (Index < Number && mCLen[Index] == 0) {
+      while (Index < Number && Cd->mCLen[Index] == 0) {
         Index++;
         Count++;
       }
 
       if (Count <= 2) {
         for (Index3 = 0; Index3 < Count; Index3++) {
-          PutBits (mPTLen[0], mPTCode[0]);
+          PutBits (Cd, Cd->mPTLen[0], Cd->mPTCode[0]);
         }
       } else if (Count <= 18) {
-        PutBits (mPTLen[1], mPTCode[1]);
-        PutBits (4, Count - 3);
+        PutBits (Cd, Cd->mPTLen[1], Cd->mPTCode[1]);
+        PutBits (Cd, 4, Count - 3);
       } else if (Count == 19) {
-        PutBits (mPTLen[0], mPTCode[0]);
-        PutBits (mPTLen[1], mPTCode[1]);
-        PutBits (4, 15);
+        PutBits (Cd, Cd->mPTLen[0], Cd->mPTCode[0]);
+        PutBits (Cd, Cd->mPTLen[1], Cd->mPTCode[1]);
+        PutBits (Cd, 4, 15);
       } else {
-        PutBits (mPTLen[2], mPTCode[2]);
-        PutBits (CBIT, Count - 20);
+        PutBits (Cd, Cd->mPTLen[2], Cd->mPTCode[2]);
+        PutBits (Cd, CBIT, Count - 20);
       }
     } else {
-      PutBits (mPTLen[Index3 + 2], mPTCode[Index3 + 2]);
+      PutBits (Cd, Cd->mPTLen[Index3 + 2], Cd->mPTCode[Index3 + 2]);
     }
   }
 }
@@ -1164,15 +1257,17 @@ Returns: (VOID)
 STATIC
 VOID
 EncodeC (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Value
   )
 {
-  PutBits (mCLen[Value], mCCode[Value]);
+  PutBits (Cd, Cd->mCLen[Value], Cd->mCCode[Value]);
 }
 
 STATIC
 VOID
 EncodeP (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Value
   )
 {
@@ -1186,16 +1281,16 @@ EncodeP (
     Index++;
   }
 
-  PutBits (mPTLen[Index], mPTCode[Index]);
+  PutBits (Cd, Cd->mPTLen[Index], Cd->mPTCode[Index]);
   if (Index > 1) {
-    PutBits (Index - 1, Value & (0xFFFFFFFFU >> (32 - Index + 1)));
+    PutBits (Cd, Index - 1, Value & (0xFFFFFFFFU >> (32 - Index + 1)));
   }
 }
 
 STATIC
 VOID
 SendBlock (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 /*++
 
@@ -1204,6 +1299,7 @@ Routine Description:
   Huffman code the block and output it.
   
 Arguments: 
+  Cd      - The compression context
   (VOID)
 
 Returns: 
@@ -1220,69 +1316,70 @@ Returns:
   UINT32  Size;
   Flags = 0;
 
-  Root  = MakeTree (NC, mCFreq, mCLen, mCCode);
-  Size  = mCFreq[Root];
-  PutBits (16, Size);
+  Root  = MakeTree (Cd, NC, Cd->mCFreq, Cd->mCLen, Cd->mCCode);
+  Size  = Cd->mCFreq[Root];
+  PutBits (Cd, 16, Size);
   if (Root >= NC) {
-    CountTFreq ();
-    Root = MakeTree (NT, mTFreq, mPTLen, mPTCode);
+    CountTFreq (Cd);
+    Root = MakeTree (Cd, NT, Cd->mTFreq, Cd->mPTLen, Cd->mPTCode);
     if (Root >= NT) {
-      WritePTLen (NT, TBIT, 3);
+      WritePTLen (Cd, NT, TBIT, 3);
     } else {
-      PutBits (TBIT, 0);
-      PutBits (TBIT, Root);
+      PutBits (Cd, TBIT, 0);
+      PutBits (Cd, TBIT, Root);
     }
 
-    WriteCLen ();
+    WriteCLen (Cd);
   } else {
-    PutBits (TBIT, 0);
-    PutBits (TBIT, 0);
-    PutBits (CBIT, 0);
-    PutBits (CBIT, Root);
+    PutBits (Cd, TBIT, 0);
+    PutBits (Cd, TBIT, 0);
+    PutBits (Cd, CBIT, 0);
+    PutBits (Cd, CBIT, Root);
   }
 
-  Root = MakeTree (NP, mPFreq, mPTLen, mPTCode);
+  Root = MakeTree (Cd, NP, Cd->mPFreq, Cd->mPTLen, Cd->mPTCode);
   if (Root >= NP) {
-    WritePTLen (NP, PBIT, -1);
+    WritePTLen (Cd, NP, PBIT, -1);
   } else {
-    PutBits (PBIT, 0);
-    PutBits (PBIT, Root);
+    PutBits (Cd, PBIT, 0);
+    PutBits (Cd, PBIT, Root);
   }
 
   Pos = 0;
   for (Index = 0; Index < Size; Index++) {
     if (Index % UINT8_BIT == 0) {
-      Flags = mBuf[Pos++];
+      Flags = Cd->mBuf[Pos++];
     } else {
       Flags <<= 1;
     }
 
     if (Flags & (1U << (UINT8_BIT - 1))) {
-      EncodeC (mBuf[Pos++] + (1U << UINT8_BIT));
-      Index3 = mBuf[Pos++];
+      EncodeC (Cd, Cd->mBuf[Pos++] + (1U << UINT8_BIT));
+      Index3 = Cd->mBuf[Pos++];
       for (Index2 = 0; Index2 < 3; Index2++) {
         Index3 <<= UINT8_BIT;
-        Index3 += mBuf[Pos++];
+        Index3 += Cd->mBuf[Pos++];
       }
 
-      EncodeP (Index3);
+      EncodeP (Cd, Index3);
     } else {
-      EncodeC (mBuf[Pos++]);
+      EncodeC (Cd, Cd->mBuf[Pos++]);
     }
   }
 
   for (Index = 0; Index < NC; Index++) {
-    mCFreq[Index] = 0;
+    Cd->mCFreq[Index] = 0;
   }
 
   for (Index = 0; Index < NP; Index++) {
-    mPFreq[Index] = 0;
+    Cd->mPFreq[Index] = 0;
   }
 }
 
 STATIC
 VOID
 Output (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 CharC,
   IN UINT32 Pos
   )
@@ -1294,6 +1391,7 @@ Routine Description:
 
 Arguments:
 
+  Cd      - The compression context
   CharC     - The original character or the 'String Length' element of a Pointer
   Pos     - The 'Position' field of a Pointer
 
@@ -1301,75 +1399,74 @@ Returns: (VOID)
 
 --*/
 {
-  STATIC UINT32 CPos;
 
-  if ((mOutputMask >>= 1) == 0) {
-    mOutputMask = 1U << (UINT8_BIT - 1);
+  if ((Cd->mOutputMask >>= 1) == 0) {
+    Cd->mOutputMask = 1U << (UINT8_BIT - 1);
     //
     // Check the buffer overflow per outputing UINT8_BIT symbols
     // which is an Original Character or a Pointer. The biggest
     // symbol is a Pointer which occupies 5 bytes.
     //
-    if (mOutputPos >= mBufSiz - 5 * UINT8_BIT) {
-      SendBlock ();
-      mOutputPos = 0;
+    if (Cd->mOutputPos >= Cd->mBufSiz - 5 * UINT8_BIT) {
+      SendBlock (Cd);
+      Cd->mOutputPos = 0;
     }
 
-    CPos        = mOutputPos++;
-    mBuf[CPos]  = 0;
+    Cd->mCPos        = Cd->mOutputPos++;
+    Cd->mBuf[Cd->mCPos]  = 0;
   }
 
-  mBuf[mOutputPos++] = (UINT8) CharC;
-  mCFreq[CharC]++;
+  Cd->mBuf[Cd->mOutputPos++] = (UINT8) CharC;
+  Cd->mCFreq[CharC]++;
   if (CharC >= (1U << UINT8_BIT)) {
-    mBuf[CPos] |= mOutputMask;
-    mBuf[mOutputPos++]  = (UINT8) (Pos >> 24);
-    mBuf[mOutputPos++]  = (UINT8) (Pos >> 16);
-    mBuf[mOutputPos++]  = (UINT8) (Pos >> (UINT8_BIT));
-    mBuf[mOutputPos++]  = (UINT8) Pos;
+    Cd->mBuf[Cd->mCPos] |= Cd->mOutputMask;
+    Cd->mBuf[Cd->mOutputPos++]  = (UINT8) (Pos >> 24);
+    Cd->mBuf[Cd->mOutputPos++]  = (UINT8) (Pos >> 16);
+    Cd->mBuf[Cd->mOutputPos++]  = (UINT8) (Pos >> (UINT8_BIT));
+    Cd->mBuf[Cd->mOutputPos++]  = (UINT8) Pos;
     CharC               = 0;
     while (Pos) {
       Pos >>= 1;
       CharC++;
     }
 
-    mPFreq[CharC]++;
+    Cd->mPFreq[CharC]++;
   }
 }
 
 STATIC
 VOID
 HufEncodeStart (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 {
   INT32 Index;
 
   for (Index = 0; Index < NC; Index++) {
-    mCFreq[Index] = 0;
+    Cd->mCFreq[Index] = 0;
   }
 
   for (Index = 0; Index < NP; Index++) {
-    mPFreq[Index] = 0;
+    Cd->mPFreq[Index] = 0;
   }
 
-  mOutputPos = mOutputMask = 0;
-  InitPutBits ();
+  Cd->mOutputPos = Cd->mOutputMask = 0;
+  InitPutBits (Cd);
   return ;
 }
 
 STATIC
 VOID
 HufEncodeEnd (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 {
-  SendBlock ();
+  SendBlock (Cd);
 
   //
   // Flush remaining bits
   //
-  PutBits (UINT8_BIT - 1, 0);
+  PutBits (Cd, UINT8_BIT - 1, 0);
 
   return ;
 }
@@ -1377,7 +1474,7 @@ HufEncodeEnd (
 STATIC
 VOID
 MakeCrcTable (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 {
   UINT32  Index;
@@ -1394,13 +1491,14 @@ MakeCrcTable (
       }
     }
 
-    mCrcTable[Index] = (UINT16) Temp;
+    Cd->mCrcTable[Index] = (UINT16) Temp;
   }
 }
 
 STATIC
 VOID
 PutBits (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32  Number,
   IN UINT32 Value
   )
@@ -1412,6 +1510,7 @@ Routine Description:
 
 Arguments:
 
+  Cd      - The compression context
   Number   - the rightmost n bits of the data is used
   x   - the data 
 
@@ -1421,26 +1520,27 @@ Returns: (VOID)
 {
   UINT8 Temp;
 
-  while (Number >= mBitCount) {
+  while (Number >= Cd->mBitCount) {
     //
-    // Number -= mBitCount should never equal to 32
+    // Number -= Cd->mBitCount should never equal to 32
     //
-    Temp = (UINT8) (mSubBitBuf | (Value >> (Number -= mBitCount)));
-    if (mDst < mDstUpperLimit) {
-      *mDst++ = Temp;
+    Temp = (UINT8) (Cd->mSubBitBuf | (Value >> (Number -= Cd->mBitCount)));
+    if (Cd->mDst < Cd->mDstUpperLimit) {
+      *Cd->mDst++ = Temp;
     }
 
-    mCompSize++;
-    mSubBitBuf  = 0;
-    mBitCount   = UINT8_BIT;
+    Cd->mCompSize++;
+    Cd->mSubBitBuf  = 0;
+    Cd->mBitCount   = UINT8_BIT;
   }
 
-  mSubBitBuf |= Value << (mBitCount -= Number);
+  Cd->mSubBitBuf |= Value << (Cd->mBitCount -= Number);
 }
 
 STATIC
 INT32
 FreadCrc (
+  IN OUT COMPRESS_DATA  *Cd,
   OUT UINT8 *Pointer,
   IN  INT32 Number
   )
@@ -1452,6 +1552,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Pointer   - the buffer to hold the data
   Number   - number of bytes to read
 
@@ -1463,17 +1564,17 @@ Returns:
 {
   INT32 Index;
 
-  for (Index = 0; mSrc < mSrcUpperLimit && Index < Number; Index++) {
-    *Pointer++ = *mSrc++;
+  for (Index = 0; Cd->mSrc < Cd->mSrcUpperLimit && Index < Number; Index++) {
+    *Pointer++ = *Cd->mSrc++;
   }
 
   Number = Index;
 
   Pointer -= Number;
-  mOrigSize += Number;
+  Cd->mOrigSize += Number;
   Index--;
   while (Index >= 0) {
-    UPDATE_CRC (*Pointer++);
+    UPDATE_CRC (Cd, *Pointer++);
     Index--;
   }
 
@@ -1483,16 +1584,17 @@ Returns:
 STATIC
 VOID
 InitPutBits (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   )
 {
-  mBitCount   = UINT8_BIT;
-  mSubBitBuf  = 0;
+  Cd->mBitCount   = UINT8_BIT;
+  Cd->mSubBitBuf  = 0;
 }
 
 STATIC
 VOID
 CountLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Index
   )
 /*++
@@ -1503,27 +1605,28 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Index   - the top node
   
 Returns: (VOID)
 
 --*/
 {
-  STATIC INT32  Depth = 0;
 
-  if (Index < mN) {
-    mLenCnt[(Depth < 16) ? Depth : 16]++;
+  if (Index < Cd->mN) {
+    Cd->mLenCnt[(Cd->mDepth < 16) ? Cd->mDepth : 16]++;
   } else {
-    Depth++;
-    CountLen (mLeft[Index]);
-    CountLen (mRight[Index]);
-    Depth--;
+    Cd->mDepth++;
+    CountLen (Cd, Cd->mLeft[Index]);
+    CountLen (Cd, Cd->mRight[Index]);
+    Cd->mDepth--;
   }
 }
 
 STATIC
 VOID
 MakeLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Root
   )
 /*++
@@ -1534,6 +1637,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Root   - the root of the tree
   
 Returns:
@@ -1547,10 +1651,10 @@ Returns:
   UINT32  Cum;
 
   for (Index = 0; Index <= 16; Index++) {
-    mLenCnt[Index] = 0;
+    Cd->mLenCnt[Index] = 0;
   }
 
-  CountLen (Root);
+  CountLen (Cd, Root);
 
   //
   // Adjust the length count array so that
@@ -1558,15 +1662,15 @@ Returns:
   //
   Cum = 0;
   for (Index = 16; Index > 0; Index--) {
-    Cum += mLenCnt[Index] << (16 - Index);
+    Cum += Cd->mLenCnt[Index] << (16 - Index);
   }
 
   while (Cum != (1U << 16)) {
-    mLenCnt[16]--;
+    Cd->mLenCnt[16]--;
     for (Index = 15; Index > 0; Index--) {
-      if (mLenCnt[Index] != 0) {
-        mLenCnt[Index]--;
-        mLenCnt[Index + 1] += 2;
+      if (Cd->mLenCnt[Index] != 0) {
+        Cd->mLenCnt[Index]--;
+        Cd->mLenCnt[Index + 1] += 2;
         break;
       }
     }
@@ -1575,10 +1679,10 @@ Returns:
   }
 
   for (Index = 16; Index > 0; Index--) {
-    Index3 = mLenCnt[Index];
+    Index3 = Cd->mLenCnt[Index];
     Index3--;
     while (Index3 >= 0) {
-      mLen[*mSortPtr++] = (UINT8) Index;
+      Cd->mLen[*Cd->mSortPtr++] = (UINT8) Index;
       Index3--;
     }
   }
@@ -1587,6 +1691,7 @@ Returns:
 STATIC
 VOID
 DownHeap (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Index
   )
 {
@@ -1596,28 +1701,29 @@ DownHeap (
   //
   // priority queue: send Index-th entry down heap
   //
-  Index3  = mHeap[Index];
+  Index3  = Cd->mHeap[Index];
   Index2  = 2 * Index;
-  while (Index2 <= mHeapSize) {
-    if (Index2 < mHeapSize && mFreq[mHeap[Index2]] > mFreq[mHeap[Index2 + 1]]) {
+  while (Index2 <= Cd->mHeapSize) {
+    if (Index2 < Cd->mHeapSize && Cd->mFreq[Cd->mHeap[Index2]] > Cd->mFreq[Cd->mHeap[Index2 + 1]]) {
       Index2++;
     }
 
-    if (mFreq[Index3] <= mFreq[mHeap[Index2]]) {
+    if (Cd->mFreq[Index3] <= Cd->mFreq[Cd->mHeap[Index2]]) {
       break;
     }
 
-    mHeap[Index]  = mHeap[Index2];
+    Cd->mHeap[Index]  = Cd->mHeap[Index2];
     Index         = Index2;
     Index2        = 2 * Index;
   }
 
-  mHeap[Index] = (INT16) Index3;
+  Cd->mHeap[Index] = (INT16) Index3;
 }
 
 STATIC
 VOID
 MakeCode (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32       Number,
   IN  UINT8 Len[  ],
   OUT UINT16 Code[]
@@ -1630,6 +1736,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   Number     - number of symbols
   Len   - the code length array
   Code  - stores codes for each symbol
@@ -1643,7 +1750,7 @@ Returns: (VOID)
 
   Start[1] = 0;
   for (Index = 1; Index <= 16; Index++) {
-    Start[Index + 1] = (UINT16) ((Start[Index] + mLenCnt[Index]) << 1);
+    Start[Index + 1] = (UINT16) ((Start[Index] + Cd->mLenCnt[Index]) << 1);
   }
 
   for (Index = 0; Index < Number; Index++) {
@@ -1654,6 +1761,7 @@ Returns: (VOID)
 STATIC
 INT32
 MakeTree (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32            NParm,
   IN  UINT16  FreqParm[],
   OUT UINT8   LenParm[ ],
@@ -1667,6 +1775,7 @@ Routine Description:
   
 Arguments:
 
+  Cd      - The compression context
   NParm    - number of symbols
   FreqParm - frequency of each symbol
   LenParm  - code length for each symbol
@@ -1686,57 +1795,57 @@ Returns:
   //
   // make tree, calculate len[], return root
   //
-  mN        = NParm;
-  mFreq     = FreqParm;
-  mLen      = LenParm;
-  Avail     = mN;
-  mHeapSize = 0;
-  mHeap[1]  = 0;
-  for (Index = 0; Index < mN; Index++) {
-    mLen[Index] = 0;
-    if (mFreq[Index]) {
-      mHeapSize++;
-      mHeap[mHeapSize] = (INT16) Index;
+  Cd->mN        = NParm;
+  Cd->mFreq     = FreqParm;
+  Cd->mLen      = LenParm;
+  Avail     = Cd->mN;
+  Cd->mHeapSize = 0;
+  Cd->mHeap[1]  = 0;
+  for (Index = 0; Index < Cd->mN; Index++) {
+    Cd->mLen[Index] = 0;
+    if (Cd->mFreq[Index]) {
+      Cd->mHeapSize++;
+      Cd->mHeap[Cd->mHeapSize] = (INT16) Index;
     }
   }
 
-  if (mHeapSize < 2) {
-    CodeParm[mHeap[1]] = 0;
-    return mHeap[1];
+  if (Cd->mHeapSize < 2) {
+    CodeParm[Cd->mHeap[1]] = 0;
+    return Cd->mHeap[1];
   }
 
-  for (Index = mHeapSize / 2; Index >= 1; Index--) {
+  for (Index = Cd->mHeapSize / 2; Index >= 1; Index--) {
     //
     // make priority queue
     //
-    DownHeap (Index);
+    DownHeap (Cd, Index);
   }
 
-  mSortPtr = CodeParm;
+  Cd->mSortPtr = CodeParm;
   do {
-    Index = mHeap[1];
-    if (Index < mN) {
-      *mSortPtr++ = (UINT16) Index;
+    Index = Cd->mHeap[1];
+    if (Index < Cd->mN) {
+      *Cd->mSortPtr++ = (UINT16) Index;
     }
 
-    mHeap[1] = mHeap[mHeapSize--];
-    DownHeap (1);
-    Index2 = mHeap[1];
-    if (Index2 < mN) {
-      *mSortPtr++ = (UINT16) Index2;
+    Cd->mHeap[1] = Cd->mHeap[Cd->mHeapSize--];
+    DownHeap (Cd, 1);
+    Index2 = Cd->mHeap[1];
+    if (Index2 < Cd->mN) {
+      *Cd->mSortPtr++ = (UINT16) Index2;
     }
 
     Index3        = Avail++;
-    mFreq[Index3] = (UINT16) (mFreq[Index] + mFreq[Index2]);
-    mHeap[1]      = (INT16) Index3;
-    DownHeap (1);
-    mLeft[Index3]   = (UINT16) Index;
-    mRight[Index3]  = (UINT16) Index2;
-  } while (mHeapSize > 1);
-
-  mSortPtr = CodeParm;
-  MakeLen (Index3);
-  MakeCode (NParm, LenParm, CodeParm);
+    Cd->mFreq[Index3] = (UINT16) (Cd->mFreq[Index] + Cd->mFreq[Index2]);
+    Cd->mHeap[1]      = (INT16) Index3;
+    DownHeap (Cd, 1);
+    Cd->mLeft[Index3]   = (UINT16) Index;
+    Cd->mRight[Index3]  = (UINT16) Index2;
+  } while (Cd->mHeapSize > 1);
+
+  Cd->mSortPtr = CodeParm;
+  MakeLen (Cd, Index3);
+  MakeCode (Cd, NParm, LenParm, CodeParm);
 
   //
   // return root
@@ -19,6 +19,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #ifdef __GNUC__
 #include <uuid/uuid.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #endif
 #include <string.h>
 #ifndef __GNUC__
@@ -157,6 +158,8 @@ BOOLEAN                     mIsLargeFfs = FALSE;
 EFI_PHYSICAL_ADDRESS mFvBaseAddress[0x10];
 UINT32               mFvBaseAddressNumber = 0;
 
+FV_FILE_IMAGE        mFvFileImage[MAX_NUMBER_OF_FILES_IN_FV];
+
 EFI_STATUS
 ParseFvInf (
   IN  MEMORY_FILE  *InfFile,
@@ -965,10 +968,10 @@ Returns:
 
 --*/
 {
-  FILE                  *NewFile;
   UINTN                 FileSize;
   UINT8                 *FileBuffer;
-  UINTN                 NumBytesRead;
+  EFI_FFS_FILE_HEADER   *FfsFile;
+  BOOLEAN               VtfFileFlag;
   UINT32                CurrentFileAlignment;
   EFI_STATUS            Status;
   UINTN                 Index1;
@@ -983,44 +986,11 @@ Returns:
   }
 
   //
-  // Read the file to add
-  //
-  NewFile = fopen (LongFilePath (FvInfo->FvFiles[Index]), "rb");
-
-  if (NewFile == NULL) {
-    Error (NULL, 0, 0001, "Error opening file", FvInfo->FvFiles[Index]);
-    return EFI_ABORTED;
-  }
-
-  //
-  // Get the file size
-  //
-  FileSize = _filelength (fileno (NewFile));
-
-  //
-  // Read the file into a buffer
+  // The file contents were read by OpenFvFiles (). They are copied to their
+  // place in the FV image, and then verified and rebased in place.
   //
-  FileBuffer = malloc (FileSize);
-  if (FileBuffer == NULL) {
-    Error (NULL, 0, 4001, "Resouce", "memory cannot be allocated!");
-    return EFI_OUT_OF_RESOURCES;
-  }
-
-  NumBytesRead = fread (FileBuffer, sizeof (UINT8), FileSize, NewFile);
-
-  //
-  // Done with the file, from this point on we will just use the buffer read.
-  //
-  fclose (NewFile);
-  
-  //
-  // Verify read successful
-  //
-  if (NumBytesRead != sizeof (UINT8) * FileSize) {
-    free  (FileBuffer);
-    Error (NULL, 0, 0004, "Error reading file", FvInfo->FvFiles[Index]);
-    return EFI_ABORTED;
-  }
+  FileBuffer = mFvFileImage[Index].FileImage;
+  FileSize   = mFvFileImage[Index].FileSize;
   
   //
   // For None PI Ffs file, directly add them into FvImage.
@@ -1032,24 +1002,13 @@ Returns:
     } else {
     	FvImage->CurrentFilePointer += FileSize;
     }
-    goto Done;
+    return EFI_SUCCESS;
   }
   
-  //
-  // Verify Ffs file
-  //
-  Status = VerifyFfsFile ((EFI_FFS_FILE_HEADER *)FileBuffer);
-  if (EFI_ERROR (Status)) {
-    free (FileBuffer);
-    Error (NULL, 0, 3000, "Invalid", "%s is not a valid FFS file.", FvInfo->FvFiles[Index]);
-    return EFI_INVALID_PARAMETER;
-  }
-
   //
   // Verify space exists to add the file
   //
   if (FileSize > (UINTN) ((UINTN) *VtfFileImage - (UINTN) FvImage->CurrentFilePointer)) {
-    free (FileBuffer);
     Error (NULL, 0, 4002, "Resource", "FV space is full, not enough room to add file %s.", FvInfo->FvFiles[Index]);
     return EFI_OUT_OF_RESOURCES;
   }
@@ -1066,14 +1025,6 @@ Returns:
   }
   CopyMem (&mFileGuidArray [Index], FileBuffer, sizeof (EFI_GUID));
 
-  //
-  // Update the file state based on polarity of the FV.
-  //
-  UpdateFfsFileState (
-    (EFI_FFS_FILE_HEADER *) FileBuffer,
-    (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage
-    );
-
   //
   // Check if alignment is required
   //
@@ -1088,84 +1039,84 @@ Returns:
   //
   // If we have a VTF file, add it at the top.
   //
-  if (IsVtfFile ((EFI_FFS_FILE_HEADER *) FileBuffer)) {
-    if ((UINTN) *VtfFileImage == (UINTN) FvImage->Eof) {
-      //
-      // No previous VTF, add this one.
-      //
-      *VtfFileImage = (EFI_FFS_FILE_HEADER *) (UINTN) ((UINTN) FvImage->FileImage + FvInfo->Size - FileSize);
-      //
-      // Sanity check. The file MUST align appropriately
-      //
-      if (((UINTN) *VtfFileImage + GetFfsHeaderLength((EFI_FFS_FILE_HEADER *)FileBuffer) - (UINTN) FvImage->FileImage) % (1 << CurrentFileAlignment)) {
-        Error (NULL, 0, 3000, "Invalid", "VTF file cannot be aligned on a %u-byte boundary.", (unsigned) (1 << CurrentFileAlignment));
-        free (FileBuffer);
-        return EFI_ABORTED;
-      }
-      //
-      // Rebase the PE or TE image in FileBuffer of FFS file for XIP 
-      // Rebase for the debug genfvmap tool
-      //
-      Status = FfsRebase (FvInfo, FvInfo->FvFiles[Index], (EFI_FFS_FILE_HEADER *) FileBuffer, (UINTN) *VtfFileImage - (UINTN) FvImage->FileImage, FvMapFile);
-      if (EFI_ERROR (Status)) {
-        Error (NULL, 0, 3000, "Invalid", "Could not rebase %s.", FvInfo->FvFiles[Index]);
-        return Status;
-      }	  
-      //
-      // copy VTF File
-      //
-      memcpy (*VtfFileImage, FileBuffer, FileSize);
-      
-      PrintGuidToBuffer ((EFI_GUID *) FileBuffer, FileGuidString, sizeof (FileGuidString), TRUE); 
-      fprintf (FvReportFile, "0x%08X %s\n", (unsigned)(UINTN) (((UINT8 *)*VtfFileImage) - (UINTN)FvImage->FileImage), FileGuidString);
-
-      free (FileBuffer);
-      DebugMsg (NULL, 0, 9, "Add VTF FFS file in FV image", NULL);
-      return EFI_SUCCESS;
-    } else {
+  VtfFileFlag = IsVtfFile ((EFI_FFS_FILE_HEADER *) FileBuffer);
+  if (VtfFileFlag) {
+    if ((UINTN) *VtfFileImage != (UINTN) FvImage->Eof) {
       //
       // Already found a VTF file.
       //
       Error (NULL, 0, 3000, "Invalid", "multiple VTF files are not permitted within a single FV.");
-      free (FileBuffer);
       return EFI_ABORTED;
     }
+    //
+    // No previous VTF, add this one.
+    //
+    FfsFile = (EFI_FFS_FILE_HEADER *) (UINTN) ((UINTN) FvImage->FileImage + FvInfo->Size - FileSize);
+    //
+    // Sanity check. The file MUST align appropriately
+    //
+    if (((UINTN) FfsFile + GetFfsHeaderLength((EFI_FFS_FILE_HEADER *)FileBuffer) - (UINTN) FvImage->FileImage) % (1 << CurrentFileAlignment)) {
+      Error (NULL, 0, 3000, "Invalid", "VTF file cannot be aligned on a %u-byte boundary.", (unsigned) (1 << CurrentFileAlignment));
+      return EFI_ABORTED;
+    }
+  } else {
+    //
+    // Add pad file if necessary
+    //
+    Status = AddPadFile (FvImage, 1 << CurrentFileAlignment, *VtfFileImage, NULL, FileSize);
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 4002, "Resource", "FV space is full, could not add pad file for data alignment property.");
+      return EFI_ABORTED;
+    }
+    if ((UINTN) (FvImage->CurrentFilePointer + FileSize) > (UINTN) (*VtfFileImage)) {
+      Error (NULL, 0, 4002, "Resource", "FV space is full, cannot add file %s.", FvInfo->FvFiles[Index]);
+      return EFI_ABORTED;
+    }
+    FfsFile = (EFI_FFS_FILE_HEADER *) FvImage->CurrentFilePointer;
   }
 
   //
-  // Add pad file if necessary
+  // Copy the file
+  //
+  memcpy (FfsFile, FileBuffer, FileSize);
+
+  //
+  // Verify Ffs file
   //
-  Status = AddPadFile (FvImage, 1 << CurrentFileAlignment, *VtfFileImage, NULL, FileSize);
+  Status = VerifyFfsFile (FfsFile);
   if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 4002, "Resource", "FV space is full, could not add pad file for data alignment property.");
-    free (FileBuffer);
-    return EFI_ABORTED;
+    Error (NULL, 0, 3000, "Invalid", "%s is not a valid FFS file.", FvInfo->FvFiles[Index]);
+    return EFI_INVALID_PARAMETER;
   }
+
   //
-  // Add file
+  // Update the file state based on polarity of the FV.
   //
-  if ((UINTN) (FvImage->CurrentFilePointer + FileSize) <= (UINTN) (*VtfFileImage)) {
-    //
-    // Rebase the PE or TE image in FileBuffer of FFS file for XIP. 
-    // Rebase Bs and Rt drivers for the debug genfvmap tool.
-    //
-    Status = FfsRebase (FvInfo, FvInfo->FvFiles[Index], (EFI_FFS_FILE_HEADER *) FileBuffer, (UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage, FvMapFile);
-	if (EFI_ERROR (Status)) {
-	  Error (NULL, 0, 3000, "Invalid", "Could not rebase %s.", FvInfo->FvFiles[Index]);
-	  return Status;
-	}	  	
-    //
-    // Copy the file
-    //
-    memcpy (FvImage->CurrentFilePointer, FileBuffer, FileSize);
-    PrintGuidToBuffer ((EFI_GUID *) FileBuffer, FileGuidString, sizeof (FileGuidString), TRUE); 
-    fprintf (FvReportFile, "0x%08X %s\n", (unsigned) (FvImage->CurrentFilePointer - FvImage->FileImage), FileGuidString);
-    FvImage->CurrentFilePointer += FileSize;
-  } else {
-    Error (NULL, 0, 4002, "Resource", "FV space is full, cannot add file %s.", FvInfo->FvFiles[Index]);
-    free (FileBuffer);
-    return EFI_ABORTED;
+  UpdateFfsFileState (
+    FfsFile,
+    (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage
+    );
+
+  //
+  // Rebase the PE or TE image of FFS file for XIP. 
+  // Rebase Bs and Rt drivers for the debug genfvmap tool.
+  //
+  Status = FfsRebase (FvInfo, FvInfo->FvFiles[Index], FfsFile, (UINTN) FfsFile - (UINTN) FvImage->FileImage, FvMapFile);
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "Could not rebase %s.", FvInfo->FvFiles[Index]);
+    return Status;
   }
+
+  PrintGuidToBuffer ((EFI_GUID *) FfsFile, FileGuidString, sizeof (FileGuidString), TRUE); 
+  fprintf (FvReportFile, "0x%08X %s\n", (unsigned) ((UINTN) FfsFile - (UINTN) FvImage->FileImage), FileGuidString);
+
+  if (VtfFileFlag) {
+    *VtfFileImage = FfsFile;
+    DebugMsg (NULL, 0, 9, "Add VTF FFS file in FV image", NULL);
+    return EFI_SUCCESS;
+  }
+
+  FvImage->CurrentFilePointer += FileSize;
   //
   // Make next file start at QWord Boundry
   //
@@ -1173,12 +1124,6 @@ Returns:
     FvImage->CurrentFilePointer++;
   }
 
-Done: 
-  //
-  // Free allocated memory.
-  //
-  free (FileBuffer);
-
   return EFI_SUCCESS;
 }
 
@@ -2227,13 +2172,21 @@ Returns:
   strcpy (FvReportName, FvFileName);
   strcat (FvReportName, ".txt");
 
+  //
+  // Read the FFS files once for the size calculation and the FV image.
+  //
+  Status = OpenFvFiles (&mFvDataInfo);
+  if (EFI_ERROR (Status)) {
+    goto Finish;
+  }
+
   //
   // Calculate the FV size and Update Fv Size based on the actual FFS files.
   // And Update mFvDataInfo data.
   //
   Status = CalculateFvSize (&mFvDataInfo);
   if (EFI_ERROR (Status)) {
-    return Status;    
+    goto Finish;
   }
   VerboseMsg ("the generated FV image size is %u bytes", (unsigned) mFvDataInfo.Size);
   
@@ -2247,7 +2200,8 @@ Returns:
   //
   FvBufferHeader = malloc (FvImageSize + sizeof (UINT64));
   if (FvBufferHeader == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Finish;
   }
   FvImage = (UINT8 *) (((UINTN) FvBufferHeader + 7) & ~7);
 
@@ -2339,7 +2293,8 @@ Returns:
   FvMapFile = fopen (LongFilePath (FvMapName), "w");
   if (FvMapFile == NULL) {
     Error (NULL, 0, 0001, "Error opening file", FvMapName);
-    return EFI_ABORTED;
+    Status = EFI_ABORTED;
+    goto Finish;
   }
   
   //
@@ -2348,7 +2303,8 @@ Returns:
   FvReportFile = fopen (LongFilePath (FvReportName), "w");
   if (FvReportFile == NULL) {
     Error (NULL, 0, 0001, "Error opening file", FvReportName);
-    return EFI_ABORTED;
+    Status = EFI_ABORTED;
+    goto Finish;
   }
   //
   // record FV size information into FvMap file.
@@ -2491,6 +2447,8 @@ WriteFile:
   }
 
 Finish:
+  CloseFvFiles ();
+
   if (FvBufferHeader != NULL) {
     free (FvBufferHeader);
   }
@@ -2586,6 +2544,110 @@ Returns:
   }
 }
 
+EFI_STATUS
+OpenFvFiles (
+  IN FV_INFO  *FvInfo
+  )
+/*++
+Routine Description:
+  Read every FFS file of the FV once into mFvFileImage, where both the FV size
+  calculation and AddFile () use it. Where the host supports it the files are
+  mapped read only instead of being copied into allocated buffers.
+
+Arguments:
+  FvInfo        The pointer to FV_INFO structure.
+
+Returns:
+  EFI_ABORTED           - A file could not be opened or read
+  EFI_OUT_OF_RESOURCES  - Memory could not be allocated
+  EFI_SUCCESS           - All the FFS files are available
+--*/
+{
+  UINTN   Index;
+  FILE    *FfsFile;
+  UINTN   FfsFileSize;
+  UINT8   *FfsFileImage;
+
+  for (Index = 0; FvInfo->FvFiles[Index][0] != 0; Index++) {
+    FfsFile = fopen (LongFilePath (FvInfo->FvFiles[Index]), "rb");
+    if (FfsFile == NULL) {
+      Error (NULL, 0, 0001, "Error opening file", FvInfo->FvFiles[Index]);
+      return EFI_ABORTED;
+    }
+    FfsFileSize = _filelength (fileno (FfsFile));
+
+#ifdef __GNUC__
+    if (FfsFileSize != 0) {
+      FfsFileImage = mmap (NULL, FfsFileSize, PROT_READ, MAP_PRIVATE, fileno (FfsFile), 0);
+      if (FfsFileImage != MAP_FAILED) {
+        fclose (FfsFile);
+        mFvFileImage[Index].FileImage = FfsFileImage;
+        mFvFileImage[Index].FileSize  = FfsFileSize;
+        mFvFileImage[Index].Mapped    = TRUE;
+        continue;
+      }
+    }
+#endif
+
+    //
+    // Read the file into a buffer
+    //
+    FfsFileImage = malloc (FfsFileSize + 1);
+    if (FfsFileImage == NULL) {
+      fclose (FfsFile);
+      Error (NULL, 0, 4001, "Resouce", "memory cannot be allocated!");
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (fread (FfsFileImage, sizeof (UINT8), FfsFileSize, FfsFile) != FfsFileSize) {
+      fclose (FfsFile);
+      free (FfsFileImage);
+      Error (NULL, 0, 0004, "Error reading file", FvInfo->FvFiles[Index]);
+      return EFI_ABORTED;
+    }
+    fclose (FfsFile);
+    mFvFileImage[Index].FileImage = FfsFileImage;
+    mFvFileImage[Index].FileSize  = FfsFileSize;
+    mFvFileImage[Index].Mapped    = FALSE;
+  }
+
+  return EFI_SUCCESS;
+}
+
+VOID
+CloseFvFiles (
+  VOID
+  )
+/*++
+Routine Description:
+  Release the FFS file contents read by OpenFvFiles ().
+
+Arguments:
+  None
+
+Returns:
+  None
+--*/
+{
+  UINTN   Index;
+
+  for (Index = 0; Index < MAX_NUMBER_OF_FILES_IN_FV; Index++) {
+    if (mFvFileImage[Index].FileImage == NULL) {
+      continue;
+    }
+#ifdef __GNUC__
+    if (mFvFileImage[Index].Mapped) {
+      munmap (mFvFileImage[Index].FileImage, mFvFileImage[Index].FileSize);
+    } else {
+      free (mFvFileImage[Index].FileImage);
+    }
+#else
+    free (mFvFileImage[Index].FileImage);
+#endif
+    mFvFileImage[Index].FileImage = NULL;
+    mFvFileImage[Index].FileSize  = 0;
+  }
+}
+
 EFI_STATUS
 CalculateFvSize (
   FV_INFO *FvInfoPtr
@@ -2610,7 +2672,7 @@ Returns:
   UINTN               FvExtendHeaderSize;
   UINT32              FfsAlignment;
   UINT32              FfsHeaderSize;
-  EFI_FFS_FILE_HEADER FfsHeader;
+  EFI_FFS_FILE_HEADER *FfsHeader;
   BOOLEAN             VtfFileFlag;
   UINTN               VtfFileSize;
   
@@ -2668,38 +2730,26 @@ Returns:
   //
   for (Index = 0; FvInfoPtr->FvFiles[Index][0] != 0; Index++) {
     //
-    // Open FFS file
-    //
-    fpin = NULL;
-    fpin = fopen (LongFilePath (FvInfoPtr->FvFiles[Index]), "rb");
-    if (fpin == NULL) {
-      Error (NULL, 0, 0001, "Error opening file", FvInfoPtr->FvFiles[Index]);
-      return EFI_ABORTED;
-    }
+    // Get the file size, the file was read by OpenFvFiles ()
     //
-    // Get the file size
-    //
-    FfsFileSize = _filelength (fileno (fpin));
+    FfsFileSize = mFvFileImage[Index].FileSize;
     if (FfsFileSize >= MAX_FFS_SIZE) {
       FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER2);
       mIsLargeFfs = TRUE;
     } else {
       FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER);
     }
-    //
-    // Read Ffs File header
-    //
-    fread (&FfsHeader, sizeof (UINT8), sizeof (EFI_FFS_FILE_HEADER), fpin);
-    //
-    // close file
-    //
-    fclose (fpin);
     
     if (FvInfoPtr->IsPiFvImage) {
+      if (FfsFileSize < sizeof (EFI_FFS_FILE_HEADER)) {
+        Error (NULL, 0, 3000, "Invalid", "%s is not a valid FFS file.", FvInfoPtr->FvFiles[Index]);
+        return EFI_INVALID_PARAMETER;
+      }
+      FfsHeader = (EFI_FFS_FILE_HEADER *) mFvFileImage[Index].FileImage;
 	    //
 	    // Check whether this ffs file is vtf file
 	    //
-	    if (IsVtfFile (&FfsHeader)) {
+	    if (IsVtfFile (FfsHeader)) {
 	      if (VtfFileFlag) {
 	        //
 	        // One Fv image can't have two vtf files.
@@ -2714,7 +2764,7 @@ Returns:
       //
       // Get the alignment of FFS file 
       //
-      ReadFfsAlignment (&FfsHeader, &FfsAlignment);
+      ReadFfsAlignment (FfsHeader, &FfsAlignment);
       FfsAlignment = 1 << FfsAlignment;
       //
       // Add Pad file
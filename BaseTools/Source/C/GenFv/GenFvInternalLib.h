@@ -231,6 +231,15 @@ typedef struct {
   INT8                    ForceRebase;
 } FV_INFO;
 
+//
+// Contents of one FFS file of the FV
+//
+typedef struct {
+  UINT8                   *FileImage;
+  UINTN                   FileSize;
+  BOOLEAN                 Mapped;
+} FV_FILE_IMAGE;
+
 typedef struct {
   EFI_GUID                CapGuid;
   UINT32                  HeaderSize;
@@ -261,6 +270,7 @@ extern UINT32     mFvTakenSize;
 
 extern EFI_PHYSICAL_ADDRESS mFvBaseAddress[];
 extern UINT32               mFvBaseAddressNumber;
+extern FV_FILE_IMAGE        mFvFileImage[];
 //
 // Local function prototypes
 //
@@ -338,6 +348,16 @@ FindApResetVectorPosition (
   OUT UINT8        **Pointer
   ); 
 
+EFI_STATUS
+OpenFvFiles (
+  IN FV_INFO  *FvInfo
+  );
+
+VOID
+CloseFvFiles (
+  VOID
+  );
+
 EFI_STATUS
 CalculateFvSize (
   FV_INFO *FvInfoPtr
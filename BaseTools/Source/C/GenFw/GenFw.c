@@ -19,6 +19,10 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <io.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #endif
 #include <stdio.h>
 #include <stdlib.h>
@@ -59,6 +63,8 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define DEFAULT_MC_PAD_BYTE_VALUE  0xFF
 #define DEFAULT_MC_ALIGNMENT       16
 
+#define MAX_BATCH_ARGUMENTS        64
+
 #define STATUS_IGNORE 0xA
 //
 // Structure definition for a microcode header
@@ -115,6 +121,13 @@ MicrocodeReadData (
   UINT32        *Data
   );
 
+STATIC
+STATUS
+ConvertBatch (
+  IN int   argc,
+  IN char  *argv[]
+  );
+
 STATIC
 VOID
 Version (
@@ -280,6 +293,13 @@ Returns:
                         except for -o or -r option. It is a action option.\n\
                         If it is combined with other action options, the later\n\
                         input action option will override the previous one.\n");
+  fprintf (stdout, "  --batch ManifestFile [--jobs Number]\n\
+                        Run the conversions listed in ManifestFile, Number\n\
+                        of them at a time. Each line of ManifestFile holds\n\
+                        the options and input file of one conversion.\n\
+                        It must be the first option and can't be combined\n\
+                        with other options. Number defaults to the number\n\
+                        of processors.\n");
   fprintf (stdout, "  -v, --verbose         Turn on verbose output with informational messages.\n");
   fprintf (stdout, "  -q, --quiet           Disable all messages except key message and fatal error\n");
   fprintf (stdout, "  -d, --debug level     Enable debug messages, at input debug level.\n");
@@ -1175,6 +1195,10 @@ Returns:
     return STATUS_SUCCESS;
   }
 
+  if (stricmp (argv[0], "--batch") == 0) {
+    return ConvertBatch (argc, argv);
+  }
+
   while (argc > 0) {
     if ((stricmp (argv[0], "-o") == 0) || (stricmp (argv[0], "--outputfile") == 0)) {
       if (argv[1] == NULL || argv[1][0] == '-') {
@@ -2725,6 +2749,251 @@ Finish:
   return GetUtilityStatus ();
 }
 
+#ifdef __GNUC__
+STATIC
+BOOLEAN
+WaitForConversion (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Wait for one conversion started by ConvertBatch() to finish.
+
+Arguments:
+
+  None
+
+Returns:
+
+  TRUE  - The conversion succeeded.
+  FALSE - The conversion failed.
+
+--*/
+{
+  int   ChildStatus;
+
+  if (wait (&ChildStatus) < 0) {
+    return FALSE;
+  }
+  return (BOOLEAN) (WIFEXITED (ChildStatus) && WEXITSTATUS (ChildStatus) == STATUS_SUCCESS);
+}
+#endif
+
+STATIC
+STATUS
+ConvertBatch (
+  IN int   argc,
+  IN char  *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Run the conversions listed in a manifest file, several of them at a time.
+
+  Each line of the manifest holds the options and input file of one GenFw
+  invocation. Blank lines and lines starting with '#' are skipped, and a
+  value containing spaces is enclosed in double quotes. Every conversion runs
+  in a child process, so it behaves exactly like a separate invocation of the
+  utility and produces the same output.
+
+Arguments:
+
+  argc - Number of command line parameters, starting at --batch.
+  argv - The command line parameters: --batch ManifestFile [--jobs Number]
+
+Returns:
+
+  STATUS_SUCCESS - All the conversions succeeded.
+  STATUS_ERROR   - The manifest is invalid or a conversion failed.
+
+--*/
+{
+#ifdef __GNUC__
+  CHAR8     *ManifestName;
+  FILE      *ManifestFile;
+  UINTN     ManifestSize;
+  CHAR8     *Manifest;
+  CHAR8     *Line;
+  CHAR8     *NextLine;
+  CHAR8     *Cptr;
+  CHAR8     *Argv[MAX_BATCH_ARGUMENTS + 2];
+  int       Argc;
+  int       Index;
+  UINT32    LineNumber;
+  UINT64    Jobs;
+  long      Processors;
+  UINT64    Running;
+  UINT32    FailedNumber;
+  BOOLEAN   Stop;
+  pid_t     Pid;
+
+  if (argc != 2 && argc != 4) {
+    Error (NULL, 0, 1001, "Missing options", "--batch ManifestFile [--jobs Number]");
+    return STATUS_ERROR;
+  }
+  ManifestName = argv[1];
+
+  Processors = sysconf (_SC_NPROCESSORS_ONLN);
+  Jobs = (Processors > 0) ? (UINT64) Processors : 1;
+  if (argc == 4) {
+    if (stricmp (argv[2], "--jobs") != 0) {
+      Error (NULL, 0, 1000, "Unknown option", "%s", argv[2]);
+      return STATUS_ERROR;
+    }
+    if (AsciiStringToUint64 (argv[3], FALSE, &Jobs) != EFI_SUCCESS || Jobs == 0) {
+      Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[2], argv[3]);
+      return STATUS_ERROR;
+    }
+  }
+
+  //
+  // Read the whole manifest, so that no file is open when the children are
+  // created
+  //
+  ManifestFile = fopen (LongFilePath (ManifestName), "rb");
+  if (ManifestFile == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", ManifestName);
+    return STATUS_ERROR;
+  }
+  ManifestSize = _filelength (fileno (ManifestFile));
+  Manifest = malloc (ManifestSize + 1);
+  if (Manifest == NULL) {
+    fclose (ManifestFile);
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return STATUS_ERROR;
+  }
+  if (fread (Manifest, 1, ManifestSize, ManifestFile) != ManifestSize) {
+    fclose (ManifestFile);
+    free (Manifest);
+    Error (NULL, 0, 0004, "Error reading file", ManifestName);
+    return STATUS_ERROR;
+  }
+  fclose (ManifestFile);
+  Manifest[ManifestSize] = '\0';
+
+  //
+  // Don't let the children write the output buffered so far again
+  //
+  fflush (stdout);
+  fflush (stderr);
+
+  Running      = 0;
+  FailedNumber = 0;
+  Stop         = FALSE;
+  LineNumber   = 0;
+  for (Line = Manifest; !Stop && Line != NULL; Line = NextLine) {
+    LineNumber++;
+    NextLine = strchr (Line, '\n');
+    if (NextLine != NULL) {
+      *NextLine++ = '\0';
+    }
+
+    //
+    // Split the line into the arguments of one conversion
+    //
+    Argc = 0;
+    Argv[Argc++] = UTILITY_NAME;
+    Cptr = Line;
+    while (TRUE) {
+      while (isspace ((int) *Cptr)) {
+        Cptr++;
+      }
+      if (*Cptr == '\0' || (Argc == 1 && *Cptr == '#')) {
+        break;
+      }
+      if (Argc > MAX_BATCH_ARGUMENTS) {
+        Error (ManifestName, LineNumber, 2000, "Invalid parameter", "more than %u arguments", MAX_BATCH_ARGUMENTS);
+        Stop = TRUE;
+        break;
+      }
+      if (*Cptr == '"') {
+        Argv[Argc++] = ++Cptr;
+        while (*Cptr != '\0' && *Cptr != '"') {
+          Cptr++;
+        }
+      } else {
+        Argv[Argc++] = Cptr;
+        while (*Cptr != '\0' && !isspace ((int) *Cptr)) {
+          Cptr++;
+        }
+      }
+      if (*Cptr != '\0') {
+        *Cptr++ = '\0';
+      }
+    }
+    Argv[Argc] = NULL;
+    if (Stop || Argc == 1) {
+      continue;
+    }
+
+    //
+    // A conversion must not start a batch of its own
+    //
+    for (Index = 1; Index < Argc; Index++) {
+      if (stricmp (Argv[Index], "--batch") == 0 || stricmp (Argv[Index], "--jobs") == 0) {
+        Error (ManifestName, LineNumber, 1000, "Unknown option", "%s is not allowed in a batch manifest", Argv[Index]);
+        Stop = TRUE;
+        break;
+      }
+    }
+    if (Stop) {
+      continue;
+    }
+
+    //
+    // Wait for a running conversion to finish before starting another one
+    //
+    if (Running == Jobs) {
+      if (!WaitForConversion ()) {
+        FailedNumber++;
+        Stop = TRUE;
+      }
+      Running--;
+      if (Stop) {
+        continue;
+      }
+    }
+
+    Pid = fork ();
+    if (Pid < 0) {
+      Error (ManifestName, LineNumber, 4001, "Resource", "cannot create the process of the conversion");
+      Stop = TRUE;
+      continue;
+    }
+    if (Pid == 0) {
+      exit (main (Argc, Argv));
+    }
+    Running++;
+  }
+
+  //
+  // Wait for the remaining conversions
+  //
+  while (Running > 0) {
+    if (!WaitForConversion ()) {
+      FailedNumber++;
+    }
+    Running--;
+  }
+  free (Manifest);
+
+  if (FailedNumber != 0) {
+    Error (ManifestName, 0, 3000, "Invalid", "%u conversion(s) failed", (unsigned) FailedNumber);
+    return STATUS_ERROR;
+  }
+  if (Stop) {
+    return STATUS_ERROR;
+  }
+  return STATUS_SUCCESS;
+#else
+  Error (NULL, 0, 1000, "Unknown option", "--batch is not supported on this host");
+  return STATUS_ERROR;
+#endif
+}
+
 STATIC
 EFI_STATUS
 ZeroDebugData (
@@ -14,6 +14,12 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <Python.h>
 #include <Decompress.h>
+#include <Compress.h>
+#include "LzmaEnc.h"
+#include "LzmaDec.h"
+#include "Bra.h"
+
+#define LZMA_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
 
 /*
  UefiDecompress(data_buffer, size, original_size)
@@ -75,7 +81,9 @@ UefiDecompress(
     TmpBuf += Len;
   }
 
+  Py_BEGIN_ALLOW_THREADS
   Status = Extract((VOID *)SrcBuf, SrcDataSize, (VOID **)&DstBuf, &DstDataSize, 1);
+  Py_END_ALLOW_THREADS
   if (Status != EFI_SUCCESS) {
     PyErr_SetString(PyExc_Exception, "Failed to decompress\n");
     goto ERROR;
@@ -152,7 +160,9 @@ FrameworkDecompress(
     TmpBuf += Len;
   }
 
+  Py_BEGIN_ALLOW_THREADS
   Status = Extract((VOID *)SrcBuf, SrcDataSize, (VOID **)&DstBuf, &DstDataSize, 2);
+  Py_END_ALLOW_THREADS
   if (Status != EFI_SUCCESS) {
     PyErr_SetString(PyExc_Exception, "Failed to decompress\n");
     goto ERROR;
@@ -172,6 +182,63 @@ ERROR:
 }
 
 
+/*
+ Compress the data of Args with CompressFunction, without holding the GIL so
+ that other threads can compress other data at the same time.
+*/
+STATIC
+PyObject*
+CompressData(
+  PyObject          *Args,
+  COMPRESS_FUNCTION CompressFunction
+  )
+{
+  UINT8         *SrcBuf;
+  INT32         SrcDataSize;
+  UINT32        DstDataSize;
+  EFI_STATUS    Status;
+  UINT8         *DstBuf;
+  PyObject      *DstData;
+
+  if (!PyArg_ParseTuple(Args, "s#", &SrcBuf, &SrcDataSize)) {
+    return NULL;
+  }
+
+  //
+  // The compressed data is rarely larger than the source data. If it is,
+  // the compressor returns the size it needs and runs once more.
+  //
+  DstDataSize = SrcDataSize + SrcDataSize / 8 + 64;
+  Py_BEGIN_ALLOW_THREADS
+  DstBuf = malloc(DstDataSize);
+  Status = EFI_OUT_OF_RESOURCES;
+  if (DstBuf != NULL) {
+    Status = CompressFunction(SrcBuf, SrcDataSize, DstBuf, &DstDataSize);
+    if (Status == EFI_BUFFER_TOO_SMALL) {
+      free(DstBuf);
+      DstBuf = malloc(DstDataSize);
+      Status = EFI_OUT_OF_RESOURCES;
+      if (DstBuf != NULL) {
+        Status = CompressFunction(SrcBuf, SrcDataSize, DstBuf, &DstDataSize);
+      }
+    }
+  }
+  Py_END_ALLOW_THREADS
+
+  if (Status != EFI_SUCCESS) {
+    free(DstBuf);
+    PyErr_SetString(PyExc_Exception, "Failed to compress\n");
+    return NULL;
+  }
+
+  DstData = PyString_FromStringAndSize((CONST INT8*)DstBuf, (Py_ssize_t)DstDataSize);
+  free(DstBuf);
+  return DstData;
+}
+
+/*
+ UefiCompress(data)
+*/
 STATIC
 PyObject*
 UefiCompress(
@@ -179,10 +246,13 @@ UefiCompress(
   PyObject    *Args
   )
 {
-  return NULL;
+  return CompressData(Args, EfiCompress);
 }
 
 
+/*
+ FrameworkCompress(data)
+*/
 STATIC
 PyObject*
 FrameworkCompress(
@@ -190,17 +260,189 @@ FrameworkCompress(
   PyObject    *Args
   )
 {
-  return NULL;
+  return CompressData(Args, TianoCompress);
+}
+
+STATIC
+VOID *
+LzmaAlloc(
+  VOID    *P,
+  size_t  Size
+  )
+{
+  return malloc(Size);
+}
+
+STATIC
+VOID
+LzmaFree(
+  VOID    *P,
+  VOID    *Address
+  )
+{
+  free(Address);
+}
+
+STATIC ISzAlloc mLzmaAlloc = { LzmaAlloc, LzmaFree };
+
+/*
+ LzmaCompress(data, x86_convert=0)
+
+ The result is what "LzmaCompress -e" (or "LzmaF86Compress -e" if x86_convert
+ is set) writes: the LZMA properties, the 64-bit size of data and the stream.
+*/
+STATIC
+PyObject*
+LzmaCompress(
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  UINT8           *SrcBuf;
+  INT32           SrcDataSize;
+  INT32           X86Convert;
+  UINT8           *FilteredBuf;
+  UINT8           *DstBuf;
+  SizeT           DstDataSize;
+  SizeT           PropsSize;
+  CLzmaEncProps   Props;
+  UInt32          X86State;
+  SRes            Result;
+  PyObject        *DstData;
+  INT32           Index;
+
+  X86Convert = 0;
+  if (!PyArg_ParseTuple(Args, "s#|i", &SrcBuf, &SrcDataSize, &X86Convert)) {
+    return NULL;
+  }
+  if (SrcDataSize == 0) {
+    PyErr_SetString(PyExc_Exception, "No data to compress\n");
+    return NULL;
+  }
+
+  LzmaEncProps_Init(&Props);
+  LzmaEncProps_Normalize(&Props);
+
+  Py_BEGIN_ALLOW_THREADS
+  FilteredBuf = NULL;
+  DstDataSize = (SizeT)SrcDataSize / 20 * 21 + (1 << 16);
+  DstBuf = malloc(DstDataSize);
+  Result = SZ_ERROR_MEM;
+  if (DstBuf != NULL && X86Convert) {
+    FilteredBuf = malloc(SrcDataSize);
+    if (FilteredBuf != NULL) {
+      memcpy(FilteredBuf, SrcBuf, SrcDataSize);
+      x86_Convert_Init(X86State);
+      x86_Convert(FilteredBuf, (SizeT)SrcDataSize, 0, &X86State, 1);
+      SrcBuf = FilteredBuf;
+    }
+  }
+  if (DstBuf != NULL && (FilteredBuf != NULL || !X86Convert)) {
+    for (Index = 0; Index < 8; Index++) {
+      DstBuf[LZMA_PROPS_SIZE + Index] = (UINT8)((UINT64)SrcDataSize >> (8 * Index));
+    }
+    DstDataSize -= LZMA_HEADER_SIZE;
+    PropsSize = LZMA_PROPS_SIZE;
+    Result = LzmaEncode(DstBuf + LZMA_HEADER_SIZE, &DstDataSize, SrcBuf, SrcDataSize,
+                        &Props, DstBuf, &PropsSize, 0, NULL, &mLzmaAlloc, &mLzmaAlloc);
+    DstDataSize += LZMA_HEADER_SIZE;
+  }
+  free(FilteredBuf);
+  Py_END_ALLOW_THREADS
+
+  if (Result != SZ_OK) {
+    free(DstBuf);
+    PyErr_SetString(PyExc_Exception, "Failed to compress\n");
+    return NULL;
+  }
+
+  DstData = PyString_FromStringAndSize((CONST INT8*)DstBuf, (Py_ssize_t)DstDataSize);
+  free(DstBuf);
+  return DstData;
+}
+
+/*
+ LzmaDecompress(data, x86_convert=0)
+*/
+STATIC
+PyObject*
+LzmaDecompress(
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  UINT8           *SrcBuf;
+  INT32           SrcDataSize;
+  INT32           X86Convert;
+  UINT8           *DstBuf;
+  UINT64          DstDataSize;
+  SizeT           OutSize;
+  SizeT           InSize;
+  ELzmaStatus     LzmaStatus;
+  UInt32          X86State;
+  SRes            Result;
+  PyObject        *DstData;
+  INT32           Index;
+
+  X86Convert = 0;
+  if (!PyArg_ParseTuple(Args, "s#|i", &SrcBuf, &SrcDataSize, &X86Convert)) {
+    return NULL;
+  }
+  if (SrcDataSize < LZMA_HEADER_SIZE) {
+    PyErr_SetString(PyExc_Exception, "Failed to decompress\n");
+    return NULL;
+  }
+
+  DstDataSize = 0;
+  for (Index = 0; Index < 8; Index++) {
+    DstDataSize |= ((UINT64)SrcBuf[LZMA_PROPS_SIZE + Index]) << (Index * 8);
+  }
+  if (DstDataSize > 0x7FFFFFFF) {
+    PyErr_SetString(PyExc_Exception, "Failed to decompress\n");
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  OutSize = (SizeT)DstDataSize;
+  InSize = SrcDataSize - LZMA_HEADER_SIZE;
+  DstBuf = malloc(OutSize + 1);
+  Result = SZ_ERROR_MEM;
+  if (DstBuf != NULL) {
+    Result = LzmaDecode(DstBuf, &OutSize, SrcBuf + LZMA_HEADER_SIZE, &InSize, SrcBuf, LZMA_PROPS_SIZE,
+                        LZMA_FINISH_END, &LzmaStatus, &mLzmaAlloc);
+    if (Result == SZ_OK && OutSize != DstDataSize) {
+      Result = SZ_ERROR_DATA;
+    }
+    if (Result == SZ_OK && X86Convert) {
+      x86_Convert_Init(X86State);
+      x86_Convert(DstBuf, OutSize, 0, &X86State, 0);
+    }
+  }
+  Py_END_ALLOW_THREADS
+
+  if (Result != SZ_OK) {
+    free(DstBuf);
+    PyErr_SetString(PyExc_Exception, "Failed to decompress\n");
+    return NULL;
+  }
+
+  DstData = PyString_FromStringAndSize((CONST INT8*)DstBuf, (Py_ssize_t)OutSize);
+  free(DstBuf);
+  return DstData;
 }
 
 STATIC INT8 DecompressDocs[] = "Decompress(): Decompress data using UEFI standard algorithm\n";
 STATIC INT8 CompressDocs[] = "Compress(): Compress data using UEFI standard algorithm\n";
+STATIC INT8 LzmaDecompressDocs[] = "LzmaDecompress(): Decompress data using LZMA algorithm\n";
+STATIC INT8 LzmaCompressDocs[] = "LzmaCompress(): Compress data using LZMA algorithm\n";
 
 STATIC PyMethodDef EfiCompressor_Funcs[] = {
   {"UefiDecompress", (PyCFunction)UefiDecompress, METH_VARARGS, DecompressDocs},
-  {"UefiCompress", (PyCFunction)UefiCompress, METH_VARARGS, DecompressDocs},
+  {"UefiCompress", (PyCFunction)UefiCompress, METH_VARARGS, CompressDocs},
   {"FrameworkDecompress", (PyCFunction)FrameworkDecompress, METH_VARARGS, DecompressDocs},
-  {"FrameworkCompress", (PyCFunction)FrameworkCompress, METH_VARARGS, DecompressDocs},
+  {"FrameworkCompress", (PyCFunction)FrameworkCompress, METH_VARARGS, CompressDocs},
+  {"LzmaDecompress", (PyCFunction)LzmaDecompress, METH_VARARGS, LzmaDecompressDocs},
+  {"LzmaCompress", (PyCFunction)LzmaCompress, METH_VARARGS, LzmaCompressDocs},
   {NULL, NULL, 0, NULL}
 };
 
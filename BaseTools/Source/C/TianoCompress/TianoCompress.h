@@ -37,6 +37,7 @@
 #define THRESHOLD 3
 #define CODE_BIT  16
 #define BAD_TABLE - 1
+#define WNDBIT    19
 
 typedef INT32 NODE;
 
@@ -47,6 +48,7 @@ typedef INT32 NODE;
 #define CBIT    9
 #define MAXPBIT 5
 #define TBIT    5
+#define NP      (WNDBIT + 1)
 #define MAXNP   ((1U << MAXPBIT) - 1)
 #define NT      (CODE_BIT + 3)
 #if NT > MAXNP
@@ -85,6 +87,67 @@ typedef struct {
   UINT8   mPBit;
 } SCRATCH_DATA;
 
+//
+// The state of one compression. Each call to TianoCompress() has its own, so
+// several compressions can run at the same time in one process.
+//
+typedef struct {
+  UINT8   *mSrc;
+  UINT8   *mDst;
+  UINT8   *mSrcUpperLimit;
+  UINT8   *mDstUpperLimit;
+
+  //
+  // String Info Log. The dictionary holds 2^mWndBit bytes, at most 2^WNDBIT.
+  //
+  UINT32  mWndBit;
+  UINT32  mWndSiz;
+  UINT8   *mText;
+  UINT8   *mLevel;
+  UINT8   *mChildCount;
+  NODE    *mPosition;
+  NODE    *mParent;
+  NODE    *mPrev;
+  NODE    *mNext;
+  NODE    mPos;
+  NODE    mMatchPos;
+  NODE    mAvail;
+  INT32   mRemainder;
+  INT32   mMatchLen;
+
+  //
+  // Huffman encoding of the blocks
+  //
+  UINT8   *mBuf;
+  UINT32  mBufSiz;
+  UINT32  mOutputPos;
+  UINT32  mOutputMask;
+  UINT32  mCPos;
+  INT32   mBitCount;
+  UINT32  mSubBitBuf;
+  UINT32  mCompSize;
+  UINT32  mOrigSize;
+  UINT32  mCrc;
+  UINT16  mCrcTable[0xff + 1];
+  INT32   mN;
+  INT32   mHeapSize;
+  INT32   mDepth;
+  INT16   mHeap[NC + 1];
+  UINT16  *mFreq;
+  UINT16  *mSortPtr;
+  UINT8   *mLen;
+  UINT16  mLenCnt[17];
+  UINT16  mLeft[2 * NC - 1];
+  UINT16  mRight[2 * NC - 1];
+  UINT8   mCLen[NC];
+  UINT8   mPTLen[NPT];
+  UINT16  mCFreq[2 * NC - 1];
+  UINT16  mCCode[NC];
+  UINT16  mPFreq[2 * NP - 1];
+  UINT16  mPTCode[NPT];
+  UINT16  mTFreq[2 * NT - 1];
+} COMPRESS_DATA;
+
 //
 // Function Prototypes
 //
@@ -98,31 +161,33 @@ GetFileContents (
   
 STATIC
 VOID
-PutDword(
+PutDword (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Data
   );
 
 STATIC
 EFI_STATUS
 AllocateMemory (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 FreeMemory (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 InitSlide (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 NODE
 Child (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE   NodeQ,
   IN UINT8  CharC
   );
@@ -130,6 +195,7 @@ Child (
 STATIC
 VOID
 MakeChild (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE  NodeQ,
   IN UINT8 CharC,
   IN NODE  NodeR
@@ -138,42 +204,44 @@ MakeChild (
 STATIC
 VOID
 Split (
+  IN OUT COMPRESS_DATA  *Cd,
   IN NODE Old
   );
 
 STATIC
 VOID
 InsertNode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 DeleteNode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 GetNextMatch (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 EFI_STATUS
 Encode (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 CountTFreq (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 WritePTLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Number,
   IN INT32 nbit,
   IN INT32 Special
@@ -182,30 +250,33 @@ WritePTLen (
 STATIC
 VOID
 WriteCLen (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 EncodeC (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Value
   );
 
 STATIC
 VOID
 EncodeP (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 Value
   );
 
 STATIC
 VOID
 SendBlock (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 Output (
+  IN OUT COMPRESS_DATA  *Cd,
   IN UINT32 c,
   IN UINT32 p
   );
@@ -213,25 +284,26 @@ Output (
 STATIC
 VOID
 HufEncodeStart (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 HufEncodeEnd (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 MakeCrcTable (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
   
 STATIC
 VOID
 PutBits (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32  Number,
   IN UINT32 Value
   );
@@ -239,6 +311,7 @@ PutBits (
 STATIC
 INT32
 FreadCrc (
+  IN OUT COMPRESS_DATA  *Cd,
   OUT UINT8 *Pointer,
   IN  INT32 Number
   );
@@ -246,30 +319,34 @@ FreadCrc (
 STATIC
 VOID
 InitPutBits (
-  VOID
+  IN OUT COMPRESS_DATA  *Cd
   );
 
 STATIC
 VOID
 CountLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Index
   );
 
 STATIC
 VOID
 MakeLen (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Root
   );
 
 STATIC
 VOID
 DownHeap (
+  IN OUT COMPRESS_DATA  *Cd,
   IN INT32 Index
   );
 
 STATIC
 VOID
 MakeCode (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32       Number,
   IN  UINT8 Len[  ],
   OUT UINT16 Code[]
@@ -278,6 +355,7 @@ MakeCode (
 STATIC
 INT32
 MakeTree (
+  IN OUT COMPRESS_DATA  *Cd,
   IN  INT32            NParm,
   IN  UINT16  FreqParm[],
   OUT UINT8   LenParm[ ],
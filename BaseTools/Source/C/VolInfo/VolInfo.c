@@ -17,6 +17,9 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#ifdef __GNUC__
+#include <sys/mman.h>
+#endif
 
 #include <FvLib.h>
 #include <Common/UefiBaseTypes.h>
@@ -36,6 +39,8 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "OsPath.h"
 #include "ParseGuidedSectionTools.h"
 #include "StringFuncs.h"
+#include "LzmaDec.h"
+#include "Bra.h"
 
 //
 // Utility global variables
@@ -43,6 +48,14 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 EFI_GUID  gEfiCrc32GuidedSectionExtractionProtocolGuid = EFI_CRC32_GUIDED_SECTION_EXTRACTION_PROTOCOL_GUID;
 
+//
+// GUIDed sections of the LzmaCompress, LzmaF86Compress and TianoCompress tools,
+// which are decoded in-process instead of by running the tools
+//
+static EFI_GUID  mLzmaCustomDecompressGuid     = { 0xEE4E5898, 0x3914, 0x4259, { 0x9D, 0x6E, 0xDC, 0x7B, 0xD7, 0x94, 0x03, 0xCF }};
+static EFI_GUID  mLzmaF86CustomDecompressGuid  = { 0xD42AE6BD, 0x1352, 0x4BFB, { 0x90, 0x9A, 0xCA, 0x72, 0xA6, 0xEA, 0xE8, 0x89 }};
+static EFI_GUID  mTianoCustomDecompressGuid    = { 0xA31280AD, 0x481E, 0x41B6, { 0x95, 0xE8, 0x12, 0x7F, 0x4C, 0x98, 0x47, 0x79 }};
+
 #define UTILITY_MAJOR_VERSION      0
 #define UTILITY_MINOR_VERSION      83
 
@@ -52,6 +65,10 @@ EFI_GUID  gEfiCrc32GuidedSectionExtractionProtocolGuid = EFI_CRC32_GUIDED_SECTIO
 
 #define MAX_BASENAME_LEN  60  // not good to hardcode, but let's be reasonable
 
+#define LZMA_HEADER_SIZE  (LZMA_PROPS_SIZE + 8)
+
+#define MAX_JSON_DEPTH    64
+
 //
 // Structure to keep a list of guid-to-basenames
 //
@@ -70,6 +87,14 @@ EFI_HANDLE mParsedGuidedSectionTools = NULL;
 
 CHAR8* mUtilityFilename = NULL;
 
+//
+// Inventory written with --json: the current nesting depth, and whether the
+// object or array at each depth has no member yet
+//
+static FILE     *mJsonFile = NULL;
+static UINTN    mJsonDepth = 0;
+static BOOLEAN  mJsonFirst[MAX_JSON_DEPTH];
+
 EFI_STATUS
 ParseGuidBaseNameFile (
   CHAR8    *FileName
@@ -85,6 +110,11 @@ PrintGuidName (
   IN UINT8    *GuidStr
   );
 
+CHAR8 *
+GetGuidBaseName (
+  IN UINT8    *GuidStr
+  );
+
 EFI_STATUS
 ParseSection (
   IN UINT8  *SectionBuffer,
@@ -126,6 +156,51 @@ LoadGuidedSectionToolsTxt (
   IN CHAR8* FirmwareVolumeFilename
   );
 
+static
+EFI_STATUS
+DecodeGuidedSection (
+  IN  EFI_GUID  *EfiGuid,
+  IN  UINT8     *Data,
+  IN  UINT32    DataLength,
+  OUT UINT8     **DecodedBuffer,
+  OUT UINT32    *DecodedLength
+  );
+
+static
+EFI_STATUS
+JsonOpen (
+  IN CHAR8  *Name,
+  IN CHAR8  Bracket
+  );
+
+static
+VOID
+JsonClose (
+  IN CHAR8  Bracket
+  );
+
+static
+VOID
+JsonString (
+  IN CHAR8  *Name,
+  IN CHAR8  *Value
+  );
+
+static
+VOID
+JsonNumber (
+  IN CHAR8  *Name,
+  IN UINT32 Value
+  );
+
+static
+VOID
+JsonRatio (
+  IN CHAR8  *Name,
+  IN UINT32 Numerator,
+  IN UINT32 Denominator
+  );
+
 void
 Usage (
   VOID
@@ -160,6 +235,10 @@ Returns:
   EFI_STATUS                  Status;
   int                         Offset;
   BOOLEAN                     ErasePolarity;
+  CHAR8                       *JsonFileName;
+  UINT8                       *FileImage;
+  UINTN                       FileSize;
+  BOOLEAN                     Mapped;
 
   SetUtilityName (UTILITY_NAME);
   //
@@ -181,6 +260,7 @@ Returns:
   argv++;
 
   Offset = 0;
+  JsonFileName = NULL;
 
   //
   // If they specified -x xref guid/basename cross-reference files, process it.
@@ -216,6 +296,10 @@ Returns:
         }
       }
 
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[0], "--json") == 0) {
+      JsonFileName = argv[1];
       argc -= 2;
       argv += 2;
     } else {
@@ -263,35 +347,84 @@ Returns:
     fclose (InputFile);
     return GetUtilityStatus ();
   }
+  Mapped    = FALSE;
+  FileImage = NULL;
+  FileSize  = (UINTN) Offset + FvSize;
+#ifdef __GNUC__
   //
-  // Allocate a buffer for the FV image
+  // Map the file up to the end of the FV where the host supports it, so that
+  // the FV is not copied however large the image is
   //
-  FvImage = malloc (FvSize);
-  if (FvImage == NULL) {
-    Error (NULL, 0, 4001, "Resource: Memory can't be allocated", NULL);
+  if (_filelength (fileno (InputFile)) >= FileSize) {
+    FileImage = mmap (NULL, FileSize, PROT_READ, MAP_PRIVATE, fileno (InputFile), 0);
+    if (FileImage != MAP_FAILED) {
+      Mapped = TRUE;
+    }
+  }
+#endif
+  if (Mapped) {
     fclose (InputFile);
-    return GetUtilityStatus ();
+    FvImage = (EFI_FIRMWARE_VOLUME_HEADER *) (FileImage + Offset);
+  } else {
+    //
+    // Allocate a buffer for the FV image
+    //
+    FvImage = malloc (FvSize);
+    if (FvImage == NULL) {
+      Error (NULL, 0, 4001, "Resource: Memory can't be allocated", NULL);
+      fclose (InputFile);
+      return GetUtilityStatus ();
+    }
+    //
+    // Seek to the start of the image, then read the entire FV to the buffer
+    //
+    fseek (InputFile, Offset, SEEK_SET);
+    BytesRead = fread (FvImage, 1, FvSize, InputFile);
+    fclose (InputFile);
+    if ((unsigned int) BytesRead != FvSize) {
+      Error (NULL, 0, 0004, "error reading FvImage from", argv[0]);
+      free (FvImage);
+      return GetUtilityStatus ();
+    }
   }
-  //
-  // Seek to the start of the image, then read the entire FV to the buffer
-  //
-  fseek (InputFile, Offset, SEEK_SET);
-  BytesRead = fread (FvImage, 1, FvSize, InputFile);
-  fclose (InputFile);
-  if ((unsigned int) BytesRead != FvSize) {
-    Error (NULL, 0, 0004, "error reading FvImage from", argv[0]);
-    free (FvImage);
-    return GetUtilityStatus ();
+
+  if (JsonFileName != NULL) {
+    mJsonFile = fopen (LongFilePath (JsonFileName), "w");
+    if (mJsonFile == NULL) {
+      Error (NULL, 0, 0001, "Error opening the output file", JsonFileName);
+    }
   }
 
-  LoadGuidedSectionToolsTxt (argv[0]);
+  if ((JsonFileName == NULL) || (mJsonFile != NULL)) {
+    LoadGuidedSectionToolsTxt (argv[0]);
 
-  PrintFvInfo (FvImage, FALSE);
+    JsonOpen (NULL, '{');
+    JsonString ("File", argv[0]);
+    JsonNumber ("Offset", (UINT32) Offset);
+    Status = PrintFvInfo (FvImage, FALSE);
+    JsonClose ('}');
+  }
 
   //
   // Clean up
   //
-  free (FvImage);
+  if (mJsonFile != NULL) {
+    fputc ('\n', mJsonFile);
+    fclose (mJsonFile);
+    if (EFI_ERROR (Status) || GetUtilityStatus () == STATUS_ERROR) {
+      //
+      // Do not leave an incomplete inventory behind
+      //
+      remove (LongFilePath (JsonFileName));
+    }
+  }
+  if (Mapped) {
+#ifdef __GNUC__
+    munmap (FileImage, FileSize);
+#endif
+  } else {
+    free (FvImage);
+  }
   FreeGuidBaseNameList ();
   return GetUtilityStatus ();
 }
@@ -326,6 +459,7 @@ Returns:
   UINTN                       FvSize;
   EFI_FFS_FILE_HEADER         *CurrentFile;
   UINTN                       Key;
+  UINT8                       GuidBuffer[PRINTED_GUID_BUFFER_SIZE];
 
   Status = FvBufGetSize (Fv, &FvSize);
 
@@ -334,6 +468,17 @@ Returns:
     (((EFI_FIRMWARE_VOLUME_HEADER*)Fv)->Attributes & EFI_FVB2_ERASE_POLARITY) ?
       TRUE : FALSE;
 
+  PrintGuidToBuffer (&((EFI_FIRMWARE_VOLUME_HEADER*)Fv)->FileSystemGuid, GuidBuffer, sizeof (GuidBuffer), TRUE);
+  if (EFI_ERROR (JsonOpen ("FirmwareVolume", '{'))) {
+    return EFI_ABORTED;
+  }
+  JsonString ("FileSystemGuid", (CHAR8 *) GuidBuffer);
+  JsonNumber ("Size", (UINT32) FvSize);
+  JsonNumber ("Attributes", ((EFI_FIRMWARE_VOLUME_HEADER*)Fv)->Attributes);
+  if (EFI_ERROR (JsonOpen ("Files", '['))) {
+    return EFI_ABORTED;
+  }
+
   //
   // Get the first file
   //
@@ -378,6 +523,10 @@ Returns:
     printf ("There are a total of %d files in this FV\n", (int) NumberOfFiles);
   }
 
+  JsonClose (']');
+  JsonNumber ("NumberOfFiles", (UINT32) NumberOfFiles);
+  JsonClose ('}');
+
   return EFI_SUCCESS;
 }
 
@@ -533,11 +682,11 @@ Returns:
     //
     // 0x17
     //
-    "EFI_SECTION_FIRMWARE_VOLUME_IMAGE ",
+    "EFI_SECTION_FIRMWARE_VOLUME_IMAGE",
     //
     // 0x18
     //
-    "EFI_SECTION_FREEFORM_SUBTYPE_GUID ",
+    "EFI_SECTION_FREEFORM_SUBTYPE_GUID",
     //
     // 0x19
     //
@@ -972,6 +1121,7 @@ Returns:
   EFI_STATUS          Status;
   UINT8               GuidBuffer[PRINTED_GUID_BUFFER_SIZE];
   UINT32              HeaderSize;
+  CHAR8               *FileTypeStr;
 #if (PI_SPECIFICATION_VERSION < 0x00010000) 
   UINT16              *Tail;
 #endif
@@ -1009,6 +1159,18 @@ Returns:
   printf ("File Attributes:  0x%02X\n", FileHeader->Attributes);
   printf ("File State:       0x%02X\n", FileHeader->State);
 
+  if (EFI_ERROR (JsonOpen (NULL, '{'))) {
+    return EFI_ABORTED;
+  }
+  JsonString ("Name", (CHAR8 *) GuidBuffer);
+  if (GetGuidBaseName (GuidBuffer) != NULL) {
+    JsonString ("BaseName", GetGuidBaseName (GuidBuffer));
+  }
+  JsonNumber ("Offset", (UINT32) ((UINTN) FileHeader - (UINTN) FvImage));
+  JsonNumber ("Size", FileLength);
+  JsonNumber ("Attributes", FileHeader->Attributes);
+  JsonNumber ("State", FileHeader->State);
+
   //
   // Print file state
   //
@@ -1018,10 +1180,12 @@ Returns:
 
   case EFI_FILE_HEADER_CONSTRUCTION:
     printf ("        EFI_FILE_HEADER_CONSTRUCTION\n");
+    JsonClose ('}');
     return EFI_SUCCESS;
 
   case EFI_FILE_HEADER_INVALID:
     printf ("        EFI_FILE_HEADER_INVALID\n");
+    JsonClose ('}');
     return EFI_SUCCESS;
 
   case EFI_FILE_HEADER_VALID:
@@ -1034,6 +1198,7 @@ Returns:
       return EFI_ABORTED;
     }
 
+    JsonClose ('}');
     return EFI_SUCCESS;
 
   case EFI_FILE_DELETED:
@@ -1102,59 +1267,59 @@ Returns:
   switch (FileHeader->Type) {
 
   case EFI_FV_FILETYPE_RAW:
-    printf ("EFI_FV_FILETYPE_RAW\n");
+    FileTypeStr = "EFI_FV_FILETYPE_RAW";
     break;
 
   case EFI_FV_FILETYPE_FREEFORM:
-    printf ("EFI_FV_FILETYPE_FREEFORM\n");
+    FileTypeStr = "EFI_FV_FILETYPE_FREEFORM";
     break;
 
   case EFI_FV_FILETYPE_SECURITY_CORE:
-    printf ("EFI_FV_FILETYPE_SECURITY_CORE\n");
+    FileTypeStr = "EFI_FV_FILETYPE_SECURITY_CORE";
     break;
 
   case EFI_FV_FILETYPE_PEI_CORE:
-    printf ("EFI_FV_FILETYPE_PEI_CORE\n");
+    FileTypeStr = "EFI_FV_FILETYPE_PEI_CORE";
     break;
 
   case EFI_FV_FILETYPE_DXE_CORE:
-    printf ("EFI_FV_FILETYPE_DXE_CORE\n");
+    FileTypeStr = "EFI_FV_FILETYPE_DXE_CORE";
     break;
 
   case EFI_FV_FILETYPE_PEIM:
-    printf ("EFI_FV_FILETYPE_PEIM\n");
+    FileTypeStr = "EFI_FV_FILETYPE_PEIM";
     break;
 
   case EFI_FV_FILETYPE_DRIVER:
-    printf ("EFI_FV_FILETYPE_DRIVER\n");
+    FileTypeStr = "EFI_FV_FILETYPE_DRIVER";
     break;
 
   case EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER:
-    printf ("EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER\n");
+    FileTypeStr = "EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER";
     break;
 
   case EFI_FV_FILETYPE_APPLICATION:
-    printf ("EFI_FV_FILETYPE_APPLICATION\n");
+    FileTypeStr = "EFI_FV_FILETYPE_APPLICATION";
     break;
 
   case EFI_FV_FILETYPE_SMM:
-    printf ("EFI_FV_FILETYPE_SMM\n");
+    FileTypeStr = "EFI_FV_FILETYPE_SMM";
     break;
 
   case EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE:
-    printf ("EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE\n");
+    FileTypeStr = "EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE";
     break;
 
   case EFI_FV_FILETYPE_COMBINED_SMM_DXE:
-    printf ("EFI_FV_FILETYPE_COMBINED_SMM_DXE\n");
+    FileTypeStr = "EFI_FV_FILETYPE_COMBINED_SMM_DXE";
     break;
 
   case EFI_FV_FILETYPE_SMM_CORE:
-    printf ("EFI_FV_FILETYPE_SMM_CORE\n");
+    FileTypeStr = "EFI_FV_FILETYPE_SMM_CORE";
     break;
 
   case EFI_FV_FILETYPE_FFS_PAD:
-    printf ("EFI_FV_FILETYPE_FFS_PAD\n");
+    FileTypeStr = "EFI_FV_FILETYPE_FFS_PAD";
     break;
 
   default:
@@ -1163,6 +1328,9 @@ Returns:
     break;
   }
 
+  printf ("%s\n", FileTypeStr);
+  JsonString ("Type", FileTypeStr);
+
   switch (FileHeader->Type) {
 
   case EFI_FV_FILETYPE_ALL:
@@ -1174,6 +1342,9 @@ Returns:
     //
     // All other files have sections
     //
+    if (EFI_ERROR (JsonOpen ("Sections", '['))) {
+      return EFI_ABORTED;
+    }
     Status = ParseSection (
               (UINT8 *) ((UINTN) FileHeader + HeaderSize),
               FvBufGetFfsFileSize (FileHeader) - HeaderSize
@@ -1184,9 +1355,11 @@ Returns:
       //
       return EFI_ABORTED;
     }
+    JsonClose (']');
     break;
   }
 
+  JsonClose ('}');
   return EFI_SUCCESS;
 }
 
@@ -1246,6 +1419,10 @@ Returns:
   UINT16              DataOffset;
   UINT16              Attributes;
   UINT32              RealHdrLen;
+  UINT8               GuidBuffer[PRINTED_GUID_BUFFER_SIZE];
+  CHAR16              *UiName;
+  CHAR8               *AsciiName;
+  UINT32              Index;
 
   ParsedLength = 0;
   while (ParsedLength < BufferLength) {
@@ -1273,6 +1450,14 @@ Returns:
     SectionName = SectionNameToStr (Type);
     printf ("------------------------------------------------------------\n");
     printf ("  Type:  %s\n  Size:  0x%08X\n", SectionName, (unsigned) SectionLength);
+    Status = JsonOpen (NULL, '{');
+    if (EFI_ERROR (Status)) {
+      free (SectionName);
+      return EFI_SECTION_ERROR;
+    }
+    JsonString ("Type", SectionName);
+    JsonNumber ("Offset", ParsedLength);
+    JsonNumber ("Size", SectionLength);
     free (SectionName);
 
     switch (Type) {
@@ -1286,6 +1471,19 @@ Returns:
     case EFI_SECTION_USER_INTERFACE:
       // name = &((EFI_USER_INTERFACE_SECTION *) Ptr)->FileNameString;
       // printf ("  String: %s\n", &name);
+      if (mJsonFile != NULL) {
+        UiName    = (CHAR16 *) (Ptr + SectionHeaderLen);
+        AsciiName = malloc ((SectionLength - SectionHeaderLen) / sizeof (CHAR16) + 1);
+        if (AsciiName == NULL) {
+          return EFI_OUT_OF_RESOURCES;
+        }
+        for (Index = 0; (Index < (SectionLength - SectionHeaderLen) / sizeof (CHAR16)) && (UiName[Index] != 0); Index++) {
+          AsciiName[Index] = (CHAR8) ((UiName[Index] < 0x80) ? UiName[Index] : '?');
+        }
+        AsciiName[Index] = 0;
+        JsonString ("Name", AsciiName);
+        free (AsciiName);
+      }
       break;
 
     case EFI_SECTION_FIRMWARE_VOLUME_IMAGE:
@@ -1312,6 +1510,7 @@ Returns:
     case EFI_SECTION_VERSION:
       printf ("  Build Number:  0x%02X\n", *(UINT16 *)(Ptr + SectionHeaderLen));
       printf ("  Version Strg:  %s\n", (char*) (Ptr + SectionHeaderLen + sizeof (UINT16)));
+      JsonNumber ("BuildNumber", *(UINT16 *)(Ptr + SectionHeaderLen));
       break;
 
     case EFI_SECTION_COMPRESSION:
@@ -1327,6 +1526,9 @@ Returns:
       }
       CompressedLength    = SectionLength - RealHdrLen;
       printf ("  Uncompressed Length:  0x%08X\n", (unsigned) UncompressedLength);
+      JsonNumber ("UncompressedSize", UncompressedLength);
+      JsonNumber ("CompressionType", CompressionType);
+      JsonRatio ("CompressionRatio", CompressedLength, UncompressedLength);
 
       if (CompressionType == EFI_NOT_COMPRESSED) {
         printf ("  Compression Type:  EFI_NOT_COMPRESSED\n");
@@ -1384,7 +1586,11 @@ Returns:
         return EFI_SECTION_ERROR;
       }
 
-      Status = ParseSection (UncompressedBuffer, UncompressedLength);
+      Status = JsonOpen ("Sections", '[');
+      if (!EFI_ERROR (Status)) {
+        Status = ParseSection (UncompressedBuffer, UncompressedLength);
+        JsonClose (']');
+      }
 
       if (CompressionType == EFI_STANDARD_COMPRESSION) {
         //
@@ -1414,14 +1620,52 @@ Returns:
       printf ("\n");
       printf ("  DataOffset:             0x%04X\n", (unsigned) DataOffset);
       printf ("  Attributes:             0x%04X\n", (unsigned) Attributes);
+      PrintGuidToBuffer (EfiGuid, GuidBuffer, sizeof (GuidBuffer), TRUE);
+      JsonString ("SectionDefinitionGuid", (CHAR8 *) GuidBuffer);
+      JsonNumber ("DataOffset", DataOffset);
+      JsonNumber ("Attributes", Attributes);
 
-      ExtractionTool =
-        LookupGuidedSectionToolPath (
-          mParsedGuidedSectionTools,
-          EfiGuid
-          );
+      //
+      // Decode the sections of the compression tools in-process, and run the
+      // tool GuidedSectionTools.txt names for any other GUID
+      //
+      ExtractionTool = NULL;
+      Status = DecodeGuidedSection (
+                EfiGuid,
+                Ptr + DataOffset,
+                SectionLength - DataOffset,
+                &ToolOutputBuffer,
+                &ToolOutputLength
+                );
+      if (Status == EFI_UNSUPPORTED) {
+        ExtractionTool =
+          LookupGuidedSectionToolPath (
+            mParsedGuidedSectionTools,
+            EfiGuid
+            );
+      } else if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 0003, "decode of GUIDED section failed", NULL);
+        return EFI_SECTION_ERROR;
+      }
+
+      if (!EFI_ERROR (Status)) {
+        JsonNumber ("UncompressedSize", ToolOutputLength);
+        JsonRatio ("CompressionRatio", SectionLength - DataOffset, ToolOutputLength);
+        Status = JsonOpen ("Sections", '[');
+        if (!EFI_ERROR (Status)) {
+          Status = ParseSection (
+                    ToolOutputBuffer,
+                    ToolOutputLength
+                    );
+          JsonClose (']');
+        }
+        free (ToolOutputBuffer);
+        if (EFI_ERROR (Status)) {
+          Error (NULL, 0, 0003, "parse of decoded GUIDED section failed", NULL);
+          return EFI_SECTION_ERROR;
+        }
 
-      if (ExtractionTool != NULL) {
+      } else if (ExtractionTool != NULL) {
 
         ToolInputFile = CloneString (tmpnam (NULL));
         ToolOutputFile = CloneString (tmpnam (NULL));
@@ -1449,8 +1693,8 @@ Returns:
         Status =
           PutFileImage (
             ToolInputFile,
-            (CHAR8*) SectionBuffer + DataOffset,
-            BufferLength - DataOffset
+            (CHAR8*) Ptr + DataOffset,
+            SectionLength - DataOffset
             );
 
         system (SystemCommand);
@@ -1470,10 +1714,17 @@ Returns:
           return EFI_SECTION_ERROR;
         }
 
-        Status = ParseSection (
-                  ToolOutputBuffer,
-                  ToolOutputLength
-                  );
+        JsonNumber ("UncompressedSize", ToolOutputLength);
+        JsonRatio ("CompressionRatio", SectionLength - DataOffset, ToolOutputLength);
+        Status = JsonOpen ("Sections", '[');
+        if (!EFI_ERROR (Status)) {
+          Status = ParseSection (
+                    ToolOutputBuffer,
+                    ToolOutputLength
+                    );
+          JsonClose (']');
+        }
+        free (ToolOutputBuffer);
         if (EFI_ERROR (Status)) {
           Error (NULL, 0, 0003, "parse of decoded GUIDED section failed", NULL);
           return EFI_SECTION_ERROR;
@@ -1490,10 +1741,14 @@ Returns:
         //
         // CRC32 guided section
         //
-        Status = ParseSection (
-                  SectionBuffer + DataOffset,
-                  BufferLength - DataOffset
-                  );
+        Status = JsonOpen ("Sections", '[');
+        if (!EFI_ERROR (Status)) {
+          Status = ParseSection (
+                    Ptr + DataOffset,
+                    SectionLength - DataOffset
+                    );
+          JsonClose (']');
+        }
         if (EFI_ERROR (Status)) {
           Error (NULL, 0, 0003, "parse of CRC32 GUIDED section failed", NULL);
           return EFI_SECTION_ERROR;
@@ -1516,6 +1771,7 @@ Returns:
       return EFI_SECTION_ERROR;
     }
 
+    JsonClose ('}');
     ParsedLength += SectionLength;
     //
     // We make then next section begin on a 4-byte boundary
@@ -1662,25 +1918,54 @@ Returns:
   EFI_SUCCESS - GC_TODO: Add description for return value
   EFI_INVALID_PARAMETER - GC_TODO: Add description for return value
 
+--*/
+{
+  CHAR8             *BaseName;
+
+  BaseName = GetGuidBaseName (GuidStr);
+  if (BaseName != NULL) {
+    printf ("%s", BaseName);
+    return EFI_SUCCESS;
+  }
+
+  return EFI_INVALID_PARAMETER;
+}
+
+CHAR8 *
+GetGuidBaseName (
+  IN UINT8    *GuidStr
+  )
+/*++
+
+Routine Description:
+
+  Look up the basename of a file GUID in the cross-reference files
+
+Arguments:
+
+  GuidStr - File GUID as printed by PrintGuidToBuffer ()
+
+Returns:
+
+  The basename, or NULL if no cross-reference file lists the GUID
+
 --*/
 {
   GUID_TO_BASENAME  *GPtr;
   //
   // If we have a list of guid-to-basenames, then go through the list to
-  // look for a guid string match. If found, print the basename to stdout,
-  // otherwise return a failure.
+  // look for a guid string match.
   //
   GPtr = mGuidBaseNameList;
   while (GPtr != NULL) {
     if (_stricmp ((CHAR8*) GuidStr, (CHAR8*) GPtr->Guid) == 0) {
-      printf ("%s", GPtr->BaseName);
-      return EFI_SUCCESS;
+      return (CHAR8*) GPtr->BaseName;
     }
 
     GPtr = GPtr->Next;
   }
 
-  return EFI_INVALID_PARAMETER;
+  return NULL;
 }
 
 EFI_STATUS
@@ -1803,6 +2088,390 @@ LoadGuidedSectionToolsTxt (
 }
 
 
+static
+VOID *
+LzmaAlloc (
+  VOID    *P,
+  size_t  Size
+  )
+{
+  return malloc (Size);
+}
+
+static
+VOID
+LzmaFree (
+  VOID    *P,
+  VOID    *Address
+  )
+{
+  free (Address);
+}
+
+static ISzAlloc mLzmaAlloc = { LzmaAlloc, LzmaFree };
+
+static
+EFI_STATUS
+DecodeGuidedSection (
+  IN  EFI_GUID  *EfiGuid,
+  IN  UINT8     *Data,
+  IN  UINT32    DataLength,
+  OUT UINT8     **DecodedBuffer,
+  OUT UINT32    *DecodedLength
+  )
+/*++
+
+Routine Description:
+
+  Decode the data of a GUIDed section created by LzmaCompress, LzmaF86Compress
+  or TianoCompress the way "<tool> -d" does, without running the tool.
+
+Arguments:
+
+  EfiGuid       - SectionDefinitionGuid of the section
+  Data          - The data of the section, following its header
+  DataLength    - Length of Data
+  DecodedBuffer - Receives the decoded data, which the caller frees
+  DecodedLength - Receives the length of the decoded data
+
+Returns:
+
+  EFI_SUCCESS           - The data was decoded
+  EFI_UNSUPPORTED       - The GUID is not the one of a compression tool
+  EFI_ABORTED           - The data is corrupted
+  EFI_OUT_OF_RESOURCES  - Memory allocation failed
+
+--*/
+{
+  EFI_STATUS  Status;
+  UINT64      DecodedSize;
+  SizeT       OutSize;
+  SizeT       InSize;
+  ELzmaStatus LzmaStatus;
+  SRes        Result;
+  UInt32      X86State;
+  UINT32      ScratchSize;
+  UINT8       *ScratchBuffer;
+  UINTN       Index;
+
+  if (!CompareGuid (EfiGuid, &mLzmaCustomDecompressGuid) ||
+      !CompareGuid (EfiGuid, &mLzmaF86CustomDecompressGuid)) {
+    //
+    // LZMA properties and the 64-bit decoded size precede the stream
+    //
+    if (DataLength < LZMA_HEADER_SIZE) {
+      return EFI_ABORTED;
+    }
+    DecodedSize = 0;
+    for (Index = 0; Index < 8; Index++) {
+      DecodedSize |= ((UINT64) Data[LZMA_PROPS_SIZE + Index]) << (Index * 8);
+    }
+    if (DecodedSize > 0xFFFFFFFF) {
+      return EFI_ABORTED;
+    }
+
+    *DecodedBuffer = malloc ((UINTN) DecodedSize + 1);
+    if (*DecodedBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    OutSize = (SizeT) DecodedSize;
+    InSize  = DataLength - LZMA_HEADER_SIZE;
+    Result  = LzmaDecode (
+                *DecodedBuffer,
+                &OutSize,
+                Data + LZMA_HEADER_SIZE,
+                &InSize,
+                Data,
+                LZMA_PROPS_SIZE,
+                LZMA_FINISH_END,
+                &LzmaStatus,
+                &mLzmaAlloc
+                );
+    if ((Result != SZ_OK) || (OutSize != DecodedSize)) {
+      free (*DecodedBuffer);
+      return EFI_ABORTED;
+    }
+
+    if (!CompareGuid (EfiGuid, &mLzmaF86CustomDecompressGuid)) {
+      x86_Convert_Init (X86State);
+      x86_Convert (*DecodedBuffer, OutSize, 0, &X86State, 0);
+    }
+
+    *DecodedLength = (UINT32) OutSize;
+    return EFI_SUCCESS;
+  }
+
+  if (!CompareGuid (EfiGuid, &mTianoCustomDecompressGuid)) {
+    Status = TianoGetInfo (Data, DataLength, DecodedLength, &ScratchSize);
+    if (EFI_ERROR (Status)) {
+      return EFI_ABORTED;
+    }
+
+    ScratchBuffer   = malloc (ScratchSize);
+    *DecodedBuffer  = malloc (*DecodedLength + 1);
+    if ((ScratchBuffer == NULL) || (*DecodedBuffer == NULL)) {
+      free (ScratchBuffer);
+      free (*DecodedBuffer);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Status = TianoDecompress (
+              Data,
+              DataLength,
+              *DecodedBuffer,
+              *DecodedLength,
+              ScratchBuffer,
+              ScratchSize
+              );
+    free (ScratchBuffer);
+    if (EFI_ERROR (Status)) {
+      free (*DecodedBuffer);
+      return EFI_ABORTED;
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  return EFI_UNSUPPORTED;
+}
+
+static
+VOID
+JsonWriteString (
+  IN CHAR8  *Value
+  )
+/*++
+
+Routine Description:
+
+  Write a string to the JSON inventory as a quoted, escaped JSON string
+
+Arguments:
+
+  Value - The string
+
+Returns:
+
+  None
+
+--*/
+{
+  fputc ('"', mJsonFile);
+  for (; *Value != 0; Value++) {
+    if ((*Value == '"') || (*Value == '\\')) {
+      fprintf (mJsonFile, "\\%c", *Value);
+    } else if ((UINT8) *Value < 0x20) {
+      fprintf (mJsonFile, "\\u%04x", (unsigned) (UINT8) *Value);
+    } else {
+      fputc (*Value, mJsonFile);
+    }
+  }
+  fputc ('"', mJsonFile);
+}
+
+static
+VOID
+JsonWriteName (
+  IN CHAR8  *Name
+  )
+/*++
+
+Routine Description:
+
+  Start a new member of the current object or array of the JSON inventory:
+  separate it from the previous member, indent it, and write its name
+
+Arguments:
+
+  Name  - Name of the object member, or NULL for an array element
+
+Returns:
+
+  None
+
+--*/
+{
+  if (mJsonDepth != 0) {
+    if (!mJsonFirst[mJsonDepth]) {
+      fputc (',', mJsonFile);
+    }
+    fprintf (mJsonFile, "\n%*s", (int) (mJsonDepth * 2), "");
+  }
+  mJsonFirst[mJsonDepth] = FALSE;
+
+  if (Name != NULL) {
+    JsonWriteString (Name);
+    fputs (": ", mJsonFile);
+  }
+}
+
+static
+EFI_STATUS
+JsonOpen (
+  IN CHAR8  *Name,
+  IN CHAR8  Bracket
+  )
+/*++
+
+Routine Description:
+
+  Start an object or an array in the JSON inventory, if one is written
+
+Arguments:
+
+  Name    - Name of the object member, or NULL for an array element
+  Bracket - '{' or '['
+
+Returns:
+
+  EFI_SUCCESS   The object or array was started, or no inventory is written
+  EFI_ABORTED   The sections of the input are nested too deeply for the inventory
+
+--*/
+{
+  if (mJsonFile == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  if (mJsonDepth + 1 >= MAX_JSON_DEPTH) {
+    Error (NULL, 0, 0003, "error writing the JSON inventory", "the sections are nested more than %u levels deep", (unsigned) MAX_JSON_DEPTH - 1);
+    return EFI_ABORTED;
+  }
+
+  JsonWriteName (Name);
+  fputc (Bracket, mJsonFile);
+  mJsonDepth++;
+  mJsonFirst[mJsonDepth] = TRUE;
+  return EFI_SUCCESS;
+}
+
+static
+VOID
+JsonClose (
+  IN CHAR8  Bracket
+  )
+/*++
+
+Routine Description:
+
+  End the object or array JsonOpen () started last
+
+Arguments:
+
+  Bracket - '}' or ']'
+
+Returns:
+
+  None
+
+--*/
+{
+  if (mJsonFile == NULL) {
+    return;
+  }
+
+  mJsonDepth--;
+  if (!mJsonFirst[mJsonDepth + 1]) {
+    fprintf (mJsonFile, "\n%*s", (int) (mJsonDepth * 2), "");
+  }
+  fputc (Bracket, mJsonFile);
+}
+
+static
+VOID
+JsonString (
+  IN CHAR8  *Name,
+  IN CHAR8  *Value
+  )
+/*++
+
+Routine Description:
+
+  Add a string member to the current object of the JSON inventory
+
+Arguments:
+
+  Name  - Name of the member
+  Value - The string
+
+Returns:
+
+  None
+
+--*/
+{
+  if (mJsonFile == NULL) {
+    return;
+  }
+
+  JsonWriteName (Name);
+  JsonWriteString (Value);
+}
+
+static
+VOID
+JsonNumber (
+  IN CHAR8  *Name,
+  IN UINT32 Value
+  )
+/*++
+
+Routine Description:
+
+  Add a number member to the current object of the JSON inventory
+
+Arguments:
+
+  Name  - Name of the member
+  Value - The number
+
+Returns:
+
+  None
+
+--*/
+{
+  if (mJsonFile == NULL) {
+    return;
+  }
+
+  JsonWriteName (Name);
+  fprintf (mJsonFile, "%u", (unsigned) Value);
+}
+
+static
+VOID
+JsonRatio (
+  IN CHAR8  *Name,
+  IN UINT32 Numerator,
+  IN UINT32 Denominator
+  )
+/*++
+
+Routine Description:
+
+  Add a ratio, e.g. the compressed size of a section relative to its
+  uncompressed size, to the current object of the JSON inventory
+
+Arguments:
+
+  Name        - Name of the member
+  Numerator   - Numerator of the ratio
+  Denominator - Denominator of the ratio; nothing is added when it is 0
+
+Returns:
+
+  None
+
+--*/
+{
+  if ((mJsonFile == NULL) || (Denominator == 0)) {
+    return;
+  }
+
+  JsonWriteName (Name);
+  fprintf (mJsonFile, "%.4f", (double) Numerator / Denominator);
+}
+
 void
 Usage (
   VOID
@@ -1842,6 +2511,9 @@ Returns:
             Parse basename to file-guid cross reference file(s).\n");
   fprintf (stdout, "  --offset offset\n\
             Offset of file to start processing FV at.\n");
+  fprintf (stdout, "  --json JsonFile\n\
+            Also write the FVs, FFS files and sections found, with their\n\
+            offsets, sizes and compression ratios, to JsonFile.\n");
   fprintf (stdout, "  -h, --help\n\
             Show this help message and exit.\n");
 
@@ -15,8 +15,11 @@
 #
 import Common.LongFilePathOs as os
 import re
+import sys
+import glob
 import os.path as path
 import copy
+import hashlib
 
 import GenC
 import GenMake
@@ -27,6 +30,7 @@ from StrGather import *
 from BuildEngine import BuildRule
 
 from Common.LongFilePathSupport import CopyLongFilePath
+from Common.BuildVersion import gBUILD_VERSION
 from Common.BuildToolError import *
 from Common.DataType import *
 from Common.Misc import *
@@ -38,6 +42,7 @@ from Workspace.BuildClassObject import *
 from GenPatchPcdTable.GenPatchPcdTable import parsePcdInfoFromMapFile
 import Common.VpdInfoFile as VpdInfoFile
 from GenPcdDb import CreatePcdDatabaseCode
+from AutoGenWorker import CreateModuleFiles
 from Workspace.MetaFileCommentParser import UsageList
 
 import InfSectionParser
@@ -72,8 +77,69 @@ gAutoGenStringFileName = "%(module_name)sStrDefs.h"
 gAutoGenStringFormFileName = "%(module_name)sStrDefs.hpk"
 gAutoGenDepexFileName = "%(module_name)s.depex"
 
+## file recording the inputs and outputs of the AutoGen of a module in incremental mode
+gAutoGenFingerprintFileName = "AutoGen.fingerprint"
+
 gInfSpecVersion = "0x00010017"
 
+## MD5 digest of meta files, each read only once per build
+gFileDigestCache = {}
+
+## Get the MD5 digest of the content of a file
+#
+#   @param      FilePath    The path of the file
+#
+#   @retval     string      The hex digest, or an empty string if the file doesn't exist
+#
+def GetFileDigest(FilePath):
+    if FilePath not in gFileDigestCache:
+        Digest = ''
+        if os.path.isfile(FilePath):
+            Fd = open(FilePath, 'rb')
+            Digest = hashlib.md5(Fd.read()).hexdigest()
+            Fd.close()
+        gFileDigestCache[FilePath] = Digest
+    return gFileDigestCache[FilePath]
+
+## Get the MD5 digest of the code generating AutoGen files and makefiles
+#
+#   The sources of this package, or the frozen executable running the build,
+#   so that files generated by an older BaseTools are never kept.
+#
+#   @retval     string      The hex digest
+#
+def GetAutoGenToolDigest():
+    global gAutoGenToolDigest
+    if gAutoGenToolDigest == None:
+        if hasattr(sys, 'frozen'):
+            FileList = [sys.executable]
+        else:
+            FileList = sorted(glob.glob(os.path.join(os.path.dirname(os.path.abspath(__file__)), '*.py')))
+        Md5 = hashlib.md5(gBUILD_VERSION)
+        for FilePath in FileList:
+            Md5.update("%s %s\n" % (os.path.basename(FilePath), GetFileDigest(FilePath)))
+        gAutoGenToolDigest = Md5.hexdigest()
+    return gAutoGenToolDigest
+
+gAutoGenToolDigest = None
+
+## Modification time of files checked by incremental AutoGen, each stat'ed only once per build
+gFileTimeStampCache = {}
+
+## Get the modification time of a file
+#
+#   @param      FilePath    The path of the file
+#
+#   @retval     float       The modification time, or None if the file doesn't exist
+#
+def GetFileTimeStamp(FilePath):
+    if FilePath not in gFileTimeStampCache:
+        TimeStamp = None
+        if os.path.exists(FilePath):
+            TimeStamp = os.path.getmtime(FilePath)
+        gFileTimeStampCache[FilePath] = TimeStamp
+    return gFileTimeStampCache[FilePath]
+
 #
 # Template string to generic AsBuilt INF
 #
@@ -832,6 +898,7 @@ class PlatformAutoGen(AutoGen):
         self._FvDir = None
         self._MakeFileDir = None
         self._FdfFile = None
+        self._AutoGenFingerprint = None
 
         self._PcdTokenNumber = None    # (TokenCName, TokenSpaceGuidCName) : GeneratedTokenNumber
         self._DynamicPcdList = None    # [(TokenCName1, TokenSpaceGuidCName1), (TokenCName2, TokenSpaceGuidCName2), ...]
@@ -880,8 +947,7 @@ class PlatformAutoGen(AutoGen):
         if self.IsCodeFileCreated or not CreateModuleCodeFile:
             return
 
-        for Ma in self.ModuleAutoGenList:
-            Ma.CreateCodeFile(True)
+        CreateModuleFiles(self.ModuleAutoGenList, True, False)
 
         # don't do this twice
         self.IsCodeFileCreated = True
@@ -897,11 +963,13 @@ class PlatformAutoGen(AutoGen):
     #
     def CreateMakeFile(self, CreateModuleMakeFile=False):
         if CreateModuleMakeFile:
+            ModuleAutoGenList = []
             for ModuleFile in self.Platform.Modules:
                 Ma = ModuleAutoGen(self.Workspace, ModuleFile, self.BuildTarget,
                                    self.ToolChain, self.Arch, self.MetaFile)
-                Ma.CreateMakeFile(True)
+                ModuleAutoGenList.append(Ma)
                 #Ma.CreateAsBuiltInf()
+            CreateModuleFiles(ModuleAutoGenList, False, True)
 
         # no need to create makefile for the platform more than once
         if self.IsMakeFileCreated:
@@ -1476,6 +1544,25 @@ class PlatformAutoGen(AutoGen):
               
         return self._BuildRule
 
+    ## Compute the fingerprint of the platform wide settings used by module AutoGen
+    #
+    #   Settings of the DSC/FDF files which only apply to some modules are part
+    #   of the fingerprint of those modules instead.
+    #
+    #   @retval     string      The hex digest
+    #
+    def _GetAutoGenFingerprint(self):
+        if self._AutoGenFingerprint == None:
+            Md5 = hashlib.md5()
+            Md5.update("%s\n" % GetAutoGenToolDigest())
+            Md5.update("%s %s %s %s\n" % (self.BuildTarget, self.ToolChain, self.Arch, self.BuildDir))
+            for Tool in sorted(self.ToolDefinition):
+                Md5.update(repr((Tool, sorted(self.ToolDefinition[Tool].items()))))
+            Md5.update(''.join(self.BuildRule.RuleContent))
+            Md5.update(repr(sorted(GlobalData.gCommandLineDefines.items())))
+            self._AutoGenFingerprint = Md5.hexdigest()
+        return self._AutoGenFingerprint
+
     ## Summarize the packages used by modules in this platform
     def _GetPackageList(self):
         if self._PackageList == None:
@@ -2138,6 +2225,7 @@ class PlatformAutoGen(AutoGen):
     ModuleAutoGenList   = property(_GetModuleAutoGenList)
     LibraryAutoGenList  = property(_GetLibraryAutoGenList)
     GenFdsCommand       = property(_GenFdsCommand)
+    AutoGenFingerprint  = property(_GetAutoGenFingerprint)
 
 ## ModuleAutoGen class
 #
@@ -2146,6 +2234,10 @@ class PlatformAutoGen(AutoGen):
 # to the [depex] section in module's inf file.
 #
 class ModuleAutoGen(AutoGen):
+    ## Number of modules checked, and found unchanged, by incremental AutoGen
+    IncrementalCheckedCount = 0
+    IncrementalSkippedCount = 0
+
     ## The real constructor of ModuleAutoGen
     #
     #  This method is not supposed to be called by users of ModuleAutoGen. It's
@@ -2194,6 +2286,11 @@ class ModuleAutoGen(AutoGen):
         self.IsAsBuiltInfCreated = False
         self.DepexGenerated = False
 
+        self._AutoGenFingerprint = None
+        self._IsAutoGenUpToDate = None
+        self._AutoGenInputList = set()
+        self._AutoGenOutputList = []
+
         self.BuildDatabase = self.Workspace.BuildDatabase
 
         self._Module          = None
@@ -3403,6 +3500,12 @@ class ModuleAutoGen(AutoGen):
             for LibraryAutoGen in self.LibraryAutoGenList:
                 LibraryAutoGen.CreateMakeFile()
 
+        if self.IsAutoGenUpToDate:
+            EdkLogger.debug(EdkLogger.DEBUG_9, "Kept the makefile of unchanged module %s [%s]" %
+                            (self.Name, self.Arch))
+            self.IsMakeFileCreated = True
+            return
+
         if len(self.CustomMakefile) == 0:
             Makefile = GenMake.ModuleMakefile(self)
         else:
@@ -3414,7 +3517,20 @@ class ModuleAutoGen(AutoGen):
             EdkLogger.debug(EdkLogger.DEBUG_9, "Skipped the generation of makefile for module %s [%s]" %
                             (self.Name, self.Arch))
 
+        #
+        # Remember the makefile and the source/header files it depends on for
+        # incremental AutoGen
+        #
+        self._AutoGenOutputList.append(os.path.join(self.MakeFileDir, Makefile._FILE_NAME_[Makefile._FileType]))
+        for File in self.SourceFileList:
+            self._AutoGenInputList.add(File.Path)
+        for File in getattr(Makefile, 'FileCache', {}):
+            self._AutoGenInputList.add(File.Path)
+            for Dependency in Makefile.FileCache[File]:
+                self._AutoGenInputList.add(Dependency.Path)
+
         self.IsMakeFileCreated = True
+        self._SaveAutoGenFingerprint()
 
     def CopyBinaryFiles(self):
         for File in self.Module.Binaries:
@@ -3443,10 +3559,17 @@ class ModuleAutoGen(AutoGen):
             for LibraryAutoGen in self.LibraryAutoGenList:
                 LibraryAutoGen.CreateCodeFile()
 
+        if self.IsAutoGenUpToDate:
+            EdkLogger.debug(EdkLogger.DEBUG_9, "Kept the AutoGen files of unchanged module %s [%s]" %
+                            (self.Name, self.Arch))
+            self.IsCodeFileCreated = True
+            return []
+
         AutoGenList = []
         IgoredAutoGenList = []
 
         for File in self.AutoGenFileList:
+            self._AutoGenOutputList.append(File.Path)
             if GenC.Generate(File.Path, self.AutoGenFileList[File], File.IsBinary):
                 #Ignore Edk AutoGen.c
                 if self.AutoGenVersion < 0x00010005 and File.Name == 'AutoGen.c':
@@ -3471,6 +3594,7 @@ class ModuleAutoGen(AutoGen):
             if len(Dpx.PostfixNotation) <> 0:
                 self.DepexGenerated = True
 
+            self._AutoGenOutputList.append(path.join(self.OutputDir, DpxFile))
             if Dpx.Generate(path.join(self.OutputDir, DpxFile)):
                 AutoGenList.append(str(DpxFile))
             else:
@@ -3487,8 +3611,113 @@ class ModuleAutoGen(AutoGen):
                             (" ".join(AutoGenList), " ".join(IgoredAutoGenList), self.Name, self.Arch))
 
         self.IsCodeFileCreated = True
+        self._SaveAutoGenFingerprint()
         return AutoGenList
 
+    ## Check if incremental AutoGen applies to the module
+    #
+    #   PCD drivers depend on the dynamic PCDs of the whole platform, and the
+    #   dependencies of custom makefiles are unknown, so they are always
+    #   generated.
+    #
+    def _IsIncrementalAutoGenSupported(self):
+        return GlobalData.gIncrementalAutoGen and not self.IsBinaryModule and self.PcdIsDriver == '' \
+               and self.AutoGenVersion >= 0x00010005 and len(self.CustomMakefile) == 0
+
+    ## Compute the fingerprint of the settings the AutoGen files and makefile are generated from
+    #
+    #   It covers the platform wide settings, the INF/DEC files of the module
+    #   and its library instances, and the build options and PCD values which
+    #   the DSC/FDF files resolve to for the module.
+    #
+    #   @retval     string      The hex digest
+    #
+    def _GetAutoGenFingerprint(self):
+        if self._AutoGenFingerprint == None:
+            Md5 = hashlib.md5()
+            Md5.update(self.PlatformInfo.AutoGenFingerprint)
+            Md5.update("%s %s %s\n" % (self.Name, self.Guid, self.BuildDir))
+            Md5.update(GetFileDigest(self.MetaFile.Path))
+            for Package in self.DerivedPackageList:
+                Md5.update(GetFileDigest(Package.MetaFile.Path))
+            for Library in self.DependentLibraryList:
+                Md5.update("%s %s\n" % (Library.MetaFile.Path, GetFileDigest(Library.MetaFile.Path)))
+            BuildOption = self.BuildOption
+            for Tool in sorted(BuildOption):
+                Md5.update(repr((Tool, sorted(BuildOption[Tool].items()))))
+            PcdTokenNumber = self.PlatformInfo.PcdTokenNumber
+            for Pcd in self.ModulePcdList + self.LibraryPcdList:
+                Key = (Pcd.TokenCName, Pcd.TokenSpaceGuidCName)
+                TokenNumber = None
+                if Key in PcdTokenNumber:
+                    TokenNumber = PcdTokenNumber[Key]
+                Md5.update(repr((Key, Pcd.Type, Pcd.DatumType, Pcd.DefaultValue, Pcd.TokenValue,
+                                 Pcd.MaxDatumSize, TokenNumber)))
+            Md5.update(repr(sorted(self.ConstPcd.items())))
+            self._AutoGenFingerprint = Md5.hexdigest()
+        return self._AutoGenFingerprint
+
+    ## Check if the AutoGen files and makefile generated by a previous build can be kept
+    #
+    #   @retval     True        The fingerprint is unchanged, the generated files
+    #                           exist and no source or header file is newer
+    #   @retval     False       The files must be generated
+    #
+    def _GetIsAutoGenUpToDate(self):
+        if self._IsAutoGenUpToDate == None:
+            self._IsAutoGenUpToDate = False
+            if self._IsIncrementalAutoGenSupported():
+                ModuleAutoGen.IncrementalCheckedCount += 1
+                if self._CheckAutoGenFingerprint():
+                    ModuleAutoGen.IncrementalSkippedCount += 1
+                    self._IsAutoGenUpToDate = True
+        return self._IsAutoGenUpToDate
+
+    def _CheckAutoGenFingerprint(self):
+        FingerprintFile = os.path.join(self.BuildDir, gAutoGenFingerprintFileName)
+        if not os.path.isfile(FingerprintFile):
+            return False
+        Fd = open(FingerprintFile, 'r')
+        Lines = Fd.read().splitlines()
+        Fd.close()
+        if len(Lines) < 2 or Lines[0] != self.AutoGenFingerprint:
+            EdkLogger.debug(EdkLogger.DEBUG_9, "Settings of module %s [%s] changed" % (self.Name, self.Arch))
+            return False
+
+        FingerprintTime = os.path.getmtime(FingerprintFile)
+        for Line in Lines[2:]:
+            Type, FilePath = Line.split(' ', 1)
+            TimeStamp = GetFileTimeStamp(FilePath)
+            if TimeStamp == None or (Type == 'I' and TimeStamp > FingerprintTime):
+                EdkLogger.debug(EdkLogger.DEBUG_9, "%s of module %s [%s] changed" % (FilePath, self.Name, self.Arch))
+                return False
+
+        self.DepexGenerated = (Lines[1] == 'TRUE')
+        return True
+
+    ## Record the fingerprint and the files of the AutoGen just done
+    #
+    #   The file is written once both the AutoGen files and the makefile are
+    #   generated, so an interrupted build never leaves a valid fingerprint
+    #   behind.
+    #
+    def _SaveAutoGenFingerprint(self):
+        if not self.IsCodeFileCreated or not self.IsMakeFileCreated or self.IsAutoGenUpToDate:
+            return
+        if not self._IsIncrementalAutoGenSupported():
+            return
+
+        Content = [self.AutoGenFingerprint, str(self.DepexGenerated).upper()]
+        for FilePath in self._AutoGenOutputList:
+            # empty dependency expressions don't produce a .depex file
+            if os.path.exists(FilePath):
+                Content.append('O ' + FilePath)
+        for FilePath in sorted(self._AutoGenInputList):
+            Content.append('I ' + FilePath)
+        Fd = open(os.path.join(self.BuildDir, gAutoGenFingerprintFileName), 'w')
+        Fd.write('\n'.join(Content) + '\n')
+        Fd.close()
+
     ## Summarize the ModuleAutoGen objects of all libraries used by this module
     def _GetLibraryAutoGenList(self):
         if self._LibraryAutoGenList == None:
@@ -3558,6 +3787,9 @@ class ModuleAutoGen(AutoGen):
     
     FixedAtBuildPcds         = property(_GetFixedAtBuildPcds)
 
+    AutoGenFingerprint      = property(_GetAutoGenFingerprint)
+    IsAutoGenUpToDate       = property(_GetIsAutoGenUpToDate)
+
 # This acts like the main() function for the script, unless it is 'import'ed into another script.
 if __name__ == '__main__':
     pass
@@ -0,0 +1,182 @@
+## @file
+# Generate the AutoGen files and makefiles of modules in worker processes
+#
+# Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+# This program and the accompanying materials
+# are licensed and made available under the terms and conditions of the BSD License
+# which accompanies this distribution.  The full text of the license may be found at
+# http://opensource.org/licenses/bsd-license.php
+#
+# THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+# WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import os
+import logging
+import threading
+import traceback
+import multiprocessing
+
+from Common import EdkLogger
+from Common.BuildToolError import *
+import Common.GlobalData as GlobalData
+
+## The AutoGen objects the worker processes work on
+#
+#  Workers are forked once the parent has resolved the PCDs and library
+#  instances of all modules, and inherit these objects; only the index of an
+#  object and the result of its generation are passed between processes.
+#
+gAutoGenObjectList = []
+gCreateCodeFile = False
+gCreateMakeFile = False
+
+## Initialize a worker process
+#
+#  A worker must not use the database connection inherited from the parent,
+#  so it opens its own, read-only connection to the database file: a worker
+#  needing data the parent has not stored there fails, and the parent
+#  generates that module itself. The locks of the log handlers are re-created
+#  because another thread of the parent may have held them when the worker
+#  was forked.
+#
+def _InitWorker():
+    logging._lock = threading.RLock()
+    for Logger in [logging.getLogger(Name) for Name in logging.Logger.manager.loggerDict] + [logging.getLogger()]:
+        if not isinstance(Logger, logging.Logger):
+            continue
+        for Handler in Logger.handlers:
+            Handler.createLock()
+    if gAutoGenObjectList:
+        gAutoGenObjectList[0].BuildDatabase.WorkspaceDb.Reconnect(True)
+
+## Generate the files of one module in a worker process
+#
+#   @param      Index       Index of the module in gAutoGenObjectList
+#
+#   @retval     tuple       (Index, ErrorCode, State)
+#                           ErrorCode is 0 on success, the code of the reported
+#                           error, or None if the parent must generate the module.
+#                           State is the module state the parent needs later.
+#
+def _CreateFiles(Index):
+    AutoGenObject = gAutoGenObjectList[Index]
+    Class = AutoGenObject.__class__
+    CheckedCount = Class.IncrementalCheckedCount
+    SkippedCount = Class.IncrementalSkippedCount
+    try:
+        if gCreateCodeFile:
+            AutoGenObject.CreateCodeFile(False)
+        if gCreateMakeFile:
+            AutoGenObject.CreateMakeFile(False)
+    except FatalError, X:
+        return (Index, X.args[0], None)
+    except KeyboardInterrupt:
+        return (Index, ABORT_ERROR, None)
+    except:
+        EdkLogger.verbose("Failed to generate files of %s [%s] in process %d, retry in the main process:\n%s" %
+                          (AutoGenObject.Name, AutoGenObject.Arch, os.getpid(), traceback.format_exc()))
+        return (Index, None, None)
+    State = (
+        AutoGenObject.DepexGenerated,
+        AutoGenObject._IsAutoGenUpToDate,
+        AutoGenObject._AutoGenOutputList,
+        AutoGenObject._AutoGenInputList,
+        Class.IncrementalCheckedCount - CheckedCount,
+        Class.IncrementalSkippedCount - SkippedCount
+        )
+    return (Index, 0, State)
+
+## Generate AutoGen files and/or makefiles for modules and their libraries
+#
+#  With more than one build thread on a host supporting fork(), every module
+#  and library is generated in one of GlobalData.gThreadNumber worker
+#  processes. The result is the same as generating them one by one: each
+#  library is generated once, on its own, and each module only writes files to
+#  its own build directory.
+#
+#   @param      ModuleAutoGenList   ModuleAutoGen objects of the modules
+#   @param      CreateCodeFile      Generate AutoGen code files
+#   @param      CreateMakeFile      Generate makefiles
+#
+def CreateModuleFiles(ModuleAutoGenList, CreateCodeFile, CreateMakeFile):
+    global gAutoGenObjectList, gCreateCodeFile, gCreateMakeFile
+
+    AutoGenObjectList = []
+    for Ma in ModuleAutoGenList:
+        if Ma.IsLibrary:
+            continue
+        for La in Ma.LibraryAutoGenList:
+            if La not in AutoGenObjectList:
+                AutoGenObjectList.append(La)
+    for Ma in ModuleAutoGenList:
+        if Ma not in AutoGenObjectList:
+            AutoGenObjectList.append(Ma)
+
+    PendingList = []
+    for AutoGenObject in AutoGenObjectList:
+        if (CreateCodeFile and not AutoGenObject.IsCodeFileCreated) or \
+           (CreateMakeFile and not AutoGenObject.IsMakeFileCreated):
+            PendingList.append(AutoGenObject)
+
+    # an in-memory database (--no-cache) cannot be opened by the workers
+    ProcessNumber = min(GlobalData.gThreadNumber, len(PendingList))
+    if ProcessNumber > 1 and hasattr(os, 'fork') and \
+       PendingList[0].BuildDatabase.WorkspaceDb.DbPath != ':memory:':
+        #
+        # Resolve in the parent the data every module needs but does not
+        # own, so that no worker computes it again, and the module settings
+        # kept in the temporary tables of the platform, which the workers
+        # cannot query. Then commit the database so that the workers see a
+        # consistent file.
+        #
+        for AutoGenObject in PendingList:
+            AutoGenObject.PlatformInfo.PcdTokenNumber
+            AutoGenObject.BuildOption
+        PendingList[0].BuildDatabase.WorkspaceDb.Conn.commit()
+
+        gAutoGenObjectList = PendingList
+        gCreateCodeFile = CreateCodeFile
+        gCreateMakeFile = CreateMakeFile
+        Pool = multiprocessing.Pool(ProcessNumber, _InitWorker)
+        try:
+            ResultList = Pool.map(_CreateFiles, range(len(PendingList)), 1)
+        finally:
+            Pool.terminate()
+            Pool.join()
+            gAutoGenObjectList = []
+
+        FailedList = []
+        for Index, ErrorCode, State in ResultList:
+            AutoGenObject = PendingList[Index]
+            if ErrorCode == None:
+                FailedList.append(AutoGenObject)
+                continue
+            if ErrorCode != 0:
+                # the worker has reported the error already
+                raise FatalError(ErrorCode)
+            if CreateCodeFile:
+                AutoGenObject.IsCodeFileCreated = True
+            if CreateMakeFile:
+                AutoGenObject.IsMakeFileCreated = True
+            #
+            # Keep what the worker learned about the module so that a later
+            # step, e.g. the makefile generation after the code generation,
+            # continues from the same state as in a serial build
+            #
+            AutoGenObject.DepexGenerated = State[0]
+            AutoGenObject._IsAutoGenUpToDate = State[1]
+            AutoGenObject._AutoGenOutputList = State[2]
+            AutoGenObject._AutoGenInputList = State[3]
+            AutoGenObject.__class__.IncrementalCheckedCount += State[4]
+            AutoGenObject.__class__.IncrementalSkippedCount += State[5]
+        PendingList = FailedList
+
+    for AutoGenObject in PendingList:
+        if CreateCodeFile:
+            AutoGenObject.CreateCodeFile(False)
+        if CreateMakeFile:
+            AutoGenObject.CreateMakeFile(False)
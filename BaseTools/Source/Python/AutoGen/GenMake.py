@@ -1270,6 +1270,9 @@ class TopLevelMakefile(BuildFile):
         if GlobalData.gIgnoreSource:
             ExtraOption += " --ignore-sources"
 
+        if GlobalData.gThreadNumber > 1:
+            ExtraOption += " -n %d" % GlobalData.gThreadNumber
+
         MakefileName = self._FILE_NAME_[self._FileType]
         SubBuildCommandList = []
         for A in PlatformInfo.ArchList:
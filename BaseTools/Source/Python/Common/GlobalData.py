@@ -65,11 +65,21 @@ gDatabasePath = ".cache/build.db"
 #
 gIgnoreSource = False
 
+#
+# Build flag for skipping AutoGen of unchanged modules
+#
+gIncrementalAutoGen = False
+
 #
 # FDF parser
 #
 gFdfParser = None
 
+#
+# Maximum number of concurrent threads of the build, also passed to GenFds
+#
+gThreadNumber = 1
+
 #
 # If a module is built more than once with different PCDs or library classes
 # a temporary INF file with same content is created, the temporary file is removed
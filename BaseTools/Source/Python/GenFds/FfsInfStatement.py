@@ -18,6 +18,7 @@
 #
 import Rule
 import Common.LongFilePathOs as os
+import copy
 import StringIO
 from struct import *
 from GenFdsGlobalVariable import GenFdsGlobalVariable
@@ -454,6 +455,10 @@ class FfsInfStatement(FfsInfStatementClassObject):
     #
     #   Get correct rule for generating FFS for this INF
     #
+    #   The sections of a rule keep state while they are generated, so every
+    #   INF gets its own copy of the rule: the FFS file does not depend on the
+    #   modules generated before it, or at the same time in another thread.
+    #
     #   @param  self        The object pointer
     #   @retval Rule        Rule object
     #
@@ -478,7 +483,7 @@ class FfsInfStatement(FfsInfStatementClassObject):
             Rule = GenFdsGlobalVariable.FdfParser.Profile.RuleDict.get(RuleName)
             if Rule != None:
                 GenFdsGlobalVariable.VerboseLogger ("Want To Find Rule Name is : " + RuleName)
-                return Rule
+                return copy.deepcopy(Rule)
 
         RuleName = 'RULE'      + \
                    '.'         + \
@@ -496,7 +501,7 @@ class FfsInfStatement(FfsInfStatementClassObject):
         Rule = GenFdsGlobalVariable.FdfParser.Profile.RuleDict.get(RuleName)
         if Rule != None:
             GenFdsGlobalVariable.VerboseLogger ("Want To Find Rule Name is : " + RuleName)
-            return Rule
+            return copy.deepcopy(Rule)
 
         if Rule == None :
             EdkLogger.error("GenFds", GENFDS_ERROR, 'Don\'t Find common rule %s for INF %s' \
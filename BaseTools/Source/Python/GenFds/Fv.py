@@ -18,6 +18,7 @@
 import Common.LongFilePathOs as os
 import subprocess
 import StringIO
+import time
 from struct import *
 
 import Ffs
@@ -87,7 +88,11 @@ class FV (FvClassObject):
                                 GenFdsGlobalVariable.ErrorLogger("Capsule %s in FD region can't contain a FV %s in FD region." % (self.CapsuleName, self.UiFvName.upper()))
 
         GenFdsGlobalVariable.InfLogger( "\nGenerating %s FV" %self.UiFvName)
-        GenFdsGlobalVariable.LargeFileInFvFlags.append(False)
+        LargeFileInFvFlags = GenFdsGlobalVariable.GetLargeFileInFvFlags()
+        LargeFileInFvFlags.append(False)
+        StartTime = time.time()
+        CacheHits = GenFdsGlobalVariable.CacheHits
+        CacheMisses = GenFdsGlobalVariable.CacheMisses
         FFSGuid = None
         
         if self.FvBaseAddress != None:
@@ -110,8 +115,7 @@ class FV (FvClassObject):
                                            T_CHAR_LF)
 
         # Process Modules in FfsList
-        for FfsFile in self.FfsList :
-            FileName = FfsFile.GenFfs(MacroDict, FvParentAddr=BaseAddress)
+        for FileName in self.__GenFfsList__(MacroDict, [], BaseAddress):
             FfsFileList.append(FileName)
             self.FvInfFile.writelines("EFI_FILE_NAME = " + \
                                        FileName          + \
@@ -133,7 +137,7 @@ class FV (FvClassObject):
         OrigFvInfo = None
         if os.path.exists (FvInfoFileName):
             OrigFvInfo = open(FvInfoFileName, 'r').read()
-        if GenFdsGlobalVariable.LargeFileInFvFlags[-1]:
+        if LargeFileInFvFlags[-1]:
             FFSGuid = GenFdsGlobalVariable.EFI_FIRMWARE_FILE_SYSTEM3_GUID;
         GenFdsGlobalVariable.GenerateFirmwareVolume(
                                 FvOutputFile,
@@ -162,10 +166,9 @@ class FV (FvClassObject):
 
             if FvChildAddr != []:
                 # Update Ffs again
-                for FfsFile in self.FfsList :
-                    FileName = FfsFile.GenFfs(MacroDict, FvChildAddr, BaseAddress)
+                self.__GenFfsList__(MacroDict, FvChildAddr, BaseAddress)
                 
-                if GenFdsGlobalVariable.LargeFileInFvFlags[-1]:
+                if LargeFileInFvFlags[-1]:
                     FFSGuid = GenFdsGlobalVariable.EFI_FIRMWARE_FILE_SYSTEM3_GUID;
                 #Update GenFv again
                 GenFdsGlobalVariable.GenerateFirmwareVolume(
@@ -203,9 +206,40 @@ class FV (FvClassObject):
             self.FvAlignment = str (FvAlignmentValue)
         FvFileObj.close()
         GenFds.ImageBinDict[self.UiFvName.upper() + 'fv'] = FvOutputFile
-        GenFdsGlobalVariable.LargeFileInFvFlags.pop()
+        LargeFileInFvFlags.pop()
+        GenFdsGlobalVariable.InfLogger("\n%s FV: %d FFS files in %.2f seconds, %d tool runs reused from cache, %d run" % \
+                                       (self.UiFvName, len(self.FfsList), time.time() - StartTime,
+                                        GenFdsGlobalVariable.CacheHits - CacheHits,
+                                        GenFdsGlobalVariable.CacheMisses - CacheMisses))
         return FvOutputFile
 
+    ## __GenFfsList__()
+    #
+    #   Generate the FFS files of the modules in FV, in parallel if GenFds
+    #   has more than one thread and is not already generating an enclosing FV
+    #   in parallel. The FFS files are generated again one by one when the
+    #   FVs inside them are rebased, as they take their base addresses from
+    #   FvChildAddr in FfsList order.
+    #
+    #   @param  self        The object pointer
+    #   @param  MacroDict   macro value pair
+    #   @param  FvChildAddr base addresses of the FVs inside the FFS files
+    #   @param  FvParentAddr base address of this FV
+    #   @retval list        Generated FFS file paths, in FfsList order
+    #
+    def __GenFfsList__(self, MacroDict, FvChildAddr, FvParentAddr):
+        if GenFdsGlobalVariable.ThreadNumber > 1 and len(self.FfsList) > 1 and \
+           FvChildAddr == [] and not GenFdsGlobalVariable.IsGenFfsThread():
+            FileList, LargeFile = GenFdsGlobalVariable.GenFfsInParallel(self.FfsList, MacroDict, FvChildAddr, FvParentAddr)
+            if LargeFile:
+                GenFdsGlobalVariable.GetLargeFileInFvFlags()[-1] = True
+            return FileList
+
+        FileList = []
+        for FfsFile in self.FfsList :
+            FileList.append(FfsFile.GenFfs(MacroDict, FvChildAddr, FvParentAddr))
+        return FileList
+
     ## __InitializeInf__()
     #
     #   Initilize the inf file to create FV
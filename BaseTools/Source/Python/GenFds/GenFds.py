@@ -71,6 +71,12 @@ def main():
             
         if Options.FixedAddress != None:
             GenFdsGlobalVariable.FixedLoadAddress = True
+
+        if Options.ThreadNumber != None:
+            if Options.ThreadNumber < 1:
+                EdkLogger.error("GenFds", OPTION_VALUE_INVALID, "Thread number must be a positive integer",
+                                ExtraData="%d" % Options.ThreadNumber)
+            GenFdsGlobalVariable.ThreadNumber = Options.ThreadNumber
             
         if Options.quiet != None:
             EdkLogger.SetLevel(EdkLogger.QUIET)
@@ -274,6 +280,7 @@ def main():
             GenFds.PreprocessImage(BuildWorkSpace, GenFdsGlobalVariable.ActivePlatform)
         """Call GenFds"""
         GenFds.GenFd('', FdfParserObj, BuildWorkSpace, ArchList)
+        GenFdsGlobalVariable.PruneCache()
 
         """Generate GUID cross reference file"""
         GenFds.GenerateGuidXRefFile(BuildWorkSpace, ArchList)
@@ -344,6 +351,7 @@ def myOptionParser():
     Parser.add_option("-s", "--specifyaddress", dest="FixedAddress", action="store_true", type=None, help="Specify driver load address.")
     Parser.add_option("--conf", action="store", type="string", dest="ConfDirectory", help="Specify the customized Conf directory.")
     Parser.add_option("--ignore-sources", action="store_true", dest="IgnoreSources", default=False, help="Focus to a binary build and ignore all source files")
+    Parser.add_option("-n", "--thread-number", action="store", type="int", dest="ThreadNumber", help="Generate the FFS files of an FV with up to the specified number of threads.")
 
     (Options, args) = Parser.parse_args()
     return Options
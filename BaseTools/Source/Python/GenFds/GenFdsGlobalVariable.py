@@ -20,6 +20,8 @@ import sys
 import subprocess
 import struct
 import array
+import threading
+import hashlib
 
 from Common.BuildToolError import *
 from Common import EdkLogger
@@ -31,6 +33,20 @@ from AutoGen.BuildEngine import BuildRule
 import Common.DataType as DataType
 from Common.Misc import PathClass
 from Common.LongFilePathSupport import OpenLongFilePath as open
+from Common.LongFilePathSupport import CopyLongFilePath
+
+#
+# The compressors of the EfiCompressor extension release the GIL, so sections
+# of different modules are compressed in-process by the GenFfs threads at the
+# same time. Without the extension, or with one built before it had them, the
+# compression tools are run instead.
+#
+try:
+    import EfiCompressor
+    if not hasattr(EfiCompressor, 'LzmaCompress'):
+        EfiCompressor = None
+except ImportError:
+    EfiCompressor = None
 
 ## Global variables
 #
@@ -81,6 +97,38 @@ class GenFdsGlobalVariable:
     EFI_FIRMWARE_FILE_SYSTEM3_GUID = '5473C07A-3DCB-4dca-BD6F-1E9689E7349A'
     LARGE_FILE_SIZE = 0x1000000
 
+    #
+    # Maximum number of threads generating the FFS files of one FV. Only one
+    # of them runs GenFds code at a time: the lock is released while a thread
+    # waits for an external tool, so tools of different modules overlap.
+    #
+    ThreadNumber = 1
+    __GenFfsLock = threading.Lock()
+    __ThreadData = threading.local()
+
+    #
+    # Tool outputs are kept in CacheDir under the hash of the tool, its command
+    # line and the contents of its input files, so a section or FFS file whose
+    # inputs are unchanged is copied instead of regenerated. The entries used
+    # least recently are removed once the cache is larger than CacheMaxSize.
+    #
+    CacheDir = ''
+    CacheMaxSize = 256 * 1024 * 1024
+    CacheHits = 0
+    CacheMisses = 0
+    __ToolStampDict = {}
+    __CToolStamp = None
+
+    #
+    # The GUIDed section tools whose output the EfiCompressor extension
+    # produces, by GUID and tool name, with the function and its arguments
+    #
+    __GuidedCompressorDict = {
+        ('EE4E5898-3914-4259-9D6E-DC7BD79403CF', 'LZMACOMPRESS')    : ('LzmaCompress', ()),
+        ('D42AE6BD-1352-4BFB-909A-CA72A6EAE889', 'LZMAF86COMPRESS') : ('LzmaCompress', (1,)),
+        ('A31280AD-481E-41B6-95E8-127F4C984779', 'TIANOCOMPRESS')   : ('FrameworkCompress', ()),
+    }
+
     SectionHeader = struct.Struct("3B 1B")
     
     ## LoadBuildRule
@@ -283,6 +331,9 @@ class GenFdsGlobalVariable:
         GenFdsGlobalVariable.FfsDir = os.path.join(GenFdsGlobalVariable.FvDir, 'Ffs')
         if not os.path.exists(GenFdsGlobalVariable.FfsDir) :
             os.makedirs(GenFdsGlobalVariable.FfsDir)
+        GenFdsGlobalVariable.CacheDir = os.path.join(GenFdsGlobalVariable.FfsDir, 'Cache')
+        if not os.path.exists(GenFdsGlobalVariable.CacheDir) :
+            os.makedirs(GenFdsGlobalVariable.CacheDir)
         if ArchList != None:
             GenFdsGlobalVariable.ArchList = ArchList
 
@@ -360,6 +411,323 @@ class GenFdsGlobalVariable:
                 return True
         return False
 
+    ## Compute the cache key of a tool invocation
+    #
+    #   Input paths and the output path are left out of the key so that the
+    #   same contents processed in another location still hit the cache. The
+    #   path, size and modification time of the tool are part of the key, so
+    #   an updated tool never gets the outputs of its previous version.
+    #
+    #   @param  Cmd             Tool command line
+    #   @param  Output          Path of output file
+    #   @param  Input           Path list of input files
+    #
+    #   @retval string          SHA-1 of the tool, command line and input contents
+    #   @retval None            if the cache is disabled, the tool is not found
+    #                           or an input is missing
+    #
+    @staticmethod
+    def GetCacheKey(Cmd, Output, Input):
+        if not GenFdsGlobalVariable.CacheDir:
+            return None
+        ToolStamp = GenFdsGlobalVariable.GetToolStamp(Cmd[0])
+        if ToolStamp == None:
+            return None
+        Sha = hashlib.sha1()
+        Sha.update(ToolStamp + '\0')
+        for Item in Cmd[1:]:
+            if Item != Output and Item not in Input:
+                Sha.update(Item + '\0')
+        for F in Input:
+            if not os.path.isfile(F):
+                return None
+            Data = open(F, 'rb').read()
+            Sha.update('%d\0' % len(Data))
+            Sha.update(Data)
+        return Sha.hexdigest()
+
+    ## Get the path, size and modification time of a tool
+    #
+    #   The BaseTools C tools are usually run through wrapper scripts that
+    #   exec the binaries from the C tool directory, or run other tools, so
+    #   the binaries there are part of the stamp of every tool.
+    #
+    #   @param  Tool            Tool name as given on the command line
+    #
+    #   @retval string          Stamp of the executable found for the tool
+    #   @retval None            if the tool is not found
+    #
+    @staticmethod
+    def GetToolStamp(Tool):
+        if Tool not in GenFdsGlobalVariable.__ToolStampDict:
+            Stamp = None
+            if os.path.dirname(Tool):
+                PathList = ['']
+            else:
+                PathList = os.environ.get('PATH', '').split(os.pathsep)
+            ExtList = ['']
+            if sys.platform == 'win32':
+                ExtList += os.environ.get('PATHEXT', '.EXE').split(os.pathsep)
+            for Dir in PathList:
+                for Ext in ExtList:
+                    ToolPath = os.path.join(Dir, Tool + Ext)
+                    if os.path.isfile(ToolPath):
+                        Stat = os.stat(ToolPath)
+                        Stamp = '%s %d %d' % (os.path.abspath(ToolPath), Stat.st_size, Stat.st_mtime)
+                        break
+                if Stamp != None:
+                    break
+            if Stamp != None:
+                Stamp += GenFdsGlobalVariable.GetCToolStamp()
+            GenFdsGlobalVariable.__ToolStampDict[Tool] = Stamp
+        return GenFdsGlobalVariable.__ToolStampDict[Tool]
+
+    ## Get the sizes and modification times of the BaseTools C tool binaries
+    #
+    @staticmethod
+    def GetCToolStamp():
+        if GenFdsGlobalVariable.__CToolStamp == None:
+            DirList = []
+            if 'WORKSPACE' in os.environ:
+                DirList.append(os.path.join(os.environ['WORKSPACE'], 'Conf', 'BaseToolsCBinaries'))
+            if 'EDK_TOOLS_PATH' in os.environ:
+                DirList.append(os.path.join(os.environ['EDK_TOOLS_PATH'], 'Source', 'C', 'bin'))
+            Stamp = ''
+            for Dir in DirList:
+                if not os.path.isdir(Dir):
+                    continue
+                for Name in sorted(os.listdir(Dir)):
+                    Stat = os.stat(os.path.join(Dir, Name))
+                    Stamp += '\0%s %d %d' % (Name, Stat.st_size, Stat.st_mtime)
+            GenFdsGlobalVariable.__CToolStamp = Stamp
+        return GenFdsGlobalVariable.__CToolStamp
+
+    ## Remove the least recently used cache entries above CacheMaxSize
+    #
+    @staticmethod
+    def PruneCache():
+        CacheDir = GenFdsGlobalVariable.CacheDir
+        if not CacheDir or not os.path.isdir(CacheDir):
+            return
+        EntryList = []
+        TotalSize = 0
+        for Name in os.listdir(CacheDir):
+            CacheFile = os.path.join(CacheDir, Name)
+            if Name.endswith('.tmp'):
+                # left behind by an interrupted GenFds
+                os.remove(CacheFile)
+                continue
+            Stat = os.stat(CacheFile)
+            EntryList.append((Stat.st_mtime, Stat.st_size, CacheFile))
+            TotalSize += Stat.st_size
+        EntryList.sort()
+        for MTime, Size, CacheFile in EntryList:
+            if TotalSize <= GenFdsGlobalVariable.CacheMaxSize:
+                break
+            os.remove(CacheFile)
+            TotalSize -= Size
+
+    ## Call a tool producing Output, or copy the output of an earlier identical call
+    #
+    #   @param  Cmd             Tool command line
+    #   @param  Output          Path of output file
+    #   @param  Input           Path list of input files
+    #   @param  ErrorMess       Message reported if the tool fails
+    #   @param  Function        Function producing the same Output as the tool,
+    #                           called instead of the tool if given
+    #
+    @staticmethod
+    def CallCachedExternalTool(Cmd, Output, Input, ErrorMess, Function=None):
+        if Function == None:
+            Function = lambda: GenFdsGlobalVariable.CallExternalTool(Cmd, ErrorMess)
+        Key = GenFdsGlobalVariable.GetCacheKey(Cmd, Output, Input)
+        if Key == None:
+            Function()
+            return
+
+        CacheFile = os.path.join(GenFdsGlobalVariable.CacheDir, Key)
+        if os.path.isfile(CacheFile):
+            GenFdsGlobalVariable.DebugLogger(EdkLogger.DEBUG_5, "%s is reused from %s" % (Output, CacheFile))
+            CopyLongFilePath(CacheFile, Output)
+            # the modification time of an entry is its last use
+            os.utime(CacheFile, None)
+            GenFdsGlobalVariable.CacheHits += 1
+            return
+
+        Function()
+        GenFdsGlobalVariable.CacheMisses += 1
+        if os.path.isfile(Output):
+            #
+            # Copy under a temporary name first so that an interrupted copy
+            # never leaves a truncated entry behind.
+            #
+            TempFile = CacheFile + '.tmp'
+            CopyLongFilePath(Output, TempFile)
+            if os.path.exists(CacheFile):
+                os.remove(TempFile)
+            else:
+                os.rename(TempFile, CacheFile)
+
+    ## Check if the caller is one of the threads started by GenFfsInParallel
+    #
+    @staticmethod
+    def IsGenFfsThread():
+        return getattr(GenFdsGlobalVariable.__ThreadData, 'InGenFfsThread', False)
+
+    ## Get the large file flag stack of the calling thread
+    #
+    #   Each GenFfsInParallel thread has its own stack, so that an FV nested in
+    #   one module never sees the flags set by sections of another module.
+    #
+    @staticmethod
+    def GetLargeFileInFvFlags():
+        if GenFdsGlobalVariable.IsGenFfsThread():
+            return GenFdsGlobalVariable.__ThreadData.LargeFileInFvFlags
+        return GenFdsGlobalVariable.LargeFileInFvFlags
+
+    ## Call a function with the GenFfs lock released
+    #
+    #   The other GenFfs threads run while the calling one is in a function of
+    #   a C extension that releases the GIL.
+    #
+    #   @param  Function        Function to call
+    #   @param  Args            Arguments of Function
+    #
+    #   @retval object          Return value of Function
+    #
+    @staticmethod
+    def CallWithoutGenFfsLock(Function, *Args):
+        InGenFfsThread = GenFdsGlobalVariable.IsGenFfsThread()
+        if InGenFfsThread:
+            GenFdsGlobalVariable.__GenFfsLock.release()
+        try:
+            return Function(*Args)
+        finally:
+            if InGenFfsThread:
+                GenFdsGlobalVariable.__GenFfsLock.acquire()
+
+    ## Compress data with a function of the EfiCompressor extension
+    #
+    #   @param  Function        Name of the function
+    #   @param  Data            Data to compress
+    #   @param  Args            Other arguments of the function
+    #
+    #   @retval string          Compressed data
+    #
+    @staticmethod
+    def Compress(Function, Data, *Args):
+        try:
+            return GenFdsGlobalVariable.CallWithoutGenFfsLock(getattr(EfiCompressor, Function), Data, *Args)
+        except Exception, X:
+            EdkLogger.error("GenFds", COMMAND_FAILURE, "Failed to compress with %s" % Function, ExtraData=str(X))
+
+    ## Generate a compression section in-process, the way GenSec does
+    #
+    #   @param  Output          Path of output file
+    #   @param  Input           Path list of input section files
+    #   @param  CompressionType PI_STD or PI_NONE
+    #
+    @staticmethod
+    def GenerateCompressSection(Output, Input, CompressionType):
+        Data = ''
+        for File in Input:
+            # each section starts at a 4-byte boundary
+            Data += '\0' * (-len(Data) % 4)
+            Data += open(File, 'rb').read()
+        if CompressionType == 'PI_STD':
+            SectionData = GenFdsGlobalVariable.Compress('UefiCompress', Data)
+            CompressionTypeValue = 1
+        else:
+            SectionData = Data
+            CompressionTypeValue = 0
+        Size = len(SectionData) + 9
+        if Size >= 0xFFFFFF:
+            Size += 4
+            Header = struct.pack('<3BBIIB', 0xFF, 0xFF, 0xFF, 0x01, Size, len(Data), CompressionTypeValue)
+        else:
+            Header = struct.pack('<3BBIB', Size & 0xFF, (Size >> 8) & 0xFF, Size >> 16, 0x01, len(Data), CompressionTypeValue)
+        Fd = open(Output, 'wb')
+        Fd.write(Header)
+        Fd.write(SectionData)
+        Fd.close()
+
+    ## Get the function generating the data of a GUIDed section in-process
+    #
+    #   Only the compression tools whose output the EfiCompressor extension
+    #   produces are replaced, and only if they have no option but -e.
+    #
+    #   @param  Guid            GUID of the section
+    #   @param  ToolPath        Tool the GUID is defined for
+    #   @param  Options         Options of the tool
+    #   @param  Output          Path of output file
+    #   @param  Input           Path list of input files
+    #
+    #   @retval function        Function generating Output
+    #   @retval None            if the tool must be run
+    #
+    @staticmethod
+    def GetGuidedCompressor(Guid, ToolPath, Options, Output, Input):
+        if EfiCompressor == None or Guid == None or Options.split() != ['-e'] or len(Input) != 1:
+            return None
+        ToolName = os.path.splitext(os.path.basename(ToolPath))[0].upper()
+        if (Guid.upper(), ToolName) not in GenFdsGlobalVariable.__GuidedCompressorDict:
+            return None
+        Function, Args = GenFdsGlobalVariable.__GuidedCompressorDict[(Guid.upper(), ToolName)]
+
+        def GuidedCompress():
+            Data = GenFdsGlobalVariable.Compress(Function, open(Input[0], 'rb').read(), *Args)
+            Fd = open(Output, 'wb')
+            Fd.write(Data)
+            Fd.close()
+        return GuidedCompress
+
+    ## Generate FFS files with up to ThreadNumber threads
+    #
+    #   @param  FfsList         FFS statements to generate
+    #   @param  MacroDict       macro value pair
+    #   @param  FvChildAddr     base addresses of the FVs inside the FFS files
+    #   @param  FvParentAddr    base address of the FV containing the FFS files
+    #
+    #   @retval tuple           (generated FFS file paths in FfsList order,
+    #                            True if any of them holds a large section)
+    #
+    @staticmethod
+    def GenFfsInParallel(FfsList, MacroDict, FvChildAddr=[], FvParentAddr=None):
+        FileList = [None] * len(FfsList)
+        Pending = range(len(FfsList))
+        ErrorInfo = []
+        LargeFile = []
+
+        def GenFfsThread():
+            ThreadData = GenFdsGlobalVariable.__ThreadData
+            ThreadData.InGenFfsThread = True
+            ThreadData.LargeFileInFvFlags = [False]
+            GenFdsGlobalVariable.__GenFfsLock.acquire()
+            try:
+                while Pending and not ErrorInfo:
+                    Index = Pending.pop(0)
+                    try:
+                        FileList[Index] = FfsList[Index].GenFfs(MacroDict, FvChildAddr, FvParentAddr)
+                    except:
+                        ErrorInfo.append(sys.exc_info())
+                if ThreadData.LargeFileInFvFlags[0]:
+                    LargeFile.append(True)
+            finally:
+                GenFdsGlobalVariable.__GenFfsLock.release()
+
+        ThreadList = []
+        for Index in range(min(GenFdsGlobalVariable.ThreadNumber, len(FfsList))):
+            ThreadObj = threading.Thread(target=GenFfsThread, name="GenFfs-%d" % Index)
+            ThreadObj.setDaemon(True)
+            ThreadObj.start()
+            ThreadList.append(ThreadObj)
+        for ThreadObj in ThreadList:
+            ThreadObj.join()
+
+        if ErrorInfo:
+            raise ErrorInfo[0][0], ErrorInfo[0][1], ErrorInfo[0][2]
+        return FileList, LargeFile != []
+
     @staticmethod
     def GenerateSection(Output, Input, Type=None, CompressionType=None, Guid=None,
                         GuidHdrLen=None, GuidAttr=[], Ui=None, Ver=None, InputAlign=None, BuildNumber=None):
@@ -401,7 +769,7 @@ class GenFdsGlobalVariable:
             if not GenFdsGlobalVariable.NeedsUpdate(Output, list(Input) + [CommandFile]):
                 return
 
-            GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to generate section")
+            GenFdsGlobalVariable.CallCachedExternalTool(Cmd, Output, [], "Failed to generate section")
         else:
             Cmd += ["-o", Output]
             Cmd += Input
@@ -409,11 +777,16 @@ class GenFdsGlobalVariable:
             SaveFileOnChange(CommandFile, ' '.join(Cmd), False)
             if GenFdsGlobalVariable.NeedsUpdate(Output, list(Input) + [CommandFile]):
                 GenFdsGlobalVariable.DebugLogger(EdkLogger.DEBUG_5, "%s needs update because of newer %s" % (Output, Input))
-                GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to generate section")
+                Function = None
+                if Type == 'EFI_SECTION_COMPRESSION' and CompressionType in ['PI_STD', 'PI_NONE'] and \
+                   InputAlign == None and EfiCompressor != None:
+                    Function = lambda: GenFdsGlobalVariable.GenerateCompressSection(Output, Input, CompressionType)
+                GenFdsGlobalVariable.CallCachedExternalTool(Cmd, Output, Input, "Failed to generate section", Function)
 
+            LargeFileInFvFlags = GenFdsGlobalVariable.GetLargeFileInFvFlags()
             if (os.path.getsize(Output) >= GenFdsGlobalVariable.LARGE_FILE_SIZE and
-                GenFdsGlobalVariable.LargeFileInFvFlags):
-                GenFdsGlobalVariable.LargeFileInFvFlags[-1] = True 
+                LargeFileInFvFlags):
+                LargeFileInFvFlags[-1] = True
 
     @staticmethod
     def GetAlignment (AlignString):
@@ -447,7 +820,7 @@ class GenFdsGlobalVariable:
             return
         GenFdsGlobalVariable.DebugLogger(EdkLogger.DEBUG_5, "%s needs update because of newer %s" % (Output, Input))
 
-        GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to generate FFS")
+        GenFdsGlobalVariable.CallCachedExternalTool(Cmd, Output, Input, "Failed to generate FFS")
 
     @staticmethod
     def GenerateFirmwareVolume(Output, Input, BaseAddress=None, ForceRebase=None, Capsule=False, Dump=False,
@@ -572,7 +945,7 @@ class GenFdsGlobalVariable:
         GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to generate option rom")
 
     @staticmethod
-    def GuidTool(Output, Input, ToolPath, Options='', returnValue=[]):
+    def GuidTool(Output, Input, ToolPath, Options='', returnValue=[], Guid=None):
         if not GenFdsGlobalVariable.NeedsUpdate(Output, Input):
             return
         GenFdsGlobalVariable.DebugLogger(EdkLogger.DEBUG_5, "%s needs update because of newer %s" % (Output, Input))
@@ -582,7 +955,11 @@ class GenFdsGlobalVariable:
         Cmd += ["-o", Output]
         Cmd += Input
 
-        GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to call " + ToolPath, returnValue)
+        if returnValue == []:
+            Function = GenFdsGlobalVariable.GetGuidedCompressor(Guid, ToolPath, Options, Output, Input)
+            GenFdsGlobalVariable.CallCachedExternalTool(Cmd, Output, Input, "Failed to call " + ToolPath, Function)
+        else:
+            GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to call " + ToolPath, returnValue)
 
     def CallExternalTool (cmd, errorMess, returnValue=[]):
 
@@ -603,14 +980,27 @@ class GenFdsGlobalVariable:
             if GenFdsGlobalVariable.SharpCounter % GenFdsGlobalVariable.SharpNumberPerLine == 0:
                 sys.stdout.write('\n')
 
+        #
+        # Let the other GenFfs threads run while this one waits for the tool.
+        # Descriptors are not inherited so that a tool started by one thread
+        # does not hold the pipes of a tool started by another one open.
+        #
+        InGenFfsThread = GenFdsGlobalVariable.IsGenFfsThread()
+        if InGenFfsThread:
+            GenFdsGlobalVariable.__GenFfsLock.release()
         try:
-            PopenObject = subprocess.Popen(' '.join(cmd), stdout=subprocess.PIPE, stderr= subprocess.PIPE, shell=True)
-        except Exception, X:
-            EdkLogger.error("GenFds", COMMAND_FAILURE, ExtraData="%s: %s" % (str(X), cmd[0]))
-        (out, error) = PopenObject.communicate()
-
-        while PopenObject.returncode == None :
-            PopenObject.wait()
+            try:
+                PopenObject = subprocess.Popen(' '.join(cmd), stdout=subprocess.PIPE, stderr= subprocess.PIPE, shell=True,
+                                               close_fds=(InGenFfsThread and sys.platform != 'win32'))
+            except Exception, X:
+                EdkLogger.error("GenFds", COMMAND_FAILURE, ExtraData="%s: %s" % (str(X), cmd[0]))
+            (out, error) = PopenObject.communicate()
+
+            while PopenObject.returncode == None :
+                PopenObject.wait()
+        finally:
+            if InGenFfsThread:
+                GenFdsGlobalVariable.__GenFfsLock.acquire()
         if returnValue != [] and returnValue[0] != 0:
             #get command return value
             returnValue[0] = PopenObject.returncode
@@ -189,7 +189,7 @@ class GuidSection(GuidSectionClassObject) :
             if ReturnValue[0] != 0:
                 FirstCall = False
                 ReturnValue[0] = 0
-                GenFdsGlobalVariable.GuidTool(TempFile, [DummyFile], ExternalTool, CmdOption)
+                GenFdsGlobalVariable.GuidTool(TempFile, [DummyFile], ExternalTool, CmdOption, Guid=self.NameGuid)
             #
             # There is external tool which does not follow standard rule which return nonzero if tool fails
             # The output file has to be checked
@@ -227,7 +227,7 @@ class GuidSection(GuidSectionClassObject) :
             
             if FirstCall and 'PROCESSING_REQUIRED' in Attribute:
                 # Guided data by -z option on first call is the process required data. Call the guided tool with the real option.
-                GenFdsGlobalVariable.GuidTool(TempFile, [DummyFile], ExternalTool, CmdOption)
+                GenFdsGlobalVariable.GuidTool(TempFile, [DummyFile], ExternalTool, CmdOption, Guid=self.NameGuid)
             
             #
             # Call Gensection Add Section Header
@@ -38,6 +38,8 @@ class Table(object):
     _ID_STEP_ = 1
     _ID_MAX_ = 0x80000000
     _DUMMY_ = 0
+    # number of records stored together by one insert statement
+    _BULK_SIZE_ = 1
 
     def __init__(self, Cursor, Name='', IdBase=0, Temporary=False):
         self.Cur = Cursor
@@ -45,6 +47,7 @@ class Table(object):
         self.IdBase = int(IdBase)
         self.ID = int(IdBase)
         self.Temporary = Temporary
+        self._PendingRecords = []
 
     def __str__(self):
         return self.Table
@@ -69,21 +72,38 @@ class Table(object):
     #
     # Insert a record into a table
     #
+    # The record is kept until _BULK_SIZE_ records are pending or the table is
+    # read, and then stored together with the others by one statement. Tables
+    # also written through other Table objects must store each record at once.
+    #
     def Insert(self, *Args):
         self.ID = self.ID + self._ID_STEP_
         if self.ID >= (self.IdBase + self._ID_MAX_):
             self.ID = self.IdBase + self._ID_STEP_
         Values = ", ".join([str(Arg) for Arg in Args])
-        SqlCommand = "insert into %s values(%s, %s)" % (self.Table, self.ID, Values)
+        self._PendingRecords.append("(%s, %s)" % (self.ID, Values))
+        if len(self._PendingRecords) >= self._BULK_SIZE_:
+            self.Flush()
+        return self.ID
+
+    ## Flush table
+    #
+    # Store the records pending from Insert()
+    #
+    def Flush(self):
+        if not self._PendingRecords:
+            return
+        SqlCommand = "insert into %s values%s" % (self.Table, ", ".join(self._PendingRecords))
+        self._PendingRecords = []
         EdkLogger.debug(EdkLogger.DEBUG_5, SqlCommand)
         self.Cur.execute(SqlCommand)
-        return self.ID
 
     ## Query table
     #
     # Query all records of the table
     #
     def Query(self):
+        self.Flush()
         SqlCommand = """select * from %s""" % self.Table
         self.Cur.execute(SqlCommand)
         for Rs in self.Cur:
@@ -95,6 +115,7 @@ class Table(object):
     # Drop the table
     #
     def Drop(self):
+        self._PendingRecords = []
         SqlCommand = """drop table IF EXISTS %s""" % self.Table
         self.Cur.execute(SqlCommand)
 
@@ -105,11 +126,13 @@ class Table(object):
     # @retval Count:  Total count of all records
     #
     def GetCount(self):
+        self.Flush()
         SqlCommand = """select count(ID) from %s""" % self.Table
         Record = self.Cur.execute(SqlCommand).fetchall()
         return Record[0][0]
 
     def GetId(self):
+        self.Flush()
         SqlCommand = """select max(ID) from %s""" % self.Table
         Record = self.Cur.execute(SqlCommand).fetchall()
         Id = Record[0][0]
@@ -133,6 +156,7 @@ class Table(object):
     # @retval RecordSet:  The result after executed
     #
     def Exec(self, SqlCommand):
+        self.Flush()
         EdkLogger.debug(EdkLogger.DEBUG_5, SqlCommand)
         self.Cur.execute(SqlCommand)
         RecordSet = self.Cur.fetchall()
@@ -168,7 +192,8 @@ class TableFile(Table):
         Path VARCHAR,
         FullPath VARCHAR NOT NULL,
         Model INTEGER DEFAULT 0,
-        TimeStamp SINGLE NOT NULL
+        TimeStamp SINGLE NOT NULL,
+        Hash VARCHAR
         '''
     def __init__(self, Cursor):
         Table.__init__(self, Cursor, 'File')
@@ -183,9 +208,10 @@ class TableFile(Table):
     # @param FullPath:  FullPath of a File
     # @param Model:     Model of a File
     # @param TimeStamp: TimeStamp of a File
+    # @param Hash:      Hash of the content of a File
     #
-    def Insert(self, Name, ExtName, Path, FullPath, Model, TimeStamp):
-        (Name, ExtName, Path, FullPath) = ConvertToSqlString((Name, ExtName, Path, FullPath))
+    def Insert(self, Name, ExtName, Path, FullPath, Model, TimeStamp, Hash=''):
+        (Name, ExtName, Path, FullPath, Hash) = ConvertToSqlString((Name, ExtName, Path, FullPath, Hash))
         return Table.Insert(
             self,
             Name,
@@ -193,7 +219,8 @@ class TableFile(Table):
             Path,
             FullPath,
             Model,
-            TimeStamp
+            TimeStamp,
+            Hash
             )
 
     ## InsertFile
@@ -262,6 +289,27 @@ class TableFile(Table):
     def SetFileTimeStamp(self, FileId, TimeStamp):
         self.Exec("update %s set TimeStamp=%s where ID='%s'" % (self.Table, TimeStamp, FileId))
 
+    ## Get the content hash of a given file
+    #
+    #   @param  FileId      ID of file
+    #
+    #   @retval hash        Hash value of given file in the table
+    #
+    def GetFileHash(self, FileId):
+        QueryScript = "select Hash from %s where ID = '%s'" % (self.Table, FileId)
+        RecordList = self.Exec(QueryScript)
+        if len(RecordList) == 0:
+            return None
+        return RecordList[0][0]
+
+    ## Update the content hash of a given file
+    #
+    #   @param  FileId      ID of file
+    #   @param  Hash        Hash of the content of file
+    #
+    def SetFileHash(self, FileId, Hash):
+        self.Exec("update %s set Hash='%s' where ID='%s'" % (self.Table, Hash, FileId))
+
     ## Get list of file with given type
     #
     #   @param  FileType    Type value of file
@@ -15,8 +15,10 @@
 # Import Modules
 #
 import uuid
+import hashlib
 
 import Common.EdkLogger as EdkLogger
+from Common.LongFilePathSupport import OpenLongFilePath as open
 
 from MetaDataTable import Table, TableFile
 from MetaDataTable import ConvertToSqlString
@@ -27,6 +29,8 @@ class MetaFileTable(Table):
     # TRICK: use file ID as the part before '.'
     _ID_STEP_ = 0.00000001
     _ID_MAX_ = 0.99999999
+    # a meta file is parsed into its table at once
+    _BULK_SIZE_ = 256
 
     ## Constructor
     def __init__(self, Cursor, MetaFile, FileType, Temporary):
@@ -48,19 +52,38 @@ class MetaFileTable(Table):
         Table.__init__(self, Cursor, TableName, FileId, Temporary)
         self.Create(not self.IsIntegrity())
 
+    ## Get the hash of the content of the meta file
+    def GetFileHash(self):
+        File = open(str(self.MetaFile), 'rb')
+        try:
+            return hashlib.md5(File.read()).hexdigest()
+        finally:
+            File.close()
+
+    ## Check whether the table holds the data of the current meta file
+    #
+    # The table is reused as long as the time stamp of the file is unchanged.
+    # A file whose time stamp changed, e.g. by a checkout, but whose content
+    # is the same is not parsed again either.
+    #
     def IsIntegrity(self):
         try:
+            self.Flush()
             TimeStamp = self.MetaFile.TimeStamp
             Result = self.Cur.execute("select ID from %s where ID<0" % (self.Table)).fetchall()
             if not Result:
-                # update the timestamp in database
-                self._FileIndexTable.SetFileTimeStamp(self.IdBase, TimeStamp)                
+                # update the timestamp and hash in database
+                self._FileIndexTable.SetFileTimeStamp(self.IdBase, TimeStamp)
+                self._FileIndexTable.SetFileHash(self.IdBase, self.GetFileHash())
                 return False
 
             if TimeStamp != self._FileIndexTable.GetFileTimeStamp(self.IdBase):
                 # update the timestamp in database
                 self._FileIndexTable.SetFileTimeStamp(self.IdBase, TimeStamp)
-                return False
+                Hash = self.GetFileHash()
+                if Hash != self._FileIndexTable.GetFileHash(self.IdBase):
+                    self._FileIndexTable.SetFileHash(self.IdBase, Hash)
+                    return False
         except Exception, Exc:
             EdkLogger.debug(EdkLogger.DEBUG_5, str(Exc))
             return False
@@ -227,6 +250,7 @@ class PackageTable(MetaFileTable):
 
     def GetValidExpression(self, TokenSpaceGuid, PcdCName):
         SqlCommand = "select Value1 from %s WHERE Value2='%s' and Value3='%s'" % (self.Table, TokenSpaceGuid, PcdCName)
+        self.Flush()
         self.Cur.execute(SqlCommand)
         validateranges = []
         validlists = []
@@ -2789,26 +2789,64 @@ class WorkspaceDatabase(object):
             if self._CheckWhetherDbNeedRenew(RenewDb, DbPath):
                 os.remove(DbPath)
         
+        self.DbPath = DbPath
+        self._Connect()
+
+        # create table for internal uses
+        self.TblDataModel = TableDataModel(self.Cur)
+        self.TblFile = TableFile(self.Cur)
+        self.Platform = None
+
+        # conversion object for build or file format conversion purpose
+        self.BuildObject = WorkspaceDatabase.BuildObjectFactory(self)
+        self.TransformObject = WorkspaceDatabase.TransformObjectFactory(self)
+
+    ## Open the connection to the database file
+    #
+    # @param ReadOnly           Refuse any change to the database
+    #
+    def _Connect(self, ReadOnly=False):
         # create db with optimized parameters
-        self.Conn = sqlite3.connect(DbPath, isolation_level='DEFERRED')
+        # GenFds queries the database from its FFS generation threads, which
+        # take turns under a lock, so the connection is not tied to one thread
+        self.Conn = sqlite3.connect(self.DbPath, isolation_level='DEFERRED', check_same_thread=False)
         self.Conn.execute("PRAGMA synchronous=OFF")
         self.Conn.execute("PRAGMA temp_store=MEMORY")
         self.Conn.execute("PRAGMA count_changes=OFF")
         self.Conn.execute("PRAGMA cache_size=8192")
         #self.Conn.execute("PRAGMA page_size=8192")
+        if ReadOnly:
+            self.Conn.execute("PRAGMA query_only=ON")
 
         # to avoid non-ascii character conversion issue
         self.Conn.text_factory = str
         self.Cur = self.Conn.cursor()
 
-        # create table for internal uses
-        self.TblDataModel = TableDataModel(self.Cur)
-        self.TblFile = TableFile(self.Cur)
-        self.Platform = None
-
-        # conversion object for build or file format conversion purpose
-        self.BuildObject = WorkspaceDatabase.BuildObjectFactory(self)
-        self.TransformObject = WorkspaceDatabase.TransformObjectFactory(self)
+    ## Open a new connection in a forked process
+    #
+    # A process created by fork() must not use the connection of its parent.
+    # The tables of the files parsed so far are moved to the new connection.
+    # Temporary tables live in the connection of the parent only, so a query
+    # on one of them fails in the new process.
+    #
+    # @param ReadOnly           Refuse any change to the database
+    #
+    def Reconnect(self, ReadOnly=False):
+        OldCur = self.Cur
+        self._Connect(ReadOnly)
+
+        TableList = [self.TblDataModel, self.TblFile]
+        for BuildObject in self.BuildObject._CACHE_.values():
+            for Name in ['_Table', '_RawTable']:
+                Table = getattr(BuildObject._RawData, Name, None)
+                if Table == None:
+                    continue
+                TableList.append(Table)
+                if hasattr(Table, '_FileIndexTable'):
+                    TableList.append(Table._FileIndexTable)
+        for Table in TableList:
+            if Table.Cur is OldCur:
+                Table.Cur = self.Cur
 
     ## Check whether workspace database need to be renew.
     #  The renew reason maybe:
@@ -70,6 +70,15 @@ gIncludePattern2 = re.compile(r"#include\s+EFI_([A-Z_]+)\s*[(]\s*(\w+)\s*[)]")
 ## Pattern to find the entry point for EDK module using EDKII Glue library
 gGlueLibEntryPoint = re.compile(r"__EDKII_GLUE_MODULE_ENTRY_POINT__\s*=\s*(\w+)")
 
+## Pattern to find the input sections and their sizes in a GNU ld map file
+gLdInputSectionPattern = re.compile(r"^ ([.\w$]+)\s+0x[0-9A-Fa-f]+\s+0x([0-9A-Fa-f]+)\s+(\S.*)$")
+gLdSectionNamePattern = re.compile(r"^ ([.\w$]+)$")
+gLdSectionAddressPattern = re.compile(r"^\s+0x[0-9A-Fa-f]+\s+0x([0-9A-Fa-f]+)\s+(\S.*)$")
+
+## Patterns to find the driver and PEIM records in a boot performance log of the Dp application
+gDpHandleRecordPattern = re.compile(r"^\s*\d+:\s+\[\s*[0-9A-Fa-f]+\]\s+(.+)$")
+gDpPeimRecordPattern = re.compile(r"^\s*\d+:\s+0x\s*[0-9A-Fa-f]+\s+([-0-9A-Fa-f]{36})\s+PEIM\s+(\d+)")
+
 ## Tags for MaxLength of line in report
 gLineMaxLength = 120
 
@@ -1407,6 +1416,287 @@ class FdReport(object):
 
         FileWrite(File, gSectionEnd)
 
+##
+# Reports the flash and boot cost of modules
+#
+# This class reports one table with the size every FFS file takes in the FVs
+# of the platform, the image, code and data size of the module it holds, and
+# the time the module took in a boot recorded by the Dp shell application, so
+# that the modules costing the most flash and boot time can be found. The table
+# is also saved as BootCost.csv in the build directory to follow the costs
+# across builds.
+#
+class BootCostReport(object):
+    ##
+    # Constructor function for class BootCostReport
+    #
+    # This constructor function generates BootCostReport object for the platform.
+    #
+    # @param self            The object pointer
+    # @param Wa              Workspace context information
+    # @param BootLog         The boot performance log written by Dp, or None
+    #
+    def __init__(self, Wa, BootLog):
+        self._FvDir = Wa.FvDir
+        self._CsvFileName = os.path.join(Wa.BuildDir, "BootCost.csv")
+        self._BootLog = BootLog
+        self._FvList = []
+        self._NestedFvDict = {}
+        self._ModuleDict = {}
+
+        for Pa in Wa.AutoGenObjectList:
+            for ModuleKey in Pa.Platform.Modules:
+                M = Pa.Platform.Modules[ModuleKey].M
+                self._ModuleDict.setdefault(M.Guid.upper(), M)
+
+        for Fd in Wa.FdfProfile.FdDict:
+            for FdRegion in Wa.FdfProfile.FdDict[Fd].RegionList:
+                if FdRegion.RegionType != "FV":
+                    continue
+                for FvName in FdRegion.RegionDataList:
+                    self._DiscoverFvList(FvName, Wa)
+
+    ##
+    # Discover the FV and its nested FVs
+    #
+    # This is an internal worker function to add the FV and the FVs nested in it
+    # to the FV list, and to record which FFS file holds each nested FV.
+    #
+    # @param self            The object pointer
+    # @param FvName          The name of the FV
+    # @param Wa              Workspace context information
+    #
+    def _DiscoverFvList(self, FvName, Wa):
+        if FvName.upper() in [Fv.upper() for Fv in self._FvList]:
+            return
+        self._FvList.append(FvName)
+        for Ffs in Wa.FdfProfile.FvDict[FvName.upper()].FfsList:
+            for Section in getattr(Ffs, "SectionList", []):
+                for FvSection in [Section] + getattr(Section, "SectionList", []):
+                    NestedFvName = getattr(FvSection, "FvName", None)
+                    if NestedFvName:
+                        self._NestedFvDict[Ffs.NameGuid.upper()] = NestedFvName
+                        self._DiscoverFvList(NestedFvName, Wa)
+
+    ##
+    # Collect the FFS files of a firmware volume
+    #
+    # This function reads the offset and GUID of every FFS file GenFv added to
+    # the FV from its report file, and the size of the file from the FV image.
+    #
+    # @param self            The object pointer
+    # @param FvName          The name of the FV
+    #
+    # @retval list           List of (offset, GUID, size) of the FFS files
+    #
+    def _ParseFv(self, FvName):
+        FileList = []
+        FvReportFileName = os.path.join(self._FvDir, FvName + ".Fv.txt")
+        try:
+            FvReport = open(FvReportFileName).read()
+        except IOError:
+            EdkLogger.warn(None, "Fail to read report file", FvReportFileName)
+            return FileList
+        try:
+            FvImage = open(os.path.join(self._FvDir, FvName + ".Fv"), "rb").read()
+        except IOError:
+            FvImage = ""
+
+        for Match in gOffsetGuidPattern.finditer(FvReport):
+            Offset = int(Match.group(1), 16)
+            Size = 0
+            #
+            # Size is the 24-bit field at offset 0x14 of the FFS header, or the
+            # ExtendedSize following the header of a large file
+            #
+            if Offset + 0x18 <= len(FvImage):
+                Size = struct.unpack("<I", FvImage[Offset + 0x14:Offset + 0x17] + "\0")[0]
+                if ord(FvImage[Offset + 0x13]) & 0x01 and Offset + 0x1C <= len(FvImage):
+                    Size = struct.unpack("<I", FvImage[Offset + 0x18:Offset + 0x1C])[0]
+            FileList.append((Offset, Match.group(2).upper(), Size))
+        return FileList
+
+    ##
+    # Collect the code and data size of a module from its map file
+    #
+    # This function sums the sizes of the code and data input sections listed
+    # in a GNU ld map file, and finds the largest of them. Other map files do
+    # not give the size of the sections.
+    #
+    # @param self            The object pointer
+    # @param MapFileName     The map file of the module
+    #
+    # @retval tuple          (code size, data size, largest section name, its size),
+    #                        or None if the map file gives no sizes
+    #
+    def _ParseMapFile(self, MapFileName):
+        try:
+            Lines = open(MapFileName).read().splitlines()
+            Start = Lines.index("Linker script and memory map")
+        except (IOError, ValueError):
+            return None
+
+        CodeSize = 0
+        DataSize = 0
+        Largest = ("", 0)
+        Name = None
+        for Line in Lines[Start + 1:]:
+            #
+            # A long section name is on a line of its own, followed by its
+            # address and size
+            #
+            Match = gLdInputSectionPattern.match(Line)
+            if Match:
+                Name, Size, Object = Match.groups()
+            else:
+                Match = gLdSectionAddressPattern.match(Line)
+                if not Match or Name == None:
+                    Match = gLdSectionNamePattern.match(Line)
+                    Name = Match and Match.group(1)
+                    continue
+                Size, Object = Match.groups()
+
+            Size = int(Size, 16)
+            if Name.startswith(".text"):
+                CodeSize += Size
+            elif Name.startswith((".data", ".rodata", ".bss", ".sdata", ".sbss")) or Name == "COMMON":
+                DataSize += Size
+            else:
+                Name = None
+                continue
+
+            if Size > Largest[1]:
+                #
+                # Name the section after the function or variable it holds,
+                # which -ffunction-sections and -fdata-sections put in its name
+                #
+                if Name.count(".") > 1:
+                    Largest = (Name.split(".", 2)[2], Size)
+                else:
+                    Largest = (os.path.basename(Object.strip()), Size)
+            Name = None
+
+        return (CodeSize, DataSize, Largest[0], Largest[1])
+
+    ##
+    # Collect the dispatch time of the PEIMs and drivers from the boot log
+    #
+    # This function parses the "PEIMs" and "Drivers by Handle" records of the
+    # log of the Dp shell application. The time of a driver is the sum of its
+    # records, e.g. of its entry point and of the Start() of its binding.
+    #
+    # @param self            The object pointer
+    #
+    # @retval dict           Time in microseconds by GUID or driver name in upper case
+    #
+    def _ParseBootLog(self):
+        BootTime = {}
+        if not self._BootLog:
+            return BootTime
+        try:
+            Content = open(self._BootLog, "rb").read()
+        except IOError:
+            EdkLogger.warn(None, "Fail to read boot log", self._BootLog)
+            return BootTime
+        #
+        # The UEFI shell writes the redirected output of Dp in UCS-2
+        #
+        if Content[:2] in ("\xff\xfe", "\xfe\xff"):
+            Content = Content.decode("utf-16").encode("ascii", "replace")
+
+        IdColumn = False
+        for Line in Content.splitlines():
+            if Line.lstrip().startswith("Index:"):
+                IdColumn = Line.split()[-1] == "ID"
+                continue
+            Match = gDpPeimRecordPattern.match(Line)
+            if Match:
+                Key = Match.group(1).upper()
+                BootTime[Key] = BootTime.get(Key, 0) + int(Match.group(2))
+                continue
+            Match = gDpHandleRecordPattern.match(Line)
+            if Match:
+                Fields = Match.group(1).split()
+                try:
+                    Time = int(Fields[-2 if IdColumn else -1])
+                except (ValueError, IndexError):
+                    continue
+                Key = Fields[0].upper()
+                BootTime[Key] = BootTime.get(Key, 0) + Time
+        return BootTime
+
+    ##
+    # Generate report for the flash and boot cost of modules
+    #
+    # This function generates the table of the FFS files in the FVs, the
+    # modules with the largest flash size first, and saves it as CSV.
+    #
+    # @param self            The object pointer
+    # @param File            The file object for report
+    #
+    def GenerateReport(self, File):
+        BootTime = self._ParseBootLog()
+        NestedFvList = [FvName.upper() for FvName in self._NestedFvDict.values()]
+        ItemList = []
+        FlashSize = 0
+        ModuleTime = {}
+        for FvName in self._FvList:
+            for Offset, Guid, FfsSize in self._ParseFv(FvName):
+                if FvName.upper() not in NestedFvList:
+                    FlashSize += FfsSize
+                Name = Guid
+                ImageSize = None
+                MapInfo = None
+                Time = None
+                if Guid in self._NestedFvDict:
+                    Name = "%s (FV)" % self._NestedFvDict[Guid]
+                elif Guid in self._ModuleDict:
+                    M = self._ModuleDict[Guid]
+                    Name = M.Module.BaseName
+                    FwReportFileName = os.path.join(M.BuildDir, "DEBUG", Name + ".txt")
+                    try:
+                        Match = gModuleSizePattern.search(open(FwReportFileName).read())
+                        if Match:
+                            ImageSize = int(Match.group(1))
+                    except IOError:
+                        pass
+                    MapInfo = self._ParseMapFile(os.path.join(M.BuildDir, "DEBUG", Name + ".map"))
+                    Time = BootTime.get(Guid, BootTime.get(Name.upper()))
+                    if Time != None:
+                        # a module in more than one FV is loaded once
+                        ModuleTime[Guid] = Time
+                ItemList.append((Name, Guid, FvName, Offset, FfsSize, ImageSize, MapInfo, Time))
+        ItemList.sort(key=lambda Item: (Item[4], Item[7]), reverse=True)
+
+        FileWrite(File, gSectionStart)
+        FileWrite(File, "Module Boot Cost")
+        FileWrite(File, "Flash Size:         0x%X (%.0fK)" % (FlashSize, FlashSize / 1024.0))
+        if self._BootLog:
+            FileWrite(File, "Boot Log:           %s" % self._BootLog)
+            FileWrite(File, "Boot Time:          %.1fms" % (sum(ModuleTime.values()) / 1000.0))
+        FileWrite(File, "Cost List:          %s" % self._CsvFileName)
+        FileWrite(File, gSectionSep)
+        FileWrite(File, "%-24s %-10s %9s %10s %6s %9s %9s %9s %s" %
+                  ("Module", "FV", "FFS Size", "Image Size", "Ratio", "Code", "Data", "Time(ms)", "Largest Section"))
+        FileWrite(File, gSubSectionSep)
+
+        CsvLines = ["Module,Guid,FV,Offset,FfsSize,ImageSize,CodeSize,DataSize,BootTime(us),LargestSection,LargestSectionSize"]
+        for Name, Guid, FvName, Offset, FfsSize, ImageSize, MapInfo, Time in ItemList:
+            Ratio = ""
+            if ImageSize:
+                Ratio = "%.2f" % (float(FfsSize) / ImageSize)
+            if MapInfo == None:
+                MapInfo = ("", "", "", "")
+            FileWrite(File, "%-24.24s %-10.10s %9d %10s %6s %9s %9s %9s %.26s" %
+                      (Name, FvName, FfsSize, "" if ImageSize == None else ImageSize, Ratio, MapInfo[0], MapInfo[1],
+                       "" if Time == None else "%.1f" % (Time / 1000.0), MapInfo[2]))
+            CsvLines.append(",".join([str(Value) for Value in (Name, Guid, FvName, "0x%X" % Offset, FfsSize,
+                                     "" if ImageSize == None else ImageSize) + MapInfo[:2] +
+                                     ("" if Time == None else Time, MapInfo[2], MapInfo[3])]))
+
+        FileWrite(File, gSectionEnd)
+        SaveFileOnChange(self._CsvFileName, gEndOfLine.join(CsvLines) + gEndOfLine, False)
+
 
 
 ##
@@ -1425,8 +1715,10 @@ class PlatformReport(object):
     # @param self            The object pointer
     # @param Wa              Workspace context information
     # @param MaList          The list of modules in the platform build
+    # @param ReportType      The kind of report items in the final report file
+    # @param BootLog         The boot performance log for the boot cost report
     #
-    def __init__(self, Wa, MaList, ReportType):
+    def __init__(self, Wa, MaList, ReportType, BootLog=None):
         self._WorkspaceDir = Wa.WorkspaceDir
         self.PlatformName = Wa.Name
         self.PlatformDscPath = Wa.Platform
@@ -1445,6 +1737,10 @@ class PlatformReport(object):
             for Fd in Wa.FdfProfile.FdDict:
                 self.FdReportList.append(FdReport(Wa.FdfProfile.FdDict[Fd], Wa))
 
+        self.BootCostReport = None
+        if "BOOT_COST" in ReportType and Wa.FdfProfile and MaList == None:
+            self.BootCostReport = BootCostReport(Wa, BootLog)
+
         self.PredictionReport = None
         if "FIXED_ADDRESS" in ReportType or "EXECUTION_ORDER" in ReportType:
             self.PredictionReport = PredictionReport(Wa)
@@ -1498,6 +1794,9 @@ class PlatformReport(object):
                 for FdReportListItem in self.FdReportList:
                     FdReportListItem.GenerateReport(File)
 
+            if self.BootCostReport:
+                self.BootCostReport.GenerateReport(File)
+
         for ModuleReportItem in self.ModuleReportList:
             ModuleReportItem.GenerateReport(File, self.PcdReport, self.PredictionReport, self.DepexParser, ReportType)
 
@@ -1521,9 +1820,11 @@ class BuildReport(object):
     # @param self            The object pointer
     # @param ReportFile      The file name to save report file
     # @param ReportType      The kind of report items in the final report file
+    # @param BootLog         The boot performance log for the boot cost report
     #
-    def __init__(self, ReportFile, ReportType):
+    def __init__(self, ReportFile, ReportType, BootLog=None):
         self.ReportFile = ReportFile
+        self.BootLog = BootLog
         if ReportFile:
             self.ReportList = []
             self.ReportType = []
@@ -1560,7 +1861,7 @@ class BuildReport(object):
             try:
                 File = StringIO('')
                 for (Wa, MaList) in self.ReportList:
-                    PlatformReport(Wa, MaList, self.ReportType).GenerateReport(File, BuildDuration, self.ReportType)
+                    PlatformReport(Wa, MaList, self.ReportType, self.BootLog).GenerateReport(File, BuildDuration, self.ReportType)
                 Content = FileLinesSplit(File.getvalue(), gLineMaxLength)
                 SaveFileOnChange(self.ReportFile, Content, True)
                 EdkLogger.quiet("Build report can be found at %s" % os.path.abspath(self.ReportFile))
@@ -39,6 +39,7 @@ from Common.ToolDefClassObject import *
 from Common.DataType import *
 from Common.BuildVersion import gBUILD_VERSION
 from AutoGen.AutoGen import *
+from AutoGen.AutoGenWorker import CreateModuleFiles
 from Common.BuildToolError import *
 from Workspace.WorkspaceDatabase import *
 
@@ -735,11 +736,12 @@ class Build():
         self.SkuId          = BuildOptions.SkuId
         self.ConfDirectory = BuildOptions.ConfDirectory
         self.SpawnMode      = True
-        self.BuildReport    = BuildReport(BuildOptions.ReportFile, BuildOptions.ReportType)
+        self.BuildReport    = BuildReport(BuildOptions.ReportFile, BuildOptions.ReportType, BuildOptions.BootLog)
         self.TargetTxt      = TargetTxtClassObject()
         self.ToolDef        = ToolDefClassObject()
         #Set global flag for build mode
         GlobalData.gIgnoreSource = BuildOptions.IgnoreSources
+        GlobalData.gIncrementalAutoGen = BuildOptions.Incremental
 
         if self.ConfDirectory:
             # Get alternate Conf location, if it is absolute, then just use the absolute directory name
@@ -765,6 +767,11 @@ class Build():
         self.UniFlag        = BuildOptions.Flag
         self.BuildModules = []
 
+        # time spent in AutoGen, make and GenFds, in seconds
+        self.AutoGenTime = 0
+        self.MakeTime = 0
+        self.GenFdsTime = 0
+
         # print dot character during doing some time-consuming work
         self.Progress = Utils.Progressor()
 
@@ -842,6 +849,7 @@ class Build():
 
         if self.ThreadNumber == 0:
             self.ThreadNumber = 1
+        GlobalData.gThreadNumber = self.ThreadNumber
 
         if not self.PlatformFile:
             PlatformFile = self.TargetTxt.TargetTxtDictionary[DataType.TAB_TAT_DEFINES_ACTIVE_PLATFORM]
@@ -899,6 +907,7 @@ class Build():
             return False
 
         # skip file generation for cleanxxx targets, run and fds target
+        AutoGenStartTime = time.time()
         if Target not in ['clean', 'cleanlib', 'cleanall', 'run', 'fds']:
             # for target which must generate AutoGen code and makefile
             if not self.SkipAutoGen or Target == 'genc':
@@ -906,6 +915,7 @@ class Build():
                 AutoGenObject.CreateCodeFile(CreateDepsCodeFile)
                 self.Progress.Stop("done!")
             if Target == "genc":
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 return True
 
             if not self.SkipAutoGen or Target == 'genmake':
@@ -913,11 +923,13 @@ class Build():
                 AutoGenObject.CreateMakeFile(CreateDepsMakeFile)
                 self.Progress.Stop("done!")
             if Target == "genmake":
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 return True
         else:
             # always recreate top/platform makefile when clean, just in case of inconsistency
             AutoGenObject.CreateCodeFile(False)
             AutoGenObject.CreateMakeFile(False)
+        self.AutoGenTime += time.time() - AutoGenStartTime
 
         if EdkLogger.GetLevel() == EdkLogger.QUIET:
             EdkLogger.quiet("Building ... %s" % repr(AutoGenObject))
@@ -1018,6 +1030,7 @@ class Build():
             return False
 
         # skip file generation for cleanxxx targets, run and fds target
+        AutoGenStartTime = time.time()
         if Target not in ['clean', 'cleanlib', 'cleanall', 'run', 'fds']:
             # for target which must generate AutoGen code and makefile
             if not self.SkipAutoGen or Target == 'genc':
@@ -1025,6 +1038,7 @@ class Build():
                 AutoGenObject.CreateCodeFile(CreateDepsCodeFile)
                 self.Progress.Stop("done!")
             if Target == "genc":
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 return True
 
             if not self.SkipAutoGen or Target == 'genmake':
@@ -1033,11 +1047,13 @@ class Build():
                 #AutoGenObject.CreateAsBuiltInf()
                 self.Progress.Stop("done!")
             if Target == "genmake":
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 return True
         else:
             # always recreate top/platform makefile when clean, just in case of inconsistency
             AutoGenObject.CreateCodeFile(False)
             AutoGenObject.CreateMakeFile(False)
+        self.AutoGenTime += time.time() - AutoGenStartTime
 
         if EdkLogger.GetLevel() == EdkLogger.QUIET:
             EdkLogger.quiet("Building ... %s" % repr(AutoGenObject))
@@ -1060,7 +1076,9 @@ class Build():
 
         # genfds
         if Target == 'fds':
+            GenFdsStartTime = time.time()
             LaunchCommand(AutoGenObject.GenFdsCommand, AutoGenObject.MakeFileDir)
+            self.GenFdsTime += time.time() - GenFdsStartTime
             return True
 
         # run
@@ -1392,6 +1410,7 @@ class Build():
             for ToolChain in self.ToolChainList:
                 GlobalData.gGlobalDefines['TOOLCHAIN'] = ToolChain
                 GlobalData.gGlobalDefines['TOOL_CHAIN_TAG'] = ToolChain
+                AutoGenStartTime = time.time()
                 Wa = WorkspaceAutoGen(
                         self.WorkspaceDir,
                         self.PlatformFile,
@@ -1409,6 +1428,7 @@ class Build():
                         self.UniFlag,
                         self.Progress
                         )
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 self.Fdf = Wa.FdfFile
                 self.LoadFixAddress = Wa.Platform.LoadFixAddress
                 self.BuildReport.AddPlatformReport(Wa)
@@ -1422,7 +1442,7 @@ class Build():
                         if Ma == None:
                             continue
                         self.BuildModules.append(Ma)
-                    self._BuildPa(self.Target, Pa)
+                    self._TimedBuild(self._BuildPa, self.Target, Pa)
 
                 # Create MAP file when Load Fix Address is enabled.
                 if self.Target in ["", "all", "fds"]:
@@ -1476,6 +1496,7 @@ class Build():
                 # module build needs platform build information, so get platform
                 # AutoGen first
                 #
+                AutoGenStartTime = time.time()
                 Wa = WorkspaceAutoGen(
                         self.WorkspaceDir,
                         self.PlatformFile,
@@ -1494,6 +1515,7 @@ class Build():
                         self.Progress,
                         self.ModuleFile
                         )
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 self.Fdf = Wa.FdfFile
                 self.LoadFixAddress = Wa.Platform.LoadFixAddress
                 Wa.CreateMakeFile(False)
@@ -1506,7 +1528,7 @@ class Build():
                     MaList.append(Ma)
                     self.BuildModules.append(Ma)
                     if not Ma.IsBinaryModule:
-                        self._Build(self.Target, Ma, BuildModule=True)
+                        self._TimedBuild(self._Build, self.Target, Ma, BuildModule=True)
 
                 self.BuildReport.AddPlatformReport(Wa, MaList)
                 if MaList == []:
@@ -1557,6 +1579,18 @@ class Build():
                     #
                     self._SaveMapFile (MapBuffer, Wa)
 
+    ## Run _BuildPa or _Build and account the time not spent in AutoGen to make
+    #
+    #   @param  BuildMethod     self._BuildPa or self._Build
+    #
+    def _TimedBuild(self, BuildMethod, *Args, **Kwargs):
+        StartTime = time.time()
+        AutoGenTime = self.AutoGenTime
+        try:
+            return BuildMethod(*Args, **Kwargs)
+        finally:
+            self.MakeTime += time.time() - StartTime - (self.AutoGenTime - AutoGenTime)
+
     ## Build a platform in multi-thread mode
     #
     def _MultiThreadBuildPlatform(self):
@@ -1565,6 +1599,7 @@ class Build():
             for ToolChain in self.ToolChainList:
                 GlobalData.gGlobalDefines['TOOLCHAIN'] = ToolChain
                 GlobalData.gGlobalDefines['TOOL_CHAIN_TAG'] = ToolChain
+                AutoGenStartTime = time.time()
                 Wa = WorkspaceAutoGen(
                         self.WorkspaceDir,
                         self.PlatformFile,
@@ -1582,6 +1617,7 @@ class Build():
                         self.UniFlag,
                         self.Progress
                         )
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 self.Fdf = Wa.FdfFile
                 self.LoadFixAddress = Wa.Platform.LoadFixAddress
                 self.BuildReport.AddPlatformReport(Wa)
@@ -1605,25 +1641,26 @@ class Build():
                             if Inf in Pa.Platform.Modules:
                                 continue
                             ModuleList.append(Inf)
+                    ModuleAutoGenList = []
                     for Module in ModuleList:
                         # Get ModuleAutoGen object to generate C code file and makefile
                         Ma = ModuleAutoGen(Wa, Module, BuildTarget, ToolChain, Arch, self.PlatformFile)
                         
                         if Ma == None:
                             continue
-                        # Not to auto-gen for targets 'clean', 'cleanlib', 'cleanall', 'run', 'fds'
-                        if self.Target not in ['clean', 'cleanlib', 'cleanall', 'run', 'fds']:
-                            # for target which must generate AutoGen code and makefile
-                            if not self.SkipAutoGen or self.Target == 'genc':
-                                Ma.CreateCodeFile(True)
-                            if self.Target == "genc":
-                                continue
-
-                            if not self.SkipAutoGen or self.Target == 'genmake':
-                                Ma.CreateMakeFile(True)
-                            if self.Target == "genmake":
-                                continue
-                        self.BuildModules.append(Ma)
+                        ModuleAutoGenList.append(Ma)
+
+                    # Not to auto-gen for targets 'clean', 'cleanlib', 'cleanall', 'run', 'fds'
+                    if self.Target not in ['clean', 'cleanlib', 'cleanall', 'run', 'fds']:
+                        # for target which must generate AutoGen code and makefile
+                        AutoGenStartTime = time.time()
+                        CreateModuleFiles(ModuleAutoGenList,
+                                          not self.SkipAutoGen or self.Target == 'genc',
+                                          self.Target != 'genc' and (not self.SkipAutoGen or self.Target == 'genmake'))
+                        self.AutoGenTime += time.time() - AutoGenStartTime
+                        if self.Target in ["genc", "genmake"]:
+                            ModuleAutoGenList = []
+                    self.BuildModules.extend(ModuleAutoGenList)
                     self.Progress.Stop("done!")
 
                     for Ma in self.BuildModules:
@@ -1659,7 +1696,9 @@ class Build():
                 # to exit if all tasks are completed
                 #
                 ExitFlag.set()
+                MakeStartTime = time.time()
                 BuildTask.WaitForComplete()
+                self.MakeTime += time.time() - MakeStartTime
                 self.CreateAsBuiltInf()
 
                 #
@@ -1698,7 +1737,9 @@ class Build():
                         #
                         # Generate FD image if there's a FDF file found
                         #
+                        GenFdsStartTime = time.time()
                         LaunchCommand(Wa.GenFdsCommand, os.getcwd())
+                        self.GenFdsTime += time.time() - GenFdsStartTime
 
                         #
                         # Create MAP file for all platform FVs after GenFds.
@@ -1714,6 +1755,7 @@ class Build():
     def CreateGuidedSectionToolsFile(self):
         for BuildTarget in self.BuildTargetList:
             for ToolChain in self.ToolChainList:
+                AutoGenStartTime = time.time()
                 Wa = WorkspaceAutoGen(
                         self.WorkspaceDir,
                         self.PlatformFile,
@@ -1730,6 +1772,7 @@ class Build():
                         self.SkuId,
                         self.UniFlag
                         )
+                self.AutoGenTime += time.time() - AutoGenStartTime
                 FvDir = Wa.FvDir
                 if not os.path.exists(FvDir):
                     continue
@@ -1903,9 +1946,11 @@ def MyOptionParser():
     Parser.add_option("-D", "--define", action="append", type="string", dest="Macros", help="Macro: \"Name [= Value]\".")
 
     Parser.add_option("-y", "--report-file", action="store", dest="ReportFile", help="Create/overwrite the report to the specified filename.")
-    Parser.add_option("-Y", "--report-type", action="append", type="choice", choices=['PCD','LIBRARY','FLASH','DEPEX','BUILD_FLAGS','FIXED_ADDRESS', 'EXECUTION_ORDER'], dest="ReportType", default=[],
-        help="Flags that control the type of build report to generate.  Must be one of: [PCD, LIBRARY, FLASH, DEPEX, BUILD_FLAGS, FIXED_ADDRESS, EXECUTION_ORDER].  "\
+    Parser.add_option("-Y", "--report-type", action="append", type="choice", choices=['PCD','LIBRARY','FLASH','DEPEX','BUILD_FLAGS','FIXED_ADDRESS', 'EXECUTION_ORDER', 'BOOT_COST'], dest="ReportType", default=[],
+        help="Flags that control the type of build report to generate.  Must be one of: [PCD, LIBRARY, FLASH, DEPEX, BUILD_FLAGS, FIXED_ADDRESS, EXECUTION_ORDER, BOOT_COST].  "\
              "To specify more than one flag, repeat this option on the command line and the default flag set is [PCD, LIBRARY, FLASH, DEPEX, BUILD_FLAGS, FIXED_ADDRESS]")
+    Parser.add_option("--boot-log", action="store", type="string", dest="BootLog",
+        help="Boot performance log written by the Dp shell application, from which the BOOT_COST report takes the time of the PEIMs and drivers.")
     Parser.add_option("-F", "--flag", action="store", type="string", dest="Flag",
         help="Specify the specific option to parse EDK UNI file. Must be one of: [-c, -s]. -c is for EDK framework UNI file, and -s is for EDK UEFI UNI file. "\
              "This option can also be specified by setting *_*_*_BUILD_FLAGS in [BuildOptions] section of platform DSC. If they are both specified, this value "\
@@ -1914,10 +1959,24 @@ def MyOptionParser():
     Parser.add_option("--conf", action="store", type="string", dest="ConfDirectory", help="Specify the customized Conf directory.")
     Parser.add_option("--check-usage", action="store_true", dest="CheckUsage", default=False, help="Check usage content of entries listed in INF file.")
     Parser.add_option("--ignore-sources", action="store_true", dest="IgnoreSources", default=False, help="Focus to a binary build and ignore all source files")
+    Parser.add_option("--incremental", action="store_true", dest="Incremental", default=False,
+        help="Skip AutoGen and makefile generation of modules whose meta-data, settings and source files are unchanged since the previous build.")
 
     (Opt, Args)=Parser.parse_args()
     return (Opt, Args)
 
+## Format a duration as HH:MM:SS
+#
+#   @param  Seconds     The duration in seconds
+#
+#   @retval string      The formatted duration
+#
+def FormatDuration(Seconds):
+    Duration = time.gmtime(int(round(Seconds)))
+    if Duration.tm_yday > 1:
+        return time.strftime("%H:%M:%S", Duration) + ", %d day(s)"%(Duration.tm_yday - 1)
+    return time.strftime("%H:%M:%S", Duration)
+
 ## Tool entrance method
 #
 # This method mainly dispatch specific methods per the command line options.
@@ -2088,18 +2147,20 @@ def Main():
     else:
         Conclusion = "Failed"
     FinishTime = time.time()
-    BuildDuration = time.gmtime(int(round(FinishTime - StartTime)))
-    BuildDurationStr = ""
-    if BuildDuration.tm_yday > 1:
-        BuildDurationStr = time.strftime("%H:%M:%S", BuildDuration) + ", %d day(s)"%(BuildDuration.tm_yday - 1)
-    else:
-        BuildDurationStr = time.strftime("%H:%M:%S", BuildDuration)
+    BuildDurationStr = FormatDuration(FinishTime - StartTime)
     if MyBuild != None:
         MyBuild.BuildReport.GenerateReport(BuildDurationStr)
         MyBuild.Db.Close()
     EdkLogger.SetLevel(EdkLogger.QUIET)
     EdkLogger.quiet("\n- %s -" % Conclusion)
     EdkLogger.quiet(time.strftime("Build end time: %H:%M:%S, %b.%d %Y", time.localtime()))
+    if GlobalData.gIncrementalAutoGen:
+        EdkLogger.quiet("Incremental AutoGen: %d of %d modules unchanged and skipped" % (ModuleAutoGen.IncrementalSkippedCount,
+                                                                         ModuleAutoGen.IncrementalCheckedCount))
+    if MyBuild != None:
+        EdkLogger.quiet("AutoGen time: %s, make time: %s, GenFds time: %s" % (FormatDuration(MyBuild.AutoGenTime),
+                                                                            FormatDuration(MyBuild.MakeTime),
+                                                                            FormatDuration(MyBuild.GenFdsTime)))
     EdkLogger.quiet("Build total time: %s\n" % BuildDurationStr)
     return ReturnCode
 
@@ -18,6 +18,7 @@
 import os
 import random
 import sys
+import time
 import unittest
 
 import TestTools
@@ -65,6 +66,46 @@ class Tests(TestTools.BaseToolsTest):
             self.compressionTestCycle(data)
             self.CleanUpTmpDir()
 
+    def testDictionaryBoundaryCycles(self):
+        #
+        # The dictionary is sized to the input, so cover repetitive data of
+        # sizes around the dictionary sizes
+        #
+        for size in (511, 512, 513, 4095, 4096, 4097, 65535, 65536, 65537):
+            pattern = self.GetRandomString(16, 300)
+            data = (pattern * (size / len(pattern) + 1))[:size]
+            self.compressionTestCycle(data)
+            self.CleanUpTmpDir()
+
+    def testFvBenchmark(self):
+        #
+        # Compress the files of a built firmware volume, for example
+        # Build/OvmfX64/DEBUG_GCC49/FV/Ffs, given by TIANO_COMPRESS_BENCHMARK_DIR
+        #
+        fvDir = os.environ.get('TIANO_COMPRESS_BENCHMARK_DIR')
+        if fvDir is None:
+            return
+        inputSize = outputSize = 0
+        seconds = 0.0
+        for root, dirs, files in os.walk(fvDir):
+            for name in files:
+                data = open(os.path.join(root, name), 'rb').read()
+                self.WriteTmpFile('input', data)
+                start = time.time()
+                result = self.RunTool(
+                    '-e',
+                    '-o', self.GetTmpFilePath('output1'),
+                    self.GetTmpFilePath('input')
+                    )
+                seconds += time.time() - start
+                self.assertTrue(result == 0)
+                inputSize += len(data)
+                outputSize += os.path.getsize(self.GetTmpFilePath('output1'))
+                self.compressionTestCycle(data)
+                self.CleanUpTmpDir()
+        print
+        print 'Compressed %d bytes to %d bytes in %.2f seconds' % (inputSize, outputSize, seconds)
+
 TheTestSuite = TestTools.MakeTheTestSuite(locals())
 
 if __name__ == '__main__':
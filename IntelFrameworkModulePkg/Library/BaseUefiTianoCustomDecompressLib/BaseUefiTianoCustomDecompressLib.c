@@ -556,77 +556,63 @@ DecodeC (
 
 /**
   Decode the source data and put the resulting data into the destination buffer.
-  
-  @param  Sd The global scratch data
+
+  Returns when the destination buffer is full, when the source data is corrupted,
+  or when fewer than MAX_CODE_INPUT bytes of the source data before mInAvail are
+  left to decode the next code. In the last case the string being copied is kept
+  in the scratch data, and Decode() continues with it when it is called again.
+
+  @param  Sd The global scratch data.
+
 **/
 VOID
 Decode (
   SCRATCH_DATA  *Sd
   )
 {
-  UINT16  BytesRemain;
-  UINT32  DataIdx;
   UINT16  CharC;
 
-  BytesRemain = (UINT16) (-1);
+  for (;;) {
+    //
+    // Write the rest of the current string into mDstBase
+    //
+    while (Sd->mBytesRemain > 0) {
+      if (Sd->mOutBuf >= Sd->mOrigSize) {
+        return;
+      }
+      Sd->mDstBase[Sd->mOutBuf++] = Sd->mDstBase[Sd->mDataIdx++];
+      Sd->mBytesRemain--;
+    }
+
+    if (Sd->mOutBuf >= Sd->mOrigSize) {
+      return;
+    }
 
-  DataIdx     = 0;
+    if (Sd->mInAvail - Sd->mInBuf < MAX_CODE_INPUT) {
+      return;
+    }
 
-  for (;;) {
     //
     // Get one code from mBitBuf
     // 
     CharC = DecodeC (Sd);
     if (Sd->mBadTableFlag != 0) {
-      goto Done;
+      return;
     }
 
     if (CharC < 256) {
       //
-      // Process an Original character
+      // Write orignal character into mDstBase
       //
-      if (Sd->mOutBuf >= Sd->mOrigSize) {
-        goto Done;
-      } else {
-        //
-        // Write orignal character into mDstBase
-        //
-        Sd->mDstBase[Sd->mOutBuf++] = (UINT8) CharC;
-      }
-
+      Sd->mDstBase[Sd->mOutBuf++] = (UINT8) CharC;
     } else {
       //
-      // Process a Pointer
-      //
-      CharC       = (UINT16) (CharC - (BIT8 - THRESHOLD));
- 
-      //
-      // Get string length
-      //
-      BytesRemain = CharC;
-
-      //
-      // Locate string position
-      //
-      DataIdx     = Sd->mOutBuf - DecodeP (Sd) - 1;
-
+      // Process a Pointer: get the string length and locate the string position
       //
-      // Write BytesRemain of bytes into mDstBase
-      //
-      BytesRemain--;
-      while ((INT16) (BytesRemain) >= 0) {
-        Sd->mDstBase[Sd->mOutBuf++] = Sd->mDstBase[DataIdx++];
-        if (Sd->mOutBuf >= Sd->mOrigSize) {
-          goto Done ;
-        }
-
-        BytesRemain--;
-      }
+      Sd->mBytesRemain = (UINT16) (CharC - (BIT8 - THRESHOLD));
+      Sd->mDataIdx     = Sd->mOutBuf - DecodeP (Sd) - 1;
     }
   }
-
-Done:
-  return ;
 }
 
 /**
@@ -788,6 +774,7 @@ UefiTianoDecompress (
   //
   Sd->mCompSize = CompSize;
   Sd->mOrigSize = OrigSize;
+  Sd->mInAvail  = MAX_UINT32;
 
   //
   // Fill the first BITBUFSIZ bits
@@ -849,6 +836,228 @@ UefiDecompress (
   return UefiTianoDecompress (Source, Destination, Scratch, 1);
 }
 
+/**
+  Given the beginning of a compressed source buffer, this function retrieves the
+  size of the uncompressed buffer and the size of the scratch buffer required
+  to decompress it incrementally with UefiDecompressStreamDecode().
+
+  Only the 8-byte header of the compressed data needs to be available, so the
+  rest of the compressed data may still be on its way from the storage device.
+
+  If Source is NULL, then ASSERT().
+  If DestinationSize is NULL, then ASSERT().
+  If ScratchSize is NULL, then ASSERT().
+
+  @param  Source          The source buffer containing the beginning of the compressed data.
+  @param  SourceSize      The size, in bytes, of the source buffer.
+  @param  DestinationSize A pointer to the size, in bytes, of the uncompressed buffer.
+  @param  ScratchSize     A pointer to the size, in bytes, of the scratch buffer that
+                          is required by UefiDecompressStreamDecode().
+
+  @retval  RETURN_SUCCESS The sizes were returned in DestinationSize and ScratchSize.
+  @retval  RETURN_INVALID_PARAMETER
+                          SourceSize is smaller than the header of the compressed data.
+**/
+RETURN_STATUS
+EFIAPI
+UefiDecompressStreamGetInfo (
+  IN  CONST VOID  *Source,
+  IN  UINT32      SourceSize,
+  OUT UINT32      *DestinationSize,
+  OUT UINT32      *ScratchSize
+  )
+{
+  ASSERT (Source != NULL);
+  ASSERT (DestinationSize != NULL);
+  ASSERT (ScratchSize != NULL);
+
+  if (SourceSize < 8) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  *ScratchSize     = sizeof (STREAM_DATA);
+  *DestinationSize = ReadUnaligned32 ((UINT32 *)Source + 1);
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Prepares a scratch buffer for the incremental decompression of a compressed
+  source buffer into Destination.
+
+  The caller allocates Destination with the size returned by
+  UefiDecompressStreamGetInfo(), and then passes the compressed data to
+  UefiDecompressStreamDecode() in chunks of any size as it becomes available.
+
+  If Destination is NULL, then ASSERT().
+  If Scratch is NULL, then ASSERT().
+
+  @param  Destination The destination buffer to store the decompressed data.
+  @param  Scratch     The scratch buffer of the size returned by UefiDecompressStreamGetInfo().
+**/
+VOID
+EFIAPI
+UefiDecompressStreamInit (
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  )
+{
+  STREAM_DATA  *Stream;
+
+  ASSERT (Destination != NULL);
+  ASSERT (Scratch != NULL);
+
+  Stream = (STREAM_DATA *) Scratch;
+
+  //
+  // The staging buffer is written before it is read, so leave it alone
+  //
+  SetMem (Stream, OFFSET_OF (STREAM_DATA, mStage), 0);
+
+  Stream->Sd.mPBit    = 4;
+  Stream->Sd.mSrcBase = Stream->mStage;
+  Stream->Sd.mDstBase = Destination;
+}
+
+/**
+  Decompresses the next chunk of a compressed source buffer.
+
+  Consumes as much of the chunk specified by Source and SourceSize as the
+  decompressor can hold, and decompresses everything that can be decompressed
+  without more input. The decompressed data is written to the Destination
+  that was passed to UefiDecompressStreamInit(), so Destination[0] up to
+  Destination[*DestinationSize - 1] may be used by the caller as soon as this
+  function returns. If not all of the chunk was consumed, the caller passes the
+  rest of it again in the next call.
+
+  If Scratch is NULL, then ASSERT().
+  If SourceSize is NULL, then ASSERT().
+  If Source is NULL and *SourceSize is not 0, then ASSERT().
+  If DestinationSize is NULL, then ASSERT().
+
+  @param  Scratch         The scratch buffer prepared by UefiDecompressStreamInit().
+  @param  Source          The next chunk of the compressed data.
+  @param  SourceSize      On input, the size, in bytes, of the chunk.
+                          On output, the number of bytes of the chunk that were consumed.
+  @param  DestinationSize A pointer to the number of bytes decompressed so far.
+
+  @retval  RETURN_SUCCESS All of the data was decompressed into Destination.
+  @retval  RETURN_NOT_READY
+                          More compressed data is needed to continue.
+  @retval  RETURN_INVALID_PARAMETER
+                          The compressed data is corrupted.
+**/
+RETURN_STATUS
+EFIAPI
+UefiDecompressStreamDecode (
+  IN OUT VOID        *Scratch,
+  IN     CONST VOID  *Source,
+  IN OUT UINT32      *SourceSize,
+  OUT    UINT32      *DestinationSize
+  )
+{
+  STREAM_DATA      *Stream;
+  SCRATCH_DATA     *Sd;
+  CONST UINT8      *Src;
+  UINT32           SrcLeft;
+  UINT32           Length;
+  UINT32           Total;
+  RETURN_STATUS    Status;
+
+  ASSERT (Scratch != NULL);
+  ASSERT (SourceSize != NULL);
+  ASSERT (Source != NULL || *SourceSize == 0);
+  ASSERT (DestinationSize != NULL);
+
+  Stream  = (STREAM_DATA *) Scratch;
+  Sd      = &Stream->Sd;
+  Src     = Source;
+  SrcLeft = *SourceSize;
+  Status  = RETURN_NOT_READY;
+
+  for (;;) {
+    //
+    // Move the bytes that were not consumed yet to the beginning of the staging
+    // buffer, and top it up from the chunk, but not past the end of the
+    // compressed data. FillBuf() has not read the mCompSize bytes that are
+    // left of it yet.
+    //
+    Length = Stream->mStageLength - Sd->mInBuf;
+    CopyMem (Stream->mStage, Stream->mStage + Sd->mInBuf, Length);
+    Stream->mStageLength = Length;
+    Sd->mInBuf           = 0;
+
+    if (Stream->mHeaderDone) {
+      Total = Sd->mCompSize;
+    } else {
+      Total = 8;
+    }
+    Length = MIN (SrcLeft, STAGE_SIZE - Stream->mStageLength);
+    Length = MIN (Length, Total - Stream->mStageLength);
+    CopyMem (Stream->mStage + Stream->mStageLength, Src, Length);
+    Src                  += Length;
+    SrcLeft              -= Length;
+    Stream->mStageLength += Length;
+
+    if (!Stream->mHeaderDone) {
+      if (Stream->mStageLength < 8) {
+        break;
+      }
+
+      //
+      // CompSize and OrigSize are calculated in bytes
+      //
+      Sd->mCompSize       = ReadUnaligned32 ((UINT32 *) Stream->mStage);
+      Sd->mOrigSize       = ReadUnaligned32 ((UINT32 *) Stream->mStage + 1);
+      Sd->mInBuf          = 8;
+      Stream->mHeaderDone = TRUE;
+      if (Sd->mOrigSize == 0) {
+        Status = RETURN_SUCCESS;
+        break;
+      }
+      continue;
+    }
+
+    if (Stream->mStageLength == Sd->mCompSize) {
+      //
+      // All of the remaining compressed data is staged
+      //
+      Sd->mInAvail = MAX_UINT32;
+    } else if (Stream->mStageLength < MAX_CODE_INPUT) {
+      if (SrcLeft == 0) {
+        break;
+      }
+      continue;
+    } else {
+      Sd->mInAvail = Stream->mStageLength;
+    }
+
+    if (!Stream->mStarted) {
+      //
+      // Fill the first BITBUFSIZ bits
+      //
+      FillBuf (Sd, BITBUFSIZ);
+      Stream->mStarted = TRUE;
+    }
+
+    Decode (Sd);
+
+    if (Sd->mBadTableFlag != 0) {
+      Status = RETURN_INVALID_PARAMETER;
+      break;
+    }
+    if (Sd->mOutBuf >= Sd->mOrigSize) {
+      Status = RETURN_SUCCESS;
+      break;
+    }
+  }
+
+  *SourceSize      -= SrcLeft;
+  *DestinationSize  = Sd->mOutBuf;
+
+  return Status;
+}
+
 /**
   Examines a GUIDed section and returns the size of the decoded buffer and the
   size of an optional scratch buffer required to actually decode the data in a GUIDed section.
@@ -48,6 +48,15 @@
 #define NPT MAXNP
 #endif
 
+//
+// The most compressed bytes that decoding one code can consume, including a
+// block header with all of its code length arrays and the bits that FillBuf()
+// reads ahead. The incremental decompressor only starts a new code when this
+// many bytes are staged.
+//
+#define MAX_CODE_INPUT  0x800
+#define STAGE_SIZE      (4 * MAX_CODE_INPUT)
+
 typedef struct {
   UINT8   *mSrcBase;  // Starting address of compressed data
   UINT8   *mDstBase;  // Starting address of decompressed data
@@ -76,8 +85,33 @@ typedef struct {
   /// For Tiano de/compression algorithm, mPBit = 5
   ///
   UINT8   mPBit;
+
+  ///
+  /// The string that was being copied when Decode() returned.
+  ///
+  UINT16  mBytesRemain;
+  UINT32  mDataIdx;
+
+  ///
+  /// The number of bytes at mSrcBase that may be read. MAX_UINT32 when all of
+  /// the compressed data is available.
+  ///
+  UINT32  mInAvail;
 } SCRATCH_DATA;
 
+///
+/// The scratch data of the incremental decompressor. The compressed data is
+/// staged in mStage, which is refilled from the caller's chunks as Decode()
+/// consumes it.
+///
+typedef struct {
+  SCRATCH_DATA  Sd;
+  UINT32        mStageLength;  // The number of bytes in mStage
+  BOOLEAN       mHeaderDone;
+  BOOLEAN       mStarted;
+  UINT8         mStage[STAGE_SIZE];
+} STREAM_DATA;
+
 /**
   Read NumOfBit of bits from source into mBitBuf.
 
@@ -92,5 +92,54 @@ LzmaUefiDecompress (
   IN OUT VOID    *Scratch
   );
 
+/**
+  Prepares a scratch buffer for the incremental decompression of a Lzma
+  compressed source buffer into Destination.
+
+  The caller allocates Destination and Scratch with the sizes returned by
+  LzmaUefiDecompressGetInfo(), for which only the LZMA_HEADER_SIZE beginning
+  bytes of the source data are needed, and then passes the compressed data to
+  LzmaUefiDecompressStreamDecode() in chunks of any size.
+
+  @param  Destination The destination buffer to store the decompressed data.
+  @param  Scratch     The scratch buffer.
+**/
+VOID
+EFIAPI
+LzmaUefiDecompressStreamInit (
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
+/**
+  Decompresses the next chunk of a Lzma compressed source buffer.
+
+  Consumes the chunk specified by Source and SourceSize and decompresses
+  everything that can be decompressed without more input. The decompressed data
+  is written to the Destination that was passed to LzmaUefiDecompressStreamInit(),
+  so Destination[0] up to Destination[*DestinationSize - 1] may be used by the
+  caller as soon as this function returns.
+
+  @param  Scratch         The scratch buffer prepared by LzmaUefiDecompressStreamInit().
+  @param  Source          The next chunk of the compressed data.
+  @param  SourceSize      On input, the size, in bytes, of the chunk.
+                          On output, the number of bytes of the chunk that were consumed.
+  @param  DestinationSize A pointer to the number of bytes decompressed so far.
+
+  @retval  RETURN_SUCCESS All of the data was decompressed into Destination.
+  @retval  RETURN_NOT_READY
+                          More compressed data is needed to continue.
+  @retval  RETURN_INVALID_PARAMETER
+                          The compressed data is corrupted.
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamDecode (
+  IN OUT VOID        *Scratch,
+  IN     CONST VOID  *Source,
+  IN OUT UINTN       *SourceSize,
+  OUT    UINTN       *DestinationSize
+  );
+
 #endif
 
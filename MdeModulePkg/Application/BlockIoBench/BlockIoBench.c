@@ -0,0 +1,329 @@
+/** @file
+  Shell application measuring the read throughput of the block devices, with
+  blocking BlockIo reads and with nonblocking BlockIo2 reads kept in flight.
+
+  Copyright (c) 2016, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/TimerLib.h>
+
+#include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
+
+//
+// Amount of data read from each device, and the size of the reads.
+//
+#define BENCH_MAX_SIZE              SIZE_64MB
+#define BENCH_BLOCKIO_READ_SIZE     SIZE_1MB
+#define BENCH_BLOCKIO2_READ_SIZE    SIZE_128KB
+
+//
+// Number of BlockIo2 reads kept in flight.
+//
+#define BENCH_BLOCKIO2_QUEUE_DEPTH  32
+
+/**
+  Get the time between two values of the performance counter.
+
+  @param  Start    The value of the performance counter at the start.
+  @param  End      The value of the performance counter at the end.
+
+  @return The elapsed time in nanoseconds.
+
+**/
+UINT64
+GetElapsedTime (
+  IN UINT64                   Start,
+  IN UINT64                   End
+  )
+{
+  UINT64                      CounterStart;
+  UINT64                      CounterEnd;
+
+  GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+  if (CounterStart < CounterEnd) {
+    return GetTimeInNanoSecond (End - Start);
+  }
+  return GetTimeInNanoSecond (Start - End);
+}
+
+/**
+  Print the throughput of a transfer.
+
+  @param  Name     The name of the protocol used.
+  @param  Size     The number of bytes transferred, which is a multiple of 1MB.
+  @param  Time     The duration of the transfer in nanoseconds.
+
+**/
+VOID
+PrintThroughput (
+  IN CHAR16                   *Name,
+  IN UINTN                    Size,
+  IN UINT64                   Time
+  )
+{
+  UINT64                      Milliseconds;
+
+  Milliseconds = DivU64x32 (Time, 1000000);
+  if (Milliseconds == 0) {
+    Print (L"  %-8s %4d MB in %ld ns, n/a\n", Name, Size / SIZE_1MB, Time);
+    return;
+  }
+
+  Print (
+    L"  %-8s %4d MB in %ld ms, %ld MB/s\n",
+    Name,
+    Size / SIZE_1MB,
+    Milliseconds,
+    DivU64x64Remainder (MultU64x32 (Size / SIZE_1MB, 1000), Milliseconds, NULL)
+    );
+}
+
+/**
+  Read a device with blocking reads of BENCH_BLOCKIO_READ_SIZE bytes.
+
+  @param  BlockIo  The BlockIo protocol of the device.
+  @param  Buffer   The buffer receiving the data.
+  @param  Size     The number of bytes to read from the start of the device.
+  @param  Time     Returns the duration of the reads in nanoseconds.
+
+  @retval EFI_SUCCESS  The data was read.
+  @retval Others       A read failed.
+
+**/
+EFI_STATUS
+BenchBlockIo (
+  IN  EFI_BLOCK_IO_PROTOCOL   *BlockIo,
+  IN  VOID                    *Buffer,
+  IN  UINTN                   Size,
+  OUT UINT64                  *Time
+  )
+{
+  EFI_STATUS                  Status;
+  UINTN                       Offset;
+  UINT64                      Start;
+
+  Status = EFI_SUCCESS;
+  Start  = GetPerformanceCounter ();
+  for (Offset = 0; Offset < Size; Offset += BENCH_BLOCKIO_READ_SIZE) {
+    Status = BlockIo->ReadBlocks (
+                        BlockIo,
+                        BlockIo->Media->MediaId,
+                        DivU64x32 (Offset, BlockIo->Media->BlockSize),
+                        BENCH_BLOCKIO_READ_SIZE,
+                        (UINT8 *) Buffer + Offset
+                        );
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+  *Time = GetElapsedTime (Start, GetPerformanceCounter ());
+
+  return Status;
+}
+
+/**
+  Read a device with nonblocking reads of BENCH_BLOCKIO2_READ_SIZE bytes, keeping
+  BENCH_BLOCKIO2_QUEUE_DEPTH of them in flight.
+
+  @param  BlockIo2 The BlockIo2 protocol of the device.
+  @param  Buffer   The buffer receiving the data.
+  @param  Size     The number of bytes to read from the start of the device.
+  @param  Time     Returns the duration of the reads in nanoseconds.
+
+  @retval EFI_SUCCESS  The data was read.
+  @retval Others       A read failed.
+
+**/
+EFI_STATUS
+BenchBlockIo2 (
+  IN  EFI_BLOCK_IO2_PROTOCOL  *BlockIo2,
+  IN  VOID                    *Buffer,
+  IN  UINTN                   Size,
+  OUT UINT64                  *Time
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_BLOCK_IO2_TOKEN         Token[BENCH_BLOCKIO2_QUEUE_DEPTH];
+  BOOLEAN                     InFlight[BENCH_BLOCKIO2_QUEUE_DEPTH];
+  UINTN                       Index;
+  UINTN                       Offset;
+  UINTN                       Pending;
+  UINT64                      Start;
+
+  ZeroMem (Token, sizeof (Token));
+  ZeroMem (InFlight, sizeof (InFlight));
+  for (Index = 0; Index < BENCH_BLOCKIO2_QUEUE_DEPTH; Index++) {
+    Status = gBS->CreateEvent (0, TPL_NOTIFY, NULL, NULL, &Token[Index].Event);
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+  }
+
+  Status  = EFI_SUCCESS;
+  Offset  = 0;
+  Pending = 0;
+  Start   = GetPerformanceCounter ();
+  do {
+    for (Index = 0; Index < BENCH_BLOCKIO2_QUEUE_DEPTH; Index++) {
+      if (InFlight[Index]) {
+        if (EFI_ERROR (gBS->CheckEvent (Token[Index].Event))) {
+          continue;
+        }
+        InFlight[Index] = FALSE;
+        Pending--;
+        if (EFI_ERROR (Token[Index].TransactionStatus)) {
+          Status = Token[Index].TransactionStatus;
+        }
+      }
+
+      if ((Offset < Size) && !EFI_ERROR (Status)) {
+        Status = BlockIo2->ReadBlocksEx (
+                             BlockIo2,
+                             BlockIo2->Media->MediaId,
+                             DivU64x32 (Offset, BlockIo2->Media->BlockSize),
+                             &Token[Index],
+                             BENCH_BLOCKIO2_READ_SIZE,
+                             (UINT8 *) Buffer + Offset
+                             );
+        if (!EFI_ERROR (Status)) {
+          InFlight[Index] = TRUE;
+          Pending++;
+          Offset += BENCH_BLOCKIO2_READ_SIZE;
+        }
+      }
+    }
+  } while (Pending > 0);
+  *Time = GetElapsedTime (Start, GetPerformanceCounter ());
+
+Exit:
+  for (Index = 0; Index < BENCH_BLOCKIO2_QUEUE_DEPTH; Index++) {
+    if (Token[Index].Event != NULL) {
+      gBS->CloseEvent (Token[Index].Event);
+    }
+  }
+
+  return Status;
+}
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the application.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The entry point is executed successfully.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE               ImageHandle,
+  IN EFI_SYSTEM_TABLE         *SystemTable
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_HANDLE                  *HandleBuffer;
+  UINTN                       HandleCount;
+  UINTN                       Index;
+  EFI_BLOCK_IO_PROTOCOL       *BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL      *BlockIo2;
+  EFI_BLOCK_IO_MEDIA          *Media;
+  CHAR16                      *DevicePathText;
+  UINT64                      DeviceSize;
+  UINTN                       Size;
+  UINTN                       Pages;
+  VOID                        *Buffer;
+  UINT64                      Time;
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiBlockIoProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &HandleBuffer
+                  );
+  if (EFI_ERROR (Status)) {
+    Print (L"BlockIoBench: no block device found\n");
+    return Status;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (HandleBuffer[Index], &gEfiBlockIoProtocolGuid, (VOID **) &BlockIo);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    //
+    // Partitions read the same blocks as their whole disk.
+    //
+    Media = BlockIo->Media;
+    if (!Media->MediaPresent || Media->LogicalPartition) {
+      continue;
+    }
+
+    //
+    // Read whole megabytes, at most BENCH_MAX_SIZE bytes.
+    //
+    DeviceSize = MultU64x32 (Media->LastBlock + 1, Media->BlockSize);
+    Size       = (UINTN) MIN (DeviceSize, BENCH_MAX_SIZE) & ~(SIZE_1MB - 1);
+    if ((Size == 0) || ((SIZE_128KB % Media->BlockSize) != 0)) {
+      continue;
+    }
+
+    DevicePathText = ConvertDevicePathToText (DevicePathFromHandle (HandleBuffer[Index]), TRUE, TRUE);
+    Print (L"%s\n", (DevicePathText != NULL) ? DevicePathText : L"<unknown device>");
+    if (DevicePathText != NULL) {
+      FreePool (DevicePathText);
+    }
+
+    Pages  = EFI_SIZE_TO_PAGES (Size);
+    Buffer = AllocateAlignedPages (Pages, MAX (Media->IoAlign, EFI_PAGE_SIZE));
+    if (Buffer == NULL) {
+      Print (L"  Out of memory\n");
+      continue;
+    }
+
+    Status = BenchBlockIo (BlockIo, Buffer, Size, &Time);
+    if (EFI_ERROR (Status)) {
+      Print (L"  BlockIo  read failed - %r\n", Status);
+    } else {
+      PrintThroughput (L"BlockIo", Size, Time);
+    }
+
+    Status = gBS->HandleProtocol (HandleBuffer[Index], &gEfiBlockIo2ProtocolGuid, (VOID **) &BlockIo2);
+    if (EFI_ERROR (Status)) {
+      Print (L"  BlockIo2 not supported\n");
+    } else {
+      Status = BenchBlockIo2 (BlockIo2, Buffer, Size, &Time);
+      if (EFI_ERROR (Status)) {
+        Print (L"  BlockIo2 read failed - %r\n", Status);
+      } else {
+        PrintThroughput (L"BlockIo2", Size, Time);
+      }
+    }
+
+    FreeAlignedPages (Buffer, Pages);
+  }
+
+  FreePool (HandleBuffer);
+  return EFI_SUCCESS;
+}
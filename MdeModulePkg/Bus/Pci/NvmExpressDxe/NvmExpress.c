@@ -148,6 +148,15 @@ EnumerateNvmeDevNamespace (
     Device->BlockIo.WriteBlocks  = NvmeBlockIoWriteBlocks;
     Device->BlockIo.FlushBlocks  = NvmeBlockIoFlushBlocks;
 
+    //
+    // Create BlockIo2 Protocol instance
+    //
+    Device->BlockIo2.Media          = &Device->Media;
+    Device->BlockIo2.Reset          = NvmeBlockIoResetEx;
+    Device->BlockIo2.ReadBlocksEx   = NvmeBlockIoReadBlocksEx;
+    Device->BlockIo2.WriteBlocksEx  = NvmeBlockIoWriteBlocksEx;
+    Device->BlockIo2.FlushBlocksEx  = NvmeBlockIoFlushBlocksEx;
+
     //
     // Create DiskInfo Protocol instance
     //
@@ -198,6 +207,8 @@ EnumerateNvmeDevNamespace (
                     Device->DevicePath,
                     &gEfiBlockIoProtocolGuid,
                     &Device->BlockIo,
+                    &gEfiBlockIo2ProtocolGuid,
+                    &Device->BlockIo2,
                     &gEfiDiskInfoProtocolGuid,
                     &Device->DiskInfo,
                     NULL
@@ -355,6 +366,11 @@ UnregisterNvmeNamespace (
 
   Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO (BlockIo);
 
+  //
+  // Finish the nonblocking I/O of the namespace before its resources go away.
+  //
+  NvmeWaitAsyncIo (Device->Controller, NULL, NVME_GENERIC_TIMEOUT);
+
   //
   // Close the child handle
   //
@@ -366,8 +382,8 @@ UnregisterNvmeNamespace (
          );
 
   //
-  // The Nvm Express driver installs the BlockIo and DiskInfo in the DriverBindingStart().
-  // Here should uninstall both of them.
+  // The Nvm Express driver installs the BlockIo, BlockIo2 and DiskInfo in the DriverBindingStart().
+  // Here should uninstall all of them.
   //
   Status = gBS->UninstallMultipleProtocolInterfaces (
                   Handle,
@@ -375,6 +391,8 @@ UnregisterNvmeNamespace (
                   Device->DevicePath,
                   &gEfiBlockIoProtocolGuid,
                   &Device->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid,
+                  &Device->BlockIo2,
                   &gEfiDiskInfoProtocolGuid,
                   &Device->DiskInfo,
                   NULL
@@ -405,6 +423,315 @@ UnregisterNvmeNamespace (
   return EFI_SUCCESS;
 }
 
+/**
+  Release the resources of a nonblocking command and signal its caller.
+
+  @param[in]  Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  AsyncRequest   The nonblocking command, which is removed from
+                             the AsyncPassThruQueue and freed.
+
+**/
+VOID
+NvmeCompleteAsyncRequest (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN NVME_PASS_THRU_ASYNC_REQ           *AsyncRequest
+  )
+{
+  EFI_PCI_IO_PROTOCOL                   *PciIo;
+
+  PciIo = Private->PciIo;
+
+  if (AsyncRequest->MapData != NULL) {
+    PciIo->Unmap (PciIo, AsyncRequest->MapData);
+  }
+
+  if (AsyncRequest->MapMeta != NULL) {
+    PciIo->Unmap (PciIo, AsyncRequest->MapMeta);
+  }
+
+  if (AsyncRequest->MapPrpList != NULL) {
+    PciIo->Unmap (PciIo, AsyncRequest->MapPrpList);
+  }
+
+  if (AsyncRequest->PrpListHost != NULL) {
+    PciIo->FreeBuffer (PciIo, AsyncRequest->PrpListNo, AsyncRequest->PrpListHost);
+  }
+
+  RemoveEntryList (&AsyncRequest->Link);
+  gBS->SignalEvent (AsyncRequest->CallerEvent);
+  FreePool (AsyncRequest);
+}
+
+/**
+  Abort all the nonblocking I/O of the controller.
+
+  The controller is reset first, so it no longer accesses the buffers of the
+  commands in flight. Then these commands are completed with a timeout status,
+  and the BlockIo2 subtasks not submitted yet fail with EFI_DEVICE_ERROR.
+
+  It is called at TPL_NOTIFY.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeAbortAsyncIo (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  EFI_STATUS                            Status;
+  UINT64                                PciAttributes;
+  NVME_ADMIN_CONTROLLER_DATA            *ControllerData;
+  LIST_ENTRY                            *Link;
+  NVME_PASS_THRU_ASYNC_REQ              *AsyncRequest;
+  NVME_BLKIO2_SUBTASK                   *Subtask;
+
+  //
+  // Disabling the controller deletes all its I/O queues and stops the commands
+  // in them. NvmeControllerInit() then brings it back with empty queues. It
+  // saves the PCI attributes and reads the Identify Controller data again, so
+  // keep the attributes to restore on Stop(), and keep the old data if the
+  // new one can't be read.
+  //
+  PciAttributes           = Private->PciAttributes;
+  ControllerData          = Private->ControllerData;
+  Private->ControllerData = NULL;
+  Status = NvmeControllerInit (Private);
+  Private->PciAttributes  = PciAttributes;
+  if (Private->ControllerData == NULL) {
+    Private->ControllerData = ControllerData;
+  } else {
+    FreePool (ControllerData);
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "NvmeAbortAsyncIo: resetting the controller failed - %r\n", Status));
+  }
+
+  while (!IsListEmpty (&Private->AsyncPassThruQueue)) {
+    AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (GetFirstNode (&Private->AsyncPassThruQueue));
+    AsyncRequest->Packet->ControllerStatus = NVM_EXPRESS_STATUS_CONTROLLER_TIMEOUT_COMMAND;
+    NvmeCompleteAsyncRequest (Private, AsyncRequest);
+  }
+
+  while (!IsListEmpty (&Private->UnsubmittedSubtasks)) {
+    Link    = GetFirstNode (&Private->UnsubmittedSubtasks);
+    Subtask = NVME_BLKIO2_SUBTASK_FROM_LINK (Link);
+    RemoveEntryList (Link);
+    NvmeCompleteBlockIo2Subtask (Subtask, EFI_DEVICE_ERROR);
+  }
+}
+
+/**
+  Complete the nonblocking commands the controller has finished, and submit the
+  BlockIo2 subtasks waiting for a free entry of the nonblocking I/O queue.
+
+  It is called periodically at TPL_NOTIFY, and by the blocking services that
+  wait for nonblocking I/O, at TPL_NOTIFY too. When called by the timer, it
+  also counts down the timeouts of the commands in flight, and aborts all the
+  nonblocking I/O with NvmeAbortAsyncIo() once one of them has timed out.
+
+  @param[in]  Event     The timer event, or NULL.
+  @param[in]  Context   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT                    Event,
+  IN VOID                         *Context
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA         *Private;
+  EFI_PCI_IO_PROTOCOL                  *PciIo;
+  NVME_CQ                              *Cq;
+  UINT16                               QueueId;
+  UINT32                               Data;
+  LIST_ENTRY                           *Link;
+  NVME_PASS_THRU_ASYNC_REQ             *AsyncRequest;
+  NVME_BLKIO2_SUBTASK                  *Subtask;
+  EFI_BLOCK_IO2_TOKEN                  *Token;
+  BOOLEAN                              HasNewItem;
+  BOOLEAN                              TimedOut;
+  EFI_STATUS                           Status;
+
+  Private    = (NVME_CONTROLLER_PRIVATE_DATA *)Context;
+  PciIo      = Private->PciIo;
+  QueueId    = NVME_ASYNC_IO_QUEUE;
+  HasNewItem = FALSE;
+  TimedOut   = FALSE;
+
+  //
+  // Complete the commands the controller has finished.
+  //
+  Cq = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+  while (Cq->Pt != Private->Pt[QueueId]) {
+    HasNewItem = TRUE;
+
+    for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
+         !IsNull (&Private->AsyncPassThruQueue, Link);
+         Link = GetNextNode (&Private->AsyncPassThruQueue, Link)) {
+      AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+      if (AsyncRequest->CommandId == Cq->Cid) {
+        CopyMem (AsyncRequest->Packet->NvmeResponse, Cq, sizeof (NVM_EXPRESS_RESPONSE));
+        AsyncRequest->Packet->ControllerStatus = NVM_EXPRESS_STATUS_CONTROLLER_READY;
+        NvmeCompleteAsyncRequest (Private, AsyncRequest);
+        break;
+      }
+    }
+
+    Private->AsyncSqHead = Cq->Sqhd;
+    if (++Private->CqHdbl[QueueId].Cqh == Private->AsyncQueueSize) {
+      Private->CqHdbl[QueueId].Cqh = 0;
+      Private->Pt[QueueId] ^= 1;
+    }
+    Cq = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+  }
+
+  if (HasNewItem) {
+    Data = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[QueueId]);
+    PciIo->Mem.Write (
+                 PciIo,
+                 EfiPciIoWidthUint32,
+                 NVME_BAR,
+                 NVME_CQHDBL_OFFSET(QueueId, Private->Cap.Dstrd),
+                 1,
+                 &Data
+                 );
+  }
+
+  //
+  // Count down the timeouts of the commands still in flight.
+  //
+  if (Event != NULL) {
+    for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
+         !IsNull (&Private->AsyncPassThruQueue, Link);
+         Link = GetNextNode (&Private->AsyncPassThruQueue, Link)) {
+      AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+      if (AsyncRequest->Timeout == 0) {
+        continue;
+      }
+      if (AsyncRequest->Timeout > NVME_HC_ASYNC_TIMER) {
+        AsyncRequest->Timeout -= NVME_HC_ASYNC_TIMER;
+      } else {
+        //
+        // Keep a nonzero timeout, so the command stays timed out if the
+        // reset has to wait for the next tick.
+        //
+        AsyncRequest->Timeout = 1;
+        TimedOut = TRUE;
+      }
+    }
+
+    //
+    // The reset would break a blocking command in flight, which this timer may
+    // have interrupted, so try again on the next tick then.
+    //
+    if (TimedOut && (Private->BlockingCommands == 0)) {
+      DEBUG ((EFI_D_ERROR, "ProcessAsyncTaskList: a nonblocking command timed out\n"));
+      NvmeAbortAsyncIo (Private);
+      return;
+    }
+  }
+
+  //
+  // Submit the waiting BlockIo2 subtasks while the queue has free entries.
+  //
+  while (!IsListEmpty (&Private->UnsubmittedSubtasks)) {
+    Link    = GetFirstNode (&Private->UnsubmittedSubtasks);
+    Subtask = NVME_BLKIO2_SUBTASK_FROM_LINK (Link);
+    Token   = Subtask->BlockIo2Request->Token;
+
+    if (EFI_ERROR (Token->TransactionStatus)) {
+      //
+      // Another subtask of the request failed, so don't submit this one.
+      //
+      RemoveEntryList (Link);
+      NvmeCompleteBlockIo2Subtask (Subtask, Token->TransactionStatus);
+      continue;
+    }
+
+    Status = Private->Passthru.PassThru (
+                                 &Private->Passthru,
+                                 Subtask->NamespaceId,
+                                 0,
+                                 &Subtask->CommandPacket,
+                                 Subtask->Event
+                                 );
+    if (Status == EFI_NOT_READY) {
+      break;
+    }
+
+    RemoveEntryList (Link);
+    if (EFI_ERROR (Status)) {
+      NvmeCompleteBlockIo2Subtask (Subtask, EFI_DEVICE_ERROR);
+    }
+  }
+}
+
+/**
+  Process the nonblocking I/O queue until Event is signaled, or until all the
+  nonblocking I/O of the controller is done if Event is NULL.
+
+  The nonblocking commands still pending after Timeout are aborted by
+  NvmeAbortAsyncIo(), so the wait ends even if the controller stops responding.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  Event     The event to wait for, of a type CheckEvent() accepts, or NULL.
+  @param[in]  Timeout   The time to wait for progress before aborting the pending
+                        commands, in 100ns units.
+
+**/
+VOID
+NvmeWaitAsyncIo (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN EFI_EVENT                          Event    OPTIONAL,
+  IN UINT64                             Timeout
+  )
+{
+  EFI_TPL                               OldTpl;
+  UINT64                                Delay;
+  UINT16                                Cqh;
+  UINT8                                 Pt;
+  BOOLEAN                               Done;
+
+  Delay = 0;
+  while (TRUE) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+    Cqh = Private->CqHdbl[NVME_ASYNC_IO_QUEUE].Cqh;
+    Pt  = Private->Pt[NVME_ASYNC_IO_QUEUE];
+    ProcessAsyncTaskList (NULL, Private);
+    if ((Cqh != Private->CqHdbl[NVME_ASYNC_IO_QUEUE].Cqh) || (Pt != Private->Pt[NVME_ASYNC_IO_QUEUE])) {
+      Delay = 0;
+    }
+
+    Done = (BOOLEAN)(IsListEmpty (&Private->AsyncPassThruQueue) &&
+                     IsListEmpty (&Private->UnsubmittedSubtasks));
+
+    if (!Done && (Delay >= Timeout)) {
+      DEBUG ((EFI_D_ERROR, "NvmeWaitAsyncIo: the nonblocking I/O timed out\n"));
+      NvmeAbortAsyncIo (Private);
+      Delay = 0;
+    }
+
+    //
+    // Restoring the TPL runs the notification functions of the completed requests.
+    //
+    gBS->RestoreTPL (OldTpl);
+
+    if (Event != NULL) {
+      Done = (BOOLEAN)!EFI_ERROR (gBS->CheckEvent (Event));
+    }
+
+    if (Done) {
+      break;
+    }
+
+    gBS->Stall (10);
+    Delay += 100;
+  }
+}
+
 /**
   Tests to see if this driver supports a given controller. If a child device is provided,
   it further tests to see if this driver supports creating a handle for the specified child device.
@@ -661,19 +988,23 @@ NvmExpressDriverBindingStart (
     }
 
     //
-    // 4 x 4kB aligned buffers will be carved out of this buffer.
+    // BufferPages x 4kB aligned buffers will be carved out of this buffer.
     // 1st 4kB boundary is the start of the admin submission queue.
     // 2nd 4kB boundary is the start of the admin completion queue.
     // 3rd 4kB boundary is the start of I/O submission queue #1.
     // 4th 4kB boundary is the start of I/O completion queue #1.
+    // 5th 4kB boundary is the start of I/O submission queue #2, followed by
+    // I/O completion queue #2, both with AsyncQueueSize entries.
     //
-    // Allocate 4 pages of memory, then map it for bus master read and write.
+    // Allocate BufferPages pages of memory, then map it for bus master read and write.
     //
+    Private->AsyncQueueSize = MAX (PcdGet16 (PcdNvmeIoQueueDepth), 2);
+    Private->BufferPages    = 4 + NVME_SQ_PAGES (Private->AsyncQueueSize) + NVME_CQ_PAGES (Private->AsyncQueueSize);
     Status = PciIo->AllocateBuffer (
                       PciIo,
                       AllocateAnyPages,
                       EfiBootServicesData,
-                      4,
+                      Private->BufferPages,
                       (VOID**)&Private->Buffer,
                       0
                       );
@@ -681,7 +1012,7 @@ NvmExpressDriverBindingStart (
       goto Exit2;
     }
 
-    Bytes = EFI_PAGES_TO_SIZE (4);
+    Bytes = EFI_PAGES_TO_SIZE (Private->BufferPages);
     Status = PciIo->Map (
                       PciIo,
                       EfiPciIoOperationBusMasterCommonBuffer,
@@ -691,12 +1022,12 @@ NvmExpressDriverBindingStart (
                       &Private->Mapping
                       );
 
-    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (4))) {
+    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (Private->BufferPages))) {
       goto Exit2;
     }
 
     Private->BufferPciAddr = (UINT8 *)(UINTN)MappedAddr;
-    ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (4));
+    ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (Private->BufferPages));
 
     Private->Signature = NVME_CONTROLLER_PRIVATE_DATA_SIGNATURE;
     Private->ControllerHandle          = Controller;
@@ -709,7 +1040,10 @@ NvmExpressDriverBindingStart (
     Private->Passthru.GetNextNamespace = NvmExpressGetNextNamespace;
     Private->Passthru.BuildDevicePath  = NvmExpressBuildDevicePath;
     Private->Passthru.GetNamespace     = NvmExpressGetNamespace;
-    Private->PassThruMode.Attributes   = NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL;
+    Private->PassThruMode.Attributes   = NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL |
+                                         NVM_EXPRESS_PASS_THRU_ATTRIBUTES_NONBLOCKIO;
+    InitializeListHead (&Private->AsyncPassThruQueue);
+    InitializeListHead (&Private->UnsubmittedSubtasks);
 
     Status = NvmeControllerInit (Private);
 
@@ -717,6 +1051,29 @@ NvmExpressDriverBindingStart (
       goto Exit2;
     }
 
+    //
+    // Start the timer completing the nonblocking I/O.
+    //
+    Status = gBS->CreateEvent (
+                    EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                    TPL_NOTIFY,
+                    ProcessAsyncTaskList,
+                    Private,
+                    &Private->TimerEvent
+                    );
+    if (EFI_ERROR (Status)) {
+      goto Exit2;
+    }
+
+    Status = gBS->SetTimer (
+                    Private->TimerEvent,
+                    TimerPeriodic,
+                    NVME_HC_ASYNC_TIMER
+                    );
+    if (EFI_ERROR (Status)) {
+      goto Exit2;
+    }
+
     Status = gBS->InstallMultipleProtocolInterfaces (
                     &Controller,
                     &gEfiCallerIdGuid,
@@ -780,12 +1137,16 @@ Exit1:
          NULL
          );
 Exit2:
+  if ((Private != NULL) && (Private->TimerEvent != NULL)) {
+    gBS->CloseEvent (Private->TimerEvent);
+  }
+
   if ((Private != NULL) && (Private->Mapping != NULL)) {
     PciIo->Unmap (PciIo, Private->Mapping);
   }
 
   if ((Private != NULL) && (Private->Buffer != NULL)) {
-    PciIo->FreeBuffer (PciIo, 4, Private->Buffer);
+    PciIo->FreeBuffer (PciIo, Private->BufferPages, Private->Buffer);
   }
 
   if (Private != NULL) {
@@ -870,12 +1231,18 @@ NvmExpressDriverBindingStop (
             NULL
             );
 
+      //
+      // Complete the nonblocking I/O, then stop the timer processing it.
+      //
+      NvmeWaitAsyncIo (Private, NULL, NVME_GENERIC_TIMEOUT);
+      gBS->CloseEvent (Private->TimerEvent);
+
       if (Private->Mapping != NULL) {
         Private->PciIo->Unmap (Private->PciIo, Private->Mapping);
       }
 
       if (Private->Buffer != NULL) {
-        Private->PciIo->FreeBuffer (Private->PciIo, 4, Private->Buffer);
+        Private->PciIo->FreeBuffer (Private->PciIo, Private->BufferPages, Private->Buffer);
       }
 
       FreePool (Private->ControllerData);
@@ -27,6 +27,7 @@
 #include <Protocol/DevicePath.h>
 #include <Protocol/PciIo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DiskInfo.h>
 #include <Protocol/DriverSupportedEfiVersion.h>
 
@@ -37,6 +38,7 @@
 #include <Library/UefiLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiDriverEntryPoint.h>
 
@@ -62,7 +64,13 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 #define NVME_CSQ_SIZE                             1     // Number of I/O submission queue entries, which is 0-based
 #define NVME_CCQ_SIZE                             1     // Number of I/O completion queue entries, which is 0-based
 
-#define NVME_MAX_IO_QUEUES                        2     // Number of I/O queues supported by the driver
+#define NVME_MAX_QUEUES                           3     // Number of queues supported by the driver
+
+//
+// Queue used for nonblocking I/O. Its number of entries is PcdNvmeIoQueueDepth,
+// limited to the maximum queue size the controller supports.
+//
+#define NVME_ASYNC_IO_QUEUE                       2
 
 #define NVME_CONTROLLER_ID                        0
 
@@ -71,6 +79,17 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 //
 #define NVME_GENERIC_TIMEOUT                      EFI_TIMER_PERIOD_SECONDS (5)
 
+//
+// Interval of the timer that processes the nonblocking I/O queue
+//
+#define NVME_HC_ASYNC_TIMER                       EFI_TIMER_PERIOD_MILLISECONDS (1)
+
+//
+// Number of pages of the submission and completion queues with the given number of entries
+//
+#define NVME_SQ_PAGES(Entries)                    EFI_SIZE_TO_PAGES ((Entries) * sizeof (NVME_SQ))
+#define NVME_CQ_PAGES(Entries)                    EFI_SIZE_TO_PAGES ((Entries) * sizeof (NVME_CQ))
+
 //
 // Unique signature for private data structure.
 //
@@ -100,33 +119,59 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   NVME_ADMIN_CONTROLLER_DATA      *ControllerData;
 
   //
-  // 6 x 4kB aligned buffers will be carved out of this buffer.
+  // BufferPages x 4kB aligned buffers will be carved out of this buffer.
   // 1st 4kB boundary is the start of the admin submission queue.
-  // 2nd 4kB boundary is the start of submission queue #1.
-  // 3rd 4kB boundary is the start of the admin completion queue.
-  // 4th 4kB boundary is the start of completion queue #1.
-  // 5th 4kB boundary is the start of the first PRP list page.
-  // 6th 4kB boundary is the start of the second PRP list page.
+  // 2nd 4kB boundary is the start of the admin completion queue.
+  // 3rd 4kB boundary is the start of I/O submission queue #1.
+  // 4th 4kB boundary is the start of I/O completion queue #1.
+  // 5th 4kB boundary is the start of I/O submission queue #2, for nonblocking I/O,
+  // followed by I/O completion queue #2.
   //
   UINT8                           *Buffer;
   UINT8                           *BufferPciAddr;
+  UINTN                           BufferPages;
 
   //
   // Pointers to 4kB aligned submission & completion queues.
   //
-  NVME_SQ                         *SqBuffer[NVME_MAX_IO_QUEUES];
-  NVME_CQ                         *CqBuffer[NVME_MAX_IO_QUEUES];
-  NVME_SQ                         *SqBufferPciAddr[NVME_MAX_IO_QUEUES];
-  NVME_CQ                         *CqBufferPciAddr[NVME_MAX_IO_QUEUES];
+  NVME_SQ                         *SqBuffer[NVME_MAX_QUEUES];
+  NVME_CQ                         *CqBuffer[NVME_MAX_QUEUES];
+  NVME_SQ                         *SqBufferPciAddr[NVME_MAX_QUEUES];
+  NVME_CQ                         *CqBufferPciAddr[NVME_MAX_QUEUES];
 
   //
   // Submission and completion queue indices.
   //
-  NVME_SQTDBL                     SqTdbl[NVME_MAX_IO_QUEUES];
-  NVME_CQHDBL                     CqHdbl[NVME_MAX_IO_QUEUES];
+  NVME_SQTDBL                     SqTdbl[NVME_MAX_QUEUES];
+  NVME_CQHDBL                     CqHdbl[NVME_MAX_QUEUES];
+
+  UINT8                           Pt[NVME_MAX_QUEUES];
+  UINT16                          Cid[NVME_MAX_QUEUES];
+
+  //
+  // Number of entries of the nonblocking I/O queues, and the submission queue
+  // head reported by the last completion of the nonblocking I/O queue.
+  //
+  UINT16                          AsyncQueueSize;
+  UINT16                          AsyncSqHead;
+
+  //
+  // Number of blocking commands in flight. The timer defers the controller
+  // reset for timed out nonblocking commands while it is not 0.
+  //
+  UINTN                           BlockingCommands;
+
+  //
+  // Periodic timer processing the nonblocking I/O queue.
+  //
+  EFI_EVENT                       TimerEvent;
 
-  UINT8                           Pt[2];
-  UINT16                          Cid[2];
+  //
+  // Nonblocking commands sent to the controller (NVME_PASS_THRU_ASYNC_REQ), and
+  // BlockIo2 subtasks waiting for a free submission queue entry (NVME_BLKIO2_SUBTASK).
+  //
+  LIST_ENTRY                      AsyncPassThruQueue;
+  LIST_ENTRY                      UnsubmittedSubtasks;
 
   //
   // Nvme controller capabilities
@@ -167,6 +212,7 @@ struct _NVME_DEVICE_PRIVATE_DATA {
 
   EFI_BLOCK_IO_MEDIA                Media;
   EFI_BLOCK_IO_PROTOCOL             BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL            BlockIo2;
   EFI_DISK_INFO_PROTOCOL            DiskInfo;
 
   EFI_LBA                           NumBlocks;
@@ -188,6 +234,13 @@ struct _NVME_DEVICE_PRIVATE_DATA {
       NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
       )
 
+#define NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2(a) \
+  CR (a, \
+      NVME_DEVICE_PRIVATE_DATA, \
+      BlockIo2, \
+      NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
+      )
+
 #define NVME_DEVICE_PRIVATE_DATA_FROM_DISK_INFO(a) \
   CR (a, \
       NVME_DEVICE_PRIVATE_DATA, \
@@ -195,6 +248,67 @@ struct _NVME_DEVICE_PRIVATE_DATA {
       NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
       )
 
+//
+// Nonblocking command sent to the controller through the NVME_ASYNC_IO_QUEUE.
+//
+#define NVME_PASS_THRU_ASYNC_REQ_SIG           SIGNATURE_32 ('N','P','A','R')
+
+typedef struct {
+  UINT32                                   Signature;
+  LIST_ENTRY                               Link;
+
+  NVM_EXPRESS_PASS_THRU_COMMAND_PACKET     *Packet;
+  UINT16                                   CommandId;
+  //
+  // Time left before the command times out, in 100ns units, or 0 if it never does.
+  //
+  UINT64                                   Timeout;
+  VOID                                     *MapData;
+  VOID                                     *MapMeta;
+  VOID                                     *MapPrpList;
+  UINTN                                    PrpListNo;
+  VOID                                     *PrpListHost;
+
+  EFI_EVENT                                CallerEvent;
+} NVME_PASS_THRU_ASYNC_REQ;
+
+#define NVME_PASS_THRU_ASYNC_REQ_FROM_THIS(a) \
+  CR (a, \
+      NVME_PASS_THRU_ASYNC_REQ, \
+      Link, \
+      NVME_PASS_THRU_ASYNC_REQ_SIG \
+      )
+
+//
+// BlockIo2 request. It is split into subtasks of at most the maximum data
+// transfer size of the controller, which run at the same time.
+//
+#define NVME_BLKIO2_REQUEST_SIGNATURE          SIGNATURE_32 ('N','B','2','R')
+
+typedef struct {
+  UINT32                                   Signature;
+
+  EFI_BLOCK_IO2_TOKEN                      *Token;
+  UINTN                                    SubtaskNum;    // Number of subtasks not completed yet
+} NVME_BLKIO2_REQUEST;
+
+#define NVME_BLKIO2_SUBTASK_SIGNATURE          SIGNATURE_32 ('N','B','2','S')
+
+typedef struct {
+  UINT32                                   Signature;
+  LIST_ENTRY                               Link;
+
+  NVME_BLKIO2_REQUEST                      *BlockIo2Request;
+  UINT32                                   NamespaceId;
+  EFI_EVENT                                Event;
+  NVM_EXPRESS_PASS_THRU_COMMAND_PACKET     CommandPacket;
+  NVM_EXPRESS_COMMAND                      Command;
+  NVM_EXPRESS_RESPONSE                     Response;
+} NVME_BLKIO2_SUBTASK;
+
+#define NVME_BLKIO2_SUBTASK_FROM_LINK(a) \
+  CR (a, NVME_BLKIO2_SUBTASK, Link, NVME_BLKIO2_SUBTASK_SIGNATURE)
+
 /**
   Retrieves a Unicode string that is the user readable name of the driver.
 
@@ -491,6 +605,77 @@ NvmExpressPassThru (
   IN     EFI_EVENT                                   Event OPTIONAL
   );
 
+/**
+  Complete the nonblocking commands the controller has finished, and submit the
+  BlockIo2 subtasks waiting for a free entry of the nonblocking I/O queue.
+
+  It is called periodically at TPL_NOTIFY, and by the blocking services that
+  wait for nonblocking I/O, at TPL_NOTIFY too.
+
+  @param[in]  Event     The timer event, or NULL.
+  @param[in]  Context   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT                    Event,
+  IN VOID                         *Context
+  );
+
+/**
+  Abort all the nonblocking I/O of the controller.
+
+  The controller is reset first, so it no longer accesses the buffers of the
+  commands in flight. Then these commands are completed with a timeout status,
+  and the BlockIo2 subtasks not submitted yet fail with EFI_DEVICE_ERROR.
+
+  It is called at TPL_NOTIFY.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeAbortAsyncIo (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  );
+
+/**
+  Process the nonblocking I/O queue until Event is signaled, or until all the
+  nonblocking I/O of the controller is done if Event is NULL.
+
+  The nonblocking commands still pending after Timeout are aborted by
+  NvmeAbortAsyncIo(), so the wait ends even if the controller stops responding.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  Event     The event to wait for, of a type CheckEvent() accepts, or NULL.
+  @param[in]  Timeout   The time to wait for progress before aborting the pending
+                        commands, in 100ns units.
+
+**/
+VOID
+NvmeWaitAsyncIo (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN EFI_EVENT                          Event    OPTIONAL,
+  IN UINT64                             Timeout
+  );
+
+/**
+  Complete a subtask of a BlockIo2 request that is no longer in any queue.
+
+  The Token of the request is signaled when its last subtask completes, with
+  the status of the first subtask that failed.
+
+  @param[in]  Subtask   The subtask, which is freed.
+  @param[in]  Status    The status of the subtask.
+
+**/
+VOID
+NvmeCompleteBlockIo2Subtask (
+  IN NVME_BLKIO2_SUBTASK                *Subtask,
+  IN EFI_STATUS                         Status
+  );
+
 /**
   Used to retrieve the list of namespaces defined on an NVM Express controller.
 
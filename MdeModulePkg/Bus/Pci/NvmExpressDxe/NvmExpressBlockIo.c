@@ -148,6 +148,269 @@ WriteSectors (
   return Status;
 }
 
+/**
+  Get the maximum number of blocks a read or write command transfers.
+
+  @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+
+  @return The maximum number of blocks of a transfer.
+
+**/
+UINT32
+NvmeGetMaxTransferBlocks (
+  IN NVME_DEVICE_PRIVATE_DATA           *Device
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA     *Controller;
+
+  Controller = Device->Controller;
+
+  if (Controller->ControllerData->Mdts != 0) {
+    return (1 << (Controller->ControllerData->Mdts)) * (1 << (Controller->Cap.Mpsmin + 12)) / Device->Media.BlockSize;
+  }
+
+  return 1024;
+}
+
+/**
+  Complete a subtask of a BlockIo2 request that is no longer in any queue.
+
+  The Token of the request is signaled when its last subtask completes, with
+  the status of the first subtask that failed.
+
+  @param[in]  Subtask   The subtask, which is freed.
+  @param[in]  Status    The status of the subtask.
+
+**/
+VOID
+NvmeCompleteBlockIo2Subtask (
+  IN NVME_BLKIO2_SUBTASK                *Subtask,
+  IN EFI_STATUS                         Status
+  )
+{
+  NVME_BLKIO2_REQUEST                   *Request;
+
+  Request = Subtask->BlockIo2Request;
+  if (EFI_ERROR (Status) && !EFI_ERROR (Request->Token->TransactionStatus)) {
+    Request->Token->TransactionStatus = Status;
+  }
+
+  gBS->CloseEvent (Subtask->Event);
+  FreePool (Subtask);
+
+  if (--Request->SubtaskNum == 0) {
+    gBS->SignalEvent (Request->Token->Event);
+    FreePool (Request);
+  }
+}
+
+/**
+  Notification function of the event signaled when the controller completes a
+  subtask of a BlockIo2 request.
+
+  @param  Event                  The event signaled.
+  @param  Context                The pointer to the NVME_BLKIO2_SUBTASK data structure.
+
+**/
+VOID
+EFIAPI
+AsyncIoCallback (
+  IN EFI_EVENT                          Event,
+  IN VOID                               *Context
+  )
+{
+  NVME_BLKIO2_SUBTASK                   *Subtask;
+  NVME_CQ                               *Completion;
+  EFI_STATUS                            Status;
+
+  Subtask    = (NVME_BLKIO2_SUBTASK *) Context;
+  Completion = (NVME_CQ *) &Subtask->Response;
+  Status     = EFI_SUCCESS;
+
+  if ((Subtask->CommandPacket.ControllerStatus != NVM_EXPRESS_STATUS_CONTROLLER_READY) ||
+      (Completion->Sct != 0) || (Completion->Sc != 0)) {
+    DEBUG ((EFI_D_ERROR, "AsyncIoCallback: Sct = 0x%x, Sc = 0x%x\n", Completion->Sct, Completion->Sc));
+    Status = EFI_DEVICE_ERROR;
+  }
+
+  NvmeCompleteBlockIo2Subtask (Subtask, Status);
+}
+
+/**
+  Queue a nonblocking read or write of some blocks.
+
+  The request is split into commands of at most the maximum transfer size, which
+  are all queued at once, so the controller works on several of them at the same
+  time. Token->Event is signaled when all of them complete.
+
+  @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param  IsRead                 TRUE to read from the device, FALSE to write to it.
+  @param  Buffer                 The buffer of the data.
+  @param  Lba                    The start block number.
+  @param  Blocks                 Total block number to be transferred, which is not 0.
+  @param  Token                  The token signaled when the transfer is done, with
+                                 TransactionStatus set to EFI_SUCCESS.
+
+  @retval EFI_SUCCESS            The request is queued.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be queued due to a lack of resources.
+
+**/
+EFI_STATUS
+NvmeAsyncReadWrite (
+  IN NVME_DEVICE_PRIVATE_DATA           *Device,
+  IN BOOLEAN                            IsRead,
+  IN VOID                               *Buffer,
+  IN UINT64                             Lba,
+  IN UINTN                              Blocks,
+  IN EFI_BLOCK_IO2_TOKEN                *Token
+  )
+{
+  EFI_STATUS                            Status;
+  NVME_CONTROLLER_PRIVATE_DATA          *Controller;
+  UINT32                                BlockSize;
+  UINT32                                MaxTransferBlocks;
+  UINT32                                TransferBlocks;
+  NVME_BLKIO2_REQUEST                   *BlkIo2Req;
+  NVME_BLKIO2_SUBTASK                   *Subtask;
+  LIST_ENTRY                            Subtasks;
+  LIST_ENTRY                            *Link;
+  EFI_TPL                               OldTpl;
+
+  Controller        = Device->Controller;
+  BlockSize         = Device->Media.BlockSize;
+  MaxTransferBlocks = NvmeGetMaxTransferBlocks (Device);
+
+  BlkIo2Req = AllocateZeroPool (sizeof (NVME_BLKIO2_REQUEST));
+  if (BlkIo2Req == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  BlkIo2Req->Signature = NVME_BLKIO2_REQUEST_SIGNATURE;
+  BlkIo2Req->Token     = Token;
+
+  //
+  // Build all the subtasks first, so a failure leaves nothing queued.
+  //
+  InitializeListHead (&Subtasks);
+  Status = EFI_SUCCESS;
+  while (Blocks > 0) {
+    TransferBlocks = (UINT32) MIN (Blocks, MaxTransferBlocks);
+
+    Subtask = AllocateZeroPool (sizeof (NVME_BLKIO2_SUBTASK));
+    if (Subtask == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      break;
+    }
+
+    Subtask->Signature       = NVME_BLKIO2_SUBTASK_SIGNATURE;
+    Subtask->BlockIo2Request = BlkIo2Req;
+    Subtask->NamespaceId     = Device->NamespaceId;
+    InsertTailList (&Subtasks, &Subtask->Link);
+
+    Status = gBS->CreateEvent (
+                    EVT_NOTIFY_SIGNAL,
+                    TPL_NOTIFY,
+                    AsyncIoCallback,
+                    Subtask,
+                    &Subtask->Event
+                    );
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Subtask->CommandPacket.NvmeCmd      = &Subtask->Command;
+    Subtask->CommandPacket.NvmeResponse = &Subtask->Response;
+
+    Subtask->Command.Cdw0.Opcode = IsRead ? NVME_IO_READ_OPC : NVME_IO_WRITE_OPC;
+    Subtask->Command.Nsid        = Device->NamespaceId;
+    Subtask->CommandPacket.TransferBuffer = Buffer;
+
+    Subtask->CommandPacket.TransferLength = TransferBlocks * BlockSize;
+    Subtask->CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
+    Subtask->CommandPacket.QueueId        = NVME_IO_QUEUE;
+
+    Subtask->Command.Cdw10 = (UINT32)Lba;
+    Subtask->Command.Cdw11 = (UINT32)(Lba >> 32);
+    Subtask->Command.Cdw12 = (TransferBlocks - 1) & 0xFFFF;
+
+    Subtask->Command.Flags = CDW10_VALID | CDW11_VALID | CDW12_VALID;
+
+    BlkIo2Req->SubtaskNum++;
+    Blocks -= TransferBlocks;
+    Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + TransferBlocks * BlockSize);
+    Lba    += TransferBlocks;
+  }
+
+  if (EFI_ERROR (Status)) {
+    while (!IsListEmpty (&Subtasks)) {
+      Subtask = NVME_BLKIO2_SUBTASK_FROM_LINK (GetFirstNode (&Subtasks));
+      RemoveEntryList (&Subtask->Link);
+      if (Subtask->Event != NULL) {
+        gBS->CloseEvent (Subtask->Event);
+      }
+      FreePool (Subtask);
+    }
+    FreePool (BlkIo2Req);
+    return Status;
+  }
+
+  //
+  // Hand the subtasks over to the nonblocking I/O queue of the controller.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  while (!IsListEmpty (&Subtasks)) {
+    Link = GetFirstNode (&Subtasks);
+    RemoveEntryList (Link);
+    InsertTailList (&Controller->UnsubmittedSubtasks, Link);
+  }
+  ProcessAsyncTaskList (NULL, Controller);
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Read or write some blocks, keeping several commands in flight, and wait for
+  the transfer to complete.
+
+  @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param  IsRead                 TRUE to read from the device, FALSE to write to it.
+  @param  Buffer                 The buffer of the data.
+  @param  Lba                    The start block number.
+  @param  Blocks                 Total block number to be transferred, which is not 0.
+
+  @retval EFI_SUCCESS            Datum are transferred.
+  @retval Others                 Fail to transfer all the datum.
+
+**/
+EFI_STATUS
+NvmeQueuedReadWrite (
+  IN NVME_DEVICE_PRIVATE_DATA           *Device,
+  IN BOOLEAN                            IsRead,
+  IN VOID                               *Buffer,
+  IN UINT64                             Lba,
+  IN UINTN                              Blocks
+  )
+{
+  EFI_STATUS                            Status;
+  EFI_BLOCK_IO2_TOKEN                   Token;
+
+  Status = gBS->CreateEvent (0, TPL_NOTIFY, NULL, NULL, &Token.Event);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Token.TransactionStatus = EFI_SUCCESS;
+  Status = NvmeAsyncReadWrite (Device, IsRead, Buffer, Lba, Blocks, &Token);
+  if (!EFI_ERROR (Status)) {
+    NvmeWaitAsyncIo (Device->Controller, Token.Event, NVME_GENERIC_TIMEOUT);
+    Status = Token.TransactionStatus;
+  }
+
+  gBS->CloseEvent (Token.Event);
+  return Status;
+}
+
 /**
   Read some blocks from the device.
 
@@ -170,39 +433,19 @@ NvmeRead (
 {
   EFI_STATUS                       Status;
   UINT32                           BlockSize;
-  NVME_CONTROLLER_PRIVATE_DATA     *Controller;
-  UINT32                           MaxTransferBlocks;
-  UINTN                            OrginalBlocks;
 
-  Status        = EFI_SUCCESS;
-  Controller    = Device->Controller;
-  BlockSize     = Device->Media.BlockSize;
-  OrginalBlocks = Blocks;
+  BlockSize = Device->Media.BlockSize;
 
-  if (Controller->ControllerData->Mdts != 0) {
-    MaxTransferBlocks = (1 << (Controller->ControllerData->Mdts)) * (1 << (Controller->Cap.Mpsmin + 12)) / BlockSize;
+  if (Blocks > NvmeGetMaxTransferBlocks (Device)) {
+    //
+    // Split the transfer into commands the controller works on at the same time.
+    //
+    Status = NvmeQueuedReadWrite (Device, TRUE, Buffer, Lba, Blocks);
   } else {
-    MaxTransferBlocks = 1024;
+    Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
   }
 
-  while (Blocks > 0) {
-    if (Blocks > MaxTransferBlocks) {
-      Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
-
-      Blocks -= MaxTransferBlocks;
-      Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + MaxTransferBlocks * BlockSize);
-      Lba    += MaxTransferBlocks;
-    } else {
-      Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
-      Blocks = 0;
-    }
-
-    if (EFI_ERROR(Status)) {
-      break;
-    }
-  }
-
-  DEBUG ((EFI_D_INFO, "NvmeRead()  Lba = 0x%08x, Original = 0x%08x, Remaining = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, OrginalBlocks, Blocks, BlockSize, Status));
+  DEBUG ((EFI_D_INFO, "NvmeRead()  Lba = 0x%08x, Blocks = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, Blocks, BlockSize, Status));
 
   return Status;
 }
@@ -229,39 +472,19 @@ NvmeWrite (
 {
   EFI_STATUS                       Status;
   UINT32                           BlockSize;
-  NVME_CONTROLLER_PRIVATE_DATA     *Controller;
-  UINT32                           MaxTransferBlocks;
-  UINTN                            OrginalBlocks;
 
-  Status        = EFI_SUCCESS;
-  Controller    = Device->Controller;
-  BlockSize     = Device->Media.BlockSize;
-  OrginalBlocks = Blocks;
+  BlockSize = Device->Media.BlockSize;
 
-  if (Controller->ControllerData->Mdts != 0) {
-    MaxTransferBlocks = (1 << (Controller->ControllerData->Mdts)) * (1 << (Controller->Cap.Mpsmin + 12)) / BlockSize;
+  if (Blocks > NvmeGetMaxTransferBlocks (Device)) {
+    //
+    // Split the transfer into commands the controller works on at the same time.
+    //
+    Status = NvmeQueuedReadWrite (Device, FALSE, Buffer, Lba, Blocks);
   } else {
-    MaxTransferBlocks = 1024;
-  }
-
-  while (Blocks > 0) {
-    if (Blocks > MaxTransferBlocks) {
-      Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
-
-      Blocks -= MaxTransferBlocks;
-      Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + MaxTransferBlocks * BlockSize);
-      Lba    += MaxTransferBlocks;
-    } else {
-      Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
-      Blocks = 0;
-    }
-
-    if (EFI_ERROR(Status)) {
-      break;
-    }
+    Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
   }
 
-  DEBUG ((EFI_D_INFO, "NvmeWrite() Lba = 0x%08x, Original = 0x%08x, Remaining = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, OrginalBlocks, Blocks, BlockSize, Status));
+  DEBUG ((EFI_D_INFO, "NvmeWrite() Lba = 0x%08x, Blocks = 0x%08x, BlockSize = 0x%x Status = %r\n", Lba, Blocks, BlockSize, Status));
 
   return Status;
 }
@@ -349,6 +572,11 @@ NvmeBlockIoReset (
 
   Private = Device->Controller;
 
+  //
+  // Let the nonblocking I/O finish before the queues are reinitialized.
+  //
+  NvmeWaitAsyncIo (Private, NULL, NVME_GENERIC_TIMEOUT);
+
   Status  = NvmeControllerInit (Private);
 
   gBS->RestoreTPL (OldTpl);
@@ -561,3 +789,325 @@ NvmeBlockIoFlushBlocks (
 
   return Status;
 }
+
+/**
+  Reset the block device hardware.
+
+  @param[in]  This                 Indicates a pointer to the calling context.
+  @param[in]  ExtendedVerification Indicates that the driver may perform a more
+                                   exhausive verification operation of the device
+                                   during reset.
+
+  @retval EFI_SUCCESS          The device was reset.
+  @retval EFI_DEVICE_ERROR     The device is not functioning properly and could
+                               not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL  *This,
+  IN BOOLEAN                 ExtendedVerification
+  )
+{
+  EFI_TPL                         OldTpl;
+  NVME_CONTROLLER_PRIVATE_DATA    *Private;
+  NVME_DEVICE_PRIVATE_DATA        *Device;
+  EFI_STATUS                      Status;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // For Nvm Express subsystem, reset block device means reset controller.
+  //
+  OldTpl  = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Device  = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  Private = Device->Controller;
+
+  //
+  // Let the nonblocking I/O finish before the queues are reinitialized.
+  //
+  NvmeWaitAsyncIo (Private, NULL, NVME_GENERIC_TIMEOUT);
+
+  Status  = NvmeControllerInit (Private);
+
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Read BufferSize bytes from Lba into Buffer.
+
+  This function reads the requested number of blocks from the device. All the
+  blocks are read, or an error is returned.
+  If EFI_DEVICE_ERROR, EFI_NO_MEDIA,_or EFI_MEDIA_CHANGED is returned and
+  non-blocking I/O is being used, the Event associated with this request will
+  not be signaled.
+
+  @param[in]       This       Indicates a pointer to the calling context.
+  @param[in]       MediaId    Id of the media, changes every time the media is
+                              replaced.
+  @param[in]       Lba        The starting Logical Block Address to read from.
+  @param[in, out]  Token      A pointer to the token associated with the transaction.
+  @param[in]       BufferSize Size of Buffer, must be a multiple of device block size.
+  @param[out]      Buffer     A pointer to the destination buffer for the data. The
+                              caller is responsible for either having implicit or
+                              explicit ownership of the buffer.
+
+  @retval EFI_SUCCESS           The read request was queued if Token->Event is
+                                not NULL.The data was read correctly from the
+                                device if the Token->Event is NULL.
+  @retval EFI_DEVICE_ERROR      The device reported an error while performing
+                                the read.
+  @retval EFI_NO_MEDIA          There is no media in the device.
+  @retval EFI_MEDIA_CHANGED     The MediaId is not for the current media.
+  @retval EFI_BAD_BUFFER_SIZE   The BufferSize parameter is not a multiple of the
+                                intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER The read request contains LBAs that are not valid,
+                                or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be completed due to a lack
+                                of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+     OUT VOID                   *Buffer
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA          *Device;
+  EFI_STATUS                        Status;
+  EFI_BLOCK_IO_MEDIA                *Media;
+  UINTN                             BlockSize;
+  UINTN                             NumberOfBlocks;
+  UINTN                             IoAlign;
+  EFI_TPL                           OldTpl;
+
+  //
+  // Check parameters.
+  //
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Media = This->Media;
+
+  if (MediaId != Media->MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (BufferSize == 0) {
+    if ((Token != NULL) && (Token->Event != NULL)) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+    return EFI_SUCCESS;
+  }
+
+  BlockSize = Media->BlockSize;
+  if ((BufferSize % BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  NumberOfBlocks  = BufferSize / BlockSize;
+  if ((Lba + NumberOfBlocks - 1) > Media->LastBlock) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IoAlign = Media->IoAlign;
+  if (IoAlign > 0 && (((UINTN) Buffer & (IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    Status = NvmeAsyncReadWrite (Device, TRUE, Buffer, Lba, NumberOfBlocks, Token);
+  } else {
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    Status = NvmeRead (Device, Buffer, Lba, NumberOfBlocks);
+    gBS->RestoreTPL (OldTpl);
+  }
+
+  return Status;
+}
+
+/**
+  Write BufferSize bytes from Lba into Buffer.
+
+  This function writes the requested number of blocks to the device. All blocks
+  are written, or an error is returned.If EFI_DEVICE_ERROR, EFI_NO_MEDIA,
+  EFI_WRITE_PROTECTED or EFI_MEDIA_CHANGED is returned and non-blocking I/O is
+  being used, the Event associated with this request will not be signaled.
+
+  @param[in]       This       Indicates a pointer to the calling context.
+  @param[in]       MediaId    The media ID that the write request is for.
+  @param[in]       Lba        The starting logical block address to be written. The
+                              caller is responsible for writing to only legitimate
+                              locations.
+  @param[in, out]  Token      A pointer to the token associated with the transaction.
+  @param[in]       BufferSize Size of Buffer, must be a multiple of device block size.
+  @param[in]       Buffer     A pointer to the source buffer for the data.
+
+  @retval EFI_SUCCESS           The write request was queued if Event is not NULL.
+                                The data was written correctly to the device if
+                                the Event is NULL.
+  @retval EFI_WRITE_PROTECTED   The device can not be written to.
+  @retval EFI_NO_MEDIA          There is no media in the device.
+  @retval EFI_MEDIA_CHNAGED     The MediaId does not matched the current device.
+  @retval EFI_DEVICE_ERROR      The device reported an error while performing the write.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size of the device.
+  @retval EFI_INVALID_PARAMETER The write request contains LBAs that are not valid,
+                                or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be completed due to a lack
+                                of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL  *This,
+  IN     UINT32                  MediaId,
+  IN     EFI_LBA                 Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN     *Token,
+  IN     UINTN                   BufferSize,
+  IN     VOID                    *Buffer
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA          *Device;
+  EFI_STATUS                        Status;
+  EFI_BLOCK_IO_MEDIA                *Media;
+  UINTN                             BlockSize;
+  UINTN                             NumberOfBlocks;
+  UINTN                             IoAlign;
+  EFI_TPL                           OldTpl;
+
+  //
+  // Check parameters.
+  //
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Media = This->Media;
+
+  if (MediaId != Media->MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (BufferSize == 0) {
+    if ((Token != NULL) && (Token->Event != NULL)) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+    return EFI_SUCCESS;
+  }
+
+  BlockSize = Media->BlockSize;
+  if ((BufferSize % BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  NumberOfBlocks  = BufferSize / BlockSize;
+  if ((Lba + NumberOfBlocks - 1) > Media->LastBlock) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IoAlign = Media->IoAlign;
+  if (IoAlign > 0 && (((UINTN) Buffer & (IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    Status = NvmeAsyncReadWrite (Device, FALSE, Buffer, Lba, NumberOfBlocks, Token);
+  } else {
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    Status = NvmeWrite (Device, Buffer, Lba, NumberOfBlocks);
+    gBS->RestoreTPL (OldTpl);
+  }
+
+  return Status;
+}
+
+/**
+  Flush the Block Device.
+
+  If EFI_DEVICE_ERROR, EFI_NO_MEDIA,_EFI_WRITE_PROTECTED or EFI_MEDIA_CHANGED
+  is returned and non-blocking I/O is being used, the Event associated with
+  this request will not be signaled.
+
+  The flush is done once the nonblocking I/O queued before it has completed.
+
+  @param[in]      This     Indicates a pointer to the calling context.
+  @param[in,out]  Token    A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The flush request was queued if Event is not NULL.
+                               All outstanding data was written correctly to the
+                               device if the Event is NULL.
+  @retval EFI_DEVICE_ERROR     The device reported an error while writting back
+                               the data.
+  @retval EFI_WRITE_PROTECTED  The device cannot be written to.
+  @retval EFI_NO_MEDIA         There is no media in the device.
+  @retval EFI_MEDIA_CHANGED    The MediaId is not for the current media.
+  @retval EFI_OUT_OF_RESOURCES The request could not be completed due to a lack
+                               of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA          *Device;
+  EFI_STATUS                        Status;
+  EFI_TPL                           OldTpl;
+
+  //
+  // Check parameters.
+  //
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  NvmeWaitAsyncIo (Device->Controller, NULL, NVME_GENERIC_TIMEOUT);
+
+  Status = NvmeFlush (Device);
+
+  gBS->RestoreTPL (OldTpl);
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = Status;
+    gBS->SignalEvent (Token->Event);
+    Status = EFI_SUCCESS;
+  }
+
+  return Status;
+}
@@ -670,6 +670,8 @@ NvmeIdentifyNamespace (
   Create io completion queue.
 
   @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param  Qid              The identifier of the queue.
+  @param  Qsize            The number of entries of the queue, which is 0-based.
 
   @return EFI_SUCCESS      Successfully create io completion queue.
   @return EFI_DEVICE_ERROR Fail to create io completion queue.
@@ -677,7 +679,9 @@ NvmeIdentifyNamespace (
 **/
 EFI_STATUS
 NvmeCreateIoCompletionQueue (
-  IN NVME_CONTROLLER_PRIVATE_DATA      *Private
+  IN NVME_CONTROLLER_PRIVATE_DATA      *Private,
+  IN UINT16                            Qid,
+  IN UINT16                            Qsize
   )
 {
   NVM_EXPRESS_PASS_THRU_COMMAND_PACKET     CommandPacket;
@@ -696,13 +700,13 @@ NvmeCreateIoCompletionQueue (
 
   Command.Cdw0.Opcode = NVME_ADMIN_CRIOCQ_OPC;
   Command.Cdw0.Cid    = Private->Cid[0]++;
-  CommandPacket.TransferBuffer = Private->CqBufferPciAddr[1];
-  CommandPacket.TransferLength = EFI_PAGE_SIZE;
+  CommandPacket.TransferBuffer = Private->CqBufferPciAddr[Qid];
+  CommandPacket.TransferLength = EFI_PAGES_TO_SIZE (NVME_CQ_PAGES ((UINTN)Qsize + 1));
   CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
   CommandPacket.QueueId        = NVME_ADMIN_QUEUE;
 
-  CrIoCq.Qid   = NVME_IO_QUEUE;
-  CrIoCq.Qsize = NVME_CCQ_SIZE;
+  CrIoCq.Qid   = Qid;
+  CrIoCq.Qsize = Qsize;
   CrIoCq.Pc    = 1;
   CopyMem (&CommandPacket.NvmeCmd->Cdw10, &CrIoCq, sizeof (NVME_ADMIN_CRIOCQ));
   CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
@@ -722,6 +726,8 @@ NvmeCreateIoCompletionQueue (
   Create io submission queue.
 
   @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param  Qid              The identifier of the queue, and of its completion queue.
+  @param  Qsize            The number of entries of the queue, which is 0-based.
 
   @return EFI_SUCCESS      Successfully create io submission queue.
   @return EFI_DEVICE_ERROR Fail to create io submission queue.
@@ -729,7 +735,9 @@ NvmeCreateIoCompletionQueue (
 **/
 EFI_STATUS
 NvmeCreateIoSubmissionQueue (
-  IN NVME_CONTROLLER_PRIVATE_DATA      *Private
+  IN NVME_CONTROLLER_PRIVATE_DATA      *Private,
+  IN UINT16                            Qid,
+  IN UINT16                            Qsize
   )
 {
   NVM_EXPRESS_PASS_THRU_COMMAND_PACKET     CommandPacket;
@@ -748,15 +756,15 @@ NvmeCreateIoSubmissionQueue (
 
   Command.Cdw0.Opcode = NVME_ADMIN_CRIOSQ_OPC;
   Command.Cdw0.Cid    = Private->Cid[0]++;
-  CommandPacket.TransferBuffer = Private->SqBufferPciAddr[1];
-  CommandPacket.TransferLength = EFI_PAGE_SIZE;
+  CommandPacket.TransferBuffer = Private->SqBufferPciAddr[Qid];
+  CommandPacket.TransferLength = EFI_PAGES_TO_SIZE (NVME_SQ_PAGES ((UINTN)Qsize + 1));
   CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
   CommandPacket.QueueId        = NVME_ADMIN_QUEUE;
 
-  CrIoSq.Qid   = NVME_IO_QUEUE;
-  CrIoSq.Qsize = NVME_CSQ_SIZE;
+  CrIoSq.Qid   = Qid;
+  CrIoSq.Qsize = Qsize;
   CrIoSq.Pc    = 1;
-  CrIoSq.Cqid  = NVME_IO_QUEUE;
+  CrIoSq.Cqid  = Qid;
   CrIoSq.Qprio = 0;
   CopyMem (&CommandPacket.NvmeCmd->Cdw10, &CrIoSq, sizeof (NVME_ADMIN_CRIOSQ));
   CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
@@ -848,8 +856,22 @@ NvmeControllerInit (
   //
   ASSERT ((Private->Cap.Mpsmin + 12) <= EFI_PAGE_SHIFT);
 
-  Private->Cid[0] = 0;
-  Private->Cid[1] = 0;
+  //
+  // Start with empty queues, also when the controller is reset.
+  //
+  ZeroMem (Private->Cid, sizeof (Private->Cid));
+  ZeroMem (Private->Pt, sizeof (Private->Pt));
+  ZeroMem (Private->SqTdbl, sizeof (Private->SqTdbl));
+  ZeroMem (Private->CqHdbl, sizeof (Private->CqHdbl));
+  ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (Private->BufferPages));
+  Private->AsyncSqHead = 0;
+
+  //
+  // The nonblocking I/O queue has at most as many entries as the controller supports.
+  //
+  if (Private->AsyncQueueSize > (UINT32)Private->Cap.Mqes + 1) {
+    Private->AsyncQueueSize = (UINT16)(Private->Cap.Mqes + 1);
+  }
 
   Status = NvmeDisableController (Private);
 
@@ -888,6 +910,10 @@ NvmeControllerInit (
   Private->SqBufferPciAddr[1] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr + 2 * EFI_PAGE_SIZE);
   Private->CqBuffer[1]        = (NVME_CQ *)(UINTN)(Private->Buffer + 3 * EFI_PAGE_SIZE);
   Private->CqBufferPciAddr[1] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + 3 * EFI_PAGE_SIZE);
+  Private->SqBuffer[2]        = (NVME_SQ *)(UINTN)(Private->Buffer + 4 * EFI_PAGE_SIZE);
+  Private->SqBufferPciAddr[2] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr + 4 * EFI_PAGE_SIZE);
+  Private->CqBuffer[2]        = (NVME_CQ *)(UINTN)(Private->Buffer + (4 + NVME_SQ_PAGES (Private->AsyncQueueSize)) * EFI_PAGE_SIZE);
+  Private->CqBufferPciAddr[2] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + (4 + NVME_SQ_PAGES (Private->AsyncQueueSize)) * EFI_PAGE_SIZE);
 
   DEBUG ((EFI_D_INFO, "Private->Buffer = [%016X]\n", (UINT64)(UINTN)Private->Buffer));
   DEBUG ((EFI_D_INFO, "Admin Submission Queue size (Aqa.Asqs) = [%08X]\n", Aqa.Asqs));
@@ -896,6 +922,9 @@ NvmeControllerInit (
   DEBUG ((EFI_D_INFO, "Admin Completion Queue (CqBuffer[0]) = [%016X]\n", Private->CqBuffer[0]));
   DEBUG ((EFI_D_INFO, "I/O   Submission Queue (SqBuffer[1]) = [%016X]\n", Private->SqBuffer[1]));
   DEBUG ((EFI_D_INFO, "I/O   Completion Queue (CqBuffer[1]) = [%016X]\n", Private->CqBuffer[1]));
+  DEBUG ((EFI_D_INFO, "I/O   Submission Queue (SqBuffer[2]) = [%016X]\n", Private->SqBuffer[2]));
+  DEBUG ((EFI_D_INFO, "I/O   Completion Queue (CqBuffer[2]) = [%016X]\n", Private->CqBuffer[2]));
+  DEBUG ((EFI_D_INFO, "I/O   Queue #2 size = [%08X]\n", Private->AsyncQueueSize));
 
   //
   // Program admin queue attributes.
@@ -930,17 +959,25 @@ NvmeControllerInit (
   }
 
   //
-  // Create one I/O completion queue.
+  // Create the I/O completion & submission queues: #1 for blocking I/O, and
+  // #2 for nonblocking I/O.
   //
-  Status = NvmeCreateIoCompletionQueue (Private);
+  Status = NvmeCreateIoCompletionQueue (Private, NVME_IO_QUEUE, NVME_CCQ_SIZE);
   if (EFI_ERROR(Status)) {
    return Status;
   }
 
-  //
-  // Create one I/O Submission queue.
-  //
-  Status = NvmeCreateIoSubmissionQueue (Private);
+  Status = NvmeCreateIoSubmissionQueue (Private, NVME_IO_QUEUE, NVME_CSQ_SIZE);
+  if (EFI_ERROR(Status)) {
+   return Status;
+  }
+
+  Status = NvmeCreateIoCompletionQueue (Private, NVME_ASYNC_IO_QUEUE, Private->AsyncQueueSize - 1);
+  if (EFI_ERROR(Status)) {
+   return Status;
+  }
+
+  Status = NvmeCreateIoSubmissionQueue (Private, NVME_ASYNC_IO_QUEUE, Private->AsyncQueueSize - 1);
   if (EFI_ERROR(Status)) {
    return Status;
   }
@@ -218,6 +218,7 @@ NvmeDumpStatus (
 /**
   Create PRP lists for data transfer which is larger than 2 memory pages.
   Note here we calcuate the number of required PRP lists and allocate them at one time.
+  The last entry of each PRP list but the last one points to the next PRP list.
 
   @param[in]     PciIo               A pointer to the EFI_PCI_IO_PROTOCOL instance.
   @param[in]     PhysicalAddr        The physical base address of data buffer.
@@ -243,7 +244,6 @@ NvmeCreatePrpList (
   UINT64                      PrpListBase;
   UINTN                       PrpListIndex;
   UINTN                       PrpEntryIndex;
-  UINT64                      Remainder;
   EFI_PHYSICAL_ADDRESS        PrpListPhyAddr;
   UINTN                       Bytes;
   EFI_STATUS                  Status;
@@ -254,12 +254,11 @@ NvmeCreatePrpList (
   PrpEntryNo = EFI_PAGE_SIZE / sizeof (UINT64);
 
   //
-  // Calculate total PrpList number.
+  // Calculate total PrpList number. The last PrpList holds up to PrpEntryNo pages,
+  // the other ones PrpEntryNo - 1 pages and the pointer to the next PrpList.
   //
-  *PrpListNo = (UINTN)DivU64x64Remainder ((UINT64)Pages, (UINT64)PrpEntryNo, &Remainder);
-  if (Remainder != 0) {
-    *PrpListNo += 1;
-  }
+  ASSERT (Pages > 1);
+  *PrpListNo = (UINTN)DivU64x64Remainder ((UINT64)Pages - 2, (UINT64)(PrpEntryNo - 1), NULL) + 1;
 
   Status = PciIo->AllocateBuffer (
                     PciIo,
@@ -288,36 +287,23 @@ NvmeCreatePrpList (
     DEBUG ((EFI_D_ERROR, "NvmeCreatePrpList: create PrpList failure!\n"));
     goto EXIT;
   }
-  //
-  // Fill all PRP lists except of last one.
-  //
   ZeroMem (*PrpListHost, Bytes);
-  for (PrpListIndex = 0; PrpListIndex < *PrpListNo - 1; ++PrpListIndex) {
-    PrpListBase = *(UINT8*)PrpListHost + PrpListIndex * EFI_PAGE_SIZE;
+  for (PrpListIndex = 0; PrpListIndex < *PrpListNo; ++PrpListIndex) {
+    PrpListBase = (UINTN)*PrpListHost + PrpListIndex * EFI_PAGE_SIZE;
 
-    for (PrpEntryIndex = 0; PrpEntryIndex < PrpEntryNo; ++PrpEntryIndex) {
-      if (PrpEntryIndex != PrpEntryNo - 1) {
-        //
-        // Fill all PRP entries except of last one.
-        //
-        *((UINT64*)(UINTN)PrpListBase + PrpEntryIndex) = PhysicalAddr;
-        PhysicalAddr += EFI_PAGE_SIZE;
-      } else {
+    for (PrpEntryIndex = 0; (PrpEntryIndex < PrpEntryNo) && (Pages > 0); ++PrpEntryIndex) {
+      if ((PrpEntryIndex == PrpEntryNo - 1) && (Pages > 1)) {
         //
         // Fill last PRP entries with next PRP List pointer.
         //
         *((UINT64*)(UINTN)PrpListBase + PrpEntryIndex) = PrpListPhyAddr + (PrpListIndex + 1) * EFI_PAGE_SIZE;
+      } else {
+        *((UINT64*)(UINTN)PrpListBase + PrpEntryIndex) = PhysicalAddr;
+        PhysicalAddr += EFI_PAGE_SIZE;
+        Pages--;
       }
     }
   }
-  //
-  // Fill last PRP list.
-  //
-  PrpListBase = *(UINT64*)PrpListHost + PrpListIndex * EFI_PAGE_SIZE;
-  for (PrpEntryIndex = 0; PrpEntryIndex < ((Remainder != 0) ? Remainder : PrpEntryNo); ++PrpEntryIndex) {
-    *((UINT64*)(UINTN)PrpListBase + PrpEntryIndex) = PhysicalAddr;
-    PhysicalAddr += EFI_PAGE_SIZE;
-  }
 
   return (VOID*)(UINTN)PrpListPhyAddr;
 
@@ -389,6 +375,8 @@ NvmExpressPassThru (
   VOID                          *PrpListHost;
   UINTN                         PrpListNo;
   UINT32                        Data;
+  EFI_TPL                       OldTpl;
+  NVME_PASS_THRU_ASYNC_REQ      *AsyncRequest;
 
   //
   // check the data fields in Packet parameter.
@@ -416,27 +404,56 @@ NvmExpressPassThru (
   TimerEvent  = NULL;
   Status      = EFI_SUCCESS;
 
-  Qid = Packet->QueueId;
-  Sq  = Private->SqBuffer[Qid] + Private->SqTdbl[Qid].Sqt;
-  Cq  = Private->CqBuffer[Qid] + Private->CqHdbl[Qid].Cqh;
-
   if (Packet->NvmeCmd->Nsid != NamespaceId) {
     return EFI_INVALID_PARAMETER;
   }
 
+  Qid    = Packet->QueueId;
+  OldTpl = TPL_APPLICATION;
+  if ((Event != NULL) && (Qid == NVME_IO_QUEUE)) {
+    //
+    // Nonblocking I/O commands go through their own, deeper queue, which is
+    // shared with ProcessAsyncTaskList() running at TPL_NOTIFY.
+    //
+    Qid    = NVME_ASYNC_IO_QUEUE;
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    if ((Private->SqTdbl[Qid].Sqt + 1) % Private->AsyncQueueSize == Private->AsyncSqHead) {
+      gBS->RestoreTPL (OldTpl);
+      return EFI_NOT_READY;
+    }
+  }
+
+  Sq  = Private->SqBuffer[Qid] + Private->SqTdbl[Qid].Sqt;
+  Cq  = Private->CqBuffer[Qid] + Private->CqHdbl[Qid].Cqh;
+
   ZeroMem (Sq, sizeof (NVME_SQ));
   Sq->Opc  = Packet->NvmeCmd->Cdw0.Opcode;
   Sq->Fuse = Packet->NvmeCmd->Cdw0.FusedOperation;
   Sq->Cid  = Packet->NvmeCmd->Cdw0.Cid;
   Sq->Nsid = Packet->NvmeCmd->Nsid;
 
+  if (Qid == NVME_ASYNC_IO_QUEUE) {
+    //
+    // The completions of the nonblocking commands are matched to their requests
+    // by command identifier, so it must be unique among the commands in flight.
+    //
+    Sq->Cid = Private->Cid[Qid]++;
+  } else {
+    //
+    // A controller reset by ProcessAsyncTaskList() must not happen while this
+    // command is in the blocking queues.
+    //
+    Private->BlockingCommands++;
+  }
+
   //
   // Currently we only support PRP for data transfer, SGL is NOT supported.
   //
   ASSERT (Sq->Psdt == 0);
   if (Sq->Psdt != 0) {
     DEBUG ((EFI_D_ERROR, "NvmExpressPassThru: doesn't support SGL mechanism\n"));
-    return EFI_UNSUPPORTED;
+    Status = EFI_UNSUPPORTED;
+    goto EXIT;
   }
 
   Sq->Prp[0] = (UINT64)(UINTN)Packet->TransferBuffer;
@@ -463,7 +480,8 @@ NvmExpressPassThru (
                       &MapData
                       );
     if (EFI_ERROR (Status) || (Packet->TransferLength != MapLength)) {
-      return EFI_OUT_OF_RESOURCES;
+      Status = EFI_OUT_OF_RESOURCES;
+      goto EXIT;
     }
 
     Sq->Prp[0] = PhyAddr;
@@ -481,12 +499,8 @@ NvmExpressPassThru (
                         &MapMeta
                         );
       if (EFI_ERROR (Status) || (Packet->MetadataLength != MapLength)) {
-        PciIo->Unmap (
-                 PciIo,
-                 MapData
-                 );
-
-        return EFI_OUT_OF_RESOURCES;
+        Status = EFI_OUT_OF_RESOURCES;
+        goto EXIT;
       }
       Sq->Mptr = PhyAddr;
     }
@@ -505,6 +519,7 @@ NvmExpressPassThru (
     PhyAddr = (Sq->Prp[0] + EFI_PAGE_SIZE) & ~(EFI_PAGE_SIZE - 1);
     Prp = NvmeCreatePrpList (PciIo, PhyAddr, EFI_SIZE_TO_PAGES(Offset + Bytes) - 1, &PrpListHost, &PrpListNo, &MapPrpList);
     if (Prp == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
       goto EXIT;
     }
 
@@ -532,10 +547,45 @@ NvmExpressPassThru (
     Sq->Payload.Raw.Cdw15 = Packet->NvmeCmd->Cdw15;
   }
 
+  //
+  // Nonblocking commands are completed by ProcessAsyncTaskList(), which releases
+  // the mappings and the PRP list then.
+  //
+  if (Qid == NVME_ASYNC_IO_QUEUE) {
+    AsyncRequest = AllocateZeroPool (sizeof (NVME_PASS_THRU_ASYNC_REQ));
+    if (AsyncRequest == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      goto EXIT;
+    }
+
+    AsyncRequest->Signature   = NVME_PASS_THRU_ASYNC_REQ_SIG;
+    AsyncRequest->Packet      = Packet;
+    AsyncRequest->CommandId   = Sq->Cid;
+    AsyncRequest->Timeout     = Packet->CommandTimeout;
+    AsyncRequest->MapData     = MapData;
+    AsyncRequest->MapMeta     = MapMeta;
+    AsyncRequest->MapPrpList  = MapPrpList;
+    AsyncRequest->PrpListNo   = PrpListNo;
+    AsyncRequest->PrpListHost = PrpListHost;
+    AsyncRequest->CallerEvent = Event;
+    InsertTailList (&Private->AsyncPassThruQueue, &AsyncRequest->Link);
+
+    MapData    = NULL;
+    MapMeta    = NULL;
+    MapPrpList = NULL;
+    Prp        = NULL;
+  }
+
   //
   // Ring the submission queue doorbell.
   //
-  Private->SqTdbl[Qid].Sqt ^= 1;
+  if (Qid == NVME_ASYNC_IO_QUEUE) {
+    if (++Private->SqTdbl[Qid].Sqt == Private->AsyncQueueSize) {
+      Private->SqTdbl[Qid].Sqt = 0;
+    }
+  } else {
+    Private->SqTdbl[Qid].Sqt ^= 1;
+  }
   Data = ReadUnaligned32 ((UINT32*)&Private->SqTdbl[Qid]);
   PciIo->Mem.Write (
                PciIo,
@@ -546,6 +596,10 @@ NvmExpressPassThru (
                &Data
                );
 
+  if (Qid == NVME_ASYNC_IO_QUEUE) {
+    goto EXIT;
+  }
+
   Status = gBS->CreateEvent (
                   EVT_TIMER,
                   TPL_CALLBACK,
@@ -632,6 +686,12 @@ EXIT:
   if (TimerEvent != NULL) {
     gBS->CloseEvent (TimerEvent);
   }
+
+  if (Qid == NVME_ASYNC_IO_QUEUE) {
+    gBS->RestoreTPL (OldTpl);
+  } else {
+    Private->BlockingCommands--;
+  }
   return Status;
 }
 
@@ -209,6 +209,45 @@ XhcFreeUrb (
   FreePool (Urb);
 }
 
+/**
+  Calculate the TD Size of a Normal TRB, which tells the xHC how much of
+  the TD is left after this TRB. Check xHCI 4.11.2.4 for the details.
+
+  @param  Xhc          The XHCI Instance.
+  @param  Urb          The URB that the TRB belongs to.
+  @param  Transferred  The number of bytes of the TD up to and including the TRB.
+
+  @return The value of the TD Size field.
+
+**/
+UINT32
+XhcTdSize (
+  IN USB_XHCI_INSTANCE          *Xhc,
+  IN URB                        *Urb,
+  IN UINTN                      Transferred
+  )
+{
+  UINTN                         Remainder;
+
+  if ((Transferred >= Urb->DataLen) || (Urb->Ep.MaxPacket == 0)) {
+    return 0;
+  }
+
+  if (Xhc->HciVersion < 0x100) {
+    //
+    // xHCI 0.96 counts the remaining bytes in units of 1KB.
+    //
+    Remainder = (Urb->DataLen - Transferred) >> 10;
+  } else {
+    //
+    // xHCI 1.0 counts the packets left in the TD after this TRB.
+    //
+    Remainder = (Urb->DataLen + Urb->Ep.MaxPacket - 1) / Urb->Ep.MaxPacket - Transferred / Urb->Ep.MaxPacket;
+  }
+
+  return (UINT32) MIN (Remainder, 31);
+}
+
 /**
   Create a transfer TRB.
 
@@ -374,59 +413,31 @@ XhcCreateTransferTrb (
 
     case ED_BULK_OUT:
     case ED_BULK_IN:
-      TotalLen = 0;
-      Len      = 0;
-      TrbNum   = 0;
-      TrbStart = (TRB *)(UINTN)EPRing->RingEnqueue;
-      while (TotalLen < Urb->DataLen) {
-        if ((TotalLen + 0x10000) >= Urb->DataLen) {
-          Len = Urb->DataLen - TotalLen;
-        } else {
-          Len = 0x10000;
-        }
-        TrbStart = (TRB *)(UINTN)EPRing->RingEnqueue;
-        TrbStart->TrbNormal.TRBPtrLo  = XHC_LOW_32BIT((UINT8 *) Urb->DataPhy + TotalLen);
-        TrbStart->TrbNormal.TRBPtrHi  = XHC_HIGH_32BIT((UINT8 *) Urb->DataPhy + TotalLen);
-        TrbStart->TrbNormal.Lenth     = (UINT32) Len;
-        TrbStart->TrbNormal.TDSize    = 0;
-        TrbStart->TrbNormal.IntTarget = 0;
-        TrbStart->TrbNormal.ISP       = 1;
-        TrbStart->TrbNormal.IOC       = 1;
-        TrbStart->TrbNormal.Type      = TRB_TYPE_NORMAL;
-        //
-        // Update the cycle bit
-        //
-        TrbStart->TrbNormal.CycleBit = EPRing->RingPCS & BIT0;
-
-        XhcSyncTrsRing (Xhc, EPRing);
-        TrbNum++;
-        TotalLen += Len;
-      }
-
-      Urb->TrbNum = TrbNum;
-      Urb->TrbEnd = (TRB_TEMPLATE *)(UINTN)TrbStart;
-      break;
-
     case ED_INTERRUPT_OUT:
     case ED_INTERRUPT_IN:
+      //
+      // Build the transfer as one TD of chained Normal TRBs, so all of it is
+      // queued on the ring before the door bell is rung, and a short packet
+      // ends the whole TD. The buffer of a TRB can't cross a 64KB boundary.
+      //
       TotalLen = 0;
       Len      = 0;
       TrbNum   = 0;
       TrbStart = (TRB *)(UINTN)EPRing->RingEnqueue;
       while (TotalLen < Urb->DataLen) {
-        if ((TotalLen + 0x10000) >= Urb->DataLen) {
+        Len = 0x10000 - (((UINTN) Urb->DataPhy + TotalLen) & 0xFFFF);
+        if (Len > Urb->DataLen - TotalLen) {
           Len = Urb->DataLen - TotalLen;
-        } else {
-          Len = 0x10000;
         }
         TrbStart = (TRB *)(UINTN)EPRing->RingEnqueue;
         TrbStart->TrbNormal.TRBPtrLo  = XHC_LOW_32BIT((UINT8 *) Urb->DataPhy + TotalLen);
         TrbStart->TrbNormal.TRBPtrHi  = XHC_HIGH_32BIT((UINT8 *) Urb->DataPhy + TotalLen);
         TrbStart->TrbNormal.Lenth     = (UINT32) Len;
-        TrbStart->TrbNormal.TDSize    = 0;
+        TrbStart->TrbNormal.TDSize    = XhcTdSize (Xhc, Urb, TotalLen + Len);
         TrbStart->TrbNormal.IntTarget = 0;
         TrbStart->TrbNormal.ISP       = 1;
         TrbStart->TrbNormal.IOC       = 1;
+        TrbStart->TrbNormal.CH        = (TotalLen + Len < Urb->DataLen) ? 1 : 0;
         TrbStart->TrbNormal.Type      = TRB_TYPE_NORMAL;
         //
         // Update the cycle bit
@@ -1003,15 +1014,22 @@ IsTransferRingTrb (
   TRB_TEMPLATE  *CheckedTrb;
   UINTN         Index;
 
-  CheckedTrb = Urb->Ring->RingSeg0;
-
   ASSERT (Urb->Ring->TrbNumber == CMD_RING_TRB_NUMBER || Urb->Ring->TrbNumber == TR_RING_TRB_NUMBER);
 
-  for (Index = 0; Index < Urb->Ring->TrbNumber; Index++) {
+  //
+  // Only match the TRBs of this URB, so a late event of an earlier transfer
+  // on the same ring isn't counted against it. Skip the Link TRB at the end
+  // of the segment.
+  //
+  CheckedTrb = Urb->TrbStart;
+  for (Index = 0; Index < Urb->TrbNum; Index++) {
     if (Trb == CheckedTrb) {
       return TRUE;
     }
     CheckedTrb++;
+    if ((UINTN)CheckedTrb >= ((UINTN) Urb->Ring->RingSeg0 + sizeof (TRB_TEMPLATE) * (Urb->Ring->TrbNumber - 1))) {
+      CheckedTrb = (TRB_TEMPLATE*) Urb->Ring->RingSeg0;
+    }
   }
 
   return FALSE;
@@ -1101,6 +1119,13 @@ XhcCheckUrbResult (
     } else {
       continue;
     }
+
+    if (CheckedUrb->Finished) {
+      //
+      // A TD ended early by a short packet may still report its last TRB.
+      //
+      continue;
+    }
   
     switch (EvtTrb->Completecode) {
       case TRB_COMPLETION_STALL_ERROR:
@@ -1133,11 +1158,26 @@ XhcCheckUrbResult (
           DEBUG ((EFI_D_ERROR, "XhcCheckUrbResult: short packet happens!\n"));
         }
 
+        //
+        // The event reports the residue of its own TRB, so add up what each
+        // TRB of a multi-TRB transfer moved.
+        //
         TRBType = (UINT8) (TRBPtr->Type);
         if ((TRBType == TRB_TYPE_DATA_STAGE) ||
             (TRBType == TRB_TYPE_NORMAL) ||
             (TRBType == TRB_TYPE_ISOCH)) {
-          CheckedUrb->Completed += (CheckedUrb->DataLen - EvtTrb->Lenth);
+          CheckedUrb->Completed += (((TRB *) TRBPtr)->TrbNormal.Lenth - EvtTrb->Lenth);
+        }
+
+        //
+        // A short packet in a chained TD ends the TD, the TRBs after it won't
+        // be executed or reported.
+        //
+        if ((EvtTrb->Completecode == TRB_COMPLETION_SHORT_PACKET) &&
+            (TRBType == TRB_TYPE_NORMAL) && (TRBPtr != CheckedUrb->TrbEnd)) {
+          CheckedUrb->Finished = TRUE;
+          CheckedUrb->EvtTrb   = (TRB_TEMPLATE *)EvtTrb;
+          continue;
         }
 
         break;
@@ -1771,6 +1811,11 @@ XhcSyncTrsRing (
     if ((UINT8) TrsTrb->Type == TRB_TYPE_LINK) {
       ASSERT (((LINK_TRB*)TrsTrb)->TC != 0);
       //
+      // A TD that continues past the end of the segment needs the chain
+      // bit in the Link TRB too.
+      //
+      ((LINK_TRB*)TrsTrb)->CH = ((TRANSFER_TRB_NORMAL*)(TrsTrb - 1))->CH;
+      //
       // set cycle bit in Link TRB as normal
       //
       ((LINK_TRB*)TrsTrb)->CycleBit = TrsRing->RingPCS & BIT0;
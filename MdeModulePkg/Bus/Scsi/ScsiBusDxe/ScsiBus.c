@@ -986,13 +986,32 @@ ScsiExecuteSCSICommand (
 
   if (ScsiIoDevice->ExtScsiSupport) {
     ExtRequestPacket = (EFI_EXT_SCSI_PASS_THRU_SCSI_REQUEST_PACKET *) Packet;
-    Status = ScsiIoDevice->ExtScsiPassThru->PassThru (
-                                          ScsiIoDevice->ExtScsiPassThru,
-                                          Target,
-                                          ScsiIoDevice->Lun,
-                                          ExtRequestPacket,
-                                          Event
-                                          );
+    if (((ScsiIoDevice->ExtScsiPassThru->Mode->Attributes & EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_NONBLOCKIO) != 0) && (Event !=  NULL)) {
+      Status = ScsiIoDevice->ExtScsiPassThru->PassThru (
+                                            ScsiIoDevice->ExtScsiPassThru,
+                                            Target,
+                                            ScsiIoDevice->Lun,
+                                            ExtRequestPacket,
+                                            Event
+                                            );
+    } else {
+      //
+      // If there's no event or the SCSI Device doesn't support NON-BLOCKING,
+      // the packet is executed synchronously. A blocking PassThru() ignores
+      // its Event parameter, so signal the caller's event here, to tell it to
+      // pick up the completed packet.
+      //
+      Status = ScsiIoDevice->ExtScsiPassThru->PassThru (
+                                            ScsiIoDevice->ExtScsiPassThru,
+                                            Target,
+                                            ScsiIoDevice->Lun,
+                                            ExtRequestPacket,
+                                            NULL
+                                            );
+      if (!EFI_ERROR (Status) && (Event != NULL)) {
+        gBS->SignalEvent (Event);
+      }
+    }
   } else {
 
     mWorkingBuffer = AllocatePool (sizeof(EFI_SCSI_PASS_THRU_SCSI_REQUEST_PACKET));
@@ -1052,7 +1071,7 @@ ScsiExecuteSCSICommand (
                                           ScsiIoDevice->Pun.ScsiId.Scsi,
                                           ScsiIoDevice->Lun,
                                           mWorkingBuffer,
-                                          Event
+                                          NULL
                                           );
       if (EFI_ERROR(Status)) {
         FreePool(mWorkingBuffer);
@@ -1065,6 +1084,13 @@ ScsiExecuteSCSICommand (
       // free mWorkingBuffer.
       //
       FreePool(mWorkingBuffer);
+
+      //
+      // Signal Event to tell caller to pick up the SCSI IO Packet.
+      //
+      if (Event != NULL) {
+        gBS->SignalEvent (Event);
+      }
     }
   }
   return Status;
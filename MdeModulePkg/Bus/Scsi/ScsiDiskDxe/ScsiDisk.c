@@ -239,7 +239,13 @@ ScsiDiskDriverBindingStart (
   ScsiDiskDevice->BlkIo.ReadBlocks     = ScsiDiskReadBlocks;
   ScsiDiskDevice->BlkIo.WriteBlocks    = ScsiDiskWriteBlocks;
   ScsiDiskDevice->BlkIo.FlushBlocks    = ScsiDiskFlushBlocks;
+  ScsiDiskDevice->BlkIo2.Media         = &ScsiDiskDevice->BlkIoMedia;
+  ScsiDiskDevice->BlkIo2.Reset         = ScsiDiskResetEx;
+  ScsiDiskDevice->BlkIo2.ReadBlocksEx  = ScsiDiskReadBlocksEx;
+  ScsiDiskDevice->BlkIo2.WriteBlocksEx = ScsiDiskWriteBlocksEx;
+  ScsiDiskDevice->BlkIo2.FlushBlocksEx = ScsiDiskFlushBlocksEx;
   ScsiDiskDevice->Handle               = Controller;
+  InitializeListHead (&ScsiDiskDevice->BlkIo2Queue);
 
   ScsiIo->GetDeviceType (ScsiIo, &(ScsiDiskDevice->DeviceType));
   switch (ScsiDiskDevice->DeviceType) {
@@ -308,6 +314,8 @@ ScsiDiskDriverBindingStart (
                       &Controller,
                       &gEfiBlockIoProtocolGuid,
                       &ScsiDiskDevice->BlkIo,
+                      &gEfiBlockIo2ProtocolGuid,
+                      &ScsiDiskDevice->BlkIo2,
                       &gEfiDiskInfoProtocolGuid,
                       &ScsiDiskDevice->DiskInfo,
                       NULL
@@ -391,10 +399,22 @@ ScsiDiskDriverBindingStop (
   }
 
   ScsiDiskDevice = SCSI_DISK_DEV_FROM_THIS (BlkIo);
+
+  //
+  // Wait for the Block I/O 2 requests in progress to complete. They can only
+  // complete if Stop() is called below TPL_CALLBACK.
+  //
+  Status = ScsiDiskWaitBlkIo2Requests (ScsiDiskDevice);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   Status = gBS->UninstallMultipleProtocolInterfaces (
                   Controller,
                   &gEfiBlockIoProtocolGuid,
                   &ScsiDiskDevice->BlkIo,
+                  &gEfiBlockIo2ProtocolGuid,
+                  &ScsiDiskDevice->BlkIo2,
                   &gEfiDiskInfoProtocolGuid,
                   &ScsiDiskDevice->DiskInfo,
                   NULL
@@ -522,6 +542,12 @@ ScsiDiskReadBlocks (
             &ScsiDiskDevice->BlkIo,
             &ScsiDiskDevice->BlkIo
             );
+      gBS->ReinstallProtocolInterface (
+            ScsiDiskDevice->Handle,
+            &gEfiBlockIo2ProtocolGuid,
+            &ScsiDiskDevice->BlkIo2,
+            &ScsiDiskDevice->BlkIo2
+            );
       Status = EFI_MEDIA_CHANGED;
       goto Done;
     }
@@ -640,6 +666,12 @@ ScsiDiskWriteBlocks (
             &ScsiDiskDevice->BlkIo,
             &ScsiDiskDevice->BlkIo
             );
+      gBS->ReinstallProtocolInterface (
+            ScsiDiskDevice->Handle,
+            &gEfiBlockIo2ProtocolGuid,
+            &ScsiDiskDevice->BlkIo2,
+            &ScsiDiskDevice->BlkIo2
+            );
       Status = EFI_MEDIA_CHANGED;
       goto Done;
     }
@@ -724,6 +756,383 @@ ScsiDiskFlushBlocks (
   return EFI_SUCCESS;
 }
 
+/**
+  Reset SCSI Disk.
+
+  @param  This                 The pointer of EFI_BLOCK_IO2_PROTOCOL
+  @param  ExtendedVerification The flag about if extend verificate
+
+  @retval EFI_SUCCESS          The device was reset.
+  @retval EFI_DEVICE_ERROR     The device is not functioning properly and could
+                               not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskResetEx (
+  IN  EFI_BLOCK_IO2_PROTOCOL  *This,
+  IN  BOOLEAN                 ExtendedVerification
+  )
+{
+  SCSI_DISK_DEV *ScsiDiskDevice;
+
+  ScsiDiskDevice = SCSI_DISK_DEV_FROM_BLKIO2 (This);
+
+  return ScsiDiskReset (&ScsiDiskDevice->BlkIo, ExtendedVerification);
+}
+
+/**
+  The function is to Read Block from SCSI Disk, blocking or non-blocking.
+
+  @param  This       The pointer of EFI_BLOCK_IO2_PROTOCOL.
+  @param  MediaId    The Id of Media detected
+  @param  Lba        The logic block address
+  @param  Token      A pointer to the token associated with the transaction.
+                     If it is NULL, or Token->Event is NULL, the read is
+                     blocking.
+  @param  BufferSize The size of Buffer
+  @param  Buffer     The buffer to fill the read out data
+
+  @retval EFI_SUCCESS           The read request was queued if Token->Event is
+                                not NULL, or the data was read.
+  @retval EFI_DEVICE_ERROR      Fail to detect media.
+  @retval EFI_NO_MEDIA          Media is not present.
+  @retval EFI_MEDIA_CHANGED     Media has changed.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size of the device.
+  @retval EFI_INVALID_PARAMETER Invalid parameter passed in.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN     UINT32                   MediaId,
+  IN     EFI_LBA                  Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token,
+  IN     UINTN                    BufferSize,
+     OUT VOID                     *Buffer
+  )
+{
+  SCSI_DISK_DEV       *ScsiDiskDevice;
+  EFI_BLOCK_IO_MEDIA  *Media;
+  EFI_STATUS          Status;
+  UINTN               BlockSize;
+  UINTN               NumberOfBlocks;
+  BOOLEAN             MediaChange;
+  EFI_TPL             OldTpl;
+
+  MediaChange    = FALSE;
+  OldTpl         = gBS->RaiseTPL (TPL_CALLBACK);
+  ScsiDiskDevice = SCSI_DISK_DEV_FROM_BLKIO2 (This);
+
+  if (!IS_DEVICE_FIXED(ScsiDiskDevice)) {
+
+    Status = ScsiDiskDetectMedia (ScsiDiskDevice, FALSE, &MediaChange);
+    if (EFI_ERROR (Status)) {
+      Status = EFI_DEVICE_ERROR;
+      goto Done;
+    }
+
+    if (MediaChange) {
+      gBS->ReinstallProtocolInterface (
+            ScsiDiskDevice->Handle,
+            &gEfiBlockIoProtocolGuid,
+            &ScsiDiskDevice->BlkIo,
+            &ScsiDiskDevice->BlkIo
+            );
+      gBS->ReinstallProtocolInterface (
+            ScsiDiskDevice->Handle,
+            &gEfiBlockIo2ProtocolGuid,
+            &ScsiDiskDevice->BlkIo2,
+            &ScsiDiskDevice->BlkIo2
+            );
+      Status = EFI_MEDIA_CHANGED;
+      goto Done;
+    }
+  }
+  //
+  // Get the intrinsic block size
+  //
+  Media           = ScsiDiskDevice->BlkIo.Media;
+  BlockSize       = Media->BlockSize;
+
+  NumberOfBlocks  = BufferSize / BlockSize;
+
+  if (!(Media->MediaPresent)) {
+    Status = EFI_NO_MEDIA;
+    goto Done;
+  }
+
+  if (MediaId != Media->MediaId) {
+    Status = EFI_MEDIA_CHANGED;
+    goto Done;
+  }
+
+  if (Buffer == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  if (BufferSize == 0) {
+    if ((Token != NULL) && (Token->Event != NULL)) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+
+    Status = EFI_SUCCESS;
+    goto Done;
+  }
+
+  if (BufferSize % BlockSize != 0) {
+    Status = EFI_BAD_BUFFER_SIZE;
+    goto Done;
+  }
+
+  if (Lba > Media->LastBlock) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  if ((Lba + NumberOfBlocks - 1) > Media->LastBlock) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  if ((Media->IoAlign > 1) && (((UINTN) Buffer & (Media->IoAlign - 1)) != 0)) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  //
+  // If all the parameters are valid, then perform read sectors command
+  // to transfer data from device to host.
+  //
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    Status = ScsiDiskAsyncReadWriteSectors (
+               ScsiDiskDevice,
+               Buffer,
+               Lba,
+               NumberOfBlocks,
+               FALSE,
+               Token
+               );
+  } else {
+    Status = ScsiDiskReadSectors (ScsiDiskDevice, Buffer, Lba, NumberOfBlocks);
+  }
+
+Done:
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  The function is to Write Block to SCSI Disk, blocking or non-blocking.
+
+  @param  This       The pointer of EFI_BLOCK_IO2_PROTOCOL.
+  @param  MediaId    The Id of Media detected
+  @param  Lba        The logic block address
+  @param  Token      A pointer to the token associated with the transaction.
+                     If it is NULL, or Token->Event is NULL, the write is
+                     blocking.
+  @param  BufferSize The size of Buffer
+  @param  Buffer     The buffer of data to be written into SCSI Disk
+
+  @retval EFI_SUCCESS           The write request was queued if Token->Event is
+                                not NULL, or the data was written.
+  @retval EFI_DEVICE_ERROR      Fail to detect media.
+  @retval EFI_NO_MEDIA          Media is not present.
+  @retval EFI_MEDIA_CHANGED     Media has changed.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size of the device.
+  @retval EFI_INVALID_PARAMETER Invalid parameter passed in.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN     UINT32                   MediaId,
+  IN     EFI_LBA                  Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token,
+  IN     UINTN                    BufferSize,
+  IN     VOID                     *Buffer
+  )
+{
+  SCSI_DISK_DEV       *ScsiDiskDevice;
+  EFI_BLOCK_IO_MEDIA  *Media;
+  EFI_STATUS          Status;
+  UINTN               BlockSize;
+  UINTN               NumberOfBlocks;
+  BOOLEAN             MediaChange;
+  EFI_TPL             OldTpl;
+
+  MediaChange    = FALSE;
+  OldTpl         = gBS->RaiseTPL (TPL_CALLBACK);
+  ScsiDiskDevice = SCSI_DISK_DEV_FROM_BLKIO2 (This);
+
+  if (!IS_DEVICE_FIXED(ScsiDiskDevice)) {
+
+    Status = ScsiDiskDetectMedia (ScsiDiskDevice, FALSE, &MediaChange);
+    if (EFI_ERROR (Status)) {
+      Status = EFI_DEVICE_ERROR;
+      goto Done;
+    }
+
+    if (MediaChange) {
+      gBS->ReinstallProtocolInterface (
+            ScsiDiskDevice->Handle,
+            &gEfiBlockIoProtocolGuid,
+            &ScsiDiskDevice->BlkIo,
+            &ScsiDiskDevice->BlkIo
+            );
+      gBS->ReinstallProtocolInterface (
+            ScsiDiskDevice->Handle,
+            &gEfiBlockIo2ProtocolGuid,
+            &ScsiDiskDevice->BlkIo2,
+            &ScsiDiskDevice->BlkIo2
+            );
+      Status = EFI_MEDIA_CHANGED;
+      goto Done;
+    }
+  }
+  //
+  // Get the intrinsic block size
+  //
+  Media           = ScsiDiskDevice->BlkIo.Media;
+  BlockSize       = Media->BlockSize;
+
+  NumberOfBlocks  = BufferSize / BlockSize;
+
+  if (!(Media->MediaPresent)) {
+    Status = EFI_NO_MEDIA;
+    goto Done;
+  }
+
+  if (MediaId != Media->MediaId) {
+    Status = EFI_MEDIA_CHANGED;
+    goto Done;
+  }
+
+  if (BufferSize == 0) {
+    if ((Token != NULL) && (Token->Event != NULL)) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+
+    Status = EFI_SUCCESS;
+    goto Done;
+  }
+
+  if (Buffer == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  if (BufferSize % BlockSize != 0) {
+    Status = EFI_BAD_BUFFER_SIZE;
+    goto Done;
+  }
+
+  if (Lba > Media->LastBlock) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  if ((Lba + NumberOfBlocks - 1) > Media->LastBlock) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  if ((Media->IoAlign > 1) && (((UINTN) Buffer & (Media->IoAlign - 1)) != 0)) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+  //
+  // if all the parameters are valid, then perform read sectors command
+  // to transfer data from device to host.
+  //
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    Status = ScsiDiskAsyncReadWriteSectors (
+               ScsiDiskDevice,
+               Buffer,
+               Lba,
+               NumberOfBlocks,
+               TRUE,
+               Token
+               );
+  } else {
+    Status = ScsiDiskWriteSectors (ScsiDiskDevice, Buffer, Lba, NumberOfBlocks);
+  }
+
+Done:
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Flush Block to Disk.
+
+  A nonblocking flush is queued behind the Block I/O 2 requests in progress,
+  and its token is signaled once they have all completed. A blocking flush
+  waits for them with ScsiDiskWaitBlkIo2Requests().
+
+  @param  This              The pointer of EFI_BLOCK_IO2_PROTOCOL
+  @param  Token             A pointer to the token associated with the
+                            transaction, or NULL.
+
+  @retval EFI_SUCCESS           All outstanding data was written to the device,
+                                or the flush was queued.
+  @retval EFI_DEVICE_ERROR      The Block I/O 2 requests in progress did not
+                                complete.
+  @retval EFI_OUT_OF_RESOURCES  The flush could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token
+  )
+{
+  SCSI_DISK_DEV        *ScsiDiskDevice;
+  SCSI_BLKIO2_REQUEST  *BlkIo2Req;
+  EFI_TPL              OldTpl;
+  EFI_STATUS           Status;
+
+  ScsiDiskDevice = SCSI_DISK_DEV_FROM_BLKIO2 (This);
+
+  if ((Token == NULL) || (Token->Event == NULL)) {
+    return ScsiDiskWaitBlkIo2Requests (ScsiDiskDevice);
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Status = EFI_SUCCESS;
+  Token->TransactionStatus = EFI_SUCCESS;
+  if (IsListEmpty (&ScsiDiskDevice->BlkIo2Queue)) {
+    gBS->SignalEvent (Token->Event);
+  } else {
+    //
+    // Nothing is cached by the driver, so the flush is done when the
+    // requests queued before it are.
+    //
+    BlkIo2Req = AllocateZeroPool (sizeof (SCSI_BLKIO2_REQUEST));
+    if (BlkIo2Req == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+    } else {
+      BlkIo2Req->Token = Token;
+      InitializeListHead (&BlkIo2Req->ScsiRWQueue);
+      InsertTailList (&ScsiDiskDevice->BlkIo2Queue, &BlkIo2Req->Link);
+    }
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
 
 /**
   Detect Device and read out capacity ,if error occurs, parse the sense key.
@@ -2052,6 +2461,314 @@ ScsiDiskWriteSectors (
   return EFI_SUCCESS;
 }
 
+/**
+  Read or write sectors of SCSI Disk for a Block I/O 2 token.
+
+  The transfer is split into SCSI commands, which are all sent to the device
+  before the function returns. The token is signaled when the last of them
+  has completed; a command that fails is sent again by ScsiDiskNotify() up to
+  SCSI_DISK_ASYNC_RETRY_COUNT times, and Token->TransactionStatus is set to
+  EFI_DEVICE_ERROR if it still fails.
+
+  @param  ScsiDiskDevice  The pointer of SCSI_DISK_DEV
+  @param  Buffer          The buffer to transfer data from or to
+  @param  Lba             Logic block address
+  @param  NumberOfBlocks  The number of blocks to transfer
+  @param  Write           TRUE for write, FALSE for read
+  @param  Token           The Block I/O 2 token to signal
+
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed, nothing was sent.
+  @retval EFI_SUCCESS           The commands were sent, or carried out.
+
+**/
+EFI_STATUS
+ScsiDiskAsyncReadWriteSectors (
+  IN  SCSI_DISK_DEV         *ScsiDiskDevice,
+  IN  VOID                  *Buffer,
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 NumberOfBlocks,
+  IN  BOOLEAN               Write,
+  IN  EFI_BLOCK_IO2_TOKEN   *Token
+  )
+{
+  SCSI_BLKIO2_REQUEST              *BlkIo2Req;
+  SCSI_ASYNC_RW_REQUEST            *Request;
+  EFI_SCSI_IO_SCSI_REQUEST_PACKET  *Packet;
+  UINTN                            BlocksRemaining;
+  UINT8                            *PtrBuffer;
+  UINT32                           BlockSize;
+  UINT32                           ByteCount;
+  UINT32                           MaxBlock;
+  UINT32                           SectorCount;
+  EFI_STATUS                       Status;
+
+  BlkIo2Req = AllocateZeroPool (sizeof (SCSI_BLKIO2_REQUEST));
+  if (BlkIo2Req == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  BlkIo2Req->Token = Token;
+  InitializeListHead (&BlkIo2Req->ScsiRWQueue);
+  InsertTailList (&ScsiDiskDevice->BlkIo2Queue, &BlkIo2Req->Link);
+
+  BlocksRemaining = NumberOfBlocks;
+  BlockSize       = ScsiDiskDevice->BlkIo.Media->BlockSize;
+  PtrBuffer       = Buffer;
+
+  //
+  // Commands of moderate size let the device work on several of them at
+  // once; SCSI_DISK_ASYNC_REQUEST_SIZE is well below the transfer length
+  // limit of Read(10) and Write(10).
+  //
+  MaxBlock = MAX (SCSI_DISK_ASYNC_REQUEST_SIZE / BlockSize, 1);
+
+  while (BlocksRemaining > 0) {
+    SectorCount = (UINT32) MIN (BlocksRemaining, MaxBlock);
+    ByteCount   = SectorCount * BlockSize;
+
+    Request = AllocateZeroPool (sizeof (SCSI_ASYNC_RW_REQUEST));
+    if (Request == NULL) {
+      break;
+    }
+
+    Request->ScsiDiskDevice = ScsiDiskDevice;
+    Request->BlkIo2Req      = BlkIo2Req;
+    Request->Write          = Write;
+    Request->Buffer         = PtrBuffer;
+    Request->StartLba       = Lba;
+    Request->SectorCount    = SectorCount;
+
+    //
+    // Fill Cdb for Read/Write (10) or (16) Command, as ScsiDiskRead10() and
+    // friends do through UefiScsiLib. Sense data is not requested; a command
+    // that does not succeed is sent again by ScsiDiskNotify().
+    //
+    Packet          = &Request->Packet;
+    Packet->Timeout = EFI_TIMER_PERIOD_SECONDS (ByteCount / 2100000 + 31);
+    Packet->Cdb     = Request->Cdb;
+    if (Write) {
+      Packet->OutDataBuffer     = PtrBuffer;
+      Packet->OutTransferLength = ByteCount;
+      Packet->DataDirection     = EFI_SCSI_DATA_OUT;
+    } else {
+      Packet->InDataBuffer      = PtrBuffer;
+      Packet->InTransferLength  = ByteCount;
+      Packet->DataDirection     = EFI_SCSI_DATA_IN;
+    }
+    if (!ScsiDiskDevice->Cdb16Byte) {
+      Request->Cdb[0] = Write ? EFI_SCSI_OP_WRITE10 : EFI_SCSI_OP_READ10;
+      WriteUnaligned32 ((UINT32 *) &Request->Cdb[2], SwapBytes32 ((UINT32) Lba));
+      WriteUnaligned16 ((UINT16 *) &Request->Cdb[7], SwapBytes16 ((UINT16) SectorCount));
+      Packet->CdbLength = SCSI_DISK_CDB_LENGTH_TEN;
+    } else {
+      Request->Cdb[0] = Write ? EFI_SCSI_OP_WRITE16 : EFI_SCSI_OP_READ16;
+      WriteUnaligned64 ((UINT64 *) &Request->Cdb[2], SwapBytes64 (Lba));
+      WriteUnaligned32 ((UINT32 *) &Request->Cdb[10], SwapBytes32 (SectorCount));
+      Packet->CdbLength = SCSI_DISK_CDB_LENGTH_SIXTEEN;
+    }
+
+    Status = gBS->CreateEvent (
+                    EVT_NOTIFY_SIGNAL,
+                    TPL_CALLBACK,
+                    ScsiDiskNotify,
+                    Request,
+                    &Request->Event
+                    );
+    if (EFI_ERROR (Status)) {
+      FreePool (Request);
+      break;
+    }
+
+    //
+    // The callers run at TPL_CALLBACK, so ScsiDiskNotify() cannot run before
+    // all the commands are sent, even if the SCSI bus signals the event
+    // right away.
+    //
+    InsertTailList (&BlkIo2Req->ScsiRWQueue, &Request->Link);
+    Status = ScsiDiskDevice->ScsiIo->ExecuteScsiCommand (
+                                       ScsiDiskDevice->ScsiIo,
+                                       Packet,
+                                       Request->Event
+                                       );
+    if (EFI_ERROR (Status)) {
+      RemoveEntryList (&Request->Link);
+      gBS->CloseEvent (Request->Event);
+      FreePool (Request);
+      break;
+    }
+
+    Lba             += SectorCount;
+    PtrBuffer       += ByteCount;
+    BlocksRemaining -= SectorCount;
+  }
+
+  //
+  // If a command could not be sent, carry out the rest of the transfer
+  // synchronously.
+  //
+  if (BlocksRemaining > 0) {
+    if (Write) {
+      Status = ScsiDiskWriteSectors (ScsiDiskDevice, PtrBuffer, Lba, BlocksRemaining);
+    } else {
+      Status = ScsiDiskReadSectors (ScsiDiskDevice, PtrBuffer, Lba, BlocksRemaining);
+    }
+    if (EFI_ERROR (Status)) {
+      Token->TransactionStatus = EFI_DEVICE_ERROR;
+    }
+  }
+
+  if (IsListEmpty (&BlkIo2Req->ScsiRWQueue)) {
+    ScsiDiskCompleteBlkIo2Request (ScsiDiskDevice, BlkIo2Req);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Completion routine of a SCSI command sent by ScsiDiskAsyncReadWriteSectors().
+
+  A command that failed is sent again, up to SCSI_DISK_ASYNC_RETRY_COUNT times,
+  and completes through this function again. The blocking retry, back-off and
+  sense data parsing of ScsiDiskReadSectors() and ScsiDiskWriteSectors() are
+  not used, because they would block the other TPL_CALLBACK notifications for
+  as long as they take.
+
+  @param  Event    The event of the SCSI command.
+  @param  Context  The SCSI_ASYNC_RW_REQUEST of the command.
+
+**/
+VOID
+EFIAPI
+ScsiDiskNotify (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  )
+{
+  SCSI_ASYNC_RW_REQUEST            *Request;
+  SCSI_BLKIO2_REQUEST              *BlkIo2Req;
+  SCSI_DISK_DEV                    *ScsiDiskDevice;
+  EFI_SCSI_IO_SCSI_REQUEST_PACKET  *Packet;
+  EFI_BLOCK_IO2_TOKEN              *Token;
+  UINT32                           ByteCount;
+  UINT32                           TransferLength;
+  EFI_STATUS                       Status;
+
+  Request        = (SCSI_ASYNC_RW_REQUEST *) Context;
+  BlkIo2Req      = Request->BlkIo2Req;
+  ScsiDiskDevice = Request->ScsiDiskDevice;
+  Packet         = &Request->Packet;
+  Token          = BlkIo2Req->Token;
+
+  ByteCount      = Request->SectorCount * ScsiDiskDevice->BlkIo.Media->BlockSize;
+  TransferLength = Request->Write ? Packet->OutTransferLength : Packet->InTransferLength;
+
+  if ((CheckHostAdapterStatus (Packet->HostAdapterStatus) != EFI_SUCCESS) ||
+      (Packet->TargetStatus != EFI_EXT_SCSI_STATUS_TARGET_GOOD) ||
+      (TransferLength != ByteCount)) {
+    DEBUG ((EFI_D_ERROR, "ScsiDiskNotify: HostAdapterStatus %x, TargetStatus %x\n",
+      Packet->HostAdapterStatus, Packet->TargetStatus));
+    if (Request->RetryCount < SCSI_DISK_ASYNC_RETRY_COUNT) {
+      //
+      // Send the command again, with the event of this notification.
+      //
+      Request->RetryCount++;
+      Packet->HostAdapterStatus = 0;
+      Packet->TargetStatus      = 0;
+      Packet->SenseDataLength   = 0;
+      if (Request->Write) {
+        Packet->OutTransferLength = ByteCount;
+      } else {
+        Packet->InTransferLength  = ByteCount;
+      }
+      Status = ScsiDiskDevice->ScsiIo->ExecuteScsiCommand (
+                                         ScsiDiskDevice->ScsiIo,
+                                         Packet,
+                                         Event
+                                         );
+      if (!EFI_ERROR (Status)) {
+        return;
+      }
+    }
+    Token->TransactionStatus = EFI_DEVICE_ERROR;
+  }
+
+  RemoveEntryList (&Request->Link);
+  gBS->CloseEvent (Event);
+  FreePool (Request);
+
+  if (IsListEmpty (&BlkIo2Req->ScsiRWQueue)) {
+    ScsiDiskCompleteBlkIo2Request (ScsiDiskDevice, BlkIo2Req);
+  }
+}
+
+/**
+  Complete a Block I/O 2 request whose SCSI commands are all done, and then the
+  flushes that were only waiting for it.
+
+  @param  ScsiDiskDevice  The pointer of SCSI_DISK_DEV
+  @param  BlkIo2Req       The request, which is removed from the queue and freed
+
+**/
+VOID
+ScsiDiskCompleteBlkIo2Request (
+  IN  SCSI_DISK_DEV         *ScsiDiskDevice,
+  IN  SCSI_BLKIO2_REQUEST   *BlkIo2Req
+  )
+{
+  RemoveEntryList (&BlkIo2Req->Link);
+  gBS->SignalEvent (BlkIo2Req->Token->Event);
+  FreePool (BlkIo2Req);
+
+  //
+  // The flushes at the head of the queue have no request before them left.
+  //
+  while (!IsListEmpty (&ScsiDiskDevice->BlkIo2Queue)) {
+    BlkIo2Req = BASE_CR (GetFirstNode (&ScsiDiskDevice->BlkIo2Queue), SCSI_BLKIO2_REQUEST, Link);
+    if (!IsListEmpty (&BlkIo2Req->ScsiRWQueue)) {
+      break;
+    }
+    RemoveEntryList (&BlkIo2Req->Link);
+    gBS->SignalEvent (BlkIo2Req->Token->Event);
+    FreePool (BlkIo2Req);
+  }
+}
+
+/**
+  Wait for the Block I/O 2 requests of a SCSI disk to complete.
+
+  The requests complete in ScsiDiskNotify() at TPL_CALLBACK, so the caller must
+  run below TPL_CALLBACK for them to make progress.
+
+  @param  ScsiDiskDevice    The pointer of SCSI_DISK_DEV
+
+  @retval EFI_SUCCESS       No Block I/O 2 request is in progress.
+  @retval EFI_DEVICE_ERROR  Requests are still in progress after
+                            SCSI_DISK_BLKIO2_WAIT_TIMEOUT, or the caller runs
+                            at TPL_CALLBACK or higher.
+
+**/
+EFI_STATUS
+ScsiDiskWaitBlkIo2Requests (
+  IN  SCSI_DISK_DEV         *ScsiDiskDevice
+  )
+{
+  EFI_TPL  Tpl;
+  UINT64   Delay;
+
+  Tpl   = EfiGetCurrentTpl ();
+  Delay = 0;
+  while (!IsListEmpty (&ScsiDiskDevice->BlkIo2Queue)) {
+    if ((Tpl >= TPL_CALLBACK) || (Delay >= SCSI_DISK_BLKIO2_WAIT_TIMEOUT)) {
+      DEBUG ((EFI_D_ERROR, "ScsiDiskWaitBlkIo2Requests: Block I/O 2 requests still in progress\n"));
+      return EFI_DEVICE_ERROR;
+    }
+    gBS->Stall (1000);
+    Delay += EFI_TIMER_PERIOD_MILLISECONDS (1);
+  }
+
+  return EFI_SUCCESS;
+}
+
 
 /**
   Submit Read(10) command.
@@ -22,12 +22,14 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Protocol/ScsiIo.h>
 #include <Protocol/ComponentName.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DriverBinding.h>
 #include <Protocol/ScsiPassThruExt.h>
 #include <Protocol/ScsiPassThru.h>
 #include <Protocol/DiskInfo.h>
 
 
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/UefiDriverEntryPoint.h>
 #include <Library/UefiLib.h>
@@ -50,6 +52,7 @@ typedef struct {
   EFI_HANDLE                Handle;
 
   EFI_BLOCK_IO_PROTOCOL     BlkIo;
+  EFI_BLOCK_IO2_PROTOCOL    BlkIo2;
   EFI_BLOCK_IO_MEDIA        BlkIoMedia;
   EFI_SCSI_IO_PROTOCOL      *ScsiIo;
   UINT8                     DeviceType;
@@ -75,10 +78,53 @@ typedef struct {
   // The flag indicates if 16-byte command can be used
   //
   BOOLEAN                   Cdb16Byte;
+
+  //
+  // The Block I/O 2 requests in progress (SCSI_BLKIO2_REQUEST)
+  //
+  LIST_ENTRY                BlkIo2Queue;
 } SCSI_DISK_DEV;
 
 #define SCSI_DISK_DEV_FROM_THIS(a)  CR (a, SCSI_DISK_DEV, BlkIo, SCSI_DISK_DEV_SIGNATURE)
 
+#define SCSI_DISK_DEV_FROM_BLKIO2(a)  CR (a, SCSI_DISK_DEV, BlkIo2, SCSI_DISK_DEV_SIGNATURE)
+
+//
+// CDB lengths of the Read/Write (10) and (16) commands
+//
+#define SCSI_DISK_CDB_LENGTH_TEN      10
+#define SCSI_DISK_CDB_LENGTH_SIXTEEN  16
+
+//
+// A non-blocking read or write of the Block I/O 2 protocol. It is split into
+// SCSI commands of at most SCSI_DISK_ASYNC_REQUEST_SIZE bytes, which are all
+// sent to the device at once; the token is signaled when the last of them
+// completes. A non-blocking flush has no SCSI command; its token is signaled
+// when the requests queued before it have completed.
+//
+typedef struct {
+  LIST_ENTRY                Link;           // SCSI_DISK_DEV.BlkIo2Queue
+  EFI_BLOCK_IO2_TOKEN       *Token;
+  LIST_ENTRY                ScsiRWQueue;    // SCSI_ASYNC_RW_REQUEST in flight
+} SCSI_BLKIO2_REQUEST;
+
+//
+// A single READ or WRITE command of a Block I/O 2 request.
+//
+typedef struct {
+  LIST_ENTRY                      Link;     // SCSI_BLKIO2_REQUEST.ScsiRWQueue
+  SCSI_DISK_DEV                   *ScsiDiskDevice;
+  SCSI_BLKIO2_REQUEST             *BlkIo2Req;
+  BOOLEAN                         Write;
+  UINT8                           RetryCount;
+  UINT8                           *Buffer;
+  EFI_LBA                         StartLba;
+  UINT32                          SectorCount;
+  EFI_EVENT                       Event;
+  EFI_SCSI_IO_SCSI_REQUEST_PACKET Packet;
+  UINT8                           Cdb[SCSI_DISK_CDB_LENGTH_SIXTEEN];
+} SCSI_ASYNC_RW_REQUEST;
+
 #define SCSI_DISK_DEV_FROM_DISKINFO(a) CR (a, SCSI_DISK_DEV, DiskInfo, SCSI_DISK_DEV_SIGNATURE)
 
 //
@@ -104,6 +150,22 @@ extern EFI_COMPONENT_NAME2_PROTOCOL  gScsiDiskComponentName2;
 //
 #define SCSI_DISK_TIMEOUT           EFI_TIMER_PERIOD_SECONDS (3)
 
+//
+// Largest transfer of a single SCSI command sent for a Block I/O 2 request
+//
+#define SCSI_DISK_ASYNC_REQUEST_SIZE  SIZE_1MB
+
+//
+// Number of times a failed SCSI command of a Block I/O 2 request is sent again
+//
+#define SCSI_DISK_ASYNC_RETRY_COUNT   1
+
+//
+// Time to wait for the Block I/O 2 requests in progress: enough for a SCSI
+// command of SCSI_DISK_ASYNC_REQUEST_SIZE bytes and its retry to time out
+//
+#define SCSI_DISK_BLKIO2_WAIT_TIMEOUT EFI_TIMER_PERIOD_SECONDS (2 * 32)
+
 /**
   Test to see if this driver supports ControllerHandle.
 
@@ -410,6 +472,119 @@ ScsiDiskFlushBlocks (
   );
 
 
+/**
+  Reset SCSI Disk.
+
+  @param  This                 The pointer of EFI_BLOCK_IO2_PROTOCOL
+  @param  ExtendedVerification The flag about if extend verificate
+
+  @retval EFI_SUCCESS          The device was reset.
+  @retval EFI_DEVICE_ERROR     The device is not functioning properly and could
+                               not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskResetEx (
+  IN  EFI_BLOCK_IO2_PROTOCOL  *This,
+  IN  BOOLEAN                 ExtendedVerification
+  );
+
+
+/**
+  The function is to Read Block from SCSI Disk, blocking or non-blocking.
+
+  @param  This       The pointer of EFI_BLOCK_IO2_PROTOCOL.
+  @param  MediaId    The Id of Media detected
+  @param  Lba        The logic block address
+  @param  Token      A pointer to the token associated with the transaction.
+                     If it is NULL, or Token->Event is NULL, the read is
+                     blocking.
+  @param  BufferSize The size of Buffer
+  @param  Buffer     The buffer to fill the read out data
+
+  @retval EFI_SUCCESS           The read request was queued if Token->Event is
+                                not NULL, or the data was read.
+  @retval EFI_DEVICE_ERROR      Fail to detect media.
+  @retval EFI_NO_MEDIA          Media is not present.
+  @retval EFI_MEDIA_CHANGED     Media has changed.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size of the device.
+  @retval EFI_INVALID_PARAMETER Invalid parameter passed in.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN     UINT32                   MediaId,
+  IN     EFI_LBA                  Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token,
+  IN     UINTN                    BufferSize,
+     OUT VOID                     *Buffer
+  );
+
+
+/**
+  The function is to Write Block to SCSI Disk, blocking or non-blocking.
+
+  @param  This       The pointer of EFI_BLOCK_IO2_PROTOCOL.
+  @param  MediaId    The Id of Media detected
+  @param  Lba        The logic block address
+  @param  Token      A pointer to the token associated with the transaction.
+                     If it is NULL, or Token->Event is NULL, the write is
+                     blocking.
+  @param  BufferSize The size of Buffer
+  @param  Buffer     The buffer of data to be written into SCSI Disk
+
+  @retval EFI_SUCCESS           The write request was queued if Token->Event is
+                                not NULL, or the data was written.
+  @retval EFI_DEVICE_ERROR      Fail to detect media.
+  @retval EFI_NO_MEDIA          Media is not present.
+  @retval EFI_MEDIA_CHANGED     Media has changed.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size of the device.
+  @retval EFI_INVALID_PARAMETER Invalid parameter passed in.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN     UINT32                   MediaId,
+  IN     EFI_LBA                  Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token,
+  IN     UINTN                    BufferSize,
+  IN     VOID                     *Buffer
+  );
+
+
+/**
+  Flush Block to Disk.
+
+  A nonblocking flush is queued behind the Block I/O 2 requests in progress,
+  and its token is signaled once they have all completed. A blocking flush
+  waits for them with ScsiDiskWaitBlkIo2Requests().
+
+  @param  This              The pointer of EFI_BLOCK_IO2_PROTOCOL
+  @param  Token             A pointer to the token associated with the
+                            transaction, or NULL.
+
+  @retval EFI_SUCCESS           All outstanding data was written to the device,
+                                or the flush was queued.
+  @retval EFI_DEVICE_ERROR      The Block I/O 2 requests in progress did not
+                                complete.
+  @retval EFI_OUT_OF_RESOURCES  The flush could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+ScsiDiskFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token
+  );
+
+
 /**
   Provides inquiry information for the controller type.
   
@@ -717,6 +892,89 @@ ScsiDiskWriteSectors (
   IN  UINTN             NumberOfBlocks
   );
 
+/**
+  Read or write sectors of SCSI Disk for a Block I/O 2 token.
+
+  The transfer is split into SCSI commands, which are all sent to the device
+  before the function returns. The token is signaled when the last of them
+  has completed; a command that fails is sent again by ScsiDiskNotify() up to
+  SCSI_DISK_ASYNC_RETRY_COUNT times, and Token->TransactionStatus is set to
+  EFI_DEVICE_ERROR if it still fails.
+
+  @param  ScsiDiskDevice  The pointer of SCSI_DISK_DEV
+  @param  Buffer          The buffer to transfer data from or to
+  @param  Lba             Logic block address
+  @param  NumberOfBlocks  The number of blocks to transfer
+  @param  Write           TRUE for write, FALSE for read
+  @param  Token           The Block I/O 2 token to signal
+
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed, nothing was sent.
+  @retval EFI_SUCCESS           The commands were sent, or carried out.
+
+**/
+EFI_STATUS
+ScsiDiskAsyncReadWriteSectors (
+  IN  SCSI_DISK_DEV         *ScsiDiskDevice,
+  IN  VOID                  *Buffer,
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 NumberOfBlocks,
+  IN  BOOLEAN               Write,
+  IN  EFI_BLOCK_IO2_TOKEN   *Token
+  );
+
+/**
+  Completion routine of a SCSI command sent by ScsiDiskAsyncReadWriteSectors().
+
+  A command that failed is sent again, up to SCSI_DISK_ASYNC_RETRY_COUNT times,
+  and completes through this function again. The blocking retry, back-off and
+  sense data parsing of ScsiDiskReadSectors() and ScsiDiskWriteSectors() are
+  not used, because they would block the other TPL_CALLBACK notifications for
+  as long as they take.
+
+  @param  Event    The event of the SCSI command.
+  @param  Context  The SCSI_ASYNC_RW_REQUEST of the command.
+
+**/
+VOID
+EFIAPI
+ScsiDiskNotify (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  );
+
+/**
+  Complete a Block I/O 2 request whose SCSI commands are all done, and then the
+  flushes that were only waiting for it.
+
+  @param  ScsiDiskDevice  The pointer of SCSI_DISK_DEV
+  @param  BlkIo2Req       The request, which is removed from the queue and freed
+
+**/
+VOID
+ScsiDiskCompleteBlkIo2Request (
+  IN  SCSI_DISK_DEV         *ScsiDiskDevice,
+  IN  SCSI_BLKIO2_REQUEST   *BlkIo2Req
+  );
+
+/**
+  Wait for the Block I/O 2 requests of a SCSI disk to complete.
+
+  The requests complete in ScsiDiskNotify() at TPL_CALLBACK, so the caller must
+  run below TPL_CALLBACK for them to make progress.
+
+  @param  ScsiDiskDevice    The pointer of SCSI_DISK_DEV
+
+  @retval EFI_SUCCESS       No Block I/O 2 request is in progress.
+  @retval EFI_DEVICE_ERROR  Requests are still in progress after
+                            SCSI_DISK_BLKIO2_WAIT_TIMEOUT, or the caller runs
+                            at TPL_CALLBACK or higher.
+
+**/
+EFI_STATUS
+ScsiDiskWaitBlkIo2Requests (
+  IN  SCSI_DISK_DEV         *ScsiDiskDevice
+  );
+
 /**
   Submit Read(10) command.
 
@@ -33,6 +33,8 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/DevicePathLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/ReportStatusCodeLib.h>
+#include <Library/PerformanceLib.h>
+#include <Library/PrintLib.h>
 
 
 #include <IndustryStandard/Usb.h>
@@ -55,9 +57,17 @@ typedef struct _USB_HUB_API    USB_HUB_API;
 #define USB_MAX_LANG_ID           16
 #define USB_MAX_INTERFACE         16
 #define USB_MAX_DEVICES           128
+#define USB_MAX_HUB_PORT          255
 
 #define USB_BUS_1_MILLISECOND     1000
 
+//
+// Token and module string size of the per device enumeration
+// records in the performance log.
+//
+#define USB_PERF_TOKEN            "UsbEnum"
+#define USB_PERF_MODULE_SIZE      32
+
 //
 // Roothub and hub's polling interval, set by experience,
 // The unit of roothub is 100us, means 100ms as interval, and
@@ -638,8 +638,41 @@ UsbFindChild (
 }
 
 
+/**
+  Record the start or the end of the enumeration of the device on a hub
+  port in the performance log.
+
+  @param  HubIf                 The HUB that has the device connected.
+  @param  Port                  The port index of the hub (started with zero).
+  @param  Start                 TRUE to record the start, FALSE the end.
+
+**/
+VOID
+UsbEnumPerf (
+  IN USB_INTERFACE        *HubIf,
+  IN UINT8                Port,
+  IN BOOLEAN              Start
+  )
+{
+  CHAR8                   Module[USB_PERF_MODULE_SIZE];
+
+  if (!PerformanceMeasurementEnabled ()) {
+    return;
+  }
+
+  AsciiSPrint (Module, sizeof (Module), "UsbHub%dPort%d", HubIf->Device->Address, Port);
+
+  if (Start) {
+    PERF_START (HubIf->Device->Bus->HostHandle, USB_PERF_TOKEN, Module, 0);
+  } else {
+    PERF_END (HubIf->Device->Bus->HostHandle, USB_PERF_TOKEN, Module, 0);
+  }
+}
+
+
 /**
   Enumerate and configure the new device on the port of this HUB interface.
+  The port must have been reset already.
 
   @param  HubIf                 The HUB that has the device connected.
   @param  Port                  The port index of the hub (started with zero).
@@ -669,24 +702,6 @@ UsbEnumerateNewDev (
   HubApi  = HubIf->HubApi;  
   Address = Bus->MaxDevices;
 
-  gBS->Stall (USB_WAIT_PORT_STABLE_STALL);
-  
-  //
-  // Hub resets the device for at least 10 milliseconds.
-  // Host learns device speed. If device is of low/full speed
-  // and the hub is a EHCI root hub, ResetPort will release
-  // the device to its companion UHCI and return an error.
-  //
-  Status = HubApi->ResetPort (HubIf, Port);
-
-  if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "UsbEnumerateNewDev: failed to reset port %d - %r\n", Port, Status));
-
-    return Status;
-  }
-
-  DEBUG (( EFI_D_INFO, "UsbEnumerateNewDev: hub port %d is reset\n", Port));
-
   Child = UsbCreateDevice (HubIf, Port);
 
   if (Child == NULL) {
@@ -858,20 +873,26 @@ ON_ERROR:
 
 
 /**
-  Process the events on the port.
+  Process the events on the port. The device that was connected to the
+  port is removed. A newly connected device is only marked in NewDev, the
+  caller enumerates it with UsbEnumerateNewDevs, so that the debounce and
+  reset delays of several ports can overlap.
 
   @param  HubIf                 The HUB that has the device connected.
   @param  Port                  The port index of the hub (started with zero).
+  @param  NewDev                Which ports have a new device, indexed by port.
+                                The entry of Port is set to TRUE if a new device
+                                is connected, and left alone otherwise.
 
-  @retval EFI_SUCCESS           The device is enumerated (added or removed).
-  @retval EFI_OUT_OF_RESOURCES  Failed to allocate resource for the device.
-  @retval Others                Failed to enumerate the device.
+  @retval EFI_SUCCESS           The events on the port are processed.
+  @retval Others                Failed to get the port state, or over current.
 
 **/
 EFI_STATUS
 UsbEnumeratePort (
-  IN USB_INTERFACE        *HubIf,
-  IN UINT8                Port
+  IN     USB_INTERFACE    *HubIf,
+  IN     UINT8            Port,
+  IN OUT BOOLEAN          *NewDev
   )
 {
   USB_HUB_API             *HubApi;
@@ -961,17 +982,106 @@ UsbEnumeratePort (
   
   if (USB_BIT_IS_SET (PortState.PortStatus, USB_PORT_STAT_CONNECTION)) {
     //
-    // Now, new device connected, enumerate and configure the device 
+    // Now, new device connected, it is enumerated and configured
+    // together with the new devices on the other ports.
     //
     DEBUG (( EFI_D_INFO, "UsbEnumeratePort: new device connected at port %d\n", Port));
-    Status = UsbEnumerateNewDev (HubIf, Port);
-  
-  } else {
-    DEBUG (( EFI_D_INFO, "UsbEnumeratePort: device disconnected event on port %d\n", Port));
+    UsbEnumPerf (HubIf, Port, TRUE);
+    NewDev[Port] = TRUE;
+    return EFI_SUCCESS;
   }
-  
+
+  DEBUG (( EFI_D_INFO, "UsbEnumeratePort: device disconnected event on port %d\n", Port));
+
   HubApi->ClearPortChange (HubIf, Port);
-  return Status;
+  return EFI_SUCCESS;
+}
+
+
+/**
+  Enumerate the new devices on several ports of the hub together. The
+  ports are debounced at the same time. The ports of a super speed root
+  hub are reset at the same time too, because XHCI talks to each newly
+  reset device through its own device slot. Other hosts address a newly
+  reset device by the default address, so those ports are reset and
+  addressed one by one.
+
+  @param  HubIf                 The HUB that has the devices connected.
+  @param  NewDev                Which ports have a new device, indexed by
+                                port. The entries are cleared on return.
+
+**/
+VOID
+UsbEnumerateNewDevs (
+  IN     USB_INTERFACE    *HubIf,
+  IN OUT BOOLEAN          *NewDev
+  )
+{
+  USB_HUB_API             *HubApi;
+  EFI_STATUS              Status;
+  BOOLEAN                 ResetDone;
+  BOOLEAN                 Reset[USB_MAX_HUB_PORT];
+  UINT8                   Index;
+
+  HubApi    = HubIf->HubApi;
+  ResetDone = FALSE;
+
+  for (Index = 0; Index < HubIf->NumOfPort; Index++) {
+    if (NewDev[Index]) {
+      break;
+    }
+  }
+
+  if (Index == HubIf->NumOfPort) {
+    return;
+  }
+
+  //
+  // Wait for the connections to be stable, once for all the ports.
+  //
+  gBS->Stall (USB_WAIT_PORT_STABLE_STALL);
+
+  if ((HubIf->HubApi == &mUsbRootHubApi) && (HubIf->MaxSpeed == EFI_USB_SPEED_SUPER)) {
+    CopyMem (Reset, NewDev, HubIf->NumOfPort);
+    UsbRootHubResetPorts (HubIf, Reset);
+    ResetDone = TRUE;
+  }
+
+  for (Index = 0; Index < HubIf->NumOfPort; Index++) {
+    if (!NewDev[Index]) {
+      continue;
+    }
+
+    Status = EFI_SUCCESS;
+
+    if (ResetDone) {
+      if (!Reset[Index]) {
+        Status = EFI_DEVICE_ERROR;
+        DEBUG ((EFI_D_ERROR, "UsbEnumerateNewDev: failed to reset port %d\n", Index));
+      }
+    } else {
+      //
+      // Hub resets the device for at least 10 milliseconds.
+      // Host learns device speed. If device is of low/full speed
+      // and the hub is a EHCI root hub, ResetPort will release
+      // the device to its companion UHCI and return an error.
+      //
+      Status = HubApi->ResetPort (HubIf, Index);
+
+      if (EFI_ERROR (Status)) {
+        DEBUG ((EFI_D_ERROR, "UsbEnumerateNewDev: failed to reset port %d - %r\n", Index, Status));
+      }
+    }
+
+    if (!EFI_ERROR (Status)) {
+      DEBUG (( EFI_D_INFO, "UsbEnumerateNewDev: hub port %d is reset\n", Index));
+      UsbEnumerateNewDev (HubIf, Index);
+    }
+
+    UsbEnumPerf (HubIf, Index, FALSE);
+    HubApi->ClearPortChange (HubIf, Index);
+    NewDev[Index] = FALSE;
+  }
 }
 
 
@@ -994,6 +1104,7 @@ UsbHubEnumeration (
   UINT8                   Bit;
   UINT8                   Index;
   USB_DEVICE              *Child;
+  BOOLEAN                 NewDev[USB_MAX_HUB_PORT];
   
   ASSERT (Context != NULL);
 
@@ -1017,14 +1128,18 @@ UsbHubEnumeration (
   Byte  = 0;
   Bit   = 1;
 
+  ZeroMem (NewDev, sizeof (NewDev));
+
   for (Index = 0; Index < HubIf->NumOfPort; Index++) {
     if (USB_BIT_IS_SET (HubIf->ChangeMap[Byte], USB_BIT (Bit))) {
-      UsbEnumeratePort (HubIf, Index);
+      UsbEnumeratePort (HubIf, Index, NewDev);
     }
 
     USB_NEXT_BIT (Byte, Bit);
   }
 
+  UsbEnumerateNewDevs (HubIf, NewDev);
+
   UsbHubAckHubStatus (HubIf->Device);
 
   gBS->FreePool (HubIf->ChangeMap);
@@ -1050,9 +1165,12 @@ UsbRootHubEnumeration (
   USB_INTERFACE           *RootHub;
   UINT8                   Index;
   USB_DEVICE              *Child;
+  BOOLEAN                 NewDev[USB_MAX_HUB_PORT];
 
   RootHub = (USB_INTERFACE *) Context;
 
+  ZeroMem (NewDev, sizeof (NewDev));
+
   for (Index = 0; Index < RootHub->NumOfPort; Index++) {
     Child = UsbFindChild (RootHub, Index);
     if ((Child != NULL) && (Child->DisconnectFail == TRUE)) {
@@ -1060,6 +1178,8 @@ UsbRootHubEnumeration (
       UsbRemoveDevice (Child);
     }
     
-    UsbEnumeratePort (RootHub, Index);
+    UsbEnumeratePort (RootHub, Index, NewDev);
   }
+
+  UsbEnumerateNewDevs (RootHub, NewDev);
 }
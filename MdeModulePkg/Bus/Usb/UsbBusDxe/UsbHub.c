@@ -1252,20 +1252,18 @@ UsbRootHubClearPortFeature (
 
 
 /**
-  Interface function to reset the root hub port.
+  Start to drive the reset signal on the root hub port.
 
   @param  RootIf                The root hub interface.
   @param  Port                  The port to reset.
 
-  @retval EFI_SUCCESS           The hub port is reset.
-  @retval EFI_TIMEOUT           Failed to reset the port in time.
-  @retval EFI_NOT_FOUND         The low/full speed device connected to high  speed.
-                                root hub is released to the companion UHCI.
-  @retval Others                Failed to reset the port.
+  @retval EFI_SUCCESS           The reset signal is driven on the port.
+  @retval EFI_ALREADY_STARTED   The port has been reset, nothing else to do.
+  @retval Others                Failed to start the reset.
 
 **/
 EFI_STATUS
-UsbRootHubResetPort (
+UsbRootHubStartPortReset (
   IN USB_INTERFACE        *RootIf,
   IN UINT8                Port
   )
@@ -1273,7 +1271,6 @@ UsbRootHubResetPort (
   USB_BUS                 *Bus;
   EFI_STATUS              Status;
   EFI_USB_PORT_STATUS     PortState;
-  UINTN                   Index;
 
   //
   // Notice: although EHCI requires that ENABLED bit be cleared
@@ -1288,30 +1285,73 @@ UsbRootHubResetPort (
     return Status;
   } else if (USB_BIT_IS_SET (PortState.PortChangeStatus, USB_PORT_STAT_C_RESET)) {
     DEBUG (( EFI_D_INFO, "UsbRootHubResetPort: skip reset on root port %d\n", Port));
-    return EFI_SUCCESS;
+    return EFI_ALREADY_STARTED;
   }
 
   Status  = UsbHcSetRootHubPortFeature (Bus, Port, EfiUsbPortReset);
 
   if (EFI_ERROR (Status)) {
     DEBUG (( EFI_D_ERROR, "UsbRootHubResetPort: failed to start reset on port %d\n", Port));
-    return Status;
   }
 
-  //
-  // Drive the reset signal for at least 50ms. Check USB 2.0 Spec
-  // section 7.1.7.5 for timing requirements.
-  //
-  gBS->Stall (USB_SET_ROOT_PORT_RESET_STALL);
+  return Status;
+}
 
-  Status = UsbHcClearRootHubPortFeature (Bus, Port, EfiUsbPortReset);
+
+/**
+  Stop driving the reset signal on the root hub port.
+
+  @param  RootIf                The root hub interface.
+  @param  Port                  The port being reset.
+
+  @retval EFI_SUCCESS           The reset signal is released.
+  @retval Others                Failed to clear the reset feature.
+
+**/
+EFI_STATUS
+UsbRootHubStopPortReset (
+  IN USB_INTERFACE        *RootIf,
+  IN UINT8                Port
+  )
+{
+  EFI_STATUS              Status;
+
+  Status = UsbHcClearRootHubPortFeature (RootIf->Device->Bus, Port, EfiUsbPortReset);
 
   if (EFI_ERROR (Status)) {
     DEBUG (( EFI_D_ERROR, "UsbRootHubResetPort: failed to clear reset on port %d\n", Port));
-    return Status;
   }
 
-  gBS->Stall (USB_CLR_ROOT_PORT_RESET_STALL);
+  return Status;
+}
+
+
+/**
+  Wait for the host controller to finish the reset of the root hub
+  port, and enable the port if the host controller doesn't.
+
+  @param  RootIf                The root hub interface.
+  @param  Port                  The port being reset.
+
+  @retval EFI_SUCCESS           The hub port is reset.
+  @retval EFI_TIMEOUT           Failed to reset the port in time.
+  @retval EFI_NOT_FOUND         The low/full speed device connected to high  speed.
+                                root hub is released to the companion UHCI.
+  @retval Others                Failed to reset the port.
+
+**/
+EFI_STATUS
+UsbRootHubFinishPortReset (
+  IN USB_INTERFACE        *RootIf,
+  IN UINT8                Port
+  )
+{
+  USB_BUS                 *Bus;
+  EFI_STATUS              Status;
+  EFI_USB_PORT_STATUS     PortState;
+  UINTN                   Index;
+
+  Bus     = RootIf->Device->Bus;
 
   //
   // USB host controller won't clear the RESET bit until
@@ -1368,6 +1408,123 @@ UsbRootHubResetPort (
 }
 
 
+/**
+  Interface function to reset the root hub port.
+
+  @param  RootIf                The root hub interface.
+  @param  Port                  The port to reset.
+
+  @retval EFI_SUCCESS           The hub port is reset.
+  @retval EFI_TIMEOUT           Failed to reset the port in time.
+  @retval EFI_NOT_FOUND         The low/full speed device connected to high  speed.
+                                root hub is released to the companion UHCI.
+  @retval Others                Failed to reset the port.
+
+**/
+EFI_STATUS
+UsbRootHubResetPort (
+  IN USB_INTERFACE        *RootIf,
+  IN UINT8                Port
+  )
+{
+  EFI_STATUS              Status;
+
+  Status = UsbRootHubStartPortReset (RootIf, Port);
+
+  if (Status == EFI_ALREADY_STARTED) {
+    return EFI_SUCCESS;
+  } else if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Drive the reset signal for at least 50ms. Check USB 2.0 Spec
+  // section 7.1.7.5 for timing requirements.
+  //
+  gBS->Stall (USB_SET_ROOT_PORT_RESET_STALL);
+
+  Status = UsbRootHubStopPortReset (RootIf, Port);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  gBS->Stall (USB_CLR_ROOT_PORT_RESET_STALL);
+
+  return UsbRootHubFinishPortReset (RootIf, Port);
+}
+
+
+/**
+  Reset several ports of the root hub at the same time, so that the
+  reset delays of all the ports overlap. The caller must make sure the
+  host controller can address each of the reset devices on its own.
+
+  @param  RootIf                The root hub interface.
+  @param  Ports                 Which ports to reset, indexed by port. On
+                                return the ports that failed to reset are
+                                set to FALSE.
+
+**/
+VOID
+UsbRootHubResetPorts (
+  IN     USB_INTERFACE    *RootIf,
+  IN OUT BOOLEAN          *Ports
+  )
+{
+  BOOLEAN                 Started[USB_MAX_HUB_PORT];
+  BOOLEAN                 Resetting;
+  EFI_STATUS              Status;
+  UINT8                   Index;
+
+  Resetting = FALSE;
+
+  for (Index = 0; Index < RootIf->NumOfPort; Index++) {
+    Started[Index] = FALSE;
+
+    if (!Ports[Index]) {
+      continue;
+    }
+
+    Status = UsbRootHubStartPortReset (RootIf, Index);
+
+    if (Status == EFI_ALREADY_STARTED) {
+      continue;
+    } else if (EFI_ERROR (Status)) {
+      Ports[Index] = FALSE;
+      continue;
+    }
+
+    Started[Index] = TRUE;
+    Resetting      = TRUE;
+  }
+
+  if (!Resetting) {
+    return;
+  }
+
+  //
+  // Drive the reset signal for at least 50ms, once for all the ports.
+  //
+  gBS->Stall (USB_SET_ROOT_PORT_RESET_STALL);
+
+  for (Index = 0; Index < RootIf->NumOfPort; Index++) {
+    if (Started[Index] && EFI_ERROR (UsbRootHubStopPortReset (RootIf, Index))) {
+      Started[Index] = FALSE;
+      Ports[Index]   = FALSE;
+    }
+  }
+
+  gBS->Stall (USB_CLR_ROOT_PORT_RESET_STALL);
+
+  for (Index = 0; Index < RootIf->NumOfPort; Index++) {
+    if (Started[Index] && EFI_ERROR (UsbRootHubFinishPortReset (RootIf, Index))) {
+      Ports[Index] = FALSE;
+    }
+  }
+}
+
+
 /**
   Release the root hub's control of the interface.
 
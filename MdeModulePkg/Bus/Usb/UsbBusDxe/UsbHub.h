@@ -193,6 +193,23 @@ UsbHubAckHubStatus (
   IN  USB_DEVICE         *UsbDev
   );
 
+/**
+  Reset several ports of the root hub at the same time, so that the
+  reset delays of all the ports overlap. The caller must make sure the
+  host controller can address each of the reset devices on its own.
+
+  @param  RootIf                The root hub interface.
+  @param  Ports                 Which ports to reset, indexed by port. On
+                                return the ports that failed to reset are
+                                set to FALSE.
+
+**/
+VOID
+UsbRootHubResetPorts (
+  IN     USB_INTERFACE    *RootIf,
+  IN OUT BOOLEAN          *Ports
+  );
+
 extern USB_HUB_API        mUsbHubApi;
 extern USB_HUB_API        mUsbRootHubApi;
 #endif
@@ -91,6 +91,48 @@ typedef struct {
 
 FV_FILEPATH_DEVICE_PATH mFvDevicePath;
 
+//
+// Index of the protocols that Dependent drivers are waiting for. A driver whose
+// DXE Depex evaluates to FALSE is parked on the entries of the GUIDs it pushes,
+// and is not evaluated again until one of those protocols is installed.
+//
+#define DEPEX_GUID_HASH_TABLE_SIZE  64
+
+#define DEPEX_GUID_ENTRY_SIGNATURE  SIGNATURE_32('d','p','x','g')
+typedef struct {
+  UINTN               Signature;
+  LIST_ENTRY          HashLink;         // mDepexGuidHashTable
+  LIST_ENTRY          InstalledLink;    // mDepexInstalledList
+  EFI_GUID            Guid;
+  EFI_EVENT           Event;
+  VOID                *Registration;
+  BOOLEAN             Installed;
+  LIST_ENTRY          WaitList;         // DEPEX_WAIT_ENTRY
+} DEPEX_GUID_ENTRY;
+
+#define DEPEX_WAIT_ENTRY_SIGNATURE  SIGNATURE_32('d','p','x','w')
+typedef struct {
+  UINTN                   Signature;
+  LIST_ENTRY              GuidLink;     // DEPEX_GUID_ENTRY.WaitList
+  LIST_ENTRY              DriverLink;   // EFI_CORE_DRIVER_ENTRY.DepexWaitList
+  EFI_CORE_DRIVER_ENTRY   *DriverEntry;
+  DEPEX_GUID_ENTRY        *GuidEntry;
+} DEPEX_WAIT_ENTRY;
+
+LIST_ENTRY  mDepexGuidHashTable[DEPEX_GUID_HASH_TABLE_SIZE];
+
+//
+// GUID entries whose protocol was installed while drivers were waiting on it.
+// Protected by mDispatcherLock.
+//
+LIST_ENTRY  mDepexInstalledList = INITIALIZE_LIST_HEAD_VARIABLE (mDepexInstalledList);
+
+//
+// Incremented for every install of a protocol in the index, so the dispatcher
+// can tell if one raced with the evaluation of a Depex.
+//
+UINTN       mDepexInstallCount = 0;
+
 //
 // Function Prototypes
 //
@@ -255,7 +297,9 @@ CoreGetDepexSectionAndPreProccess (
   Fv = DriverEntry->Fv;
 
   //
-  // Grab Depex info, it will never be free'ed.
+  // Grab Depex info, it will never be free'ed. The dispatcher rewrites
+  // evaluated opcodes of the expression in place, so it needs its own copy
+  // rather than the section where the FV keeps the file.
   //
   SectionType         = EFI_SECTION_DXE_DEPEX;
   Status = Fv->ReadSection (
@@ -411,6 +455,262 @@ CoreEmptyCallbackFunction (
   return;
 }
 
+/**
+  Notification function for the protocols in the Depex index. Queues the
+  GUID entry so the dispatcher re-evaluates the drivers waiting on it.
+
+  @param  Event                 The Event that is being processed.
+  @param  Context               The DEPEX_GUID_ENTRY of the installed protocol.
+
+**/
+VOID
+EFIAPI
+CoreDepexProtocolNotify (
+  IN EFI_EVENT                Event,
+  IN VOID                     *Context
+  )
+{
+  DEPEX_GUID_ENTRY  *GuidEntry;
+
+  GuidEntry = (DEPEX_GUID_ENTRY *) Context;
+
+  CoreAcquireDispatcherLock ();
+
+  mDepexInstallCount++;
+  if (!GuidEntry->Installed && !IsListEmpty (&GuidEntry->WaitList)) {
+    GuidEntry->Installed = TRUE;
+    InsertTailList (&mDepexInstalledList, &GuidEntry->InstalledLink);
+  }
+
+  CoreReleaseDispatcherLock ();
+}
+
+
+/**
+  Find the entry of a protocol GUID in the Depex index, and add one if it
+  does not exist yet. A new entry registers for installs of the protocol.
+
+  @param  Guid                  The protocol GUID pushed by a Depex.
+
+  @return The GUID entry, or NULL if there are not enough resources.
+
+**/
+DEPEX_GUID_ENTRY *
+CoreFindDepexGuidEntry (
+  IN  EFI_GUID                *Guid
+  )
+{
+  EFI_STATUS        Status;
+  LIST_ENTRY        *Bucket;
+  LIST_ENTRY        *Link;
+  DEPEX_GUID_ENTRY  *GuidEntry;
+  VOID              *Interface;
+
+  Bucket = &mDepexGuidHashTable[CoreHashGuid (Guid) & (DEPEX_GUID_HASH_TABLE_SIZE - 1)];
+
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    GuidEntry = CR (Link, DEPEX_GUID_ENTRY, HashLink, DEPEX_GUID_ENTRY_SIGNATURE);
+    if (CompareGuid (&GuidEntry->Guid, Guid)) {
+      return GuidEntry;
+    }
+  }
+
+  GuidEntry = AllocateZeroPool (sizeof (DEPEX_GUID_ENTRY));
+  if (GuidEntry == NULL) {
+    return NULL;
+  }
+
+  GuidEntry->Signature = DEPEX_GUID_ENTRY_SIGNATURE;
+  CopyGuid (&GuidEntry->Guid, Guid);
+  InitializeListHead (&GuidEntry->WaitList);
+
+  Status = CoreCreateEvent (
+             EVT_NOTIFY_SIGNAL,
+             TPL_CALLBACK,
+             CoreDepexProtocolNotify,
+             GuidEntry,
+             &GuidEntry->Event
+             );
+  if (!EFI_ERROR (Status)) {
+    Status = CoreRegisterProtocolNotify (Guid, GuidEntry->Event, &GuidEntry->Registration);
+    if (EFI_ERROR (Status)) {
+      CoreCloseEvent (GuidEntry->Event);
+    }
+  }
+  if (EFI_ERROR (Status)) {
+    CoreFreePool (GuidEntry);
+    return NULL;
+  }
+
+  //
+  // The protocol may have been installed after the Depex was evaluated but
+  // before the notification was registered
+  //
+  Status = CoreLocateProtocol (Guid, NULL, &Interface);
+
+  CoreAcquireDispatcherLock ();
+
+  InsertTailList (Bucket, &GuidEntry->HashLink);
+  if (!EFI_ERROR (Status)) {
+    mDepexInstallCount++;
+  }
+
+  CoreReleaseDispatcherLock ();
+
+  return GuidEntry;
+}
+
+
+/**
+  Remove a driver from all the GUID entries of the Depex index it is parked on.
+
+  @param  DriverEntry           The driver to remove.
+
+**/
+VOID
+CoreRemoveDepexWaits (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  DEPEX_WAIT_ENTRY  *WaitEntry;
+
+  DriverEntry->DepexWaiting = FALSE;
+
+  while (!IsListEmpty (&DriverEntry->DepexWaitList)) {
+    WaitEntry = CR (DriverEntry->DepexWaitList.ForwardLink, DEPEX_WAIT_ENTRY, DriverLink, DEPEX_WAIT_ENTRY_SIGNATURE);
+
+    CoreAcquireDispatcherLock ();
+    RemoveEntryList (&WaitEntry->GuidLink);
+    RemoveEntryList (&WaitEntry->DriverLink);
+    CoreReleaseDispatcherLock ();
+
+    CoreFreePool (WaitEntry);
+  }
+}
+
+
+/**
+  Park a driver whose Depex evaluated to FALSE on the GUID entries of every
+  protocol its Depex still needs to locate.
+
+  @param  DriverEntry           The driver to park.
+
+  @retval TRUE                  The driver is parked and will be evaluated again
+                                once one of the protocols is installed.
+  @retval FALSE                 The driver could not be parked and has to be
+                                evaluated on every pass.
+
+**/
+BOOLEAN
+CoreAddDepexWaits (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  UINT8             *Iterator;
+  UINT8             *End;
+  EFI_GUID          Guid;
+  DEPEX_GUID_ENTRY  *GuidEntry;
+  DEPEX_WAIT_ENTRY  *WaitEntry;
+
+  //
+  // UEFI drivers without a Depex wait for the architectural protocols, and
+  // Before and After drivers are scheduled with the driver they refer to
+  //
+  if (DriverEntry->Depex == NULL || DriverEntry->Before || DriverEntry->After) {
+    return FALSE;
+  }
+
+  Iterator = DriverEntry->Depex;
+  End      = Iterator + DriverEntry->DepexSize;
+  while (Iterator < End && *Iterator != EFI_DEP_END) {
+    switch (*Iterator) {
+    case EFI_DEP_PUSH:
+      if (Iterator + 1 + sizeof (EFI_GUID) > End) {
+        break;
+      }
+      CopyMem (&Guid, Iterator + 1, sizeof (EFI_GUID));
+
+      GuidEntry = CoreFindDepexGuidEntry (&Guid);
+      WaitEntry = AllocatePool (sizeof (DEPEX_WAIT_ENTRY));
+      if (GuidEntry == NULL || WaitEntry == NULL) {
+        if (WaitEntry != NULL) {
+          CoreFreePool (WaitEntry);
+        }
+        CoreRemoveDepexWaits (DriverEntry);
+        return FALSE;
+      }
+
+      WaitEntry->Signature   = DEPEX_WAIT_ENTRY_SIGNATURE;
+      WaitEntry->DriverEntry = DriverEntry;
+      WaitEntry->GuidEntry   = GuidEntry;
+
+      CoreAcquireDispatcherLock ();
+      InsertTailList (&GuidEntry->WaitList, &WaitEntry->GuidLink);
+      InsertTailList (&DriverEntry->DepexWaitList, &WaitEntry->DriverLink);
+      CoreReleaseDispatcherLock ();
+
+      Iterator += sizeof (EFI_GUID);
+      break;
+
+    case EFI_DEP_BEFORE:
+    case EFI_DEP_AFTER:
+    case EFI_DEP_REPLACE_TRUE:
+      Iterator += sizeof (EFI_GUID);
+      break;
+
+    default:
+      break;
+    }
+    Iterator++;
+  }
+
+  if (DriverEntry->DepexWaitCount == 0) {
+    DriverEntry->DepexWaitStart = CoreCurrentSystemTime ();
+  }
+  DriverEntry->DepexWaitCount++;
+
+  return TRUE;
+}
+
+
+/**
+  Wake every driver parked on a protocol that was installed since the last
+  pass of the dispatcher.
+
+**/
+VOID
+CoreWakeDepexWaits (
+  VOID
+  )
+{
+  DEPEX_GUID_ENTRY  *GuidEntry;
+  DEPEX_WAIT_ENTRY  *WaitEntry;
+  LIST_ENTRY        *Link;
+
+  while (TRUE) {
+    CoreAcquireDispatcherLock ();
+    if (IsListEmpty (&mDepexInstalledList)) {
+      CoreReleaseDispatcherLock ();
+      break;
+    }
+    GuidEntry = CR (mDepexInstalledList.ForwardLink, DEPEX_GUID_ENTRY, InstalledLink, DEPEX_GUID_ENTRY_SIGNATURE);
+    RemoveEntryList (&GuidEntry->InstalledLink);
+    GuidEntry->Installed = FALSE;
+    CoreReleaseDispatcherLock ();
+
+    //
+    // The wait list is only changed by the dispatcher itself
+    //
+    for (Link = GuidEntry->WaitList.ForwardLink; Link != &GuidEntry->WaitList; Link = Link->ForwardLink) {
+      WaitEntry = CR (Link, DEPEX_WAIT_ENTRY, GuidLink, DEPEX_WAIT_ENTRY_SIGNATURE);
+      if (WaitEntry->DriverEntry->DepexWaiting) {
+        DEBUG ((DEBUG_DISPATCH, "GUID(%g) installed, wake FFS(%g)\n", &GuidEntry->Guid, &WaitEntry->DriverEntry->FileName));
+        WaitEntry->DriverEntry->DepexWaiting = FALSE;
+      }
+    }
+  }
+}
+
 /**
   This is the main Dispatcher for DXE and it exits when there are no more
   drivers to run. Drain the mScheduledQueue and load and start a PE
@@ -437,6 +737,7 @@ CoreDispatcher (
   EFI_CORE_DRIVER_ENTRY           *DriverEntry;
   BOOLEAN                         ReadyToRun;
   EFI_EVENT                       DxeDispatchEvent;
+  UINTN                           InstallCount;
   
 
   if (gDispatcherRunning) {
@@ -568,9 +869,11 @@ CoreDispatcher (
     }
 
     //
-    // Search DriverList for items to place on Scheduled Queue
+    // Search DriverList for items to place on Scheduled Queue. Drivers parked in
+    // the Depex index are skipped until a protocol they wait on is installed.
     //
     ReadyToRun = FALSE;
+    CoreWakeDepexWaits ();
     for (Link = mDiscoveredList.ForwardLink; Link != &mDiscoveredList; Link = Link->ForwardLink) {
       DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, Link, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
 
@@ -582,9 +885,27 @@ CoreDispatcher (
       }
 
       if (DriverEntry->Dependent) {
+        if (DriverEntry->DepexWaiting) {
+          continue;
+        }
+
+        CoreRemoveDepexWaits (DriverEntry);
+        InstallCount = mDepexInstallCount;
+
         if (CoreIsSchedulable (DriverEntry)) {
+          if (DriverEntry->DepexWaitCount != 0) {
+            DEBUG ((
+              DEBUG_DISPATCH,
+              "FFS(%g) schedulable after %d waits, %ld us\n",
+              &DriverEntry->FileName,
+              (UINT32) DriverEntry->DepexWaitCount,
+              DivU64x32 (CoreCurrentSystemTime () - DriverEntry->DepexWaitStart, 10)
+              ));
+          }
           CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
           ReadyToRun = TRUE;
+        } else if (CoreAddDepexWaits (DriverEntry) && InstallCount == mDepexInstallCount) {
+          DriverEntry->DepexWaiting = TRUE;
         }
       } else {
         if (DriverEntry->Unrequested) {
@@ -908,6 +1229,7 @@ CoreAddToDriverList (
   DriverEntry->FvHandle         = FvHandle;
   DriverEntry->Fv               = Fv;
   DriverEntry->FvFileDevicePath = CoreFvToDevicePath (Fv, FvHandle, DriverName);
+  InitializeListHead (&DriverEntry->DepexWaitList);
 
   CoreGetDepexSectionAndPreProccess (DriverEntry);
 
@@ -987,9 +1309,11 @@ CoreProcessFvImageFile (
   EFI_FIRMWARE_VOLUME_HEADER          *FvHeader;
   UINT32                              FvAlignment;
   EFI_DEVICE_PATH_PROTOCOL            *FvFileDevicePath;
+  BOOLEAN                             InPlace;
 
   //
-  // Read the first (and only the first) firmware volume section
+  // Locate the first (and only the first) firmware volume section where the
+  // FV keeps the file if it can, otherwise read a copy of it
   //
   SectionType   = EFI_SECTION_FIRMWARE_VOLUME_IMAGE;
   FvHeader      = NULL;
@@ -997,15 +1321,29 @@ CoreProcessFvImageFile (
   Buffer        = NULL;
   BufferSize    = 0;
   AlignedBuffer = NULL;
-  Status = Fv->ReadSection (
-                 Fv,
-                 DriverName,
-                 SectionType,
-                 0,
-                 &Buffer,
-                 &BufferSize,
-                 &AuthenticationStatus
-                 );
+  InPlace       = TRUE;
+  Status = FvLocateFileSection (
+             Fv,
+             DriverName,
+             SectionType,
+             0,
+             &Buffer,
+             &BufferSize,
+             &AuthenticationStatus
+             );
+  if (Status == EFI_UNSUPPORTED) {
+    Buffer  = NULL;
+    InPlace = FALSE;
+    Status = Fv->ReadSection (
+                   Fv,
+                   DriverName,
+                   SectionType,
+                   0,
+                   &Buffer,
+                   &BufferSize,
+                   &AuthenticationStatus
+                   );
+  }
   if (!EFI_ERROR (Status)) {
      //
     // Evaluate the authentication status of the Firmware Volume through
@@ -1026,7 +1364,7 @@ CoreProcessFvImageFile (
         //
         // Security check failed. The firmware volume should not be used for any purpose.
         //
-        if (Buffer != NULL) {
+        if (Buffer != NULL && !InPlace) {
           FreePool (Buffer);
         }
         return Status;
@@ -1053,12 +1391,20 @@ CoreProcessFvImageFile (
       if (FvAlignment < 8) {
         FvAlignment = 8;
       }
+    }
+    //
+    // An FvImage that is in place at its required alignment is used where it
+    // is, otherwise it is moved into an aligned buffer.
+    //
+    if (FvAlignment != 0 && (!InPlace || ((UINTN) Buffer & (FvAlignment - 1)) != 0)) {
       //
       // Allocate the aligned buffer for the FvImage.
       //
       AlignedBuffer = AllocateAlignedPages (EFI_SIZE_TO_PAGES (BufferSize), (UINTN) FvAlignment);
       if (AlignedBuffer == NULL) {
-        FreePool (Buffer);
+        if (!InPlace) {
+          FreePool (Buffer);
+        }
         return EFI_OUT_OF_RESOURCES;
       } else {
         //
@@ -1066,7 +1412,9 @@ CoreProcessFvImageFile (
         //
         CopyMem (AlignedBuffer, Buffer, BufferSize);
         FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *) AlignedBuffer;
-        CoreFreePool (Buffer);
+        if (!InPlace) {
+          CoreFreePool (Buffer);
+        }
         Buffer = NULL;
       }
     }
@@ -1086,7 +1434,7 @@ CoreProcessFvImageFile (
     //
     // ReadSection or Produce FVB failed, Free data buffer
     //
-    if (Buffer != NULL) {
+    if (Buffer != NULL && !InPlace) {
       FreePool (Buffer);
     }
 
@@ -1391,6 +1739,12 @@ CoreInitializeDispatcher (
   VOID
   )
 {
+  UINTN  Index;
+
+  for (Index = 0; Index < DEPEX_GUID_HASH_TABLE_SIZE; Index++) {
+    InitializeListHead (&mDepexGuidHashTable[Index]);
+  }
+
   mFwVolEvent = EfiCreateProtocolNotifyEvent (
                   &gEfiFirmwareVolume2ProtocolGuid,
                   TPL_CALLBACK,
@@ -1415,12 +1769,20 @@ CoreDisplayDiscoveredNotDispatched (
   )
 {
   LIST_ENTRY                    *Link;
+  LIST_ENTRY                    *WaitLink;
   EFI_CORE_DRIVER_ENTRY         *DriverEntry;
+  DEPEX_WAIT_ENTRY              *WaitEntry;
 
   for (Link = mDiscoveredList.ForwardLink;Link !=&mDiscoveredList; Link = Link->ForwardLink) {
     DriverEntry = CR(Link, EFI_CORE_DRIVER_ENTRY, Link, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
     if (DriverEntry->Dependent) {
       DEBUG ((DEBUG_LOAD, "Driver %g was discovered but not loaded!!\n", &DriverEntry->FileName));
+      for (WaitLink = DriverEntry->DepexWaitList.ForwardLink;
+           WaitLink != &DriverEntry->DepexWaitList;
+           WaitLink = WaitLink->ForwardLink) {
+        WaitEntry = CR (WaitLink, DEPEX_WAIT_ENTRY, DriverLink, DEPEX_WAIT_ENTRY_SIGNATURE);
+        DEBUG ((DEBUG_LOAD, "  waiting for GUID(%g)\n", &WaitEntry->GuidEntry->Guid));
+      }
     }
   }
 }
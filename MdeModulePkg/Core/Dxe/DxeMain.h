@@ -53,6 +53,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Protocol/TcgService.h>
 #include <Protocol/HiiPackageList.h>
 #include <Protocol/SmmBase2.h>
+#include <Protocol/MpService.h>
 #include <Guid/MemoryTypeInformation.h>
 #include <Guid/FirmwareFileSystem2.h>
 #include <Guid/FirmwareFileSystem3.h>
@@ -94,6 +95,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/DxeServicesLib.h>
 #include <Library/DebugAgentLib.h>
 #include <Library/CpuExceptionHandlerLib.h>
+#include <Library/SynchronizationLib.h>
 
 
 //
@@ -174,6 +176,11 @@ typedef struct {
   EFI_HANDLE                      ImageHandle;
   BOOLEAN                         IsFvImage;
 
+  LIST_ENTRY                      DepexWaitList;    // DEPEX_WAIT_ENTRY
+  BOOLEAN                         DepexWaiting;
+  UINTN                           DepexWaitCount;
+  UINT64                          DepexWaitStart;
+
 } EFI_CORE_DRIVER_ENTRY;
 
 //
@@ -381,6 +388,17 @@ CoreInitializeGcdServices (
   );
 
 
+/**
+  Initializes the protocol database. Must be called before any protocol
+  interface is installed.
+
+**/
+VOID
+CoreInitializeProtocolDatabase (
+  VOID
+  );
+
+
 /**
   Initializes "event" support.
 
@@ -458,6 +476,18 @@ CoreTimerTick (
   );
 
 
+/**
+  Returns the current system time.
+
+  @return The current system time
+
+**/
+UINT64
+CoreCurrentSystemTime (
+  VOID
+  );
+
+
 /**
   Initialize the dispatcher. Initialize the notification function that runs when
   an FV2 protocol is added to the system.
@@ -2200,6 +2230,30 @@ CoreDisplayDiscoveredNotDispatched (
   );
 
 
+/**
+  Display how many bytes each firmware volume read through the FVB protocol,
+  and how many bytes of file data were served from its file cache. Only used
+  in debug builds.
+
+**/
+VOID
+CoreDisplayFvCacheStatistics (
+  VOID
+  );
+
+
+/**
+  Display how often extracted encapsulation sections were reused, extracted and
+  evicted, and how many bytes of extracted data are still held. Only used in
+  debug builds.
+
+**/
+VOID
+CoreDisplaySectionCacheStatistics (
+  VOID
+  );
+
+
 /**
   Place holder function until all the Boot Services and Runtime Services are
   available.
@@ -2503,6 +2557,42 @@ GetSection (
   );
 
 
+/**
+  Retrieves a pointer to the requested section where it lies in the buffer that
+  was passed to OpenSectionStream(), without copying it.  Sections inside
+  compression or GUIDed encapsulations that had to be extracted into a buffer
+  of their own are not returned, because that buffer may be released.
+
+  @param  SectionStreamHandle   The section stream from which to locate the
+                                requested section.
+  @param  SectionType           A pointer to the type of section to search for.
+  @param  SectionInstance       Indicates which instance of the requested
+                                section to return.
+  @param  Buffer                Output pointer to the section data.
+  @param  BufferSize            Output size in bytes of the section data.
+  @param  AuthenticationStatus  Output authentication status of the section.
+  @param  IsFfs3Fv              Indicates the FV format.
+
+  @retval EFI_SUCCESS           *Buffer points to the section data.
+  @retval EFI_UNSUPPORTED       The section was found, but not in place.  The
+                                caller should use GetSection() instead.
+  @retval EFI_INVALID_PARAMETER The SectionStreamHandle does not exist.
+  @retval others                Values returned by GetSection() for the same
+                                search.
+
+**/
+EFI_STATUS
+GetSectionInPlace (
+  IN  UINTN                                             SectionStreamHandle,
+  IN  EFI_SECTION_TYPE                                  *SectionType,
+  IN  UINTN                                             SectionInstance,
+  OUT VOID                                              **Buffer,
+  OUT UINTN                                             *BufferSize,
+  OUT UINT32                                            *AuthenticationStatus,
+  IN  BOOLEAN                                           IsFfs3Fv
+  );
+
+
 /**
   SEP member function.  Deletes an existing section stream
 
@@ -2615,6 +2705,46 @@ GetFvbAuthenticationStatus (
   IN EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL     *FvbProtocol
   );
 
+/**
+  Locates a section in a given FFS File and returns a pointer to its contents
+  (not including section header) where they lie in the FV's copy of the file.
+  The FV keeps that copy for as long as it is installed, and the caller must
+  not modify or free it.
+
+  @param  This                       Indicates the calling context.
+  @param  NameGuid                   Pointer to an EFI_GUID, which is the
+                                     filename.
+  @param  SectionType                Indicates the section type to return.
+  @param  SectionInstance            Indicates which instance of sections with a
+                                     type of SectionType to return.
+  @param  Buffer                     Output pointer to the section contents.
+  @param  BufferSize                 Output size in bytes of the section
+                                     contents.
+  @param  AuthenticationStatus       AuthenticationStatus is a pointer to a
+                                     caller allocated UINT32 in which the
+                                     authentication status is returned.
+
+  @retval EFI_SUCCESS                *Buffer points to the section contents.
+  @retval EFI_UNSUPPORTED            This is not an FV produced by the DXE core,
+                                     or the section only exists in extracted
+                                     form.  Use ReadSection() instead.
+  @retval EFI_NOT_FOUND              Section not found.
+  @retval EFI_INVALID_PARAMETER      Invalid parameter.
+  @retval others                     Values returned by ReadSection() for the
+                                     same section.
+
+**/
+EFI_STATUS
+FvLocateFileSection (
+  IN CONST  EFI_FIRMWARE_VOLUME2_PROTOCOL  *This,
+  IN CONST  EFI_GUID                       *NameGuid,
+  IN        EFI_SECTION_TYPE               SectionType,
+  IN        UINTN                          SectionInstance,
+  OUT       VOID                           **Buffer,
+  OUT       UINTN                          *BufferSize,
+  OUT       UINT32                         *AuthenticationStatus
+  );
+
 /**
   This routine produces a firmware volume block protocol on a given
   buffer.
@@ -2693,6 +2823,22 @@ CoreReleaseLock (
   );
 
 
+/**
+  Hash a GUID for the GUID keyed hash tables of the DXE core. GUIDs are
+  random enough that folding the four 32-bit words together spreads them
+  evenly over the buckets.
+
+  @param  Guid               The GUID to hash
+
+  @return The hash, to be masked with the power of 2 size of the table minus 1
+
+**/
+UINT32
+CoreHashGuid (
+  IN CONST EFI_GUID  *Guid
+  );
+
+
 /**
   An empty function to pass error checking of CreateEventEx ().
 
@@ -283,6 +283,12 @@ DxeMain (
 
   gDxeCoreST->RuntimeServices = gDxeCoreRT;
 
+  //
+  // Initialize the Protocol Database before the Image Services install the
+  // first protocol interfaces
+  //
+  CoreInitializeProtocolDatabase ();
+
   //
   // Start the Image Services.
   //
@@ -479,6 +485,14 @@ DxeMain (
     CoreDisplayDiscoveredNotDispatched ();
   DEBUG_CODE_END ();
 
+  //
+  // Display how much of each FV was read from flash if this is a debug build
+  //
+  DEBUG_CODE_BEGIN ();
+    CoreDisplayFvCacheStatistics ();
+    CoreDisplaySectionCacheStatistics ();
+  DEBUG_CODE_END ();
+
   //
   // Assert if the Architectural Protocols are not present.
   //
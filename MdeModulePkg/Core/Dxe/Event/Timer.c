@@ -1,6 +1,12 @@
 /** @file
   Core Timer Services
 
+  Timer events are kept in a hierarchical timer wheel. Level 0 holds one list
+  per 2^TIMER_WHEEL_SLOT_SHIFT units of 100ns, and each higher level holds
+  timers TIMER_WHEEL_SLOTS times further away. Inserting or cancelling a timer
+  is O(1), and timers in higher levels are cascaded down as the wheel turns, so
+  the periodic tick only compares the system time against the next check time.
+
 Copyright (c) 2006 - 2013, Intel Corporation. All rights reserved.<BR>
 This program and the accompanying materials
 are licensed and made available under the terms and conditions of the BSD License
@@ -16,14 +22,42 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "DxeMain.h"
 #include "Event.h"
 
+//
+// Timer wheel geometry. A level 0 slot spans 2^16 * 100ns (about 6.5ms), and
+// six levels of 64 slots cover 2^52 * 100ns before timers are parked in the
+// last reachable slot of the top level.
+//
+#define TIMER_WHEEL_SLOT_SHIFT   16
+#define TIMER_WHEEL_LEVEL_SHIFT  6
+#define TIMER_WHEEL_SLOTS        (1 << TIMER_WHEEL_LEVEL_SHIFT)
+#define TIMER_WHEEL_LEVELS       6
+
+//
+// Number of expired timers whose lateness is summarized in one pair of
+// performance log entries
+//
+#define TIMER_LATENESS_REPORT_COUNT  256
+
 //
 // Internal data
 //
 
-LIST_ENTRY       mEfiTimerList = INITIALIZE_LIST_HEAD_VARIABLE (mEfiTimerList);
+LIST_ENTRY       mEfiTimerWheel[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+UINT64           mEfiTimerWheelMap[TIMER_WHEEL_LEVELS];
+UINT64           mEfiTimerWheelTime = 0;
+UINT64           mEfiTimerNextCheckTime = MAX_UINT64;
 EFI_LOCK         mEfiTimerLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL - 1);
 EFI_EVENT        mEfiCheckTimerEvent = NULL;
 
+//
+// Lateness of the expired timers, in 100ns units, collected by CoreCheckTimers()
+// while performance measurement is enabled. Protected by mEfiTimerLock.
+//
+UINT64           mEfiTimerLateMax = 0;
+UINT64           mEfiTimerLateTotal = 0;
+UINT64           mEfiTimerLateCount = 0;
+EFI_EVENT        mEfiTimerLateReportEvent = NULL;
+
 EFI_LOCK         mEfiSystemTimeLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 UINT64           mEfiSystemTime = 0;
 
@@ -42,29 +76,208 @@ CoreInsertEventTimer (
   IN IEVENT   *Event
   )
 {
-  UINT64          TriggerTime;
-  LIST_ENTRY      *Link;
-  IEVENT          *Event2;
+  UINT64          Expires;
+  UINT64          Delta;
+  UINTN           Level;
+  UINTN           Index;
 
   ASSERT_LOCKED (&mEfiTimerLock);
 
   //
-  // Get the timer's trigger time
+  // Timers that are already due go to the current slot of level 0
   //
-  TriggerTime = Event->Timer.TriggerTime;
+  Expires = RShiftU64 (Event->Timer.TriggerTime, TIMER_WHEEL_SLOT_SHIFT);
+  if (Expires < mEfiTimerWheelTime) {
+    Expires = mEfiTimerWheelTime;
+  }
+  Delta = Expires - mEfiTimerWheelTime;
 
   //
-  // Insert the timer into the timer database in assending sorted order
+  // Pick the lowest level whose span covers the distance to the trigger time.
+  // Timers beyond the span of the wheel are parked in the last slot it can
+  // reach, and are filed again when that slot is cascaded.
   //
-  for (Link = mEfiTimerList.ForwardLink; Link != &mEfiTimerList; Link = Link->ForwardLink) {
-    Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  for (Level = 0; Level < TIMER_WHEEL_LEVELS - 1; Level++) {
+    if (Delta < LShiftU64 (1, (Level + 1) * TIMER_WHEEL_LEVEL_SHIFT)) {
+      break;
+    }
+  }
+  if (Delta >= LShiftU64 (1, TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_SHIFT)) {
+    Expires = mEfiTimerWheelTime + LShiftU64 (1, TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_SHIFT) - 1;
+  }
+
+  Index = (UINTN) RShiftU64 (Expires, Level * TIMER_WHEEL_LEVEL_SHIFT) & (TIMER_WHEEL_SLOTS - 1);
+  Event->Timer.WheelSlot = Level * TIMER_WHEEL_SLOTS + Index;
+  InsertTailList (&mEfiTimerWheel[Event->Timer.WheelSlot], &Event->Timer.Link);
+  mEfiTimerWheelMap[Level] |= LShiftU64 (1, Index);
+}
+
+/**
+  Removes the timer event from the timer wheel.
+
+  @param  Event                  Points to the internal structure of timer event
+                                 to be removed
+
+**/
+VOID
+CoreRemoveEventTimer (
+  IN IEVENT   *Event
+  )
+{
+  UINTN           Slot;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  RemoveEntryList (&Event->Timer.Link);
+  Event->Timer.Link.ForwardLink = NULL;
+
+  Slot = Event->Timer.WheelSlot;
+  if (IsListEmpty (&mEfiTimerWheel[Slot])) {
+    mEfiTimerWheelMap[Slot / TIMER_WHEEL_SLOTS] &= ~LShiftU64 (1, Slot % TIMER_WHEEL_SLOTS);
+  }
+}
+
+/**
+  Returns the earliest system time at which the timer wheel needs attention.
+
+  For level 0 this is the trigger time of the earliest timer in the next
+  occupied slot. For the higher levels it is the time at which the next
+  occupied slot is cascaded. The result is never later than the trigger
+  time of any timer in the wheel.
+
+  @return The next check time, or MAX_UINT64 if the wheel is empty.
+
+**/
+UINT64
+CoreGetTimerWheelCheckTime (
+  VOID
+  )
+{
+  UINT64          CheckTime;
+  UINT64          Time;
+  UINT64          Slot;
+  UINT64          Map;
+  UINTN           Level;
+  UINTN           Shift;
+  UINTN           Index;
+  INTN            Offset;
+  LIST_ENTRY      *Head;
+  LIST_ENTRY      *Link;
+  IEVENT          *Event;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  CheckTime = MAX_UINT64;
+  for (Level = 0; Level < TIMER_WHEEL_LEVELS; Level++) {
+    if (mEfiTimerWheelMap[Level] == 0) {
+      continue;
+    }
+
+    //
+    // Rotate the occupancy map so that bit 0 is the current slot
+    //
+    Shift = Level * TIMER_WHEEL_LEVEL_SHIFT;
+    Index = (UINTN) RShiftU64 (mEfiTimerWheelTime, Shift) & (TIMER_WHEEL_SLOTS - 1);
+    Map   = RRotU64 (mEfiTimerWheelMap[Level], Index);
+
+    if (Level == 0) {
+      Offset = LowBitSet64 (Map);
+      Head = &mEfiTimerWheel[(Index + Offset) & (TIMER_WHEEL_SLOTS - 1)];
+      for (Link = Head->ForwardLink; Link != Head; Link = Link->ForwardLink) {
+        Event = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+        if (Event->Timer.TriggerTime < CheckTime) {
+          CheckTime = Event->Timer.TriggerTime;
+        }
+      }
+      continue;
+    }
+
+    //
+    // The current slot of a higher level was already cascaded, so the timers
+    // in it belong to the next turn of that level
+    //
+    if ((Map & ~(UINT64) BIT0) != 0) {
+      Offset = LowBitSet64 (Map & ~(UINT64) BIT0);
+    } else {
+      Offset = TIMER_WHEEL_SLOTS;
+    }
+    Slot = LShiftU64 (RShiftU64 (mEfiTimerWheelTime, Shift) + Offset, Shift);
+    Time = LShiftU64 (Slot, TIMER_WHEEL_SLOT_SHIFT);
+    if (Time < CheckTime) {
+      CheckTime = Time;
+    }
+  }
+
+  return CheckTime;
+}
+
+/**
+  Moves the timers of the higher level slots that start at the current wheel
+  time down to the lower levels. Must be called whenever the level 0 slot index
+  wraps to zero.
+
+**/
+VOID
+CoreCascadeTimerWheel (
+  VOID
+  )
+{
+  LIST_ENTRY      Pending;
+  LIST_ENTRY      *Head;
+  UINTN           Level;
+  UINTN           Index;
+  IEVENT          *Event;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  for (Level = 1; Level < TIMER_WHEEL_LEVELS; Level++) {
+    Index = (UINTN) RShiftU64 (mEfiTimerWheelTime, Level * TIMER_WHEEL_LEVEL_SHIFT) & (TIMER_WHEEL_SLOTS - 1);
+    Head  = &mEfiTimerWheel[Level * TIMER_WHEEL_SLOTS + Index];
+
+    if (!IsListEmpty (Head)) {
+      //
+      // Detach the whole slot first, as timers parked beyond the span of the
+      // wheel may be filed into the same slot again
+      //
+      Pending.ForwardLink = Head->ForwardLink;
+      Pending.BackLink    = Head->BackLink;
+      Pending.ForwardLink->BackLink = &Pending;
+      Pending.BackLink->ForwardLink = &Pending;
+      InitializeListHead (Head);
+      mEfiTimerWheelMap[Level] &= ~LShiftU64 (1, Index);
+
+      while (!IsListEmpty (&Pending)) {
+        Event = CR (Pending.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+        RemoveEntryList (&Event->Timer.Link);
+        CoreInsertEventTimer (Event);
+      }
+    }
 
-    if (Event2->Timer.TriggerTime > TriggerTime) {
+    //
+    // Only continue to the next level when this level wrapped as well
+    //
+    if (Index != 0) {
       break;
     }
   }
+}
 
-  InsertTailList (Link, &Event->Timer.Link);
+/**
+  Updates the time at which CoreTimerTick() signals the timer check event.
+
+  @param  CheckTime              The new check time
+
+**/
+VOID
+CoreSetTimerCheckTime (
+  IN UINT64   CheckTime
+  )
+{
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  CoreAcquireLock (&mEfiSystemTimeLock);
+  mEfiTimerNextCheckTime = CheckTime;
+  CoreReleaseLock (&mEfiSystemTimeLock);
 }
 
 /**
@@ -88,7 +301,105 @@ CoreCurrentSystemTime (
 }
 
 /**
-  Checks the sorted timer list against the current system time.
+  Adds the lateness of an expired timer to the summary, and requests the
+  summary to be reported once it covers TIMER_LATENESS_REPORT_COUNT timers.
+
+  @param  Lateness               The number of 100ns between the trigger time
+                                 of the timer and the time it was found expired
+
+**/
+VOID
+CoreRecordTimerLateness (
+  IN UINT64   Lateness
+  )
+{
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  if (Lateness > mEfiTimerLateMax) {
+    mEfiTimerLateMax = Lateness;
+  }
+  mEfiTimerLateTotal += Lateness;
+  mEfiTimerLateCount++;
+
+  if (mEfiTimerLateCount == TIMER_LATENESS_REPORT_COUNT) {
+    CoreSignalEvent (mEfiTimerLateReportEvent);
+  }
+}
+
+/**
+  Adds a performance log entry whose duration is a timer lateness.
+
+  @param  Token                  The token of the entry
+  @param  Lateness               The lateness in 100ns units
+
+**/
+VOID
+CoreLogTimerLateness (
+  IN CONST CHAR8  *Token,
+  IN UINT64       Lateness
+  )
+{
+  UINT64          StartValue;
+  UINT64          EndValue;
+  UINT64          Frequency;
+  UINT64          Ticks;
+  UINT64          Now;
+
+  Frequency = GetPerformanceCounterProperties (&StartValue, &EndValue);
+  Ticks     = DivU64x32 (MultU64x64 (Lateness, Frequency), 10000000);
+  Now       = GetPerformanceCounter ();
+
+  //
+  // The entry ends now and starts Ticks earlier, in the direction the
+  // performance counter counts
+  //
+  if (EndValue >= StartValue) {
+    PERF_START (NULL, Token, "DxeMain", Now - Ticks);
+  } else {
+    PERF_START (NULL, Token, "DxeMain", Now + Ticks);
+  }
+  PERF_END (NULL, Token, "DxeMain", Now);
+}
+
+/**
+  Reports the maximum and average lateness of the last expired timers to the
+  performance log. Runs at TPL_CALLBACK, as the performance library cannot be
+  called from CoreCheckTimers() at TPL_HIGH_LEVEL - 1.
+
+  @param  ReportEvent            Not used
+  @param  Context                Not used
+
+**/
+VOID
+EFIAPI
+CoreReportTimerLateness (
+  IN EFI_EVENT            ReportEvent,
+  IN VOID                 *Context
+  )
+{
+  UINT64                  LateMax;
+  UINT64                  LateTotal;
+  UINT64                  LateCount;
+
+  CoreAcquireLock (&mEfiTimerLock);
+  LateMax   = mEfiTimerLateMax;
+  LateTotal = mEfiTimerLateTotal;
+  LateCount = mEfiTimerLateCount;
+  mEfiTimerLateMax   = 0;
+  mEfiTimerLateTotal = 0;
+  mEfiTimerLateCount = 0;
+  CoreReleaseLock (&mEfiTimerLock);
+
+  if (LateCount == 0) {
+    return;
+  }
+
+  CoreLogTimerLateness ("TimerLate:Max", LateMax);
+  CoreLogTimerLateness ("TimerLate:Avg", DivU64x64Remainder (LateTotal, LateCount, NULL));
+}
+
+/**
+  Turns the timer wheel up to the current system time.
   Signals any expired event timer.
 
   @param  CheckEvent             Not used
@@ -103,6 +414,11 @@ CoreCheckTimers (
   )
 {
   UINT64                  SystemTime;
+  UINT64                  TargetSlot;
+  UINT64                  NextSlot;
+  LIST_ENTRY              Expired;
+  LIST_ENTRY              *Head;
+  LIST_ENTRY              *Link;
   IEVENT                  *Event;
 
   //
@@ -110,24 +426,60 @@ CoreCheckTimers (
   //
   CoreAcquireLock (&mEfiTimerLock);
   SystemTime = CoreCurrentSystemTime ();
+  TargetSlot = RShiftU64 (SystemTime, TIMER_WHEEL_SLOT_SHIFT);
 
-  while (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  InitializeListHead (&Expired);
 
+  while (TRUE) {
     //
-    // If this timer is not expired, then we're done
+    // Collect the expired timers of the current level 0 slot
     //
-    if (Event->Timer.TriggerTime > SystemTime) {
+    Head = &mEfiTimerWheel[(UINTN) mEfiTimerWheelTime & (TIMER_WHEEL_SLOTS - 1)];
+    for (Link = Head->ForwardLink; Link != Head; ) {
+      Event = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+      Link  = Link->ForwardLink;
+
+      if (Event->Timer.TriggerTime <= SystemTime) {
+        CoreRemoveEventTimer (Event);
+        InsertTailList (&Expired, &Event->Timer.Link);
+      }
+    }
+
+    if (mEfiTimerWheelTime >= TargetSlot) {
       break;
     }
 
     //
-    // Remove this timer from the timer queue
+    // Skip directly to the next slot that holds a timer or has to be
+    // cascaded, but never past the current system time
     //
+    NextSlot = RShiftU64 (CoreGetTimerWheelCheckTime (), TIMER_WHEEL_SLOT_SHIFT);
+    if (NextSlot <= mEfiTimerWheelTime) {
+      NextSlot = mEfiTimerWheelTime + 1;
+    }
+    if (NextSlot > TargetSlot) {
+      NextSlot = TargetSlot;
+    }
+    mEfiTimerWheelTime = NextSlot;
 
+    if ((mEfiTimerWheelTime & (TIMER_WHEEL_SLOTS - 1)) == 0) {
+      CoreCascadeTimerWheel ();
+    }
+  }
+
+  while (!IsListEmpty (&Expired)) {
+    Event = CR (Expired.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+
+    //
+    // Remove this timer from the expired list
+    //
     RemoveEntryList (&Event->Timer.Link);
     Event->Timer.Link.ForwardLink = NULL;
 
+    PERF_CODE (
+      CoreRecordTimerLateness (SystemTime - Event->Timer.TriggerTime);
+    );
+
     //
     // Signal it
     //
@@ -157,6 +509,8 @@ CoreCheckTimers (
     }
   }
 
+  CoreSetTimerCheckTime (CoreGetTimerWheelCheckTime ());
+
   CoreReleaseLock (&mEfiTimerLock);
 }
 
@@ -171,6 +525,12 @@ CoreInitializeTimer (
   )
 {
   EFI_STATUS  Status;
+  UINTN       Index;
+
+  for (Index = 0; Index < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; Index++) {
+    InitializeListHead (&mEfiTimerWheel[Index]);
+  }
+  mEfiTimerWheelTime = RShiftU64 (CoreCurrentSystemTime (), TIMER_WHEEL_SLOT_SHIFT);
 
   Status = CoreCreateEventInternal (
              EVT_NOTIFY_SIGNAL,
@@ -181,6 +541,16 @@ CoreInitializeTimer (
              &mEfiCheckTimerEvent
              );
   ASSERT_EFI_ERROR (Status);
+
+  Status = CoreCreateEventInternal (
+             EVT_NOTIFY_SIGNAL,
+             TPL_CALLBACK,
+             CoreReportTimerLateness,
+             NULL,
+             NULL,
+             &mEfiTimerLateReportEvent
+             );
+  ASSERT_EFI_ERROR (Status);
 }
 
 
@@ -197,8 +567,6 @@ CoreTimerTick (
   IN UINT64   Duration
   )
 {
-  IEVENT          *Event;
-
   //
   // Check runtiem flag in case there are ticks while exiting boot services
   //
@@ -210,15 +578,11 @@ CoreTimerTick (
   mEfiSystemTime += Duration;
 
   //
-  // If the head of the list is expired, fire the timer event
+  // If the earliest timer may have expired, fire the timer event
   // to process it
   //
-  if (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
-    if (Event->Timer.TriggerTime <= mEfiSystemTime) {
-      CoreSignalEvent (mEfiCheckTimerEvent);
-    }
+  if (mEfiTimerNextCheckTime <= mEfiSystemTime) {
+    CoreSignalEvent (mEfiCheckTimerEvent);
   }
 
   CoreReleaseLock (&mEfiSystemTimeLock);
@@ -271,8 +635,7 @@ CoreSetTimer (
   // If the timer is queued to the timer database, remove it
   //
   if (Event->Timer.Link.ForwardLink != NULL) {
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
+    CoreRemoveEventTimer (Event);
   }
 
   Event->Timer.TriggerTime = 0;
@@ -290,6 +653,13 @@ CoreSetTimer (
     Event->Timer.TriggerTime = CoreCurrentSystemTime () + TriggerTime;
     CoreInsertEventTimer (Event);
 
+    //
+    // A timer that fires before the current check time moves it earlier
+    //
+    if (Event->Timer.TriggerTime < mEfiTimerNextCheckTime) {
+      CoreSetTimerCheckTime (Event->Timer.TriggerTime);
+    }
+
     if (TriggerTime == 0) {
       CoreSignalEvent (mEfiCheckTimerEvent);
     }
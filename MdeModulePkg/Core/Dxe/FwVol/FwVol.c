@@ -24,6 +24,11 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 VOID          *gEfiFwVolBlockNotifyReg;
 EFI_EVENT     gEfiFwVolBlockEvent;
 
+//
+// List of all the FV_DEVICE instances that produce a FV protocol
+//
+LIST_ENTRY    mFvDeviceList = INITIALIZE_LIST_HEAD_VARIABLE (mFvDeviceList);
+
 FV_DEVICE mFvDevice = {
   FV2_DEVICE_SIGNATURE,
   NULL,
@@ -48,7 +53,11 @@ FV_DEVICE mFvDevice = {
   0,
   0,
   FALSE,
-  FALSE
+  FALSE,
+  { { NULL, NULL } },
+  { NULL, NULL },
+  0,
+  0
 };
 
 
@@ -288,13 +297,6 @@ FreeFvDeviceResource (
     FfsFileEntry = (FFS_FILE_LIST_ENTRY *) NextEntry;
   }
 
-  if (!FvDevice->IsMemoryMapped) {
-    //
-    // Free the cached FV buffer.
-    //
-    CoreFreePool (FvDevice->CachedFv);
-  }
-
   //
   // Free Volume Header
   //
@@ -306,7 +308,96 @@ FreeFvDeviceResource (
 
 
 /**
-  Check if an FV is consistent and allocate cache for it.
+  Read data from the firmware volume, either directly from a memory mapped FV
+  or through the FVB protocol. The offset is translated into a logical block
+  and an offset into that block using the block map of the volume header.
+
+  @param  FvDevice              A pointer to the FvDevice to read from.
+  @param  Offset                Offset of the data from the start of the FV.
+  @param  DataSize              Size of data to be read.
+  @param  Data                  Pointer to Buffer that the data will be read into.
+
+  @retval EFI_SUCCESS           Successfully read data from the firmware volume.
+  @retval EFI_INVALID_PARAMETER The data is not within the firmware volume.
+  @retval others                The FVB protocol failed to read the data.
+
+**/
+EFI_STATUS
+FvReadData (
+  IN     FV_DEVICE                              *FvDevice,
+  IN     UINTN                                  Offset,
+  IN     UINTN                                  DataSize,
+  OUT    VOID                                   *Data
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_FV_BLOCK_MAP_ENTRY      *BlockMap;
+  EFI_LBA                     Lba;
+  UINTN                       BlockSpan;
+
+  if (Offset > FvDevice->FwVolHeader->FvLength ||
+      DataSize > FvDevice->FwVolHeader->FvLength - Offset) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (FvDevice->IsMemoryMapped) {
+    CopyMem (Data, FvDevice->CachedFv - FvDevice->FwVolHeader->HeaderLength + Offset, DataSize);
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Find the block that holds the start of the data
+  //
+  Lba = 0;
+  for (BlockMap = FvDevice->FwVolHeader->BlockMap; BlockMap->NumBlocks != 0 || BlockMap->Length != 0; BlockMap++) {
+    BlockSpan = BlockMap->NumBlocks * BlockMap->Length;
+    if (Offset < BlockSpan) {
+      Lba    += Offset / BlockMap->Length;
+      Offset  = Offset % BlockMap->Length;
+      break;
+    }
+    Offset -= BlockSpan;
+    Lba    += BlockMap->NumBlocks;
+  }
+  if (BlockMap->NumBlocks == 0 && BlockMap->Length == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = ReadFvbData (FvDevice->Fvb, &Lba, &Offset, DataSize, (UINT8 *) Data);
+  if (!EFI_ERROR (Status)) {
+    FvDevice->FvbBytesRead += DataSize;
+  }
+
+  return Status;
+}
+
+
+
+/**
+  Return the bucket of the file name hash table of a FvDevice that holds the
+  FFS file entries with the given name.
+
+  @param  FvDevice              A pointer to the FvDevice.
+  @param  NameGuid              The FFS file name.
+
+  @return The head of the bucket.
+
+**/
+LIST_ENTRY *
+FvGetFileHashBucket (
+  IN FV_DEVICE        *FvDevice,
+  IN CONST EFI_GUID   *NameGuid
+  )
+{
+  return &FvDevice->FfsFileHashTable[CoreHashGuid (NameGuid) & (FFS_FILE_HASH_TABLE_SIZE - 1)];
+}
+
+
+
+/**
+  Check if an FV is consistent and build the list and the name index of its
+  files. Only the file headers are read from a FV that is not memory mapped;
+  the file contents are cached when a file is first read.
 
   @param  FvDevice              A pointer to the FvDevice to be checked.
 
@@ -323,19 +414,15 @@ FvCheck (
   EFI_STATUS                            Status;
   EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL    *Fvb;
   EFI_FIRMWARE_VOLUME_HEADER            *FwVolHeader;
-  EFI_FIRMWARE_VOLUME_EXT_HEADER        *FwVolExtHeader;
+  EFI_FIRMWARE_VOLUME_EXT_HEADER        FwVolExtHeader;
   EFI_FVB_ATTRIBUTES_2                  FvbAttributes;
-  EFI_FV_BLOCK_MAP_ENTRY                *BlockMap;
   FFS_FILE_LIST_ENTRY                   *FfsFileEntry;
   EFI_FFS_FILE_HEADER                   *FfsHeader;
-  UINT8                                 *CacheLocation;
-  UINTN                                 LbaOffset;
-  UINTN                                 HeaderSize;
+  EFI_FFS_FILE_HEADER2                  FfsHeaderBuffer;
   UINTN                                 Index;
-  EFI_LBA                               LbaIndex;
-  UINTN                                 Size;
+  UINTN                                 FileOffset;
+  UINTN                                 FvLength;
   EFI_FFS_FILE_STATE                    FileState;
-  UINT8                                 *TopFvAddress;
   UINTN                                 TestLength;
   EFI_PHYSICAL_ADDRESS                  PhysicalAddress;
   BOOLEAN                               FileCached;
@@ -353,11 +440,7 @@ FvCheck (
     return Status;
   }
 
-  //
-  // Size is the size of the FV minus the head. We have already allocated
-  // the header to check to make sure the volume is valid
-  //
-  Size = (UINTN)(FwVolHeader->FvLength - FwVolHeader->HeaderLength);
+  FvLength = (UINTN) FwVolHeader->FvLength;
   if ((FvbAttributes & EFI_FVB2_MEMORY_MAPPED) != 0) {
     FvDevice->IsMemoryMapped = TRUE;
 
@@ -370,85 +453,15 @@ FvCheck (
     // Don't cache memory mapped FV really.
     //
     FvDevice->CachedFv = (UINT8 *) (UINTN) (PhysicalAddress + FwVolHeader->HeaderLength);
+    FvDevice->EndOfCachedFv = (UINT8 *) (UINTN) (PhysicalAddress + FvLength);
   } else {
-    FvDevice->IsMemoryMapped = FALSE;
-    FvDevice->CachedFv = AllocatePool (Size);
-
-    if (FvDevice->CachedFv == NULL) {
-      return EFI_OUT_OF_RESOURCES;
-    }
-  }
-
-  //
-  // Remember a pointer to the end fo the CachedFv
-  //
-  FvDevice->EndOfCachedFv = FvDevice->CachedFv + Size;
-
-  if (!FvDevice->IsMemoryMapped) {
     //
-    // Copy FV minus header into memory using the block map we have all ready
-    // read into memory.
+    // Files of a FV that is not memory mapped are read through the FVB one at
+    // a time when they are first used.
     //
-    BlockMap = FwVolHeader->BlockMap;
-    CacheLocation = FvDevice->CachedFv;
-    LbaIndex = 0;
-    LbaOffset = 0;
-    HeaderSize = FwVolHeader->HeaderLength;
-    while ((BlockMap->NumBlocks != 0) || (BlockMap->Length != 0)) {
-      Index = 0;
-      Size  = BlockMap->Length;
-      if (HeaderSize > 0) {
-        //
-        // Skip header size
-        //
-        for (; Index < BlockMap->NumBlocks && HeaderSize >= BlockMap->Length; Index ++) {
-          HeaderSize -= BlockMap->Length;
-          LbaIndex ++;
-        }
-
-        //
-        // Check whether FvHeader is crossing the multi block range.
-        //
-        if (Index >= BlockMap->NumBlocks) {
-          BlockMap++;
-          continue;
-        } else if (HeaderSize > 0) {
-          LbaOffset = HeaderSize;
-          Size = BlockMap->Length - HeaderSize;
-          HeaderSize = 0;
-        }
-      }
-    
-      //
-      // read the FV data  
-      //
-      for (; Index < BlockMap->NumBlocks; Index ++) {
-        Status = Fvb->Read (Fvb,
-                        LbaIndex,
-                        LbaOffset,
-                        &Size,
-                        CacheLocation
-                        );
-
-        //
-        // Not check EFI_BAD_BUFFER_SIZE, for Size = BlockMap->Length
-        //
-        if (EFI_ERROR (Status)) {
-          goto Done;
-        }
-
-        LbaIndex++;
-        CacheLocation += Size;
-
-        //
-        // After we skip Fv Header always read from start of block
-        //
-        LbaOffset = 0;
-        Size  = BlockMap->Length;
-      }
-
-      BlockMap++;
-    }
+    FvDevice->IsMemoryMapped = FALSE;
+    FvDevice->CachedFv = NULL;
+    FvDevice->EndOfCachedFv = NULL;
   }
 
   //
@@ -462,11 +475,14 @@ FvCheck (
 
 
   //
-  // go through the whole FV cache, check the consistence of the FV.
+  // go through the whole FV, check the consistence of the FV.
   // Make a linked list of all the Ffs file headers
   //
   Status = EFI_SUCCESS;
   InitializeListHead (&FvDevice->FfsFileListHeader);
+  for (Index = 0; Index < FFS_FILE_HASH_TABLE_SIZE; Index++) {
+    InitializeListHead (&FvDevice->FfsFileHashTable[Index]);
+  }
 
   //
   // Build FFS list
@@ -475,21 +491,41 @@ FvCheck (
     //
     // Searching for files starts on an 8 byte aligned boundary after the end of the Extended Header if it exists.
     //
-    FwVolExtHeader = (EFI_FIRMWARE_VOLUME_EXT_HEADER *) (FvDevice->CachedFv + (FwVolHeader->ExtHeaderOffset - FwVolHeader->HeaderLength));
-    FfsHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FwVolExtHeader + FwVolExtHeader->ExtHeaderSize);
-    FfsHeader = (EFI_FFS_FILE_HEADER *) ALIGN_POINTER (FfsHeader, 8);
+    Status = FvReadData (FvDevice, FwVolHeader->ExtHeaderOffset, sizeof (FwVolExtHeader), &FwVolExtHeader);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+    FileOffset = ALIGN_VALUE (FwVolHeader->ExtHeaderOffset + FwVolExtHeader.ExtHeaderSize, 8);
   } else {
-    FfsHeader = (EFI_FFS_FILE_HEADER *) (FvDevice->CachedFv);
+    FileOffset = FwVolHeader->HeaderLength;
   }
-  TopFvAddress = FvDevice->EndOfCachedFv;
-  while (((UINTN) FfsHeader >= (UINTN) FvDevice->CachedFv) && ((UINTN) FfsHeader <= (UINTN) ((UINTN) TopFvAddress - sizeof (EFI_FFS_FILE_HEADER)))) {
+
+  while ((FileOffset >= FwVolHeader->HeaderLength) && (FileOffset <= FvLength - sizeof (EFI_FFS_FILE_HEADER))) {
 
     if (FileCached) {
       CoreFreePool (CacheFfsHeader);
       FileCached = FALSE;
     }
 
-    TestLength = TopFvAddress - ((UINT8 *) FfsHeader);
+    TestLength = FvLength - FileOffset;
+    if (TestLength > sizeof (EFI_FFS_FILE_HEADER2)) {
+      TestLength = sizeof (EFI_FFS_FILE_HEADER2);
+    }
+
+    if (FvDevice->IsMemoryMapped) {
+      FfsHeader = (EFI_FFS_FILE_HEADER *) (FvDevice->CachedFv - FwVolHeader->HeaderLength + FileOffset);
+    } else {
+      //
+      // Only the file header is read here
+      //
+      SetMem (&FfsHeaderBuffer, sizeof (FfsHeaderBuffer), (UINT8) (FvDevice->ErasePolarity != 0 ? 0xFF : 0));
+      Status = FvReadData (FvDevice, FileOffset, TestLength, &FfsHeaderBuffer);
+      if (EFI_ERROR (Status)) {
+        goto Done;
+      }
+      FfsHeader = (EFI_FFS_FILE_HEADER *) &FfsHeaderBuffer;
+    }
+
     if (TestLength > sizeof (EFI_FFS_FILE_HEADER)) {
       TestLength = sizeof (EFI_FFS_FILE_HEADER);
     }
@@ -508,9 +544,9 @@ FvCheck (
           if (!FvDevice->IsFfs3Fv) {
             DEBUG ((EFI_D_ERROR, "Found a FFS3 formatted file: %g in a non-FFS3 formatted FV.\n", &FfsHeader->Name));
           }
-          FfsHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FfsHeader + sizeof (EFI_FFS_FILE_HEADER2));
+          FileOffset += sizeof (EFI_FFS_FILE_HEADER2);
         } else {
-          FfsHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FfsHeader + sizeof (EFI_FFS_FILE_HEADER));
+          FileOffset += sizeof (EFI_FFS_FILE_HEADER);
         }
         continue;
       } else {
@@ -523,20 +559,22 @@ FvCheck (
     }
 
     CacheFfsHeader = FfsHeader;
+    WholeFileSize = IS_FFS_FILE2 (FfsHeader) ? FFS_FILE2_SIZE (FfsHeader): FFS_FILE_SIZE (FfsHeader);
     if ((CacheFfsHeader->Attributes & FFS_ATTRIB_CHECKSUM) == FFS_ATTRIB_CHECKSUM) {
-      if (FvDevice->IsMemoryMapped) {
-        //
-        // Memory mapped FV has not been cached.
-        // Here is to cache FFS file to memory buffer for following checksum calculating.
-        // And then, the cached file buffer can be also used for FvReadFile.
-        //
-        WholeFileSize = IS_FFS_FILE2 (CacheFfsHeader) ? FFS_FILE2_SIZE (CacheFfsHeader): FFS_FILE_SIZE (CacheFfsHeader);
-        CacheFfsHeader = AllocateCopyPool (WholeFileSize, CacheFfsHeader);
-        if (CacheFfsHeader == NULL) {
-          Status = EFI_OUT_OF_RESOURCES;
-          goto Done;
-        }
-        FileCached = TRUE;
+      //
+      // Cache the whole FFS file to memory buffer for following checksum calculating.
+      // And then, the cached file buffer can be also used for FvReadFile.
+      //
+      CacheFfsHeader = AllocatePool (WholeFileSize);
+      if (CacheFfsHeader == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+      }
+      FileCached = TRUE;
+      Status = FvReadData (FvDevice, FileOffset, WholeFileSize, CacheFfsHeader);
+      if (EFI_ERROR (Status)) {
+        Status = EFI_VOLUME_CORRUPTED;
+        goto Done;
       }
     }
 
@@ -552,11 +590,10 @@ FvCheck (
       ASSERT (FFS_FILE2_SIZE (CacheFfsHeader) > 0x00FFFFFF);
       if (!FvDevice->IsFfs3Fv) {
         DEBUG ((EFI_D_ERROR, "Found a FFS3 formatted file: %g in a non-FFS3 formatted FV.\n", &CacheFfsHeader->Name));
-        FfsHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FfsHeader + FFS_FILE2_SIZE (CacheFfsHeader));
         //
-        // Adjust pointer to the next 8-byte aligned boundry.
+        // Adjust offset to the next 8-byte aligned boundry.
         //
-        FfsHeader = (EFI_FFS_FILE_HEADER *) (((UINTN) FfsHeader + 7) & ~0x07);
+        FileOffset = ALIGN_VALUE (FileOffset + WholeFileSize, 8);
         continue;
       }
     }
@@ -576,23 +613,31 @@ FvCheck (
         goto Done;
       }
 
+      FfsFileEntry->FileOffset = FileOffset;
+      if (CacheFfsHeader == (EFI_FFS_FILE_HEADER *) &FfsHeaderBuffer) {
+        //
+        // Keep a copy of the header until the file is cached
+        //
+        CopyMem (&FfsFileEntry->FileHeader, &FfsHeaderBuffer, sizeof (FfsHeaderBuffer));
+        CacheFfsHeader = (EFI_FFS_FILE_HEADER *) &FfsFileEntry->FileHeader;
+      }
       FfsFileEntry->FfsHeader = CacheFfsHeader;
       FfsFileEntry->FileCached = FileCached;
       FileCached = FALSE;
       InsertTailList (&FvDevice->FfsFileListHeader, &FfsFileEntry->Link);
-    }
 
-    if (IS_FFS_FILE2 (CacheFfsHeader)) {
-      FfsHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FfsHeader + FFS_FILE2_SIZE (CacheFfsHeader));
-    } else {
-      FfsHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FfsHeader + FFS_FILE_SIZE (CacheFfsHeader));
+      //
+      // Pad files can not be looked up by name
+      //
+      if (CacheFfsHeader->Type != EFI_FV_FILETYPE_FFS_PAD) {
+        InsertTailList (FvGetFileHashBucket (FvDevice, &CacheFfsHeader->Name), &FfsFileEntry->HashLink);
+      }
     }
 
     //
-    // Adjust pointer to the next 8-byte aligned boundry.
+    // Adjust offset to the next 8-byte aligned boundry.
     //
-    FfsHeader = (EFI_FFS_FILE_HEADER *)(((UINTN)FfsHeader + 7) & ~0x07);
-
+    FileOffset = ALIGN_VALUE (FileOffset + WholeFileSize, 8);
   }
 
 Done:
@@ -608,6 +653,33 @@ Done:
 }
 
 
+/**
+  Display how many bytes each firmware volume read through the FVB protocol,
+  and how many bytes of file data were served from its file cache. Only used
+  in debug builds.
+
+**/
+VOID
+CoreDisplayFvCacheStatistics (
+  VOID
+  )
+{
+  LIST_ENTRY                  *Link;
+  FV_DEVICE                   *FvDevice;
+
+  for (Link = mFvDeviceList.ForwardLink; Link != &mFvDeviceList; Link = Link->ForwardLink) {
+    FvDevice = CR (Link, FV_DEVICE, Link, FV2_DEVICE_SIGNATURE);
+    DEBUG ((
+      DEBUG_INFO,
+      "FV %p: %ld bytes read from FVB, %ld bytes served from file cache\n",
+      FvDevice->Handle,
+      FvDevice->FvbBytesRead,
+      FvDevice->CacheBytesServed
+      ));
+  }
+}
+
+
 
 /**
   This notification function is invoked when an instance of the
@@ -730,6 +802,7 @@ NotifyFwVolBlock (
                     &FvDevice->Fv
                     );
         ASSERT_EFI_ERROR (Status);
+        InsertTailList (&mFvDeviceList, &FvDevice->Link);
       } else {
         //
         // Free FvDevice Buffer for the corrupt FV image.
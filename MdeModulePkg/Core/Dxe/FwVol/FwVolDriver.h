@@ -20,13 +20,23 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define FV2_DEVICE_SIGNATURE SIGNATURE_32 ('_', 'F', 'V', '2')
 
 //
-// Used to track all non-deleted files
+// Number of buckets of the file name index of a FV
+//
+#define FFS_FILE_HASH_TABLE_SIZE  64
+
+//
+// Used to track all non-deleted files. Until FileCached is set, FfsHeader of a
+// file in a FV that is not memory mapped points to the FileHeader copy, and
+// the contents of the file are still only in the FV at FileOffset.
 //
 typedef struct {
   LIST_ENTRY                      Link;
+  LIST_ENTRY                      HashLink;
   EFI_FFS_FILE_HEADER             *FfsHeader;
   UINTN                           StreamHandle;
   BOOLEAN                         FileCached;
+  UINTN                           FileOffset;
+  EFI_FFS_FILE_HEADER2            FileHeader;
 } FFS_FILE_LIST_ENTRY;
 
 typedef struct {
@@ -47,6 +57,11 @@ typedef struct {
   UINT8                                   ErasePolarity;
   BOOLEAN                                 IsFfs3Fv;
   BOOLEAN                                 IsMemoryMapped;
+
+  LIST_ENTRY                              FfsFileHashTable[FFS_FILE_HASH_TABLE_SIZE];
+  LIST_ENTRY                              Link;
+  UINT64                                  FvbBytesRead;
+  UINT64                                  CacheBytesServed;
 } FV_DEVICE;
 
 #define FV_DEVICE_FROM_THIS(a) CR(a, FV_DEVICE, Fv, FV2_DEVICE_SIGNATURE)
@@ -405,4 +420,44 @@ IsValidFfsFile (
   IN EFI_FFS_FILE_HEADER  *FfsHeader
   );
 
+
+/**
+  Read data from the firmware volume, either directly from a memory mapped FV
+  or through the FVB protocol.
+
+  @param  FvDevice              A pointer to the FvDevice to read from.
+  @param  Offset                Offset of the data from the start of the FV.
+  @param  DataSize              Size of data to be read.
+  @param  Data                  Pointer to Buffer that the data will be read into.
+
+  @retval EFI_SUCCESS           Successfully read data from the firmware volume.
+  @retval EFI_INVALID_PARAMETER The data is not within the firmware volume.
+  @retval others                The FVB protocol failed to read the data.
+
+**/
+EFI_STATUS
+FvReadData (
+  IN     FV_DEVICE                              *FvDevice,
+  IN     UINTN                                  Offset,
+  IN     UINTN                                  DataSize,
+  OUT    VOID                                   *Data
+  );
+
+
+/**
+  Return the bucket of the file name hash table of a FvDevice that holds the
+  FFS file entries with the given name.
+
+  @param  FvDevice              A pointer to the FvDevice.
+  @param  NameGuid              The FFS file name.
+
+  @return The head of the bucket.
+
+**/
+LIST_ENTRY *
+FvGetFileHashBucket (
+  IN FV_DEVICE        *FvDevice,
+  IN CONST EFI_GUID   *NameGuid
+  );
+
 #endif
@@ -273,14 +273,16 @@ FvReadFile (
 {
   EFI_STATUS                        Status;
   FV_DEVICE                         *FvDevice;
-  EFI_GUID                          SearchNameGuid;
-  EFI_FV_FILETYPE                   LocalFoundType;
-  EFI_FV_FILE_ATTRIBUTES            LocalAttributes;
+  EFI_FV_ATTRIBUTES                 FvAttributes;
+  LIST_ENTRY                        *Bucket;
+  LIST_ENTRY                        *Link;
+  FFS_FILE_LIST_ENTRY               *FfsFileEntry;
   UINTN                             FileSize;
   UINT8                             *SrcPtr;
   EFI_FFS_FILE_HEADER               *FfsHeader;
   UINTN                             InputBufferSize;
   UINTN                             WholeFileSize;
+  BOOLEAN                           FileCached;
 
   if (NameGuid == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -288,50 +290,59 @@ FvReadFile (
 
   FvDevice = FV_DEVICE_FROM_THIS (This);
 
+  Status = FvGetVolumeAttributes (This, &FvAttributes);
+  if (EFI_ERROR (Status) || (FvAttributes & EFI_FV2_READ_STATUS) == 0) {
+    return EFI_NOT_FOUND;
+  }
 
   //
-  // Keep looking until we find the matching NameGuid.
-  // The Key is really a FfsFileEntry
+  // Look up the first file with a matching NameGuid in the name index.
+  // Remember it in LastKey for FvReadFileSection().
   //
-  FvDevice->LastKey = 0;
-  do {
-    LocalFoundType = 0;
-    Status = FvGetNextFile (
-              This,
-              &FvDevice->LastKey,
-              &LocalFoundType,
-              &SearchNameGuid,
-              &LocalAttributes,
-              &FileSize
-              );
-    if (EFI_ERROR (Status)) {
-      return EFI_NOT_FOUND;
+  FvDevice->LastKey = NULL;
+  Bucket = FvGetFileHashBucket (FvDevice, NameGuid);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    FfsFileEntry = BASE_CR (Link, FFS_FILE_LIST_ENTRY, HashLink);
+    if (CompareGuid (&FfsFileEntry->FfsHeader->Name, NameGuid)) {
+      FvDevice->LastKey = FfsFileEntry;
+      break;
     }
-  } while (!CompareGuid (&SearchNameGuid, NameGuid));
+  }
+  if (FvDevice->LastKey == NULL) {
+    return EFI_NOT_FOUND;
+  }
 
   //
   // Get a pointer to the header
   //
-  FfsHeader = FvDevice->LastKey->FfsHeader;
-  if (FvDevice->IsMemoryMapped) {
+  FfsHeader  = FvDevice->LastKey->FfsHeader;
+  FileCached = FvDevice->LastKey->FileCached;
+  if (!FileCached) {
     //
-    // Memory mapped FV has not been cached, so here is to cache by file.
+    // Neither a memory mapped FV nor the files of a FV that is read through
+    // the FVB are cached up front, so here is to cache by file.
     //
-    if (!FvDevice->LastKey->FileCached) {
-      //
-      // Cache FFS file to memory buffer.
-      //
-      WholeFileSize = IS_FFS_FILE2 (FfsHeader) ? FFS_FILE2_SIZE (FfsHeader): FFS_FILE_SIZE (FfsHeader);
-      FfsHeader = AllocateCopyPool (WholeFileSize, FfsHeader);
-      if (FfsHeader == NULL) {
-        return EFI_OUT_OF_RESOURCES;
-      }
-      //
-      // Let FfsHeader in FfsFileEntry point to the cached file buffer.
-      //
-      FvDevice->LastKey->FfsHeader = FfsHeader;
-      FvDevice->LastKey->FileCached = TRUE;
+    WholeFileSize = IS_FFS_FILE2 (FfsHeader) ? FFS_FILE2_SIZE (FfsHeader): FFS_FILE_SIZE (FfsHeader);
+    FfsHeader = AllocatePool (WholeFileSize);
+    if (FfsHeader == NULL) {
+      return EFI_OUT_OF_RESOURCES;
     }
+    Status = FvReadData (FvDevice, FvDevice->LastKey->FileOffset, WholeFileSize, FfsHeader);
+    if (EFI_ERROR (Status)) {
+      CoreFreePool (FfsHeader);
+      return EFI_DEVICE_ERROR;
+    }
+    //
+    // Let FfsHeader in FfsFileEntry point to the cached file buffer.
+    //
+    FvDevice->LastKey->FfsHeader = FfsHeader;
+    FvDevice->LastKey->FileCached = TRUE;
+  }
+
+  if (IS_FFS_FILE2 (FfsHeader)) {
+    FileSize = FFS_FILE2_SIZE (FfsHeader) - sizeof (EFI_FFS_FILE_HEADER2);
+  } else {
+    FileSize = FFS_FILE_SIZE (FfsHeader) - sizeof (EFI_FFS_FILE_HEADER);
   }
 
   //
@@ -387,12 +398,97 @@ FvReadFile (
   // Copy data into callers buffer
   //
   CopyMem (*Buffer, SrcPtr, FileSize);
+  if (FileCached) {
+    FvDevice->CacheBytesServed += FileSize;
+  }
 
   return Status;
 }
 
 
 
+/**
+  Opens, or finds the already open, section stream of a given FFS file.
+
+  @param  FvDevice                   The FV that holds the file.
+  @param  NameGuid                   Pointer to an EFI_GUID, which is the
+                                     filename.
+  @param  FfsEntry                   Output pointer to the file list entry,
+                                     whose StreamHandle is the section stream.
+  @param  StreamCached               Output TRUE if the stream had been opened
+                                     by an earlier call.
+  @param  AuthenticationStatus       Output authentication status of the file.
+
+  @retval EFI_SUCCESS                The section stream is open.
+  @retval EFI_NOT_FOUND              The file does not exist or has no
+                                     sections.
+  @retval others                     Values returned by FvReadFile() or
+                                     OpenSectionStream().
+
+**/
+EFI_STATUS
+FvOpenFileSectionStream (
+  IN  FV_DEVICE                      *FvDevice,
+  IN  CONST EFI_GUID                 *NameGuid,
+  OUT FFS_FILE_LIST_ENTRY            **FfsEntry,
+  OUT BOOLEAN                        *StreamCached,
+  OUT UINT32                         *AuthenticationStatus
+  )
+{
+  EFI_STATUS                        Status;
+  EFI_FV_FILETYPE                   FileType;
+  EFI_FV_FILE_ATTRIBUTES            FileAttributes;
+  UINTN                             FileSize;
+  UINT8                             *FileBuffer;
+
+  //
+  // Read the file
+  //
+  Status = FvReadFile (
+            &FvDevice->Fv,
+            NameGuid,
+            NULL,
+            &FileSize,
+            &FileType,
+            &FileAttributes,
+            AuthenticationStatus
+            );
+  //
+  // Get the last key used by our call to FvReadFile as it is the FfsEntry for this file.
+  //
+  *FfsEntry = (FFS_FILE_LIST_ENTRY *) FvDevice->LastKey;
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (IS_FFS_FILE2 ((*FfsEntry)->FfsHeader)) {
+    FileBuffer = ((UINT8 *) (*FfsEntry)->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER2);
+  } else {
+    FileBuffer = ((UINT8 *) (*FfsEntry)->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER);
+  }
+  //
+  // Check to see that the file actually HAS sections before we go any further.
+  //
+  if (FileType == EFI_FV_FILETYPE_RAW) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Use FfsEntry to cache Section Extraction Protocol Information
+  //
+  *StreamCached = (BOOLEAN) ((*FfsEntry)->StreamHandle != 0);
+  if (!*StreamCached) {
+    Status = OpenSectionStream (
+               FileSize,
+               FileBuffer,
+               &(*FfsEntry)->StreamHandle
+               );
+  }
+
+  return Status;
+}
+
+
 /**
   Locates a section in a given FFS File and
   copies it to the supplied buffer (not including section header).
@@ -435,11 +531,8 @@ FvReadFileSection (
 {
   EFI_STATUS                        Status;
   FV_DEVICE                         *FvDevice;
-  EFI_FV_FILETYPE                   FileType;
-  EFI_FV_FILE_ATTRIBUTES            FileAttributes;
-  UINTN                             FileSize;
-  UINT8                             *FileBuffer;
   FFS_FILE_LIST_ENTRY               *FfsEntry;
+  BOOLEAN                           StreamCached;
 
   if (NameGuid == NULL || Buffer == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -447,52 +540,10 @@ FvReadFileSection (
 
   FvDevice = FV_DEVICE_FROM_THIS (This);
 
-  //
-  // Read the file
-  //
-  Status = FvReadFile (
-            This,
-            NameGuid,
-            NULL,
-            &FileSize,
-            &FileType,
-            &FileAttributes,
-            AuthenticationStatus
-            );
-  //
-  // Get the last key used by our call to FvReadFile as it is the FfsEntry for this file.
-  //
-  FfsEntry = (FFS_FILE_LIST_ENTRY *) FvDevice->LastKey;
-
+  Status = FvOpenFileSectionStream (FvDevice, NameGuid, &FfsEntry, &StreamCached, AuthenticationStatus);
   if (EFI_ERROR (Status)) {
     return Status;
   }
-  if (IS_FFS_FILE2 (FfsEntry->FfsHeader)) {
-    FileBuffer = ((UINT8 *) FfsEntry->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER2);
-  } else {
-    FileBuffer = ((UINT8 *) FfsEntry->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER);
-  }
-  //
-  // Check to see that the file actually HAS sections before we go any further.
-  //
-  if (FileType == EFI_FV_FILETYPE_RAW) {
-    Status = EFI_NOT_FOUND;
-    goto Done;
-  }
-
-  //
-  // Use FfsEntry to cache Section Extraction Protocol Information
-  //
-  if (FfsEntry->StreamHandle == 0) {
-    Status = OpenSectionStream (
-               FileSize,
-               FileBuffer,
-               &FfsEntry->StreamHandle
-               );
-    if (EFI_ERROR (Status)) {
-      goto Done;
-    }
-  }
 
   //
   // If SectionType == 0 We need the whole section stream
@@ -513,13 +564,103 @@ FvReadFileSection (
     // Inherit the authentication status.
     //
     *AuthenticationStatus |= FvDevice->AuthenticationStatus;
+    if (StreamCached) {
+      FvDevice->CacheBytesServed += *BufferSize;
+    }
   }
 
   //
   // Close of stream defered to close of FfsHeader list to allow SEP to cache data
   //
 
-Done:
+  return Status;
+}
+
+
+/**
+  Locates a section in a given FFS File and returns a pointer to its contents
+  (not including section header) where they lie in the FV's copy of the file.
+  The FV keeps that copy for as long as it is installed, and the caller must
+  not modify or free it.
+
+  @param  This                       Indicates the calling context.
+  @param  NameGuid                   Pointer to an EFI_GUID, which is the
+                                     filename.
+  @param  SectionType                Indicates the section type to return.
+  @param  SectionInstance            Indicates which instance of sections with a
+                                     type of SectionType to return.
+  @param  Buffer                     Output pointer to the section contents.
+  @param  BufferSize                 Output size in bytes of the section
+                                     contents.
+  @param  AuthenticationStatus       AuthenticationStatus is a pointer to a
+                                     caller allocated UINT32 in which the
+                                     authentication status is returned.
+
+  @retval EFI_SUCCESS                *Buffer points to the section contents.
+  @retval EFI_UNSUPPORTED            This is not an FV produced by the DXE core,
+                                     or the section only exists in extracted
+                                     form.  Use ReadSection() instead.
+  @retval EFI_NOT_FOUND              Section not found.
+  @retval EFI_INVALID_PARAMETER      Invalid parameter.
+  @retval others                     Values returned by ReadSection() for the
+                                     same section.
+
+**/
+EFI_STATUS
+FvLocateFileSection (
+  IN CONST  EFI_FIRMWARE_VOLUME2_PROTOCOL  *This,
+  IN CONST  EFI_GUID                       *NameGuid,
+  IN        EFI_SECTION_TYPE               SectionType,
+  IN        UINTN                          SectionInstance,
+  OUT       VOID                           **Buffer,
+  OUT       UINTN                          *BufferSize,
+  OUT       UINT32                         *AuthenticationStatus
+  )
+{
+  EFI_STATUS                        Status;
+  FV_DEVICE                         *FvDevice;
+  FFS_FILE_LIST_ENTRY               *FfsEntry;
+  BOOLEAN                           StreamCached;
+
+  if (This == NULL || NameGuid == NULL || Buffer == NULL || BufferSize == NULL ||
+      AuthenticationStatus == NULL || SectionType == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Only FVs produced by this driver keep their files where the section
+  // stream can point into them.
+  //
+  if (This->ReadSection != FvReadFileSection) {
+    return EFI_UNSUPPORTED;
+  }
+
+  FvDevice = FV_DEVICE_FROM_THIS (This);
+
+  Status = FvOpenFileSectionStream (FvDevice, NameGuid, &FfsEntry, &StreamCached, AuthenticationStatus);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = GetSectionInPlace (
+             FfsEntry->StreamHandle,
+             &SectionType,
+             SectionInstance,
+             Buffer,
+             BufferSize,
+             AuthenticationStatus,
+             FvDevice->IsFfs3Fv
+             );
+  if (!EFI_ERROR (Status)) {
+    //
+    // Inherit the authentication status.
+    //
+    *AuthenticationStatus |= FvDevice->AuthenticationStatus;
+    if (StreamCached) {
+      FvDevice->CacheBytesServed += *BufferSize;
+    }
+  }
+
   return Status;
 }
 
@@ -419,6 +419,12 @@ CoreConnectSingleController (
   PlatformDriverOverride                = NULL;
   NewDriverBindingHandleBuffer          = NULL;
 
+  //
+  // Measure the protocol lookups that collect the Driver Binding Protocols
+  // for ControllerHandle, apart from their Supported() and Start() calls
+  //
+  PERF_START (ControllerHandle, "DB:Lookup:", NULL, 0);
+
   //
   // Get list of all Driver Binding Protocol Instances
   //
@@ -430,6 +436,7 @@ CoreConnectSingleController (
              &DriverBindingHandleBuffer
              );
   if (EFI_ERROR (Status) || (DriverBindingHandleCount == 0)) {
+    PERF_END (ControllerHandle, "DB:Lookup:", NULL, 0);
     return EFI_NOT_FOUND;
   }
 
@@ -439,6 +446,7 @@ CoreConnectSingleController (
   SortedDriverBindingProtocols = AllocatePool (sizeof (VOID *) * DriverBindingHandleCount);
   if (SortedDriverBindingProtocols == NULL) {
     CoreFreePool (DriverBindingHandleBuffer);
+    PERF_END (ControllerHandle, "DB:Lookup:", NULL, 0);
     return EFI_OUT_OF_RESOURCES;
   }
 
@@ -582,6 +590,7 @@ CoreConnectSingleController (
              &NewDriverBindingHandleBuffer
              );
   CoreFreePool (NewDriverBindingHandleBuffer);
+  PERF_END (ControllerHandle, "DB:Lookup:", NULL, 0);
   if (NewDriverBindingHandleCount > DriverBindingHandleCount) {
     //
     // Free any buffers that were allocated with AllocatePool()
@@ -17,18 +17,44 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 
 //
-// mProtocolDatabase     - A list of all protocols in the system.  (simple list for now)
+// Number of buckets in mProtocolHashTable, must be a power of 2
+//
+#define PROTOCOL_HASH_TABLE_SIZE  128
+
+//
+// mProtocolDatabase     - A list of all protocols in the system.
+// mProtocolHashTable    - The entries of mProtocolDatabase hashed by protocol GUID
 // gHandleList           - A list of all the handles in the system
 // gProtocolDatabaseLock - Lock to protect the mProtocolDatabase
 // gHandleDatabaseKey    -  The Key to show that the handle has been created/modified
 //
 LIST_ENTRY      mProtocolDatabase     = INITIALIZE_LIST_HEAD_VARIABLE (mProtocolDatabase);
+LIST_ENTRY      mProtocolHashTable[PROTOCOL_HASH_TABLE_SIZE];
 LIST_ENTRY      gHandleList           = INITIALIZE_LIST_HEAD_VARIABLE (gHandleList);
 EFI_LOCK        gProtocolDatabaseLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
 UINT64          gHandleDatabaseKey    = 0;
 
 
 
+/**
+  Initializes the protocol database. Must be called before any protocol
+  interface is installed.
+
+**/
+VOID
+CoreInitializeProtocolDatabase (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < PROTOCOL_HASH_TABLE_SIZE; Index++) {
+    InitializeListHead (&mProtocolHashTable[Index]);
+  }
+}
+
+
+
 /**
   Acquire lock on gProtocolDatabaseLock.
 
@@ -85,6 +111,24 @@ CoreValidateHandle (
 
 
 
+/**
+  Get the mProtocolHashTable bucket that holds the entry of a protocol.
+
+  @param  Protocol               The ID of the protocol
+
+  @return The bucket list head
+
+**/
+LIST_ENTRY *
+CoreGetProtocolHashBucket (
+  IN EFI_GUID   *Protocol
+  )
+{
+  return &mProtocolHashTable[CoreHashGuid (Protocol) & (PROTOCOL_HASH_TABLE_SIZE - 1)];
+}
+
+
+
 /**
   Finds the protocol entry for the requested protocol.
   The gProtocolDatabaseLock must be owned
@@ -101,6 +145,7 @@ CoreFindProtocolEntry (
   IN BOOLEAN    Create
   )
 {
+  LIST_ENTRY          *Bucket;
   LIST_ENTRY          *Link;
   PROTOCOL_ENTRY      *Item;
   PROTOCOL_ENTRY      *ProtEntry;
@@ -108,15 +153,16 @@ CoreFindProtocolEntry (
   ASSERT_LOCKED(&gProtocolDatabaseLock);
 
   //
-  // Search the database for the matching GUID
+  // Search the hash bucket of the GUID for the matching entry
   //
 
   ProtEntry = NULL;
-  for (Link = mProtocolDatabase.ForwardLink;
-       Link != &mProtocolDatabase;
+  Bucket    = CoreGetProtocolHashBucket (Protocol);
+  for (Link = Bucket->ForwardLink;
+       Link != Bucket;
        Link = Link->ForwardLink) {
 
-    Item = CR(Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
+    Item = CR(Link, PROTOCOL_ENTRY, HashLink, PROTOCOL_ENTRY_SIGNATURE);
     if (CompareGuid (&Item->ProtocolID, Protocol)) {
 
       //
@@ -148,6 +194,7 @@ CoreFindProtocolEntry (
       // Add it to protocol database
       //
       InsertTailList (&mProtocolDatabase, &ProtEntry->AllEntries);
+      InsertTailList (Bucket, &ProtEntry->HashLink);
     }
   }
 
@@ -94,6 +94,14 @@ GLOBAL_REMOVE_IF_UNREFERENCED MACHINE_TYPE_INFO  mMachineTypeInfo[] = {
 
 UINT16 mDxeCoreImageMachineType = 0;
 
+//
+// State used to apply the relocations of large images on the APs.
+//
+EFI_MP_SERVICES_PROTOCOL  *mImageMpServices           = NULL;
+EFI_EVENT                 mImageRelocationApEvent     = NULL;
+BOOLEAN                   mImageRelocationApsRunning  = FALSE;
+IMAGE_RELOCATION_CONTEXT  mImageRelocationContext;
+
 /**
  Return machine type name.
 
@@ -424,6 +432,315 @@ GetPeCoffImageFixLoadingAssignedAddress(
    DEBUG ((EFI_D_INFO|EFI_D_LOAD, "LOADING MODULE FIXED INFO: Loading module at fixed address 0x%11p. Status = %r \n", (VOID *)(UINTN)(ImageContext->ImageAddress), Status));
    return Status;
 }
+/**
+  Get the number of bytes a base relocation record patches.
+
+  @param  Type                    The type of the relocation record.
+  @param  FixupSize               Return the number of bytes patched.
+
+  @retval TRUE                    The record type is applied by CoreRelocateImageChunks().
+  @retval FALSE                   The record type is left to PeCoffLoaderRelocateImage().
+
+**/
+BOOLEAN
+CoreGetImageFixupSize (
+  IN  UINT16                     Type,
+  OUT UINT32                     *FixupSize
+  )
+{
+  switch (Type) {
+  case EFI_IMAGE_REL_BASED_ABSOLUTE:
+    *FixupSize = 0;
+    return TRUE;
+
+  case EFI_IMAGE_REL_BASED_HIGH:
+  case EFI_IMAGE_REL_BASED_LOW:
+    *FixupSize = sizeof (UINT16);
+    return TRUE;
+
+  case EFI_IMAGE_REL_BASED_HIGHLOW:
+    *FixupSize = sizeof (UINT32);
+    return TRUE;
+
+  case EFI_IMAGE_REL_BASED_DIR64:
+    *FixupSize = sizeof (UINT64);
+    return TRUE;
+
+  default:
+    return FALSE;
+  }
+}
+
+/**
+  Apply the fixups of every relocation chunk the calling processor can claim.
+
+  This routine runs on the BSP and, through EFI_MP_SERVICES_PROTOCOL.StartupAllAPs(),
+  on the APs at the same time, so it must not use boot services or debug output.
+  Relocation blocks never share a fixup, so chunks can be applied in any order.
+  Every record has been checked by CoreRelocateImageOnAps() before.
+
+  @param  Buffer                  The IMAGE_RELOCATION_CONTEXT to work on.
+
+**/
+VOID
+EFIAPI
+CoreRelocateImageChunks (
+  IN OUT VOID                    *Buffer
+  )
+{
+  IMAGE_RELOCATION_CONTEXT   *Context;
+  EFI_IMAGE_BASE_RELOCATION  *RelocBase;
+  EFI_IMAGE_BASE_RELOCATION  *RelocBaseEnd;
+  UINT16                     *Reloc;
+  UINT16                     *RelocEnd;
+  CHAR8                      *Fixup;
+  UINT32                     Chunk;
+
+  Context = (IMAGE_RELOCATION_CONTEXT *) Buffer;
+
+  while (TRUE) {
+    Chunk = InterlockedIncrement ((UINT32 *) &Context->NextChunk) - 1;
+    if (Chunk >= Context->ChunkCount) {
+      break;
+    }
+
+    RelocBase    = (EFI_IMAGE_BASE_RELOCATION *) (Context->RelocBase + Context->ChunkOffset[Chunk]);
+    RelocBaseEnd = (EFI_IMAGE_BASE_RELOCATION *) (Context->RelocBase + Context->ChunkOffset[Chunk + 1]);
+    while (RelocBase < RelocBaseEnd) {
+      Reloc    = (UINT16 *) ((CHAR8 *) RelocBase + sizeof (EFI_IMAGE_BASE_RELOCATION));
+      RelocEnd = (UINT16 *) ((CHAR8 *) RelocBase + RelocBase->SizeOfBlock);
+      for (; Reloc < RelocEnd; Reloc++) {
+        Fixup = (CHAR8 *) Context->ImageAddress + RelocBase->VirtualAddress + (*Reloc & 0xFFF);
+
+        switch ((*Reloc) >> 12) {
+        case EFI_IMAGE_REL_BASED_ABSOLUTE:
+          break;
+
+        case EFI_IMAGE_REL_BASED_HIGH:
+          *(UINT16 *) Fixup = (UINT16) (*(UINT16 *) Fixup + ((UINT16) ((UINT32) Context->Adjust >> 16)));
+          break;
+
+        case EFI_IMAGE_REL_BASED_LOW:
+          *(UINT16 *) Fixup = (UINT16) (*(UINT16 *) Fixup + (UINT16) Context->Adjust);
+          break;
+
+        case EFI_IMAGE_REL_BASED_HIGHLOW:
+          *(UINT32 *) Fixup = *(UINT32 *) Fixup + (UINT32) Context->Adjust;
+          break;
+
+        case EFI_IMAGE_REL_BASED_DIR64:
+          *(UINT64 *) Fixup = *(UINT64 *) Fixup + Context->Adjust;
+          break;
+
+        default:
+          break;
+        }
+      }
+
+      RelocBase = (EFI_IMAGE_BASE_RELOCATION *) RelocEnd;
+    }
+
+    InterlockedIncrement ((UINT32 *) &Context->DoneChunks);
+  }
+}
+
+
+/**
+  Apply the base relocations of a large PE32 or PE32+ image on the BSP and all
+  enabled APs.
+
+  Only images whose relocation directory is at least PcdImageRelocationApThreshold
+  bytes are handled here, and only when the MP Services protocol is available and
+  the APs are idle. Every other case, including runtime drivers that need the
+  fixup log, is left to PeCoffLoaderRelocateImage(), which produces the same
+  image contents. Every relocation record is validated before any fixup is
+  applied, so an image with a record type not handled here, such as the ARM
+  MOV32 types, or a corrupt image is always left to the serial loader.
+
+  @param  ImageContext            The image context of an image that has been
+                                  loaded with PeCoffLoaderLoadImage().
+
+  @retval EFI_SUCCESS             The image was relocated.
+  @retval EFI_UNSUPPORTED         The image was not touched and has to be
+                                  relocated with PeCoffLoaderRelocateImage().
+
+**/
+EFI_STATUS
+CoreRelocateImageOnAps (
+  IN OUT PE_COFF_LOADER_IMAGE_CONTEXT  *ImageContext
+  )
+{
+  EFI_STATUS                           Status;
+  EFI_IMAGE_OPTIONAL_HEADER_PTR_UNION  Hdr;
+  EFI_IMAGE_DATA_DIRECTORY             *RelocDir;
+  EFI_IMAGE_BASE_RELOCATION            *RelocBase;
+  IMAGE_RELOCATION_CONTEXT             *Context;
+  UINT32                               *ChunkOffset;
+  UINT32                               ChunkSize;
+  UINT32                               ChunkCount;
+  UINT32                               MaxChunks;
+  UINT32                               Offset;
+  UINT16                               *Reloc;
+  UINT16                               *RelocEnd;
+  UINT32                               FixupSize;
+  UINT64                               Adjust;
+  UINTN                                NumberOfProcessors;
+  UINTN                                NumberOfEnabledProcessors;
+
+  if (PcdGet32 (PcdImageRelocationApThreshold) == 0 ||
+      ImageContext->IsTeImage ||
+      ImageContext->RelocationsStripped ||
+      ImageContext->FixupData != NULL ||
+      ImageContext->DestinationAddress != 0 ||
+      ImageContext->Machine == EFI_IMAGE_MACHINE_IA64) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Hdr.Pe32 = (EFI_IMAGE_NT_HEADERS32 *)((UINTN)ImageContext->ImageAddress + ImageContext->PeCoffHeaderOffset);
+  if (Hdr.Pe32->OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+    Adjust = (UINT64)ImageContext->ImageAddress - Hdr.Pe32->OptionalHeader.ImageBase;
+    if (Hdr.Pe32->OptionalHeader.NumberOfRvaAndSizes <= EFI_IMAGE_DIRECTORY_ENTRY_BASERELOC) {
+      return EFI_UNSUPPORTED;
+    }
+    RelocDir = &Hdr.Pe32->OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_BASERELOC];
+  } else {
+    Adjust = (UINT64)ImageContext->ImageAddress - Hdr.Pe32Plus->OptionalHeader.ImageBase;
+    if (Hdr.Pe32Plus->OptionalHeader.NumberOfRvaAndSizes <= EFI_IMAGE_DIRECTORY_ENTRY_BASERELOC) {
+      return EFI_UNSUPPORTED;
+    }
+    RelocDir = &Hdr.Pe32Plus->OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_BASERELOC];
+  }
+
+  if (Adjust == 0 ||
+      RelocDir->Size < PcdGet32 (PcdImageRelocationApThreshold) ||
+      (UINT64) RelocDir->VirtualAddress + RelocDir->Size > ImageContext->ImageSize) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // The APs may still be leaving the previous image's relocation. Its context
+  // stays in use until the MP Services protocol signals that they are done.
+  //
+  if (mImageRelocationApsRunning) {
+    if (CoreCheckEvent (mImageRelocationApEvent) != EFI_SUCCESS) {
+      return EFI_UNSUPPORTED;
+    }
+    mImageRelocationApsRunning = FALSE;
+  }
+
+  if (mImageMpServices == NULL) {
+    Status = CoreLocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **)&mImageMpServices);
+    if (EFI_ERROR (Status)) {
+      mImageMpServices = NULL;
+      return EFI_UNSUPPORTED;
+    }
+  }
+
+  if (mImageRelocationApEvent == NULL) {
+    Status = CoreCreateEvent (0, 0, NULL, NULL, &mImageRelocationApEvent);
+    if (EFI_ERROR (Status)) {
+      return EFI_UNSUPPORTED;
+    }
+  }
+
+  Status = mImageMpServices->GetNumberOfProcessors (
+                               mImageMpServices,
+                               &NumberOfProcessors,
+                               &NumberOfEnabledProcessors
+                               );
+  if (EFI_ERROR (Status) || NumberOfEnabledProcessors < 2) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Cut the relocation directory into about four chunks per processor, on
+  // relocation block boundaries, checking every record on the way: the APs
+  // must never find one they cannot apply once fixups have started.
+  //
+  MaxChunks   = (UINT32) MIN (NumberOfEnabledProcessors * 4, RelocDir->Size / sizeof (EFI_IMAGE_BASE_RELOCATION));
+  if (MaxChunks == 0) {
+    return EFI_UNSUPPORTED;
+  }
+  ChunkSize   = (RelocDir->Size + MaxChunks - 1) / MaxChunks;
+  ChunkOffset = AllocatePool ((MaxChunks + 2) * sizeof (UINT32));
+  if (ChunkOffset == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  ChunkOffset[0] = 0;
+  ChunkCount     = 0;
+  Offset         = 0;
+  while (Offset < RelocDir->Size - 1) {
+    RelocBase = (EFI_IMAGE_BASE_RELOCATION *) (UINTN) (ImageContext->ImageAddress + RelocDir->VirtualAddress + Offset);
+    if (RelocBase->SizeOfBlock < sizeof (EFI_IMAGE_BASE_RELOCATION) ||
+        RelocBase->SizeOfBlock > RelocDir->Size - Offset ||
+        RelocBase->VirtualAddress >= ImageContext->ImageSize) {
+      CoreFreePool (ChunkOffset);
+      return EFI_UNSUPPORTED;
+    }
+    Reloc    = (UINT16 *) ((CHAR8 *) RelocBase + sizeof (EFI_IMAGE_BASE_RELOCATION));
+    RelocEnd = (UINT16 *) ((CHAR8 *) RelocBase + RelocBase->SizeOfBlock);
+    for (; Reloc < RelocEnd; Reloc++) {
+      if (!CoreGetImageFixupSize ((UINT16) (*Reloc >> 12), &FixupSize) ||
+          (UINT64) RelocBase->VirtualAddress + (*Reloc & 0xFFF) + FixupSize > ImageContext->ImageSize) {
+        CoreFreePool (ChunkOffset);
+        return EFI_UNSUPPORTED;
+      }
+    }
+    Offset += RelocBase->SizeOfBlock;
+    if (Offset - ChunkOffset[ChunkCount] >= ChunkSize) {
+      ChunkOffset[++ChunkCount] = Offset;
+    }
+  }
+  if (ChunkOffset[ChunkCount] != Offset) {
+    ChunkOffset[++ChunkCount] = Offset;
+  }
+
+  Context               = &mImageRelocationContext;
+  Context->ImageAddress = (UINT8 *) (UINTN) ImageContext->ImageAddress;
+  Context->ImageSize    = ImageContext->ImageSize;
+  Context->Adjust       = Adjust;
+  Context->RelocBase    = Context->ImageAddress + RelocDir->VirtualAddress;
+  Context->ChunkOffset  = ChunkOffset;
+  Context->ChunkCount   = ChunkCount;
+  Context->NextChunk    = 0;
+  Context->DoneChunks   = 0;
+
+  //
+  // If the APs cannot be started the BSP simply claims every chunk itself.
+  //
+  Status = mImageMpServices->StartupAllAPs (
+                               mImageMpServices,
+                               CoreRelocateImageChunks,
+                               FALSE,
+                               mImageRelocationApEvent,
+                               0,
+                               Context,
+                               NULL
+                               );
+  if (!EFI_ERROR (Status)) {
+    mImageRelocationApsRunning = TRUE;
+  }
+
+  CoreRelocateImageChunks (Context);
+  while (Context->DoneChunks < Context->ChunkCount) {
+    CpuPause ();
+  }
+
+  Context->ChunkOffset = NULL;
+  CoreFreePool (ChunkOffset);
+
+  if (Hdr.Pe32->OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+    Hdr.Pe32->OptionalHeader.ImageBase = (UINT32) ImageContext->ImageAddress;
+  } else {
+    Hdr.Pe32Plus->OptionalHeader.ImageBase = (UINT64) ImageContext->ImageAddress;
+  }
+
+  PeCoffLoaderRelocateImageExtraAction (ImageContext);
+
+  return EFI_SUCCESS;
+}
+
 /**
   Loads, relocates, and invokes a PE/COFF image
 
@@ -629,9 +946,13 @@ CoreLoadPeImage (
   }
 
   //
-  // Relocate the image in memory
+  // Relocate the image in memory. Images with a large relocation directory
+  // may be relocated on all processors.
   //
-  Status = PeCoffLoaderRelocateImage (&Image->ImageContext);
+  Status = CoreRelocateImageOnAps (&Image->ImageContext);
+  if (Status == EFI_UNSUPPORTED) {
+    Status = PeCoffLoaderRelocateImage (&Image->ImageContext);
+  }
   if (EFI_ERROR (Status)) {
     goto Done;
   }
@@ -40,6 +40,23 @@ typedef struct {
   UINTN               SourceSize;
 } IMAGE_FILE_HANDLE;
 
+//
+// Work shared between the BSP and the APs when the base relocations of one
+// image are applied in parallel. The relocation directory is cut into chunks
+// on relocation block boundaries, and each processor claims the next chunk
+// with an interlocked increment of NextChunk until none are left.
+//
+typedef struct {
+  UINT8                       *ImageAddress;
+  UINT64                      ImageSize;
+  UINT64                      Adjust;
+  UINT8                       *RelocBase;
+  UINT32                      *ChunkOffset;     ///< ChunkCount + 1 offsets into the relocation directory
+  UINT32                      ChunkCount;
+  volatile UINT32             NextChunk;
+  volatile UINT32             DoneChunks;
+} IMAGE_RELOCATION_CONTEXT;
+
 /**
   Loads an EFI image into memory and returns a handle to the image with extended parameters.
 
@@ -103,4 +103,35 @@ CoreReleaseLock (
 }
 
 
+//
+// GUID Hash Stuff
+//
+/**
+  Hash a GUID for the GUID keyed hash tables of the DXE core. GUIDs are
+  random enough that folding the four 32-bit words together spreads them
+  evenly over the buckets.
+
+  @param  Guid               The GUID to hash
+
+  @return The hash, to be masked with the power of 2 size of the table minus 1
+
+**/
+UINT32
+CoreHashGuid (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  UINT32  Hash;
+
+  ASSERT (Guid != NULL);
+
+  Hash = ReadUnaligned32 ((CONST UINT32 *) Guid)     ^ ReadUnaligned32 ((CONST UINT32 *) Guid + 1) ^
+         ReadUnaligned32 ((CONST UINT32 *) Guid + 2) ^ ReadUnaligned32 ((CONST UINT32 *) Guid + 3);
+  Hash ^= Hash >> 16;
+  Hash ^= Hash >> 8;
+
+  return Hash;
+}
+
+
 
@@ -46,7 +46,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 //
 
 #define MEMORY_MAP_SIGNATURE   SIGNATURE_32('m','m','a','p')
-typedef struct {
+typedef struct _MEMORY_MAP {
   UINTN           Signature;
   LIST_ENTRY      Link;
   BOOLEAN         FromPages;
@@ -57,6 +57,16 @@ typedef struct {
 
   UINT64          VirtualStart;
   UINT64          Attribute;
+
+  //
+  // Node of the balanced tree that indexes gMemoryMap by Start.  MaxFreeBytes
+  // is the size of the largest EfiConventionalMemory range in the subtree.
+  //
+  struct _MEMORY_MAP  *Parent;
+  struct _MEMORY_MAP  *Left;
+  struct _MEMORY_MAP  *Right;
+  UINTN               Height;
+  UINT64              MaxFreeBytes;
 } MEMORY_MAP;
 
 //
@@ -159,6 +169,6 @@ CoreReleaseMemoryLock (
 //
 
 extern EFI_LOCK           gMemoryLock;
-extern LIST_ENTRY         gMemoryMap;
+extern LIST_ENTRY         gMemoryMap;    // Kept in ascending address order
 extern LIST_ENTRY         mGcdMemorySpaceMap;
 #endif
@@ -50,6 +50,10 @@ UINTN         mFreeMapStack = 0;
 /// This list maintain the free memory map list
 ///
 LIST_ENTRY   mFreeMemoryMapEntryList = INITIALIZE_LIST_HEAD_VARIABLE (mFreeMemoryMapEntryList);
+///
+/// mMemoryMapRoot - root of the AVL tree that indexes gMemoryMap by start address
+///
+MEMORY_MAP   *mMemoryMapRoot = NULL;
 BOOLEAN      mMemoryTypeInformationInitialized = FALSE;
 
 EFI_MEMORY_TYPE_STATISTICS mMemoryTypeStatistics[EfiMaxMemoryType + 1] = {
@@ -124,7 +128,276 @@ CoreReleaseMemoryLock (
 }
 
 
+#define MEMORY_MAP_HEIGHT(Node)    (((Node) == NULL) ? 0 : (Node)->Height)
+#define MEMORY_MAP_MAX_FREE(Node)  (((Node) == NULL) ? 0 : (Node)->MaxFreeBytes)
+
+/**
+  Internal function.  Recomputes the height and the largest free range of a
+  memory map index node from the node and its children.
+
+  @param  Node                   The node to update
+
+**/
+VOID
+MemoryMapIndexUpdateNode (
+  IN OUT MEMORY_MAP      *Node
+  )
+{
+  UINT64  FreeBytes;
+
+  FreeBytes = 0;
+  if (Node->Type == EfiConventionalMemory) {
+    FreeBytes = Node->End - Node->Start + 1;
+  }
+  FreeBytes = MAX (FreeBytes, MEMORY_MAP_MAX_FREE (Node->Left));
+  FreeBytes = MAX (FreeBytes, MEMORY_MAP_MAX_FREE (Node->Right));
+
+  Node->MaxFreeBytes = FreeBytes;
+  Node->Height       = 1 + MAX (MEMORY_MAP_HEIGHT (Node->Left), MEMORY_MAP_HEIGHT (Node->Right));
+}
+
+/**
+  Internal function.  Puts a node in place of a child of Parent in the memory
+  map index.
+
+  @param  Parent                 The parent of OldChild, or NULL if OldChild is
+                                 the root
+  @param  OldChild               The node being replaced
+  @param  NewChild               The replacement node, may be NULL
+
+**/
+VOID
+MemoryMapIndexReplaceChild (
+  IN OUT MEMORY_MAP      *Parent,
+  IN     MEMORY_MAP      *OldChild,
+  IN OUT MEMORY_MAP      *NewChild
+  )
+{
+  if (Parent == NULL) {
+    mMemoryMapRoot = NewChild;
+  } else if (Parent->Left == OldChild) {
+    Parent->Left = NewChild;
+  } else {
+    Parent->Right = NewChild;
+  }
+
+  if (NewChild != NULL) {
+    NewChild->Parent = Parent;
+  }
+}
+
+/**
+  Internal function.  Rotates a memory map index node to the left.
+
+  @param  Node                   The node to rotate, its right child must exist
+
+  @return The node that took the place of Node
+
+**/
+MEMORY_MAP *
+MemoryMapIndexRotateLeft (
+  IN OUT MEMORY_MAP      *Node
+  )
+{
+  MEMORY_MAP  *Pivot;
+
+  Pivot = Node->Right;
+  MemoryMapIndexReplaceChild (Node->Parent, Node, Pivot);
+  Node->Right = Pivot->Left;
+  if (Node->Right != NULL) {
+    Node->Right->Parent = Node;
+  }
+  Pivot->Left  = Node;
+  Node->Parent = Pivot;
+
+  MemoryMapIndexUpdateNode (Node);
+  MemoryMapIndexUpdateNode (Pivot);
+  return Pivot;
+}
+
+/**
+  Internal function.  Rotates a memory map index node to the right.
+
+  @param  Node                   The node to rotate, its left child must exist
+
+  @return The node that took the place of Node
+
+**/
+MEMORY_MAP *
+MemoryMapIndexRotateRight (
+  IN OUT MEMORY_MAP      *Node
+  )
+{
+  MEMORY_MAP  *Pivot;
+
+  Pivot = Node->Left;
+  MemoryMapIndexReplaceChild (Node->Parent, Node, Pivot);
+  Node->Left = Pivot->Right;
+  if (Node->Left != NULL) {
+    Node->Left->Parent = Node;
+  }
+  Pivot->Right = Node;
+  Node->Parent = Pivot;
+
+  MemoryMapIndexUpdateNode (Node);
+  MemoryMapIndexUpdateNode (Pivot);
+  return Pivot;
+}
+
+/**
+  Internal function.  Walks from a node to the root of the memory map index,
+  refreshing the cached values and restoring the AVL balance on the way.
+  Must be called whenever Start, End or Type of an indexed entry changes.
+
+  @param  Node                   The lowest node whose subtree changed, may be NULL
+
+**/
+VOID
+MemoryMapIndexUpdate (
+  IN OUT MEMORY_MAP      *Node
+  )
+{
+  INTN  Balance;
+
+  while (Node != NULL) {
+    MemoryMapIndexUpdateNode (Node);
+    Balance = (INTN) MEMORY_MAP_HEIGHT (Node->Left) - (INTN) MEMORY_MAP_HEIGHT (Node->Right);
+    if (Balance > 1) {
+      if (MEMORY_MAP_HEIGHT (Node->Left->Left) < MEMORY_MAP_HEIGHT (Node->Left->Right)) {
+        MemoryMapIndexRotateLeft (Node->Left);
+      }
+      Node = MemoryMapIndexRotateRight (Node);
+    } else if (Balance < -1) {
+      if (MEMORY_MAP_HEIGHT (Node->Right->Right) < MEMORY_MAP_HEIGHT (Node->Right->Left)) {
+        MemoryMapIndexRotateRight (Node->Right);
+      }
+      Node = MemoryMapIndexRotateLeft (Node);
+    }
+    Node = Node->Parent;
+  }
+}
+
+/**
+  Internal function.  Adds a descriptor entry to the memory map index and
+  links it into gMemoryMap after the entry that precedes it in address order.
+
+  @param  Entry                  The entry to add
+
+**/
+VOID
+MemoryMapIndexInsert (
+  IN OUT MEMORY_MAP      *Entry
+  )
+{
+  MEMORY_MAP  **Link;
+  MEMORY_MAP  *Parent;
+  MEMORY_MAP  *Previous;
+
+  Link     = &mMemoryMapRoot;
+  Parent   = NULL;
+  Previous = NULL;
+  while (*Link != NULL) {
+    Parent = *Link;
+    if (Entry->Start < Parent->Start) {
+      Link = &Parent->Left;
+    } else {
+      Previous = Parent;
+      Link     = &Parent->Right;
+    }
+  }
+
+  Entry->Parent = Parent;
+  Entry->Left   = NULL;
+  Entry->Right  = NULL;
+  *Link         = Entry;
+
+  if (Previous == NULL) {
+    InsertHeadList (&gMemoryMap, &Entry->Link);
+  } else {
+    InsertHeadList (&Previous->Link, &Entry->Link);
+  }
+
+  MemoryMapIndexUpdate (Entry);
+}
+
+/**
+  Internal function.  Removes a descriptor entry from the memory map index
+  and from gMemoryMap.
+
+  @param  Entry                  The entry to remove
+
+**/
+VOID
+MemoryMapIndexRemove (
+  IN OUT MEMORY_MAP      *Entry
+  )
+{
+  MEMORY_MAP  *Successor;
+  MEMORY_MAP  *Lowest;
+
+  RemoveEntryList (&Entry->Link);
+
+  if (Entry->Left != NULL && Entry->Right != NULL) {
+    //
+    // Move the in-order successor into the position of Entry
+    //
+    Successor = Entry->Right;
+    while (Successor->Left != NULL) {
+      Successor = Successor->Left;
+    }
+
+    if (Successor->Parent == Entry) {
+      Lowest = Successor;
+    } else {
+      Lowest = Successor->Parent;
+      MemoryMapIndexReplaceChild (Successor->Parent, Successor, Successor->Right);
+      Successor->Right         = Entry->Right;
+      Successor->Right->Parent = Successor;
+    }
+    MemoryMapIndexReplaceChild (Entry->Parent, Entry, Successor);
+    Successor->Left         = Entry->Left;
+    Successor->Left->Parent = Successor;
+  } else {
+    Lowest = Entry->Parent;
+    MemoryMapIndexReplaceChild (Entry->Parent, Entry, (Entry->Left != NULL) ? Entry->Left : Entry->Right);
+  }
+
+  Entry->Parent = NULL;
+  Entry->Left   = NULL;
+  Entry->Right  = NULL;
+
+  MemoryMapIndexUpdate (Lowest);
+}
+
+/**
+  Internal function.  Finds the descriptor entry with the highest start
+  address that is not above Address.
+
+  @param  Address                The address to look up
+
+  @return The entry found, or NULL if all entries start above Address
 
+**/
+MEMORY_MAP *
+MemoryMapIndexFloor (
+  IN UINT64              Address
+  )
+{
+  MEMORY_MAP  *Node;
+  MEMORY_MAP  *Found;
+
+  Found = NULL;
+  Node  = mMemoryMapRoot;
+  while (Node != NULL) {
+    if (Address < Node->Start) {
+      Node = Node->Left;
+    } else {
+      Found = Node;
+      Node  = Node->Right;
+    }
+  }
+  return Found;
+}
 
 /**
   Internal function.  Removes a descriptor entry.
@@ -137,7 +410,7 @@ RemoveMemoryMapEntry (
   IN OUT MEMORY_MAP      *Entry
   )
 {
-  RemoveEntryList (&Entry->Link);
+  MemoryMapIndexRemove (Entry);
   Entry->Link.ForwardLink = NULL;
 
   if (Entry->FromPages) {
@@ -170,6 +443,7 @@ CoreAddRange (
 {
   LIST_ENTRY        *Link;
   MEMORY_MAP        *Entry;
+  MEMORY_MAP        *Next;
 
   ASSERT ((Start & EFI_PAGE_MASK) == 0);
   ASSERT (End > Start) ;
@@ -212,32 +486,26 @@ CoreAddRange (
   //
 
   // Two memory descriptors can only be merged if they have the same Type
-  // and the same Attribute
+  // and the same Attribute.  gMemoryMap is in address order and the range
+  // is not in the map yet, so only the entries right before and right after
+  // the range can be adjacent to it.
   //
 
-  Link = gMemoryMap.ForwardLink;
-  while (Link != &gMemoryMap) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    Link  = Link->ForwardLink;
-
-    if (Entry->Type != Type) {
-      continue;
-    }
-
-    if (Entry->Attribute != Attribute) {
-      continue;
-    }
-
-    if (Entry->End + 1 == Start) {
-
-      Start = Entry->Start;
-      RemoveMemoryMapEntry (Entry);
+  Entry = MemoryMapIndexFloor (Start);
+  Link  = (Entry == NULL) ? gMemoryMap.ForwardLink : Entry->Link.ForwardLink;
+  Next  = NULL;
+  if (Link != &gMemoryMap) {
+    Next = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+  }
 
-    } else if (Entry->Start == End + 1) {
+  if (Entry != NULL && Entry->Type == Type && Entry->Attribute == Attribute && Entry->End + 1 == Start) {
+    Start = Entry->Start;
+    RemoveMemoryMapEntry (Entry);
+  }
 
-      End = Entry->End;
-      RemoveMemoryMapEntry (Entry);
-    }
+  if (Next != NULL && Next->Type == Type && Next->Attribute == Attribute && Next->Start == End + 1) {
+    End = Next->End;
+    RemoveMemoryMapEntry (Next);
   }
 
   //
@@ -251,7 +519,7 @@ CoreAddRange (
   mMapStack[mMapDepth].End           = End;
   mMapStack[mMapDepth].VirtualStart  = 0;
   mMapStack[mMapDepth].Attribute     = Attribute;
-  InsertTailList (&gMemoryMap, &mMapStack[mMapDepth].Link);
+  MemoryMapIndexInsert (&mMapStack[mMapDepth]);
 
   mMapDepth += 1;
   ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -319,8 +587,6 @@ CoreFreeMemoryMapStack (
   )
 {
   MEMORY_MAP      *Entry;
-  MEMORY_MAP      *Entry2;
-  LIST_ENTRY      *Link2;
 
   ASSERT_LOCKED (&gMemoryLock);
 
@@ -354,23 +620,13 @@ CoreFreeMemoryMapStack (
       //
       // Move this entry to general memory
       //
-      RemoveEntryList (&mMapStack[mMapDepth].Link);
+      MemoryMapIndexRemove (&mMapStack[mMapDepth]);
       mMapStack[mMapDepth].Link.ForwardLink = NULL;
 
       CopyMem (Entry , &mMapStack[mMapDepth], sizeof (MEMORY_MAP));
       Entry->FromPages = TRUE;
 
-      //
-      // Find insertion location
-      //
-      for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
-        Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-        if (Entry2->FromPages && Entry2->Start > Entry->Start) {
-          break;
-        }
-      }
-
-      InsertTailList (Link2, &Entry->Link);
+      MemoryMapIndexInsert (Entry);
 
     } else {
       //
@@ -706,7 +962,6 @@ CoreConvertPagesEx (
   UINT64          RangeEnd;
   UINT64          Attribute;
   EFI_MEMORY_TYPE MemType;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
 
   Entry = NULL;
@@ -732,15 +987,9 @@ CoreConvertPagesEx (
     //
     // Find the entry that the covers the range
     //
-    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+    Entry = MemoryMapIndexFloor (Start);
 
-      if (Entry->Start <= Start && Entry->End > Start) {
-        break;
-      }
-    }
-
-    if (Link == &gMemoryMap) {
+    if (Entry == NULL || Entry->End <= Start) {
       DEBUG ((DEBUG_ERROR | DEBUG_PAGE, "ConvertPages: failed to find range %lx - %lx\n", Start, End));
       return EFI_NOT_FOUND;
     }
@@ -806,6 +1055,7 @@ CoreConvertPagesEx (
       // Clip start
       //
       Entry->Start = RangeEnd + 1;
+      MemoryMapIndexUpdate (Entry);
 
     } else if (Entry->End == RangeEnd) {
 
@@ -813,6 +1063,7 @@ CoreConvertPagesEx (
       // Clip end
       //
       Entry->End = Start - 1;
+      MemoryMapIndexUpdate (Entry);
 
     } else {
 
@@ -836,9 +1087,10 @@ CoreConvertPagesEx (
 
       Entry->End = Start - 1;
       ASSERT (Entry->Start < Entry->End);
+      MemoryMapIndexUpdate (Entry);
 
       Entry = &mMapStack[mMapDepth];
-      InsertTailList (&gMemoryMap, &Entry->Link);
+      MemoryMapIndexInsert (Entry);
 
       mMapDepth += 1;
       ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -956,6 +1208,85 @@ CoreUpdateMemoryAttributes (
 }
 
 
+/**
+  Internal function.  Searches a subtree of the memory map index for the free
+  range with the highest end address that can hold the requested number of
+  bytes between MinAddress and MaxAddress.
+
+  Subtrees whose largest free range is too small are skipped without being
+  visited, and the search goes from high to low addresses so the first range
+  that fits is the answer.
+
+  @param  Node                   The root of the subtree to search
+  @param  MaxAddress             The address that the range must be below
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfBytes          Number of bytes needed
+  @param  Alignment              Bits to align with
+
+  @return The last byte of the usable part of the range found, or 0 if no
+          range was found
+
+**/
+UINT64
+MemoryMapIndexFindFree (
+  IN MEMORY_MAP       *Node,
+  IN UINT64           MaxAddress,
+  IN UINT64           MinAddress,
+  IN UINT64           NumberOfBytes,
+  IN UINTN            Alignment
+  )
+{
+  UINT64          Target;
+  UINT64          DescStart;
+  UINT64          DescEnd;
+
+  for (; Node != NULL && Node->MaxFreeBytes >= NumberOfBytes; Node = Node->Left) {
+    //
+    // If desc is past max allowed address, so are all the descriptors to its right
+    //
+    if (Node->Start < MaxAddress) {
+      Target = MemoryMapIndexFindFree (Node->Right, MaxAddress, MinAddress, NumberOfBytes, Alignment);
+      if (Target != 0) {
+        return Target;
+      }
+
+      if (Node->Type == EfiConventionalMemory && Node->End >= MinAddress) {
+        DescStart = Node->Start;
+        DescEnd   = Node->End;
+
+        //
+        // If desc ends past max allowed address, clip the end
+        //
+        if (DescEnd >= MaxAddress) {
+          DescEnd = MaxAddress;
+        }
+
+        DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+
+        //
+        // See if the descriptor still holds the request once aligned, and
+        // that the start of the allocated range is not below the min address
+        //
+        if ((DescEnd >= DescStart) &&
+            (DescEnd - DescStart + 1 >= NumberOfBytes) &&
+            (DescEnd - NumberOfBytes + 1 >= MinAddress)) {
+          return DescEnd;
+        }
+      }
+    }
+
+    //
+    // If desc is below min allowed address, so are all the descriptors to its left
+    //
+    if (Node->End < MinAddress) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+
 /**
   Internal function. Finds a consecutive free page range below
   the requested address.
@@ -981,11 +1312,6 @@ CoreFindFreePagesI (
 {
   UINT64          NumberOfBytes;
   UINT64          Target;
-  UINT64          DescStart;
-  UINT64          DescEnd;
-  UINT64          DescNumberOfBytes;
-  LIST_ENTRY      *Link;
-  MEMORY_MAP      *Entry;
 
   if ((MaxAddress < EFI_PAGE_MASK) ||(NumberOfPages == 0)) {
     return 0;
@@ -1014,58 +1340,17 @@ CoreFindFreePagesI (
   }
 
   NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
-  Target = 0;
-
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-    //
-    // If it's not a free entry, don't bother with it
-    //
-    if (Entry->Type != EfiConventionalMemory) {
-      continue;
-    }
-
-    DescStart = Entry->Start;
-    DescEnd = Entry->End;
-
-    //
-    // If desc is past max allowed address or below min allowed address, skip it
-    //
-    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
-      continue;
-    }
-
-    //
-    // If desc ends past max allowed address, clip the end
-    //
-    if (DescEnd >= MaxAddress) {
-      DescEnd = MaxAddress;
-    }
-
-    DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
 
-    //
-    // Compute the number of bytes we can used from this
-    // descriptor, and see it's enough to satisfy the request
-    //
-    DescNumberOfBytes = DescEnd - DescStart + 1;
-
-    if (DescNumberOfBytes >= NumberOfBytes) {
-      //
-      // If the start of the allocated range is below the min address allowed, skip it
-      //
-      if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
-        continue;
-      }
+  //
+  // Find the highest free range that is big enough
+  //
+  Target = MemoryMapIndexFindFree (mMemoryMapRoot, MaxAddress, MinAddress, NumberOfBytes, Alignment);
 
-      //
-      // If this is the best match so far remember it
-      //
-      if (DescEnd > Target) {
-        Target = DescEnd;
-      }
-    }
+  //
+  // If we didn't find a match, return 0
+  //
+  if (Target == 0) {
+    return 0;
   }
 
   //
@@ -1073,9 +1358,6 @@ CoreFindFreePagesI (
   //
   Target -= NumberOfBytes - 1;
 
-  //
-  // If we didn't find a match, return 0
-  //
   if ((Target & EFI_PAGE_MASK) != 0) {
     return 0;
   }
@@ -1322,7 +1604,6 @@ CoreInternalFreePages (
   )
 {
   EFI_STATUS      Status;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
   UINTN           Alignment;
 
@@ -1334,14 +1615,8 @@ CoreInternalFreePages (
   //
   // Find the entry that the covers the range
   //
-  Entry = NULL;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR(Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    if (Entry->Start <= Memory && Entry->End > Memory) {
-        break;
-    }
-  }
-  if (Link == &gMemoryMap) {
+  Entry = MemoryMapIndexFloor (Memory);
+  if (Entry == NULL || Entry->End <= Memory) {
     Status = EFI_NOT_FOUND;
     goto Done;
   }
@@ -1636,10 +1911,15 @@ CoreGetMemoryMap (
     }
 
     //
-    // Check to see if the new Memory Map Descriptor can be merged with an 
-    // existing descriptor if they are adjacent and have the same attributes
+    // Check to see if the new Memory Map Descriptor can be merged with the
+    // previous one if they are adjacent and have the same attributes.
+    // gMemoryMap is in address order, so no other descriptor can be adjacent.
     //
-    MemoryMap = MergeMemoryMapDescriptor (MemoryMapStart, MemoryMap, Size);
+    MemoryMap = MergeMemoryMapDescriptor (
+                  (MemoryMap == MemoryMapStart) ? MemoryMap : (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap - Size),
+                  MemoryMap,
+                  Size
+                  );
   }
 
   for (Link = mGcdMemorySpaceMap.ForwardLink; Link != &mGcdMemorySpaceMap; Link = Link->ForwardLink) {
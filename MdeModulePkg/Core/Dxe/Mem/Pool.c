@@ -15,14 +15,6 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "DxeMain.h"
 #include "Imem.h"
 
-#define POOL_FREE_SIGNATURE   SIGNATURE_32('p','f','r','0')
-typedef struct {
-  UINT32          Signature;
-  UINT32          Index;
-  LIST_ENTRY      Link;
-} POOL_FREE;
-
-
 #define POOL_HEAD_SIGNATURE   SIGNATURE_32('p','h','d','0')
 typedef struct {
   UINT32          Signature;
@@ -47,12 +39,13 @@ typedef struct {
   ((POOL_TAIL *) (((CHAR8 *) (a)) + (a)->Size - sizeof(POOL_TAIL)));
 
 //
-// Each element is the sum of the 2 previous ones: this allows us to migrate
-// blocks between bins by splitting them up, while not wasting too much memory
-// as we would in a strict power-of-2 sequence
+// Size classes served from slabs.  A slab is one pool page (of the memory
+// type's allocation granularity) holding equally sized blocks of a single
+// class.  The classes are chosen so that a 4KB slab is filled with little
+// waste once the slab header and its occupancy bitmap are accounted for.
 //
 STATIC CONST UINT16 mPoolSizeTable[] = {
-  64, 128, 192, 320, 512, 832, 1344, 2176, 3520, 5696, 9216, 14912, 24128
+  64, 128, 192, 320, 448, 576, 672, 1008, 1344, 2016, 4032, 8064, 16128, 32256
 };
 
 #define SIZE_TO_LIST(a)   (GetPoolIndexFromSize (a))
@@ -62,6 +55,25 @@ STATIC CONST UINT16 mPoolSizeTable[] = {
 
 #define MAX_POOL_SIZE     (MAX_ADDRESS - POOL_OVERHEAD)
 
+//
+// Slab header placed at the start of every page that backs small pool
+// blocks.  Bitmap has one bit per block (set = in use); the bits past
+// Capacity are permanently set so they are never handed out.
+//
+#define POOL_SLAB_SIGNATURE   SIGNATURE_32('p','s','l','b')
+typedef struct {
+  UINT32          Signature;
+  UINT16          Index;
+  UINT16          Capacity;
+  UINT16          FreeCount;
+  UINT16          DataOffset;
+  UINT32          Reserved;
+  LIST_ENTRY      Link;
+  UINT64          Bitmap[1];
+} POOL_SLAB;
+
+#define SIZE_OF_POOL_SLAB_HEAD  OFFSET_OF (POOL_SLAB, Bitmap)
+
 //
 // Globals
 //
@@ -71,7 +83,8 @@ typedef struct {
     INTN             Signature;
     UINTN            Used;
     EFI_MEMORY_TYPE  MemoryType;
-    LIST_ENTRY       FreeList[MAX_POOL_LIST];
+    LIST_ENTRY       SlabList[MAX_POOL_LIST];
+    POOL_SLAB        *EmptySlab[MAX_POOL_LIST];
     LIST_ENTRY       Link;
 } POOL;
 
@@ -109,6 +122,117 @@ GetPoolIndexFromSize (
   return MAX_POOL_LIST;
 }
 
+/**
+  Get the page allocation granularity used for pool of a memory type.
+
+  @param  PoolType      The memory type of the pool.
+
+  @return               The granularity in bytes.
+
+**/
+STATIC
+UINTN
+GetPoolGranularity (
+  IN EFI_MEMORY_TYPE  PoolType
+  )
+{
+  if  (PoolType == EfiACPIReclaimMemory   ||
+       PoolType == EfiACPIMemoryNVS       ||
+       PoolType == EfiRuntimeServicesCode ||
+       PoolType == EfiRuntimeServicesData) {
+    return EFI_ACPI_RUNTIME_PAGE_ALLOCATION_ALIGNMENT;
+  }
+  return DEFAULT_PAGE_ALLOCATION;
+}
+
+/**
+  Initialize a freshly allocated pool page as an empty slab.
+
+  The bitmap is sized for the number of blocks of the size class that fit
+  in the page, and the first block starts right after the bitmap.
+
+  @param  Slab          The page to initialize.
+  @param  Index         The size class served by the slab.
+  @param  Granularity   The size of the page in bytes.
+
+**/
+STATIC
+VOID
+InitializePoolSlab (
+  IN POOL_SLAB  *Slab,
+  IN UINTN      Index,
+  IN UINTN      Granularity
+  )
+{
+  UINTN  BlockSize;
+  UINTN  Capacity;
+  UINTN  Words;
+  UINTN  DataOffset;
+  UINTN  Word;
+
+  BlockSize = LIST_TO_SIZE (Index);
+
+  //
+  // Size the bitmap for the upper bound of blocks, then recompute how many
+  // blocks remain once the bitmap is in place.  Fewer blocks never need more
+  // bitmap words, so a single adjustment is enough.
+  //
+  Capacity   = (Granularity - SIZE_OF_POOL_SLAB_HEAD) / BlockSize;
+  Words      = (Capacity + 63) / 64;
+  DataOffset = ALIGN_VALUE (SIZE_OF_POOL_SLAB_HEAD + Words * sizeof (UINT64), sizeof (UINT64));
+  Capacity   = (Granularity - DataOffset) / BlockSize;
+  ASSERT (Capacity > 0);
+
+  Slab->Signature  = POOL_SLAB_SIGNATURE;
+  Slab->Index      = (UINT16) Index;
+  Slab->Capacity   = (UINT16) Capacity;
+  Slab->FreeCount  = (UINT16) Capacity;
+  Slab->DataOffset = (UINT16) DataOffset;
+  Slab->Reserved   = 0;
+
+  for (Word = 0; Word < Words; Word++) {
+    if (Word < Capacity / 64) {
+      Slab->Bitmap[Word] = 0;
+    } else if (Word == Capacity / 64) {
+      Slab->Bitmap[Word] = LShiftU64 (MAX_UINT64, Capacity % 64);
+    } else {
+      Slab->Bitmap[Word] = MAX_UINT64;
+    }
+  }
+}
+
+/**
+  Take a free block from a slab.  The slab must have at least one free block.
+
+  @param  Slab          The slab to allocate from.
+
+  @return The address of the block.
+
+**/
+STATIC
+VOID *
+AllocatePoolSlabBlock (
+  IN POOL_SLAB  *Slab
+  )
+{
+  UINTN  Word;
+  INTN   Bit;
+
+  ASSERT (Slab->FreeCount > 0);
+
+  for (Word = 0; Slab->Bitmap[Word] == MAX_UINT64; Word++) {
+    ASSERT (Word * 64 < Slab->Capacity);
+  }
+
+  Bit = LowBitSet64 (~Slab->Bitmap[Word]);
+  ASSERT (Bit >= 0);
+
+  Slab->Bitmap[Word] |= LShiftU64 (1, (UINTN) Bit);
+  Slab->FreeCount--;
+
+  return (CHAR8 *) Slab + Slab->DataOffset + (Word * 64 + (UINTN) Bit) * LIST_TO_SIZE (Slab->Index);
+}
+
 /**
   Called to initialize the pool.
 
@@ -126,7 +250,8 @@ CoreInitializePool (
     mPoolHead[Type].Used       = 0;
     mPoolHead[Type].MemoryType = (EFI_MEMORY_TYPE) Type;
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
-      InitializeListHead (&mPoolHead[Type].FreeList[Index]);
+      InitializeListHead (&mPoolHead[Type].SlabList[Index]);
+      mPoolHead[Type].EmptySlab[Index] = NULL;
     }
   }
 }
@@ -175,7 +300,8 @@ LookupPoolHead (
     Pool->Used      = 0;
     Pool->MemoryType = MemoryType;
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
-      InitializeListHead (&Pool->FreeList[Index]);
+      InitializeListHead (&Pool->SlabList[Index]);
+      Pool->EmptySlab[Index] = NULL;
     }
 
     InsertHeadList (&mPoolHeadList, &Pool->Link);
@@ -293,28 +419,17 @@ CoreAllocatePoolI (
   )
 {
   POOL        *Pool;
-  POOL_FREE   *Free;
+  POOL_SLAB   *Slab;
   POOL_HEAD   *Head;
   POOL_TAIL   *Tail;
-  CHAR8       *NewPage;
   VOID        *Buffer;
   UINTN       Index;
-  UINTN       FSize;
-  UINTN       Offset, MaxOffset;
   UINTN       NoPages;
   UINTN       Granularity;
 
   ASSERT_LOCKED (&gMemoryLock);
 
-  if  (PoolType == EfiACPIReclaimMemory   ||
-       PoolType == EfiACPIMemoryNVS       ||
-       PoolType == EfiRuntimeServicesCode ||
-       PoolType == EfiRuntimeServicesData) {
-
-    Granularity = EFI_ACPI_RUNTIME_PAGE_ALLOCATION_ALIGNMENT;
-  } else {
-    Granularity = DEFAULT_PAGE_ALLOCATION;
-  }
+  Granularity = GetPoolGranularity (PoolType);
 
   //
   // Adjust the size by the pool header & tail overhead
@@ -347,69 +462,30 @@ CoreAllocatePoolI (
   }
 
   //
-  // If there's no free pool in the proper list size, go get some more pages
+  // If no slab of this size class has a free block, go get another page
   //
-  if (IsListEmpty (&Pool->FreeList[Index])) {
-
-    Offset = LIST_TO_SIZE (Index);
-    MaxOffset = Granularity;
-
-    //
-    // Check the bins holding larger blocks, and carve one up if needed
-    //
-    while (++Index < SIZE_TO_LIST (Granularity)) {
-      if (!IsListEmpty (&Pool->FreeList[Index])) {
-        Free = CR (Pool->FreeList[Index].ForwardLink, POOL_FREE, Link, POOL_FREE_SIGNATURE);
-        RemoveEntryList (&Free->Link);
-        NewPage = (VOID *) Free;
-        MaxOffset = LIST_TO_SIZE (Index);
-        goto Carve;
-      }
-    }
-
-    //
-    // Get another page
-    //
-    NewPage = CoreAllocatePoolPages(PoolType, EFI_SIZE_TO_PAGES (Granularity), Granularity);
-    if (NewPage == NULL) {
+  if (IsListEmpty (&Pool->SlabList[Index])) {
+    Slab = CoreAllocatePoolPages (PoolType, EFI_SIZE_TO_PAGES (Granularity), Granularity);
+    if (Slab == NULL) {
       goto Done;
     }
+    InitializePoolSlab (Slab, Index, Granularity);
+    InsertHeadList (&Pool->SlabList[Index], &Slab->Link);
+  }
 
-    //
-    // Serve the allocation request from the head of the allocated block
-    //
-Carve:
-    Head = (POOL_HEAD *) NewPage;
-
-    //
-    // Carve up remaining space into free pool blocks
-    //
-    Index--;
-    while (Offset < MaxOffset) {
-      ASSERT (Index < MAX_POOL_LIST);
-      FSize = LIST_TO_SIZE(Index);
-
-      while (Offset + FSize <= MaxOffset) {
-        Free = (POOL_FREE *) &NewPage[Offset];
-        Free->Signature = POOL_FREE_SIGNATURE;
-        Free->Index     = (UINT32)Index;
-        InsertHeadList (&Pool->FreeList[Index], &Free->Link);
-        Offset += FSize;
-      }
-      Index -= 1;
-    }
-
-    ASSERT (Offset == MaxOffset);
-    goto Done;
+  Slab = CR (Pool->SlabList[Index].ForwardLink, POOL_SLAB, Link, POOL_SLAB_SIGNATURE);
+  Head = AllocatePoolSlabBlock (Slab);
+  if (Slab == Pool->EmptySlab[Index]) {
+    Pool->EmptySlab[Index] = NULL;
   }
 
   //
-  // Remove entry from free pool list
+  // Full slabs are not kept on the list; they are found again from the
+  // address of a block when it is freed
   //
-  Free = CR (Pool->FreeList[Index].ForwardLink, POOL_FREE, Link, POOL_FREE_SIGNATURE);
-  RemoveEntryList (&Free->Link);
-
-  Head = (POOL_HEAD *) Free;
+  if (Slab->FreeCount == 0) {
+    RemoveEntryList (&Slab->Link);
+  }
 
 Done:
   Buffer = NULL;
@@ -519,13 +595,13 @@ CoreFreePoolI (
   POOL        *Pool;
   POOL_HEAD   *Head;
   POOL_TAIL   *Tail;
-  POOL_FREE   *Free;
+  POOL_SLAB   *Slab;
   UINTN       Index;
   UINTN       NoPages;
   UINTN       Size;
-  CHAR8       *NewPage;
   UINTN       Offset;
-  BOOLEAN     AllFree;
+  UINTN       Block;
+  UINT64      Mask;
   UINTN       Granularity;
 
   ASSERT(Buffer != NULL);
@@ -558,36 +634,51 @@ CoreFreePoolI (
   }
 
   //
-  // Determine the pool type and account for it
+  // Determine the pool type and the pool list
   //
   Size = Head->Size;
   Pool = LookupPoolHead (Head->Type);
   if (Pool == NULL) {
     return EFI_INVALID_PARAMETER;
   }
-  Pool->Used -= Size;
-  DEBUG ((DEBUG_POOL, "FreePool: %p (len %lx) %,ld\n", Head->Data, (UINT64)(Head->Size - POOL_OVERHEAD), (UINT64) Pool->Used));
 
-  if  (Head->Type == EfiACPIReclaimMemory   ||
-       Head->Type == EfiACPIMemoryNVS       ||
-       Head->Type == EfiRuntimeServicesCode ||
-       Head->Type == EfiRuntimeServicesData) {
+  Granularity = GetPoolGranularity (Head->Type);
+  Index       = SIZE_TO_LIST(Size);
+  Slab        = NULL;
+  Block       = 0;
+  Mask        = 0;
 
-    Granularity = EFI_ACPI_RUNTIME_PAGE_ALLOCATION_ALIGNMENT;
-  } else {
-    Granularity = DEFAULT_PAGE_ALLOCATION;
+  if (Index < SIZE_TO_LIST (Granularity)) {
+    //
+    // Locate the block in the slab that owns the page
+    //
+    Slab = (POOL_SLAB *)((UINTN)Head & ~(Granularity - 1));
+    ASSERT (Slab->Signature == POOL_SLAB_SIGNATURE);
+    ASSERT (Slab->Index == Index);
+    if (Slab->Signature != POOL_SLAB_SIGNATURE || Slab->Index != Index) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Offset = (UINTN)Head - (UINTN)Slab - Slab->DataOffset;
+    Block  = Offset / LIST_TO_SIZE (Index);
+    Mask   = LShiftU64 (1, Block % 64);
+    if ((Offset % LIST_TO_SIZE (Index)) != 0 ||
+        Block >= Slab->Capacity ||
+        (Slab->Bitmap[Block / 64] & Mask) == 0) {
+      ASSERT (FALSE);
+      return EFI_INVALID_PARAMETER;
+    }
   }
 
-  //
-  // Determine the pool list
-  //
-  Index = SIZE_TO_LIST(Size);
+  Pool->Used -= Size;
+  DEBUG ((DEBUG_POOL, "FreePool: %p (len %lx) %,ld\n", Head->Data, (UINT64)(Head->Size - POOL_OVERHEAD), (UINT64) Pool->Used));
+
   DEBUG_CLEAR_MEMORY (Head, Size);
 
   //
-  // If it's not on the list, it must be pool pages
+  // If it's not in a slab, it must be pool pages
   //
-  if (Index >= SIZE_TO_LIST (Granularity)) {
+  if (Slab == NULL) {
 
     //
     // Return the memory pages back to free memory
@@ -599,59 +690,41 @@ CoreFreePoolI (
   } else {
 
     //
-    // Put the pool entry onto the free pool list
-    //
-    Free = (POOL_FREE *) Head;
-    ASSERT(Free != NULL);
-    Free->Signature = POOL_FREE_SIGNATURE;
-    Free->Index     = (UINT32)Index;
-    InsertHeadList (&Pool->FreeList[Index], &Free->Link);
-
-    //
-    // See if all the pool entries in the same page as Free are freed pool
-    // entries
+    // Return the block to its slab
     //
-    NewPage = (CHAR8 *)((UINTN)Free & ~(Granularity - 1));
-    Free = (POOL_FREE *) &NewPage[0];
-    ASSERT(Free != NULL);
-
-    if (Free->Signature == POOL_FREE_SIGNATURE) {
-
-      AllFree = TRUE;
-      Offset = 0;
-
-      while ((Offset < Granularity) && (AllFree)) {
-        Free = (POOL_FREE *) &NewPage[Offset];
-        ASSERT(Free != NULL);
-        if (Free->Signature != POOL_FREE_SIGNATURE) {
-          AllFree = FALSE;
-        }
-        Offset += LIST_TO_SIZE(Free->Index);
+    Head->Signature = 0;
+    Slab->Bitmap[Block / 64] &= ~Mask;
+    Slab->FreeCount++;
+
+    if (Slab->FreeCount == Slab->Capacity) {
+      //
+      // The slab is empty.  A slab with a single block was never put back on
+      // the list.
+      //
+      if (Slab->Capacity > 1) {
+        RemoveEntryList (&Slab->Link);
       }
-
-      if (AllFree) {
-
+      if (Pool->EmptySlab[Index] == NULL) {
         //
-        // All of the pool entries in the same page as Free are free pool
-        // entries
-        // Remove all of these pool entries from the free loop lists.
+        // Keep one empty slab per size class so that a size class whose last
+        // block is freed and allocated again repeatedly does not go to the
+        // page allocator each time.  It goes to the tail of the list so that
+        // partially used slabs are filled first.
         //
-        Free = (POOL_FREE *) &NewPage[0];
-        ASSERT(Free != NULL);
-        Offset = 0;
-
-        while (Offset < Granularity) {
-          Free = (POOL_FREE *) &NewPage[Offset];
-          ASSERT(Free != NULL);
-          RemoveEntryList (&Free->Link);
-          Offset += LIST_TO_SIZE(Free->Index);
-        }
-
+        InsertTailList (&Pool->SlabList[Index], &Slab->Link);
+        Pool->EmptySlab[Index] = Slab;
+      } else {
         //
-        // Free the page
+        // Give the pages of any other empty slab back to the page allocator
         //
-        CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN)NewPage, EFI_SIZE_TO_PAGES (Granularity));
+        Slab->Signature = 0;
+        CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN)Slab, EFI_SIZE_TO_PAGES (Granularity));
       }
+    } else if (Slab->FreeCount == 1) {
+      //
+      // The slab was full, make it available for allocation again
+      //
+      InsertHeadList (&Pool->SlabList[Index], &Slab->Link);
     }
   }
 
@@ -661,10 +734,17 @@ CoreFreePoolI (
   // list entry for that memory type
   //
   if ((INT32)Pool->MemoryType < 0 && Pool->Used == 0) {
+    for (Index = 0; Index < MAX_POOL_LIST; Index++) {
+      Slab = Pool->EmptySlab[Index];
+      if (Slab != NULL) {
+        RemoveEntryList (&Slab->Link);
+        Slab->Signature = 0;
+        CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN)Slab, EFI_SIZE_TO_PAGES (Granularity));
+      }
+    }
     RemoveEntryList (&Pool->Link);
     CoreFreePoolI (Pool);
   }
 
   return EFI_SUCCESS;
 }
-
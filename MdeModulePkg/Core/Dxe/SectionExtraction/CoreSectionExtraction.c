@@ -71,6 +71,23 @@ typedef struct {
   // when the required GUIDed extraction protocol becomes available.
   //
   EFI_EVENT                   Event;
+  //
+  // TRUE if the encapsulated stream is a view into this child's own section
+  // data rather than a buffer of its own.  That is the case for sections that
+  // need no processing to be read.
+  //
+  BOOLEAN                     EncapsulatedStreamShared;
+  //
+  // Encapsulations that were decompressed or extracted into a buffer of their
+  // own are kept on mExtractedChildList in least recently used order, so that
+  // the buffers can be released once the cache grows past its limit.  CacheSize
+  // is 0 if the child is not on the list.  An Evicted child is extracted again
+  // the next time a search walks into it.
+  //
+  LIST_ENTRY                  CacheLink;
+  UINTN                       CacheSize;
+  UINTN                       LastUsed;
+  BOOLEAN                     Evicted;
 } CORE_SECTION_CHILD_NODE;
 
 #define CORE_SECTION_STREAM_SIGNATURE SIGNATURE_32('S','X','S','S')
@@ -88,6 +105,11 @@ typedef struct {
   // Authentication status is from GUIDed encapsulations.
   //
   UINT32                      AuthenticationStatus;
+  //
+  // TRUE if StreamBuffer lies within the buffer that was passed to
+  // OpenSectionStream(), so sections found in it can be returned in place.
+  //
+  BOOLEAN                     InPlace;
 } CORE_SECTION_STREAM_NODE;
 
 #define NULL_STREAM_HANDLE    0
@@ -197,6 +219,17 @@ CustomGuidedSectionExtract (
 //
 LIST_ENTRY mStreamRoot = INITIALIZE_LIST_HEAD_VARIABLE (mStreamRoot);
 
+//
+// Extracted encapsulations in least recently used order, the number of bytes
+// their buffers hold, and the statistics reported in debug builds.
+//
+LIST_ENTRY mExtractedChildList = INITIALIZE_LIST_HEAD_VARIABLE (mExtractedChildList);
+UINTN      mExtractedChildBytes = 0;
+UINTN      mSectionSearchCount = 0;
+UINT64     mExtractedChildHits = 0;
+UINT64     mExtractedChildMisses = 0;
+UINT64     mExtractedChildEvictions = 0;
+
 EFI_HANDLE mSectionExtractionHandle = NULL;
 
 EFI_GUIDED_SECTION_EXTRACTION_PROTOCOL mCustomGuidedSectionExtractionProtocol = {
@@ -393,6 +426,7 @@ OpenSectionStreamEx (
   NewStream->StreamLength = SectionStreamLength;
   InitializeListHead (&NewStream->Children);
   NewStream->AuthenticationStatus = AuthenticationStatus;
+  NewStream->InPlace = FALSE;
 
   //
   // Add new stream to stream list
@@ -430,6 +464,8 @@ OpenSectionStream (
      OUT UINTN                                     *SectionStreamHandle
   )
 {
+  EFI_STATUS                                       Status;
+
   //
   // Check to see section stream looks good...
   //
@@ -437,13 +473,18 @@ OpenSectionStream (
     return EFI_INVALID_PARAMETER;
   }
 
-  return OpenSectionStreamEx (
-           SectionStreamLength,
-           SectionStream,
-           FALSE,
-           0,
-           SectionStreamHandle
-           );
+  Status = OpenSectionStreamEx (
+             SectionStreamLength,
+             SectionStream,
+             FALSE,
+             0,
+             SectionStreamHandle
+             );
+  if (!EFI_ERROR (Status)) {
+    ((CORE_SECTION_STREAM_NODE *) *SectionStreamHandle)->InPlace = TRUE;
+  }
+
+  return Status;
 }
 
 
@@ -539,6 +580,28 @@ VerifyGuidedSectionGuid (
   return FALSE;
 }
 
+/**
+  Worker function.  Record an encapsulation whose contents were extracted into
+  a buffer of its own as the most recently used entry of the extracted section
+  cache.
+
+  @param  ChildNode              The encapsulating child.
+  @param  Size                   Size in bytes of the extracted buffer.
+
+**/
+VOID
+CacheExtractedChild (
+  IN  CORE_SECTION_CHILD_NODE                   *ChildNode,
+  IN  UINTN                                     Size
+  )
+{
+  ChildNode->CacheSize = MAX (Size, 1);
+  ChildNode->LastUsed  = mSectionSearchCount;
+  InsertTailList (&mExtractedChildList, &ChildNode->CacheLink);
+  mExtractedChildBytes += ChildNode->CacheSize;
+  mExtractedChildMisses++;
+}
+
 /**
   RPN callback function. Initializes the section stream
   when GUIDED_SECTION_EXTRACTION_PROTOCOL is installed.
@@ -605,6 +668,7 @@ NotifyGuidedExtraction (
              &Context->ChildNode->EncapsulatedStreamHandle
              );
   ASSERT_EFI_ERROR (Status);
+  CacheExtractedChild (Context->ChildNode, NewStreamBufferSize);
 
   //
   //  Close the event when done.
@@ -648,31 +712,63 @@ CreateGuidedExtractionRpnEvent (
 }
 
 /**
-  Worker function.  Constructor for new child nodes.
+  Worker function.  Release least recently used extracted encapsulations until
+  the buffers still held fit in PcdMaxExtractedSectionCacheSize.  The children
+  stay in their parent streams and are extracted again when they are needed.
 
-  @param  Stream                 Indicates the section stream in which to add the
-                                 child.
-  @param  ChildOffset            Indicates the offset in Stream that is the
-                                 beginning of the child section.
-  @param  ChildNode              Indicates the Callee allocated and initialized
+  This must not be called while a search of the stream database is in progress,
+  since it may free streams that the search is walking.
+
+**/
+VOID
+EvictExtractedChildren (
+  VOID
+  )
+{
+  CORE_SECTION_CHILD_NODE                       *ChildNode;
+  UINTN                                         StreamHandle;
+
+  while (mExtractedChildBytes > PcdGet32 (PcdMaxExtractedSectionCacheSize) &&
+         !IsListEmpty (&mExtractedChildList)) {
+    ChildNode = CR (GetFirstNode (&mExtractedChildList), CORE_SECTION_CHILD_NODE, CacheLink, CORE_SECTION_CHILD_SIGNATURE);
+
+    RemoveEntryList (&ChildNode->CacheLink);
+    mExtractedChildBytes -= ChildNode->CacheSize;
+    ChildNode->CacheSize = 0;
+
+    StreamHandle = ChildNode->EncapsulatedStreamHandle;
+    ChildNode->EncapsulatedStreamHandle = NULL_STREAM_HANDLE;
+    ChildNode->Evicted = TRUE;
+    CloseSectionStream (StreamHandle, TRUE);
+    mExtractedChildEvictions++;
+  }
+}
+
+
+/**
+  Worker function.  Open the section stream encapsulated by a child node, if the
+  child is an encapsulating section.
+
+  Sections that need no processing to be read get a stream that is a view into
+  the parent stream.  Compressed and GUIDed sections are extracted into a new
+  buffer that is tracked by the extracted section cache.
+
+  @param  Stream                 Indicates the section stream that holds the
                                  child.
+  @param  Node                   Indicates the child whose stream is opened.
 
-  @retval EFI_SUCCESS            Child node was found and returned.
-                                 EFI_OUT_OF_RESOURCES- Memory allocation failed.
-  @retval EFI_PROTOCOL_ERROR     Encapsulation sections produce new stream
-                                 handles when the child node is created.  If the
-                                 section type is GUID defined, and the extraction
-                                 GUID does not exist, and producing the stream
-                                 requires the GUID, then a protocol error is
-                                 generated and no child is produced. Values
-                                 returned by OpenSectionStreamEx.
+  @retval EFI_SUCCESS            The stream was opened, or the child is a leaf.
+  @retval EFI_NOT_FOUND          The encapsulation section is malformed.
+  @retval EFI_OUT_OF_RESOURCES   Memory allocation failed.
+  @retval EFI_PROTOCOL_ERROR     The GUIDed section extraction protocol failed.
+  @retval others                 Values returned by the decompress protocol or
+                                 OpenSectionStreamEx.
 
 **/
 EFI_STATUS
-CreateChildNode (
+OpenChildStream (
   IN     CORE_SECTION_STREAM_NODE              *Stream,
-  IN     UINT32                                ChildOffset,
-  OUT    CORE_SECTION_CHILD_NODE               **ChildNode
+  IN OUT CORE_SECTION_CHILD_NODE               *Node
   )
 {
   EFI_STATUS                                   Status;
@@ -691,44 +787,16 @@ CreateChildNode (
   UINT32                                       UncompressedLength;
   UINT8                                        CompressionType;
   UINT16                                       GuidedSectionAttributes;
+  UINT32                                       DataOffset;
 
-  CORE_SECTION_CHILD_NODE                      *Node;
-
-  SectionHeader = (EFI_COMMON_SECTION_HEADER *) (Stream->StreamBuffer + ChildOffset);
-
-  //
-  // Allocate a new node
-  //
-  *ChildNode = AllocateZeroPool (sizeof (CORE_SECTION_CHILD_NODE));
-  Node = *ChildNode;
-  if (Node == NULL) {
-    return EFI_OUT_OF_RESOURCES;
-  }
-
-  //
-  // Now initialize it
-  //
-  Node->Signature = CORE_SECTION_CHILD_SIGNATURE;
-  Node->Type = SectionHeader->Type;
-  if (IS_SECTION2 (SectionHeader)) {
-    Node->Size = SECTION2_SIZE (SectionHeader);
-  } else {
-    Node->Size = SECTION_SIZE (SectionHeader);
-  }
-  Node->OffsetInStream = ChildOffset;
-  Node->EncapsulatedStreamHandle = NULL_STREAM_HANDLE;
-  Node->EncapsulationGuid = NULL;
+  SectionHeader = (EFI_COMMON_SECTION_HEADER *) (Stream->StreamBuffer + Node->OffsetInStream);
 
-  //
-  // If it's an encapsulating section, then create the new section stream also
-  //
   switch (Node->Type) {
     case EFI_SECTION_COMPRESSION:
       //
       // Get the CompressionSectionHeader
       //
       if (Node->Size < sizeof (EFI_COMPRESSION_SECTION)) {
-        CoreFreePool (Node);
         return EFI_NOT_FOUND;
       }
 
@@ -746,6 +814,29 @@ CreateChildNode (
         CompressionType = CompressionHeader->CompressionType;
       }
 
+      if (CompressionType == EFI_NOT_COMPRESSED) {
+        //
+        // stream is not actually compressed, just encapsulated.  So just look
+        // at it in place.
+        //
+        if (UncompressedLength > CompressionSourceSize) {
+          return EFI_NOT_FOUND;
+        }
+        Status = OpenSectionStreamEx (
+                   UncompressedLength,
+                   (UncompressedLength > 0) ? CompressionSource : NULL,
+                   FALSE,
+                   Stream->AuthenticationStatus,
+                   &Node->EncapsulatedStreamHandle
+                   );
+        if (EFI_ERROR (Status)) {
+          return Status;
+        }
+        Node->EncapsulatedStreamShared = TRUE;
+        ((CORE_SECTION_STREAM_NODE *) Node->EncapsulatedStreamHandle)->InPlace = Stream->InPlace;
+        break;
+      }
+
       //
       // Allocate space for the new stream
       //
@@ -753,16 +844,10 @@ CreateChildNode (
         NewStreamBufferSize = UncompressedLength;
         NewStreamBuffer = AllocatePool (NewStreamBufferSize);
         if (NewStreamBuffer == NULL) {
-          CoreFreePool (Node);
           return EFI_OUT_OF_RESOURCES;
         }
 
-        if (CompressionType == EFI_NOT_COMPRESSED) {
-          //
-          // stream is not actually compressed, just encapsulated.  So just copy it.
-          //
-          CopyMem (NewStreamBuffer, CompressionSource, NewStreamBufferSize);
-        } else if (CompressionType == EFI_STANDARD_COMPRESSION) {
+        if (CompressionType == EFI_STANDARD_COMPRESSION) {
           //
           // Only support the EFI_SATNDARD_COMPRESSION algorithm.
           //
@@ -782,7 +867,6 @@ CreateChildNode (
                                  &ScratchSize
                                  );
           if (EFI_ERROR (Status) || (NewStreamBufferSize != UncompressedLength)) {
-            CoreFreePool (Node);
             CoreFreePool (NewStreamBuffer);
             if (!EFI_ERROR (Status)) {
               Status = EFI_BAD_BUFFER_SIZE;
@@ -792,7 +876,6 @@ CreateChildNode (
 
           ScratchBuffer = AllocatePool (ScratchSize);
           if (ScratchBuffer == NULL) {
-            CoreFreePool (Node);
             CoreFreePool (NewStreamBuffer);
             return EFI_OUT_OF_RESOURCES;
           }
@@ -808,7 +891,6 @@ CreateChildNode (
                                  );
           CoreFreePool (ScratchBuffer);
           if (EFI_ERROR (Status)) {
-            CoreFreePool (Node);
             CoreFreePool (NewStreamBuffer);
             return Status;
           }
@@ -826,10 +908,12 @@ CreateChildNode (
                  &Node->EncapsulatedStreamHandle
                  );
       if (EFI_ERROR (Status)) {
-        CoreFreePool (Node);
-        CoreFreePool (NewStreamBuffer);
+        if (NewStreamBuffer != NULL) {
+          CoreFreePool (NewStreamBuffer);
+        }
         return Status;
       }
+      CacheExtractedChild (Node, NewStreamBufferSize);
       break;
 
     case EFI_SECTION_GUID_DEFINED:
@@ -837,9 +921,11 @@ CreateChildNode (
       if (IS_SECTION2 (GuidedHeader)) {
         Node->EncapsulationGuid = &(((EFI_GUID_DEFINED_SECTION2 *) GuidedHeader)->SectionDefinitionGuid);
         GuidedSectionAttributes = ((EFI_GUID_DEFINED_SECTION2 *) GuidedHeader)->Attributes;
+        DataOffset = ((EFI_GUID_DEFINED_SECTION2 *) GuidedHeader)->DataOffset;
       } else {
         Node->EncapsulationGuid = &GuidedHeader->SectionDefinitionGuid;
         GuidedSectionAttributes = GuidedHeader->Attributes;
+        DataOffset = GuidedHeader->DataOffset;
       }
       if (VerifyGuidedSectionGuid (Node->EncapsulationGuid, &GuidedExtraction)) {
         //
@@ -854,7 +940,6 @@ CreateChildNode (
                                      &AuthenticationStatus
                                      );
         if (EFI_ERROR (Status)) {
-          CoreFreePool (*ChildNode);
           return EFI_PROTOCOL_ERROR;
         }
 
@@ -883,10 +968,10 @@ CreateChildNode (
                    &Node->EncapsulatedStreamHandle
                    );
         if (EFI_ERROR (Status)) {
-          CoreFreePool (*ChildNode);
           CoreFreePool (NewStreamBuffer);
           return Status;
         }
+        CacheExtractedChild (Node, NewStreamBufferSize);
       } else {
         //
         // There's no GUIDed section extraction protocol available.
@@ -896,7 +981,9 @@ CreateChildNode (
           // If the section REQUIRES an extraction protocol, register for RPN 
           // when the required GUIDed extraction protocol becomes available. 
           //
-          CreateGuidedExtractionRpnEvent (Stream, Node);
+          if (Node->Event == NULL) {
+            CreateGuidedExtractionRpnEvent (Stream, Node);
+          }
         } else {
           //
           // Figure out the proper authentication status
@@ -907,27 +994,24 @@ CreateChildNode (
             AuthenticationStatus |= EFI_AUTH_STATUS_IMAGE_SIGNED | EFI_AUTH_STATUS_NOT_TESTED;
           }
 
-          if (IS_SECTION2 (GuidedHeader)) {
-            Status = OpenSectionStreamEx (
-                       SECTION2_SIZE (GuidedHeader) - ((EFI_GUID_DEFINED_SECTION2 *) GuidedHeader)->DataOffset,
-                       (UINT8 *) GuidedHeader + ((EFI_GUID_DEFINED_SECTION2 *) GuidedHeader)->DataOffset,
-                       TRUE,
-                       AuthenticationStatus,
-                       &Node->EncapsulatedStreamHandle
-                       );
-          } else {
-            Status = OpenSectionStreamEx (
-                       SECTION_SIZE (GuidedHeader) - ((EFI_GUID_DEFINED_SECTION *) GuidedHeader)->DataOffset,
-                       (UINT8 *) GuidedHeader + ((EFI_GUID_DEFINED_SECTION *) GuidedHeader)->DataOffset,
-                       TRUE,
-                       AuthenticationStatus,
-                       &Node->EncapsulatedStreamHandle
-                       );
+          //
+          // The data can be read without processing, so look at it in place.
+          //
+          if (DataOffset > Node->Size) {
+            return EFI_NOT_FOUND;
           }
+          Status = OpenSectionStreamEx (
+                     Node->Size - DataOffset,
+                     (UINT8 *) GuidedHeader + DataOffset,
+                     FALSE,
+                     AuthenticationStatus,
+                     &Node->EncapsulatedStreamHandle
+                     );
           if (EFI_ERROR (Status)) {
-            CoreFreePool (Node);
             return Status;
           }
+          Node->EncapsulatedStreamShared = TRUE;
+          ((CORE_SECTION_STREAM_NODE *) Node->EncapsulatedStreamHandle)->InPlace = Stream->InPlace;
         }
       }
 
@@ -941,6 +1025,76 @@ CreateChildNode (
       break;
   }
 
+  return EFI_SUCCESS;
+}
+
+
+/**
+  Worker function.  Constructor for new child nodes.
+
+  @param  Stream                 Indicates the section stream in which to add the
+                                 child.
+  @param  ChildOffset            Indicates the offset in Stream that is the
+                                 beginning of the child section.
+  @param  ChildNode              Indicates the Callee allocated and initialized
+                                 child.
+
+  @retval EFI_SUCCESS            Child node was found and returned.
+                                 EFI_OUT_OF_RESOURCES- Memory allocation failed.
+  @retval EFI_PROTOCOL_ERROR     Encapsulation sections produce new stream
+                                 handles when the child node is created.  If the
+                                 section type is GUID defined, and the extraction
+                                 GUID does not exist, and producing the stream
+                                 requires the GUID, then a protocol error is
+                                 generated and no child is produced. Values
+                                 returned by OpenSectionStreamEx.
+
+**/
+EFI_STATUS
+CreateChildNode (
+  IN     CORE_SECTION_STREAM_NODE              *Stream,
+  IN     UINT32                                ChildOffset,
+  OUT    CORE_SECTION_CHILD_NODE               **ChildNode
+  )
+{
+  EFI_STATUS                                   Status;
+  EFI_COMMON_SECTION_HEADER                    *SectionHeader;
+  CORE_SECTION_CHILD_NODE                      *Node;
+
+  SectionHeader = (EFI_COMMON_SECTION_HEADER *) (Stream->StreamBuffer + ChildOffset);
+
+  //
+  // Allocate a new node
+  //
+  *ChildNode = AllocateZeroPool (sizeof (CORE_SECTION_CHILD_NODE));
+  Node = *ChildNode;
+  if (Node == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Now initialize it
+  //
+  Node->Signature = CORE_SECTION_CHILD_SIGNATURE;
+  Node->Type = SectionHeader->Type;
+  if (IS_SECTION2 (SectionHeader)) {
+    Node->Size = SECTION2_SIZE (SectionHeader);
+  } else {
+    Node->Size = SECTION_SIZE (SectionHeader);
+  }
+  Node->OffsetInStream = ChildOffset;
+  Node->EncapsulatedStreamHandle = NULL_STREAM_HANDLE;
+  Node->EncapsulationGuid = NULL;
+
+  //
+  // If it's an encapsulating section, then create the new section stream also
+  //
+  Status = OpenChildStream (Stream, Node);
+  if (EFI_ERROR (Status)) {
+    CoreFreePool (Node);
+    return Status;
+  }
+
   //
   // Last, add the new child node to the stream
   //
@@ -1043,6 +1197,32 @@ FindChildNode (
       }
     }
 
+    if (CurrentChildNode->Evicted) {
+      //
+      // The extracted contents were released to keep the cache bounded, so
+      // extract them again before searching inside.
+      //
+      Status = OpenChildStream (SourceStream, CurrentChildNode);
+      if (EFI_ERROR (Status)) {
+        ErrorStatus = Status;
+      } else {
+        CurrentChildNode->Evicted = FALSE;
+      }
+    }
+
+    if (CurrentChildNode->CacheSize != 0) {
+      //
+      // Count one hit per search that reuses an extraction, and keep the
+      // cache list in least recently used order.
+      //
+      if (CurrentChildNode->LastUsed != mSectionSearchCount) {
+        CurrentChildNode->LastUsed = mSectionSearchCount;
+        mExtractedChildHits++;
+      }
+      RemoveEntryList (&CurrentChildNode->CacheLink);
+      InsertTailList (&mExtractedChildList, &CurrentChildNode->CacheLink);
+    }
+
     if (CurrentChildNode->EncapsulatedStreamHandle != NULL_STREAM_HANDLE) {
       //
       // If the current node is an encapsulating node, recurse into it...
@@ -1151,6 +1331,121 @@ FindStreamNode (
 }
 
 
+/**
+  Worker function.  Locate the data of a section in a section stream.  The
+  caller must have raised the TPL to TPL_NOTIFY, and the data is only valid
+  until the TPL is restored.
+
+  @param  SectionStreamHandle   The section stream from which to extract the
+                                requested section.
+  @param  SectionType           A pointer to the type of section to search for.
+                                NULL means the whole section stream.
+  @param  SectionDefinitionGuid If the section type is EFI_SECTION_GUID_DEFINED,
+                                then SectionDefinitionGuid indicates which of
+                                these types of sections to search for.
+  @param  SectionInstance       Indicates which instance of the requested
+                                section to return.
+  @param  Data                  Output pointer to the section data.
+  @param  DataSize              Output size in bytes of the section data.
+  @param  AuthenticationStatus  Output authentication status of the section.
+  @param  InPlace               Output TRUE if the data lies within the buffer
+                                passed to OpenSectionStream().
+  @param  IsFfs3Fv              Indicates the FV format.
+
+  @retval EFI_SUCCESS           The section was found.
+  @retval EFI_INVALID_PARAMETER The SectionStreamHandle does not exist.
+  @retval others                Values returned by FindChildNode.
+
+**/
+EFI_STATUS
+FindSectionData (
+  IN  UINTN                                             SectionStreamHandle,
+  IN  EFI_SECTION_TYPE                                  *SectionType,
+  IN  EFI_GUID                                          *SectionDefinitionGuid,
+  IN  UINTN                                             SectionInstance,
+  OUT UINT8                                             **Data,
+  OUT UINTN                                             *DataSize,
+  OUT UINT32                                            *AuthenticationStatus,
+  OUT BOOLEAN                                           *InPlace,
+  IN  BOOLEAN                                           IsFfs3Fv
+  )
+{
+  CORE_SECTION_STREAM_NODE                              *StreamNode;
+  EFI_STATUS                                            Status;
+  CORE_SECTION_CHILD_NODE                               *ChildNode;
+  CORE_SECTION_STREAM_NODE                              *ChildStreamNode;
+  UINT32                                                ExtractedAuthenticationStatus;
+  UINTN                                                 Instance;
+  EFI_COMMON_SECTION_HEADER                             *Section;
+
+  ChildStreamNode = NULL;
+  Instance = SectionInstance + 1;
+
+  //
+  // Release extractions that no longer fit in the cache before the stream
+  // database is walked.
+  //
+  mSectionSearchCount++;
+  EvictExtractedChildren ();
+
+  //
+  // Locate target stream
+  //
+  Status = FindStreamNode (SectionStreamHandle, &StreamNode);
+  if (EFI_ERROR (Status)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Found the stream, now locate and return the appropriate section
+  //
+  if (SectionType == NULL) {
+    //
+    // SectionType == NULL means return the WHOLE section stream...
+    //
+    *DataSize = StreamNode->StreamLength;
+    *Data = StreamNode->StreamBuffer;
+    *AuthenticationStatus = StreamNode->AuthenticationStatus;
+    *InPlace = StreamNode->InPlace;
+  } else {
+    //
+    // There's a requested section type, so go find it and return it...
+    //
+    Status = FindChildNode (
+               StreamNode,
+               *SectionType,
+               &Instance,
+               SectionDefinitionGuid,
+               &ChildNode,
+               &ChildStreamNode,
+               &ExtractedAuthenticationStatus
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Section = (EFI_COMMON_SECTION_HEADER *) (ChildStreamNode->StreamBuffer + ChildNode->OffsetInStream);
+
+    if (IS_SECTION2 (Section)) {
+      ASSERT (SECTION2_SIZE (Section) > 0x00FFFFFF);
+      if (!IsFfs3Fv) {
+        DEBUG ((DEBUG_ERROR, "It is a FFS3 formatted section in a non-FFS3 formatted FV.\n"));
+        return EFI_NOT_FOUND;
+      }
+      *DataSize = SECTION2_SIZE (Section) - sizeof (EFI_COMMON_SECTION_HEADER2);
+      *Data = (UINT8 *) Section + sizeof (EFI_COMMON_SECTION_HEADER2);
+    } else {
+      *DataSize = SECTION_SIZE (Section) - sizeof (EFI_COMMON_SECTION_HEADER);
+      *Data = (UINT8 *) Section + sizeof (EFI_COMMON_SECTION_HEADER);
+    }
+    *AuthenticationStatus = ExtractedAuthenticationStatus;
+    *InPlace = ChildStreamNode->InPlace;
+  }
+
+  return EFI_SUCCESS;
+}
+
+
 /**
   SEP member function.  Retrieves requested section from section stream.
 
@@ -1222,77 +1517,30 @@ GetSection (
   IN BOOLEAN                                            IsFfs3Fv
   )
 {
-  CORE_SECTION_STREAM_NODE                              *StreamNode;
   EFI_TPL                                               OldTpl;
   EFI_STATUS                                            Status;
-  CORE_SECTION_CHILD_NODE                               *ChildNode;
-  CORE_SECTION_STREAM_NODE                              *ChildStreamNode;
   UINTN                                                 CopySize;
-  UINT32                                                ExtractedAuthenticationStatus;
-  UINTN                                                 Instance;
   UINT8                                                 *CopyBuffer;
   UINTN                                                 SectionSize;
-  EFI_COMMON_SECTION_HEADER                             *Section;
-
+  BOOLEAN                                               InPlace;
 
-  ChildStreamNode = NULL;
   OldTpl = CoreRaiseTpl (TPL_NOTIFY);
-  Instance = SectionInstance + 1;
 
-  //
-  // Locate target stream
-  //
-  Status = FindStreamNode (SectionStreamHandle, &StreamNode);
+  Status = FindSectionData (
+             SectionStreamHandle,
+             SectionType,
+             SectionDefinitionGuid,
+             SectionInstance,
+             &CopyBuffer,
+             &CopySize,
+             AuthenticationStatus,
+             &InPlace,
+             IsFfs3Fv
+             );
   if (EFI_ERROR (Status)) {
-    Status = EFI_INVALID_PARAMETER;
     goto GetSection_Done;
   }
 
-  //
-  // Found the stream, now locate and return the appropriate section
-  //
-  if (SectionType == NULL) {
-    //
-    // SectionType == NULL means return the WHOLE section stream...
-    //
-    CopySize = StreamNode->StreamLength;
-    CopyBuffer = StreamNode->StreamBuffer;
-    *AuthenticationStatus = StreamNode->AuthenticationStatus;
-  } else {
-    //
-    // There's a requested section type, so go find it and return it...
-    //
-    Status = FindChildNode (
-               StreamNode,
-               *SectionType,
-               &Instance,
-               SectionDefinitionGuid,
-               &ChildNode,
-               &ChildStreamNode,
-               &ExtractedAuthenticationStatus
-               );
-    if (EFI_ERROR (Status)) {
-      goto GetSection_Done;
-    }
-
-    Section = (EFI_COMMON_SECTION_HEADER *) (ChildStreamNode->StreamBuffer + ChildNode->OffsetInStream);
-
-    if (IS_SECTION2 (Section)) {
-      ASSERT (SECTION2_SIZE (Section) > 0x00FFFFFF);
-      if (!IsFfs3Fv) {
-        DEBUG ((DEBUG_ERROR, "It is a FFS3 formatted section in a non-FFS3 formatted FV.\n"));
-        Status = EFI_NOT_FOUND;
-        goto GetSection_Done;
-      }
-      CopySize = SECTION2_SIZE (Section) - sizeof (EFI_COMMON_SECTION_HEADER2);
-      CopyBuffer = (UINT8 *) Section + sizeof (EFI_COMMON_SECTION_HEADER2);
-    } else {
-      CopySize = SECTION_SIZE (Section) - sizeof (EFI_COMMON_SECTION_HEADER);
-      CopyBuffer = (UINT8 *) Section + sizeof (EFI_COMMON_SECTION_HEADER);
-    }
-    *AuthenticationStatus = ExtractedAuthenticationStatus;
-  }
-
   SectionSize = CopySize;
   if (*Buffer != NULL) {
     //
@@ -1322,6 +1570,99 @@ GetSection_Done:
 }
 
 
+/**
+  Retrieves a pointer to the requested section where it lies in the buffer that
+  was passed to OpenSectionStream(), without copying it.  Sections inside
+  compression or GUIDed encapsulations that had to be extracted into a buffer
+  of their own are not returned, because that buffer may be released.
+
+  @param  SectionStreamHandle   The section stream from which to locate the
+                                requested section.
+  @param  SectionType           A pointer to the type of section to search for.
+  @param  SectionInstance       Indicates which instance of the requested
+                                section to return.
+  @param  Buffer                Output pointer to the section data.
+  @param  BufferSize            Output size in bytes of the section data.
+  @param  AuthenticationStatus  Output authentication status of the section.
+  @param  IsFfs3Fv              Indicates the FV format.
+
+  @retval EFI_SUCCESS           *Buffer points to the section data.
+  @retval EFI_UNSUPPORTED       The section was found, but not in place.  The
+                                caller should use GetSection() instead.
+  @retval EFI_INVALID_PARAMETER The SectionStreamHandle does not exist.
+  @retval others                Values returned by GetSection() for the same
+                                search.
+
+**/
+EFI_STATUS
+GetSectionInPlace (
+  IN  UINTN                                             SectionStreamHandle,
+  IN  EFI_SECTION_TYPE                                  *SectionType,
+  IN  UINTN                                             SectionInstance,
+  OUT VOID                                              **Buffer,
+  OUT UINTN                                             *BufferSize,
+  OUT UINT32                                            *AuthenticationStatus,
+  IN  BOOLEAN                                           IsFfs3Fv
+  )
+{
+  EFI_TPL                                               OldTpl;
+  EFI_STATUS                                            Status;
+  UINT8                                                 *Data;
+  UINTN                                                 DataSize;
+  UINT32                                                DataAuthenticationStatus;
+  BOOLEAN                                               InPlace;
+
+  OldTpl = CoreRaiseTpl (TPL_NOTIFY);
+
+  Status = FindSectionData (
+             SectionStreamHandle,
+             SectionType,
+             NULL,
+             SectionInstance,
+             &Data,
+             &DataSize,
+             &DataAuthenticationStatus,
+             &InPlace,
+             IsFfs3Fv
+             );
+  if (!EFI_ERROR (Status)) {
+    if (InPlace) {
+      *Buffer = Data;
+      *BufferSize = DataSize;
+      *AuthenticationStatus = DataAuthenticationStatus;
+    } else {
+      Status = EFI_UNSUPPORTED;
+    }
+  }
+
+  CoreRestoreTpl (OldTpl);
+
+  return Status;
+}
+
+
+/**
+  Display how often extracted encapsulation sections were reused, extracted and
+  evicted, and how many bytes of extracted data are still held. Only used in
+  debug builds.
+
+**/
+VOID
+CoreDisplaySectionCacheStatistics (
+  VOID
+  )
+{
+  DEBUG ((
+    DEBUG_INFO,
+    "Section cache: %ld hits, %ld extractions, %ld evictions, 0x%lx bytes held\n",
+    mExtractedChildHits,
+    mExtractedChildMisses,
+    mExtractedChildEvictions,
+    (UINT64) mExtractedChildBytes
+    ));
+}
+
+
 /**
   Worker function.  Destructor for child nodes.
 
@@ -1339,12 +1680,18 @@ FreeChildNode (
   //
   RemoveEntryList (&ChildNode->Link);
 
+  if (ChildNode->CacheSize != 0) {
+    RemoveEntryList (&ChildNode->CacheLink);
+    mExtractedChildBytes -= ChildNode->CacheSize;
+  }
+
   if (ChildNode->EncapsulatedStreamHandle != NULL_STREAM_HANDLE) {
     //
     // If it's an encapsulating section, we close the resulting section stream.
-    // CloseSectionStream will free all memory associated with the stream.
+    // CloseSectionStream will free all memory associated with the stream,
+    // except a buffer that is only a view into the parent stream.
     //
-    CloseSectionStream (ChildNode->EncapsulatedStreamHandle, TRUE);
+    CloseSectionStream (ChildNode->EncapsulatedStreamHandle, (BOOLEAN) !ChildNode->EncapsulatedStreamShared);
   }
 
   if (ChildNode->Event != NULL) {
@@ -52,6 +52,12 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define STACK_SIZE      0x20000
 #define BSP_STORE_SIZE  0x4000
 
+//
+// The size of the chunks in which a compressed section is passed to the
+// incremental UEFI decompressor.
+//
+#define DECOMPRESS_CHUNK_SIZE  SIZE_64KB
+
 
 //
 // This PPI is installed to indicate the end of the PEI usage of memory
@@ -51,6 +51,15 @@ CONST EFI_PEI_PPI_DESCRIPTOR gEndOfPeiSignalPpi = {
   NULL
 };
 
+//
+// The scratch buffer that is shared by the decompression of all sections.
+// Pages allocated in PEI are never freed, so the scratch buffer is kept for the
+// next section instead of allocating a new one each time.
+//
+VOID     *mScratchBuffer      = NULL;
+UINTN    mScratchBufferPages  = 0;
+BOOLEAN  mScratchBufferInUse  = FALSE;
+
 /**
   Entry point of DXE IPL PEIM.
   
@@ -417,7 +426,61 @@ DxeIplFindDxeCore (
   }
 }
 
+/**
+   Gets a scratch buffer to decompress a section.
+
+   On the S3 resume boot path DXE IPL is not shadowed to memory and its module
+   globals may be read-only, so a new buffer is allocated each time. Otherwise
+   the shared scratch buffer is returned, and it is only reallocated when it is
+   too small.
+
+   @param  Size           The size, in bytes, of the scratch buffer.
+
+   @return The scratch buffer, or NULL if it could not be allocated.
+
+**/
+VOID *
+AcquireScratchBuffer (
+  IN UINTN   Size
+  )
+{
+  UINTN      Pages;
+  VOID       *Buffer;
+
+  Pages = EFI_SIZE_TO_PAGES (Size);
+  if (mScratchBufferInUse || GetBootModeHob () == BOOT_ON_S3_RESUME) {
+    return AllocatePages (Pages);
+  }
+
+  if (Pages > mScratchBufferPages) {
+    Buffer = AllocatePages (Pages);
+    if (Buffer == NULL) {
+      return NULL;
+    }
+    mScratchBuffer      = Buffer;
+    mScratchBufferPages = Pages;
+  }
+
+  mScratchBufferInUse = TRUE;
+  return mScratchBuffer;
+}
+
+/**
+   Returns a scratch buffer got from AcquireScratchBuffer() when the
+   decompression of a section is done.
 
+   @param  Buffer         The scratch buffer.
+
+**/
+VOID
+ReleaseScratchBuffer (
+  IN VOID    *Buffer
+  )
+{
+  if (Buffer != NULL && Buffer == mScratchBuffer) {
+    mScratchBufferInUse = FALSE;
+  }
+}
 
 /**
   The ExtractSection() function processes the input section and
@@ -513,7 +576,7 @@ CustomGuidedSectionExtract (
     //
     // Allocate scratch buffer
     //
-    ScratchBuffer = AllocatePages (EFI_SIZE_TO_PAGES (ScratchBufferSize));
+    ScratchBuffer = AcquireScratchBuffer (ScratchBufferSize);
     if (ScratchBuffer == NULL) {
       return EFI_OUT_OF_RESOURCES;
     }
@@ -525,6 +588,7 @@ CustomGuidedSectionExtract (
     //
     *OutputBuffer = AllocatePages (EFI_SIZE_TO_PAGES (OutputBufferSize) + 1);
     if (*OutputBuffer == NULL) {
+      ReleaseScratchBuffer (ScratchBuffer);
       return EFI_OUT_OF_RESOURCES;
     }
     DEBUG ((DEBUG_INFO, "Customized Guided section Memory Size required is 0x%x and address is 0x%p\n", OutputBufferSize, *OutputBuffer));
@@ -541,6 +605,7 @@ CustomGuidedSectionExtract (
              ScratchBuffer,
              AuthenticationStatus
              );
+  ReleaseScratchBuffer (ScratchBuffer);
   if (EFI_ERROR (Status)) {
     //
     // Decode failed
@@ -594,6 +659,9 @@ Decompress (
   UINT32                          CompressionSourceSize;
   UINT32                          UncompressedLength;
   UINT8                           CompressionType;
+  UINT32                          Offset;
+  UINT32                          ChunkSize;
+  UINT32                          DecodedSize;
 
   if (CompressionSection->CommonHeader.Type != EFI_SECTION_COMPRESSION) {
     ASSERT (FALSE);
@@ -622,7 +690,7 @@ Decompress (
       // Load EFI standard compression.
       // For compressed data, decompress them to destination buffer.
       //
-      Status = UefiDecompressGetInfo (
+      Status = UefiDecompressStreamGetInfo (
                  CompressionSource,
                  CompressionSourceSize,
                  &DstBufferSize,
@@ -638,7 +706,7 @@ Decompress (
       //
       // Allocate scratch buffer
       //
-      ScratchBuffer = AllocatePages (EFI_SIZE_TO_PAGES (ScratchBufferSize));
+      ScratchBuffer = AcquireScratchBuffer (ScratchBufferSize);
       if (ScratchBuffer == NULL) {
         return EFI_OUT_OF_RESOURCES;
       }
@@ -647,6 +715,7 @@ Decompress (
       //
       DstBuffer = AllocatePages (EFI_SIZE_TO_PAGES (DstBufferSize) + 1);
       if (DstBuffer == NULL) {
+        ReleaseScratchBuffer (ScratchBuffer);
         return EFI_OUT_OF_RESOURCES;
       }
       //
@@ -655,13 +724,29 @@ Decompress (
       //
       DstBuffer = DstBuffer + EFI_PAGE_SIZE - sizeof (EFI_COMMON_SECTION_HEADER);
       //
-      // Call decompress function
+      // Pass the compressed data to the decompressor in chunks. Each chunk is
+      // copied from flash with wide sequential reads into the staging buffer
+      // of the decompressor, instead of being read bit by bit while decoding.
       //
-      Status = UefiDecompress (
-                  CompressionSource,
-                  DstBuffer,
-                  ScratchBuffer
-                  );
+      UefiDecompressStreamInit (DstBuffer, ScratchBuffer);
+      Offset = 0;
+      do {
+        ChunkSize = MIN (CompressionSourceSize - Offset, DECOMPRESS_CHUNK_SIZE);
+        Status = UefiDecompressStreamDecode (
+                   ScratchBuffer,
+                   (UINT8 *) CompressionSource + Offset,
+                   &ChunkSize,
+                   &DecodedSize
+                   );
+        Offset += ChunkSize;
+      } while (Status == RETURN_NOT_READY && ChunkSize != 0);
+      ReleaseScratchBuffer (ScratchBuffer);
+      if (Status == RETURN_NOT_READY) {
+        //
+        // The section ended before all of the data was decompressed
+        //
+        Status = EFI_VOLUME_CORRUPTED;
+      }
       if (EFI_ERROR (Status)) {
         //
         // Decompress failed
@@ -17,7 +17,12 @@
 #include "Sdk/C/7zVersion.h"
 #include "Sdk/C/LzmaDec.h"
 
-#define SCRATCH_BUFFER_REQUEST_SIZE SIZE_64KB
+//
+// The number of probabilities the decoder allocates, as LzmaProps_GetNumProbs()
+// in LzmaDec.c.
+//
+#define LZMA_PROBS_BASE_SIZE  1846
+#define LZMA_PROBS_LIT_SIZE   0x300
 
 typedef struct
 {
@@ -26,6 +31,20 @@ typedef struct
   UINTN    BufferSize;
 } ISzAllocWithData;
 
+///
+/// The scratch data of the incremental decompressor. The probabilities of the
+/// decoder follow it in the scratch buffer.
+///
+typedef struct
+{
+  CLzmaDec          Decoder;
+  ISzAllocWithData  AllocFuncs;
+  UINT8             *Destination;
+  SizeT             DecodedSize;
+  UINTN             HeaderLength;
+  UINT8             Header[LZMA_PROPS_SIZE + 8];
+} LZMA_STREAM_DATA;
+
 /**
   Allocation routine used by LZMA decompression.
 
@@ -100,6 +119,28 @@ GetDecodedSizeOfBuf(
   return DecodedSize;
 }
 
+/**
+  Get the size of the probabilities the decoder allocates by parsing the
+  lc and lp properties in EncodeData header.
+
+  @param EncodedData  Pointer to the compressed data.
+
+  @return The size, in bytes, of the probabilities.
+**/
+UINTN
+GetProbsSizeOfBuf (
+  UINT8 *EncodedData
+  )
+{
+  UINTN  Lc;
+  UINTN  Lp;
+
+  Lc = EncodedData[0] % 9;
+  Lp = (EncodedData[0] / 9) % 5;
+
+  return (LZMA_PROBS_BASE_SIZE + (LZMA_PROBS_LIT_SIZE << (Lc + Lp))) * sizeof (CLzmaProb);
+}
+
 //
 // LZMA functions and data as defined in local LzmaDecompressLibInternal.h
 //
@@ -150,7 +191,7 @@ LzmaUefiDecompressGetInfo (
   DecodedSize = GetDecodedSizeOfBuf((UINT8*)Source);
 
   *DestinationSize = (UINT32)DecodedSize;
-  *ScratchSize = SCRATCH_BUFFER_REQUEST_SIZE;
+  *ScratchSize = (UINT32) (sizeof (LZMA_STREAM_DATA) + GetProbsSizeOfBuf ((UINT8*)Source));
   return RETURN_SUCCESS;
 }
 
@@ -185,36 +226,148 @@ LzmaUefiDecompress (
   IN OUT VOID    *Scratch
   )
 {
-  SRes              LzmaResult;
-  ELzmaStatus       Status;
-  SizeT             DecodedBufSize;
-  SizeT             EncodedDataSize;
-  ISzAllocWithData  AllocFuncs;
+  RETURN_STATUS     Status;
+  UINTN             DecodedSize;
 
-  AllocFuncs.Functions.Alloc  = SzAlloc;
-  AllocFuncs.Functions.Free   = SzFree;
-  AllocFuncs.Buffer           = Scratch;
-  AllocFuncs.BufferSize       = SCRATCH_BUFFER_REQUEST_SIZE;
-  
-  DecodedBufSize = (SizeT)GetDecodedSizeOfBuf((UINT8*)Source);
-  EncodedDataSize = (SizeT) (SourceSize - LZMA_HEADER_SIZE);
-
-  LzmaResult = LzmaDecode(
-    Destination,
-    &DecodedBufSize,
-    (Byte*)((UINT8*)Source + LZMA_HEADER_SIZE),
-    &EncodedDataSize,
-    Source,
-    LZMA_PROPS_SIZE,
-    LZMA_FINISH_END,
-    &Status,
-    &(AllocFuncs.Functions)
-    );
-
-  if (LzmaResult == SZ_OK) {
+  LzmaUefiDecompressStreamInit (Destination, Scratch);
+  Status = LzmaUefiDecompressStreamDecode (Scratch, Source, &SourceSize, &DecodedSize);
+
+  if (Status == RETURN_SUCCESS) {
     return RETURN_SUCCESS;
   } else {
     return RETURN_INVALID_PARAMETER;
   }
 }
 
+/**
+  Prepares a scratch buffer for the incremental decompression of a Lzma
+  compressed source buffer into Destination.
+
+  The caller allocates Destination and Scratch with the sizes returned by
+  LzmaUefiDecompressGetInfo(), for which only the LZMA_HEADER_SIZE beginning
+  bytes of the source data are needed, and then passes the compressed data to
+  LzmaUefiDecompressStreamDecode() in chunks of any size.
+
+  @param  Destination The destination buffer to store the decompressed data.
+  @param  Scratch     The scratch buffer.
+**/
+VOID
+EFIAPI
+LzmaUefiDecompressStreamInit (
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  )
+{
+  LZMA_STREAM_DATA  *Stream;
+
+  ASSERT (Destination != NULL);
+  ASSERT (Scratch != NULL);
+
+  Stream = (LZMA_STREAM_DATA *) Scratch;
+  ZeroMem (Stream, sizeof (LZMA_STREAM_DATA));
+  Stream->Destination = Destination;
+}
+
+/**
+  Decompresses the next chunk of a Lzma compressed source buffer.
+
+  Consumes the chunk specified by Source and SourceSize and decompresses
+  everything that can be decompressed without more input. The decompressed data
+  is written to the Destination that was passed to LzmaUefiDecompressStreamInit(),
+  so Destination[0] up to Destination[*DestinationSize - 1] may be used by the
+  caller as soon as this function returns.
+
+  @param  Scratch         The scratch buffer prepared by LzmaUefiDecompressStreamInit().
+  @param  Source          The next chunk of the compressed data.
+  @param  SourceSize      On input, the size, in bytes, of the chunk.
+                          On output, the number of bytes of the chunk that were consumed.
+  @param  DestinationSize A pointer to the number of bytes decompressed so far.
+
+  @retval  RETURN_SUCCESS All of the data was decompressed into Destination.
+  @retval  RETURN_NOT_READY
+                          More compressed data is needed to continue.
+  @retval  RETURN_INVALID_PARAMETER
+                          The compressed data is corrupted.
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamDecode (
+  IN OUT VOID        *Scratch,
+  IN     CONST VOID  *Source,
+  IN OUT UINTN       *SourceSize,
+  OUT    UINTN       *DestinationSize
+  )
+{
+  LZMA_STREAM_DATA  *Stream;
+  CONST UINT8       *Src;
+  UINTN             Length;
+  SizeT             EncodedDataSize;
+  SRes              LzmaResult;
+  ELzmaStatus       Status;
+
+  ASSERT (Scratch != NULL);
+  ASSERT (SourceSize != NULL);
+  ASSERT (Source != NULL || *SourceSize == 0);
+  ASSERT (DestinationSize != NULL);
+
+  Stream = (LZMA_STREAM_DATA *) Scratch;
+  Src    = Source;
+  Length = 0;
+
+  if (Stream->HeaderLength < LZMA_HEADER_SIZE) {
+    //
+    // Collect the header, then size the probabilities by the lc and lp
+    // properties and start decoding into Destination
+    //
+    Length = MIN (*SourceSize, LZMA_HEADER_SIZE - Stream->HeaderLength);
+    CopyMem (Stream->Header + Stream->HeaderLength, Src, Length);
+    Stream->HeaderLength += Length;
+    Src                  += Length;
+    if (Stream->HeaderLength < LZMA_HEADER_SIZE) {
+      *DestinationSize = 0;
+      return RETURN_NOT_READY;
+    }
+
+    Stream->AllocFuncs.Functions.Alloc = SzAlloc;
+    Stream->AllocFuncs.Functions.Free  = SzFree;
+    Stream->AllocFuncs.Buffer          = Stream + 1;
+    Stream->AllocFuncs.BufferSize      = GetProbsSizeOfBuf (Stream->Header);
+    Stream->DecodedSize                = (SizeT)GetDecodedSizeOfBuf (Stream->Header);
+
+    LzmaDec_Construct (&Stream->Decoder);
+    LzmaResult = LzmaDec_AllocateProbs (
+                   &Stream->Decoder,
+                   Stream->Header,
+                   LZMA_PROPS_SIZE,
+                   &(Stream->AllocFuncs.Functions)
+                   );
+    if (LzmaResult != SZ_OK) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    Stream->Decoder.dic        = Stream->Destination;
+    Stream->Decoder.dicBufSize = Stream->DecodedSize;
+    LzmaDec_Init (&Stream->Decoder);
+  }
+
+  EncodedDataSize = (SizeT) (*SourceSize - Length);
+  LzmaResult = LzmaDec_DecodeToDic (
+                 &Stream->Decoder,
+                 Stream->DecodedSize,
+                 Src,
+                 &EncodedDataSize,
+                 LZMA_FINISH_END,
+                 &Status
+                 );
+
+  *SourceSize      = Length + EncodedDataSize;
+  *DestinationSize = Stream->Decoder.dicPos;
+
+  if (LzmaResult != SZ_OK) {
+    return RETURN_INVALID_PARAMETER;
+  }
+  if (Status == LZMA_STATUS_NEEDS_MORE_INPUT) {
+    return RETURN_NOT_READY;
+  }
+  return RETURN_SUCCESS;
+}
+
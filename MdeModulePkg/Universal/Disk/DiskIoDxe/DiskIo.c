@@ -326,6 +326,7 @@ DiskIoDriverBindingStop (
       Instance->SharedWorkingBuffer,
       EFI_SIZE_TO_PAGES (PcdGet32 (PcdDiskIoDataBufferBlockNum) * Instance->BlockIo->Media->BlockSize)
       );
+    DiskIoCacheFree (Instance);
 
     Status = gBS->CloseProtocol (
                     ControllerHandle,
@@ -847,6 +848,19 @@ DiskIo2ReadWriteDisk (
     //
     while (!DiskIo2RemoveCompletedTask (Instance));
 
+    //
+    // Small reads are served by the cache when possible.
+    //
+    if (!Write) {
+      OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+      Status = DiskIoCacheRead (Instance, Offset, BufferSize, Buffer);
+      gBS->RestoreTPL (OldTpl);
+      if (Status != EFI_UNSUPPORTED) {
+        return Status;
+      }
+      Status = EFI_SUCCESS;
+    }
+
     SubtasksPtr = &Subtasks;
   } else {
     DiskIo2RemoveCompletedTask (Instance);
@@ -867,6 +881,16 @@ DiskIo2ReadWriteDisk (
     SubtasksPtr = &Task->Subtasks;
   }
 
+  if (Write) {
+    //
+    // The cache only holds data as it is on the media. Drop what this write
+    // makes stale, whether or not the write succeeds.
+    //
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    DiskIoCacheInvalidate (Instance, Offset, BufferSize);
+    gBS->RestoreTPL (OldTpl);
+  }
+
   InitializeListHead (SubtasksPtr);
   if (!DiskIoCreateSubtaskList (Instance, Write, Offset, BufferSize, Buffer, Blocking, Instance->SharedWorkingBuffer, SubtasksPtr)) {
     if (Task != NULL) {
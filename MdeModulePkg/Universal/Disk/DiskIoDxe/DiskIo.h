@@ -30,6 +30,53 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
+//
+// Read cache. Lines of DISK_IO_CACHE_LINE_SIZE bytes (rounded down to whole
+// blocks) are kept in the order of their last use, and found by hashing the
+// line number. Sequential reads fetch up to DISK_IO_CACHE_MAX_READ_AHEAD lines
+// at once.
+//
+#define DISK_IO_CACHE_LINE_SIZE        SIZE_16KB
+#define DISK_IO_CACHE_MAX_READ_AHEAD   8
+#define DISK_IO_CACHE_HASH_SIZE        64
+
+#define DISK_IO_CACHE_LINE_SIGNATURE   SIGNATURE_32 ('d', 'i', 'c', 'l')
+typedef struct {
+  UINT32                          Signature;
+  LIST_ENTRY                      LruLink;  /// < link in the LRU list, most recently used first
+  LIST_ENTRY                      HashLink; /// < link in the hash bucket, valid lines only
+  BOOLEAN                         Valid;
+  UINT64                          Line;     /// < LBA of the first block / LineBlocks
+  UINT8                           *Data;
+} DISK_IO_CACHE_LINE;
+
+typedef struct {
+  //
+  // The media the cached data belongs to.
+  //
+  UINT32                          MediaId;
+  UINT32                          BlockSize;
+  EFI_LBA                         LastBlock;
+
+  UINT32                          LineBlocks;
+  UINTN                           LineSize;
+  UINTN                           LineCount;
+  DISK_IO_CACHE_LINE              *Lines;
+  UINT8                           *Data;
+  UINTN                           DataPages;
+  UINT8                           *ReadAheadBuffer;
+  UINTN                           ReadAheadPages;
+  LIST_ENTRY                      LruList;
+  LIST_ENTRY                      Hash[DISK_IO_CACHE_HASH_SIZE];
+
+  UINT64                          NextOffset; /// < end of the last read, to detect sequential reads
+  UINTN                           ReadAhead;  /// < number of lines to read on the next sequential miss
+
+  UINT64                          Hits;
+  UINT64                          Misses;
+  UINT64                          ReadAheadLines;
+} DISK_IO_CACHE;
+
 #define DISK_IO_PRIVATE_DATA_SIGNATURE  SIGNATURE_32 ('d', 's', 'k', 'I')
 typedef struct {
   UINT32                          Signature;
@@ -40,6 +87,7 @@ typedef struct {
   EFI_BLOCK_IO2_PROTOCOL          *BlockIo2;
 
   UINT8                           *SharedWorkingBuffer;
+  DISK_IO_CACHE                   *Cache;   /// < NULL until the first cached read
 
   EFI_LOCK                        TaskQueueLock;
   LIST_ENTRY                      TaskQueue;
@@ -340,6 +388,54 @@ DiskIo2FlushDiskEx (
   IN OUT EFI_DISK_IO2_TOKEN       *Token
   );
 
+/**
+  Read from the media through the cache.
+
+  Reads of at least one cache line, reads beyond the end of the media, and
+  reads of media that cannot be cached are not served; the caller reads those
+  from the media directly. So are reads for which the media reports an error,
+  so that the caller gets the precise error of the uncached read.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset to read from.
+  @param BufferSize  The size in bytes of Buffer.
+  @param Buffer      A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS     The data has been read through the cache.
+  @retval EFI_UNSUPPORTED The read is not served by the cache.
+**/
+EFI_STATUS
+DiskIoCacheRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  OUT UINT8                   *Buffer
+  );
+
+/**
+  Invalidate the cached lines that a write makes stale.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset of the write.
+  @param BufferSize  The size in bytes of the write.
+**/
+VOID
+DiskIoCacheInvalidate (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize
+  );
+
+/**
+  Release the cache of a DiskIo instance, if any, and report its counters.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheFree (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  );
+
 //
 // EFI Component Name Functions
 //
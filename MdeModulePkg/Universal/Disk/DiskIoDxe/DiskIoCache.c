@@ -0,0 +1,465 @@
+/** @file
+  Read cache of the DiskIo driver.
+
+  Small reads, like those of FAT directory walks and of files loaded in small
+  pieces, are served from lines of DISK_IO_CACHE_LINE_SIZE bytes that are kept
+  in the order of their last use. A miss reads a whole line from the media, or,
+  if the reads are sequential, a growing number of lines at once (read-ahead).
+  The least recently used lines are reused first.
+
+  The cache only holds data as it is on the media. Writes go to the media
+  directly and invalidate the lines they touch, so there is nothing to write
+  back. A change of MediaId, BlockSize or LastBlock of the media drops the
+  whole cache. The cache of a DiskIo instance is allocated on its first read,
+  and only if PcdDiskIoCacheSize is not zero.
+
+  Each DiskIo instance has its own cache, so the whole disk and each of its
+  partitions cache separately. A write through another DiskIo instance, or
+  straight through the BlockIo protocol, does not invalidate the lines of this
+  cache, which then return stale data. Only platforms where all the writes to a
+  media go through one DiskIo instance may enable the cache.
+
+Copyright (c) 2016, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "DiskIo.h"
+
+/**
+  Allocate and initialize the cache for the current media of a DiskIo instance.
+
+  @param Media       The media of the BlockIo protocol under the DiskIo instance.
+
+  @return A pointer to the new cache, or NULL if the media is not suitable for
+          caching or there is not enough memory.
+**/
+DISK_IO_CACHE *
+DiskIoCacheCreate (
+  IN EFI_BLOCK_IO_MEDIA       *Media
+  )
+{
+  DISK_IO_CACHE               *Cache;
+  DISK_IO_CACHE_LINE          *CacheLine;
+  UINT32                      IoAlign;
+  UINT32                      LineBlocks;
+  UINTN                       LineCount;
+  UINTN                       Index;
+
+  IoAlign = Media->IoAlign;
+  if (IoAlign == 0) {
+    IoAlign = 1;
+  }
+
+  LineBlocks = MAX (1, DISK_IO_CACHE_LINE_SIZE / Media->BlockSize);
+  if ((LineBlocks * Media->BlockSize) % IoAlign != 0) {
+    //
+    // Every line must satisfy the alignment requirement of the media.
+    //
+    return NULL;
+  }
+  LineCount = MAX (1, PcdGet32 (PcdDiskIoCacheSize) / (LineBlocks * Media->BlockSize));
+
+  Cache = AllocateZeroPool (sizeof (DISK_IO_CACHE) + LineCount * sizeof (DISK_IO_CACHE_LINE));
+  if (Cache == NULL) {
+    return NULL;
+  }
+
+  Cache->MediaId        = Media->MediaId;
+  Cache->BlockSize      = Media->BlockSize;
+  Cache->LastBlock      = Media->LastBlock;
+  Cache->LineBlocks     = LineBlocks;
+  Cache->LineSize       = LineBlocks * Media->BlockSize;
+  Cache->LineCount      = LineCount;
+  Cache->Lines          = (DISK_IO_CACHE_LINE *) (Cache + 1);
+  Cache->DataPages      = EFI_SIZE_TO_PAGES (LineCount * Cache->LineSize);
+  Cache->ReadAheadPages = EFI_SIZE_TO_PAGES (DISK_IO_CACHE_MAX_READ_AHEAD * Cache->LineSize);
+  Cache->ReadAhead      = 1;
+
+  Cache->Data = AllocateAlignedPages (Cache->DataPages, IoAlign);
+  if (Cache->Data == NULL) {
+    FreePool (Cache);
+    return NULL;
+  }
+  Cache->ReadAheadBuffer = AllocateAlignedPages (Cache->ReadAheadPages, IoAlign);
+  if (Cache->ReadAheadBuffer == NULL) {
+    FreeAlignedPages (Cache->Data, Cache->DataPages);
+    FreePool (Cache);
+    return NULL;
+  }
+
+  InitializeListHead (&Cache->LruList);
+  for (Index = 0; Index < DISK_IO_CACHE_HASH_SIZE; Index++) {
+    InitializeListHead (&Cache->Hash[Index]);
+  }
+  for (Index = 0; Index < LineCount; Index++) {
+    CacheLine            = &Cache->Lines[Index];
+    CacheLine->Signature = DISK_IO_CACHE_LINE_SIGNATURE;
+    CacheLine->Data      = Cache->Data + Index * Cache->LineSize;
+    InitializeListHead (&CacheLine->HashLink);
+    InsertTailList (&Cache->LruList, &CacheLine->LruLink);
+  }
+
+  DEBUG ((EFI_D_BLKIO, "DiskIo: Cache of %d lines of %d bytes created\n", (UINT32) LineCount, (UINT32) Cache->LineSize));
+  return Cache;
+}
+
+/**
+  Release the cache of a DiskIo instance, if any, and report its counters.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheFree (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  )
+{
+  DISK_IO_CACHE               *Cache;
+
+  Cache = Instance->Cache;
+  if (Cache == NULL) {
+    return;
+  }
+
+  DEBUG ((
+    EFI_D_INFO,
+    "DiskIo: Cache hits/misses/read-ahead lines = %ld/%ld/%ld\n",
+    Cache->Hits, Cache->Misses, Cache->ReadAheadLines
+    ));
+
+  FreeAlignedPages (Cache->ReadAheadBuffer, Cache->ReadAheadPages);
+  FreeAlignedPages (Cache->Data, Cache->DataPages);
+  FreePool (Cache);
+  Instance->Cache = NULL;
+}
+
+/**
+  Find the cache line holding a given line of the media.
+
+  @param Cache       Pointer to the DISK_IO_CACHE.
+  @param Line        The line number, that is the LBA of the first block of the
+                     line divided by Cache->LineBlocks.
+
+  @return A pointer to the cache line, or NULL if the line is not cached.
+**/
+DISK_IO_CACHE_LINE *
+DiskIoCacheLookup (
+  IN DISK_IO_CACHE            *Cache,
+  IN UINT64                   Line
+  )
+{
+  LIST_ENTRY                  *Bucket;
+  LIST_ENTRY                  *Link;
+  DISK_IO_CACHE_LINE          *CacheLine;
+
+  Bucket = &Cache->Hash[(UINTN) Line & (DISK_IO_CACHE_HASH_SIZE - 1)];
+  for (Link = GetFirstNode (Bucket); !IsNull (Bucket, Link); Link = GetNextNode (Bucket, Link)) {
+    CacheLine = CR (Link, DISK_IO_CACHE_LINE, HashLink, DISK_IO_CACHE_LINE_SIGNATURE);
+    if (CacheLine->Line == Line) {
+      return CacheLine;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Invalidate a cache line, and make it the first one to be reused.
+
+  @param Cache       Pointer to the DISK_IO_CACHE.
+  @param CacheLine   The cache line.
+**/
+VOID
+DiskIoCacheDropLine (
+  IN DISK_IO_CACHE            *Cache,
+  IN DISK_IO_CACHE_LINE       *CacheLine
+  )
+{
+  if (CacheLine->Valid) {
+    RemoveEntryList (&CacheLine->HashLink);
+    InitializeListHead (&CacheLine->HashLink);
+    CacheLine->Valid = FALSE;
+  }
+  RemoveEntryList (&CacheLine->LruLink);
+  InsertTailList (&Cache->LruList, &CacheLine->LruLink);
+}
+
+/**
+  Take the least recently used cache line for new data.
+
+  The line is invalid on return, and it becomes the most recently used one once
+  DiskIoCacheInsertLine() is called for it.
+
+  @param Cache       Pointer to the DISK_IO_CACHE.
+
+  @return A pointer to the cache line.
+**/
+DISK_IO_CACHE_LINE *
+DiskIoCacheEvictLine (
+  IN DISK_IO_CACHE            *Cache
+  )
+{
+  DISK_IO_CACHE_LINE          *CacheLine;
+
+  CacheLine = CR (
+                GetPreviousNode (&Cache->LruList, &Cache->LruList),
+                DISK_IO_CACHE_LINE,
+                LruLink,
+                DISK_IO_CACHE_LINE_SIGNATURE
+                );
+  DiskIoCacheDropLine (Cache, CacheLine);
+  return CacheLine;
+}
+
+/**
+  Mark a cache line as holding a given line of the media, and make it the most
+  recently used one.
+
+  @param Cache       Pointer to the DISK_IO_CACHE.
+  @param CacheLine   The cache line, taken by DiskIoCacheEvictLine().
+  @param Line        The line number of the data in the cache line.
+**/
+VOID
+DiskIoCacheInsertLine (
+  IN DISK_IO_CACHE            *Cache,
+  IN DISK_IO_CACHE_LINE       *CacheLine,
+  IN UINT64                   Line
+  )
+{
+  ASSERT (!CacheLine->Valid);
+
+  CacheLine->Line  = Line;
+  CacheLine->Valid = TRUE;
+  InsertHeadList (&Cache->Hash[(UINTN) Line & (DISK_IO_CACHE_HASH_SIZE - 1)], &CacheLine->HashLink);
+  RemoveEntryList (&CacheLine->LruLink);
+  InsertHeadList (&Cache->LruList, &CacheLine->LruLink);
+}
+
+/**
+  Read a line that is not cached from the media, together with up to Count - 1
+  following lines that are not cached either.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Cache       Pointer to the DISK_IO_CACHE.
+  @param Line        The line number of the missing line.
+  @param Count       The number of lines to read, including the read-ahead.
+
+  @retval EFI_SUCCESS The lines have been read and cached.
+  @retval others      The BlockIo read failed; nothing has been cached.
+**/
+EFI_STATUS
+DiskIoCacheFill (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN DISK_IO_CACHE            *Cache,
+  IN UINT64                   Line,
+  IN UINTN                    Count
+  )
+{
+  EFI_STATUS                  Status;
+  DISK_IO_CACHE_LINE          *CacheLine;
+  EFI_LBA                     Lba;
+  UINT64                      Blocks;
+  UINTN                       Size;
+  UINTN                       Index;
+
+  Lba = MultU64x32 (Line, Cache->LineBlocks);
+
+  //
+  // Stop the read-ahead at the first line that is cached already, at the end
+  // of the media, and at half of the cache, so that it doesn't push out all
+  // the other lines.
+  //
+  Count = MIN (Count, MAX (1, Cache->LineCount / 2));
+  for (Index = 1; Index < Count; Index++) {
+    if ((Lba + MultU64x32 (Index, Cache->LineBlocks) > Cache->LastBlock) ||
+        (DiskIoCacheLookup (Cache, Line + Index) != NULL)) {
+      break;
+    }
+  }
+  Count  = Index;
+  Blocks = MIN (MultU64x32 (Count, Cache->LineBlocks), Cache->LastBlock + 1 - Lba);
+  Size   = (UINTN) Blocks * Cache->BlockSize;
+
+  if (Count == 1) {
+    CacheLine = DiskIoCacheEvictLine (Cache);
+    Status = Instance->BlockIo->ReadBlocks (Instance->BlockIo, Cache->MediaId, Lba, Size, CacheLine->Data);
+    if (!EFI_ERROR (Status)) {
+      DiskIoCacheInsertLine (Cache, CacheLine, Line);
+    }
+    return Status;
+  }
+
+  Status = Instance->BlockIo->ReadBlocks (Instance->BlockIo, Cache->MediaId, Lba, Size, Cache->ReadAheadBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    CacheLine = DiskIoCacheEvictLine (Cache);
+    CopyMem (
+      CacheLine->Data,
+      Cache->ReadAheadBuffer + Index * Cache->LineSize,
+      MIN (Cache->LineSize, Size - Index * Cache->LineSize)
+      );
+    DiskIoCacheInsertLine (Cache, CacheLine, Line + Index);
+  }
+  Cache->ReadAheadLines += Count - 1;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Read from the media through the cache.
+
+  Reads of at least one cache line, reads beyond the end of the media, and
+  reads of media that cannot be cached are not served; the caller reads those
+  from the media directly. So are reads for which the media reports an error,
+  so that the caller gets the precise error of the uncached read.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset to read from.
+  @param BufferSize  The size in bytes of Buffer.
+  @param Buffer      A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS     The data has been read through the cache.
+  @retval EFI_UNSUPPORTED The read is not served by the cache.
+**/
+EFI_STATUS
+DiskIoCacheRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  OUT UINT8                   *Buffer
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_BLOCK_IO_MEDIA          *Media;
+  DISK_IO_CACHE               *Cache;
+  DISK_IO_CACHE_LINE          *CacheLine;
+  BOOLEAN                     Sequential;
+  UINT64                      MediaSize;
+  UINT64                      Line;
+  UINT32                      LineOffset;
+  UINTN                       Length;
+
+  if ((PcdGet32 (PcdDiskIoCacheSize) == 0) || (BufferSize == 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Media = Instance->BlockIo->Media;
+  Cache = Instance->Cache;
+  if ((Cache != NULL) &&
+      (!Media->MediaPresent ||
+       (Cache->MediaId   != Media->MediaId) ||
+       (Cache->BlockSize != Media->BlockSize) ||
+       (Cache->LastBlock != Media->LastBlock))) {
+    //
+    // The media has changed, nothing in the cache belongs to it.
+    //
+    DiskIoCacheFree (Instance);
+    Cache = NULL;
+  }
+  if (!Media->MediaPresent) {
+    return EFI_UNSUPPORTED;
+  }
+  if (Cache == NULL) {
+    Cache = DiskIoCacheCreate (Media);
+    if (Cache == NULL) {
+      return EFI_UNSUPPORTED;
+    }
+    Instance->Cache = Cache;
+  }
+
+  MediaSize = MultU64x32 (Cache->LastBlock + 1, Cache->BlockSize);
+  if ((BufferSize >= Cache->LineSize) || (Offset > MediaSize) || (BufferSize > MediaSize - Offset)) {
+    Cache->NextOffset = Offset + BufferSize;
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Grow the read-ahead while the reads are sequential.
+  //
+  Sequential        = (BOOLEAN) (Offset == Cache->NextOffset);
+  Cache->NextOffset = Offset + BufferSize;
+  if (!Sequential) {
+    Cache->ReadAhead = 1;
+  }
+
+  while (BufferSize > 0) {
+    Line      = DivU64x32Remainder (Offset, (UINT32) Cache->LineSize, &LineOffset);
+    CacheLine = DiskIoCacheLookup (Cache, Line);
+    if (CacheLine == NULL) {
+      Cache->Misses++;
+      Status = DiskIoCacheFill (Instance, Cache, Line, Sequential ? Cache->ReadAhead : 1);
+      if (EFI_ERROR (Status)) {
+        return EFI_UNSUPPORTED;
+      }
+      if (Sequential && (Cache->ReadAhead < DISK_IO_CACHE_MAX_READ_AHEAD)) {
+        Cache->ReadAhead *= 2;
+      }
+      CacheLine = DiskIoCacheLookup (Cache, Line);
+      ASSERT (CacheLine != NULL);
+    } else {
+      Cache->Hits++;
+      RemoveEntryList (&CacheLine->LruLink);
+      InsertHeadList (&Cache->LruList, &CacheLine->LruLink);
+    }
+
+    Length = MIN (BufferSize, Cache->LineSize - LineOffset);
+    CopyMem (Buffer, CacheLine->Data + LineOffset, Length);
+    Buffer     += Length;
+    Offset     += Length;
+    BufferSize -= Length;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Invalidate the cached lines that a write makes stale.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset of the write.
+  @param BufferSize  The size in bytes of the write.
+**/
+VOID
+DiskIoCacheInvalidate (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize
+  )
+{
+  DISK_IO_CACHE               *Cache;
+  DISK_IO_CACHE_LINE          *CacheLine;
+  UINT64                      Line;
+  UINT64                      LastLine;
+  UINTN                       Index;
+
+  Cache = Instance->Cache;
+  if ((Cache == NULL) || (BufferSize == 0)) {
+    return;
+  }
+
+  Line     = DivU64x32 (Offset, (UINT32) Cache->LineSize);
+  LastLine = DivU64x32 (Offset + BufferSize - 1, (UINT32) Cache->LineSize);
+  if (LastLine - Line >= Cache->LineCount) {
+    for (Index = 0; Index < Cache->LineCount; Index++) {
+      if (Cache->Lines[Index].Valid) {
+        DiskIoCacheDropLine (Cache, &Cache->Lines[Index]);
+      }
+    }
+    return;
+  }
+
+  for (; Line <= LastLine; Line++) {
+    CacheLine = DiskIoCacheLookup (Cache, Line);
+    if (CacheLine != NULL) {
+      DiskIoCacheDropLine (Cache, CacheLine);
+    }
+  }
+}
@@ -105,4 +105,93 @@ UefiDecompress (
   IN OUT VOID    *Scratch  OPTIONAL
   );
 
+/**
+  Given the beginning of a compressed source buffer, this function retrieves the
+  size of the uncompressed buffer and the size of the scratch buffer required
+  to decompress it incrementally with UefiDecompressStreamDecode().
+
+  Only the 8-byte header of the compressed data needs to be available, so the
+  rest of the compressed data may still be on its way from the storage device.
+
+  If Source is NULL, then ASSERT().
+  If DestinationSize is NULL, then ASSERT().
+  If ScratchSize is NULL, then ASSERT().
+
+  @param  Source          The source buffer containing the beginning of the compressed data.
+  @param  SourceSize      The size, in bytes, of the source buffer.
+  @param  DestinationSize A pointer to the size, in bytes, of the uncompressed buffer.
+  @param  ScratchSize     A pointer to the size, in bytes, of the scratch buffer that
+                          is required by UefiDecompressStreamDecode().
+
+  @retval  RETURN_SUCCESS The sizes were returned in DestinationSize and ScratchSize.
+  @retval  RETURN_INVALID_PARAMETER
+                          SourceSize is smaller than the header of the compressed data.
+**/
+RETURN_STATUS
+EFIAPI
+UefiDecompressStreamGetInfo (
+  IN  CONST VOID  *Source,
+  IN  UINT32      SourceSize,
+  OUT UINT32      *DestinationSize,
+  OUT UINT32      *ScratchSize
+  );
+
+/**
+  Prepares a scratch buffer for the incremental decompression of a compressed
+  source buffer into Destination.
+
+  The caller allocates Destination with the size returned by
+  UefiDecompressStreamGetInfo(), and then passes the compressed data to
+  UefiDecompressStreamDecode() in chunks of any size as it becomes available.
+
+  If Destination is NULL, then ASSERT().
+  If Scratch is NULL, then ASSERT().
+
+  @param  Destination The destination buffer to store the decompressed data.
+  @param  Scratch     The scratch buffer of the size returned by UefiDecompressStreamGetInfo().
+**/
+VOID
+EFIAPI
+UefiDecompressStreamInit (
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
+/**
+  Decompresses the next chunk of a compressed source buffer.
+
+  Consumes as much of the chunk specified by Source and SourceSize as the
+  decompressor can hold, and decompresses everything that can be decompressed
+  without more input. The decompressed data is written to the Destination
+  that was passed to UefiDecompressStreamInit(), so Destination[0] up to
+  Destination[*DestinationSize - 1] may be used by the caller as soon as this
+  function returns. If not all of the chunk was consumed, the caller passes the
+  rest of it again in the next call.
+
+  If Scratch is NULL, then ASSERT().
+  If SourceSize is NULL, then ASSERT().
+  If Source is NULL and *SourceSize is not 0, then ASSERT().
+  If DestinationSize is NULL, then ASSERT().
+
+  @param  Scratch         The scratch buffer prepared by UefiDecompressStreamInit().
+  @param  Source          The next chunk of the compressed data.
+  @param  SourceSize      On input, the size, in bytes, of the chunk.
+                          On output, the number of bytes of the chunk that were consumed.
+  @param  DestinationSize A pointer to the number of bytes decompressed so far.
+
+  @retval  RETURN_SUCCESS All of the data was decompressed into Destination.
+  @retval  RETURN_NOT_READY
+                          More compressed data is needed to continue.
+  @retval  RETURN_INVALID_PARAMETER
+                          The compressed data is corrupted.
+**/
+RETURN_STATUS
+EFIAPI
+UefiDecompressStreamDecode (
+  IN OUT VOID        *Scratch,
+  IN     CONST VOID  *Source,
+  IN OUT UINT32      *SourceSize,
+  OUT    UINT32      *DestinationSize
+  );
+
 #endif
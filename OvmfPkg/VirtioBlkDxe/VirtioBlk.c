@@ -6,9 +6,16 @@
 
   - No attach/detach (ie. removable media).
 
-  - Although the non-blocking interfaces of EFI_BLOCK_IO2_PROTOCOL could be a
-    good match for multiple in-flight virtio-blk requests, we stick to
-    synchronous requests and EFI_BLOCK_IO_PROTOCOL for now.
+  - Transfers are split into virtio-blk requests of at most
+    VBLK_MAX_REQUEST_SIZE bytes, which are all put in flight at once, up to the
+    capacity of the ring. With indirect descriptors (if the host offers them),
+    each request takes a single descriptor in the ring.
+
+  - The non-blocking interfaces of EFI_BLOCK_IO2_PROTOCOL queue the requests
+    and return; a periodic timer reaps the completed requests from the used
+    ring and signals the tokens. The blocking interfaces use the same queue
+    and poll the used ring until their requests complete. We never ask for
+    interrupts.
 
   Copyright (C) 2012, Red Hat, Inc.
   Copyright (c) 2012 - 2014, Intel Corporation. All rights reserved.<BR>
@@ -24,6 +31,7 @@
 **/
 
 #include <IndustryStandard/VirtioBlk.h>
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
@@ -77,25 +85,6 @@
                                                 ))
 
 
-//
-// UEFI Spec 2.3.1 + Errata C, 12.8 EFI Block I/O Protocol
-// Driver Writer's Guide for UEFI 2.3.1 v1.01,
-//   24.2 Block I/O Protocol Implementations
-//
-EFI_STATUS
-EFIAPI
-VirtioBlkReset (
-  IN EFI_BLOCK_IO_PROTOCOL *This,
-  IN BOOLEAN               ExtendedVerification
-  )
-{
-  //
-  // If we managed to initialize and install the driver, then the device is
-  // working correctly.
-  //
-  return EFI_SUCCESS;
-}
-
 /**
 
   Verify correctness of the read/write (not flush) request submitted to the
@@ -112,9 +101,10 @@ VirtioBlkReset (
     - 24.2.2. ReadBlocks() and ReadBlocksEx() Implementation
     - 24.2.3 WriteBlocks() and WriteBlockEx() Implementation
 
-  Request sizes are limited to 1 GB (checked). This is not a practical
-  limitation, just conformance to virtio-0.9.5, 2.3.2 Descriptor Table: "no
-  descriptor chain may be more than 2^32 bytes long in total".
+  Request sizes are not limited here. QueueRequests() splits the transfer into
+  virtio-blk requests of at most VBLK_DEV.RequestSize bytes, which conforms to
+  virtio-0.9.5, 2.3.2 Descriptor Table: "no descriptor chain may be more than
+  2^32 bytes long in total".
 
   Some Media characteristics are hardcoded in VirtioBlkInit() below (like
   non-removable media, no restriction on buffer alignment etc); we rely on
@@ -158,8 +148,7 @@ VerifyReadWriteRequest (
 
   ASSERT (PositiveBufferSize > 0);
 
-  if (PositiveBufferSize > SIZE_1GB ||
-      PositiveBufferSize % Media->BlockSize > 0) {
+  if (PositiveBufferSize % Media->BlockSize > 0) {
     return EFI_BAD_BUFFER_SIZE;
   }
   BlockCount = PositiveBufferSize / Media->BlockSize;
@@ -183,12 +172,247 @@ VerifyReadWriteRequest (
 
 /**
 
-  Format a read / write / flush request as three consecutive virtio
-  descriptors, push them to the host, and poll for the response.
+  Fill in the descriptor that has the given position in the descriptor chain
+  of a virtio-blk request.
+
+  The chain consists of the request header, the data segments (none for a
+  flush request) and the host status, in this order. Each data segment
+  covers at most VBLK_DEV.SegmentSize bytes of the buffer.
+
+  @param[in] Dev    The virtio-blk device the request is targeted at.
+
+  @param[in] Req    The request.
+
+  @param[in] Index  Position of the descriptor in the chain of Req.
+
+  @param[out] Desc  The descriptor to fill in. Desc->Next is left intact.
+
+**/
+STATIC
+VOID
+SetRequestDesc (
+  IN  VBLK_DEV            *Dev,
+  IN  VBLK_REQ            *Req,
+  IN  UINT16              Index,
+  OUT volatile VRING_DESC *Desc
+  )
+{
+  UINTN  Offset;
+  UINT16 Flags;
+
+  Flags = (Index + 1 < Req->NumDesc) ? VRING_DESC_F_NEXT : 0;
+
+  if (Index == 0) {
+    Desc->Addr = (UINTN) &Req->Header;
+    Desc->Len  = sizeof Req->Header;
+  } else if (Index + 1 == Req->NumDesc) {
+    Desc->Addr = (UINTN) &Req->HostStatus;
+    Desc->Len  = sizeof Req->HostStatus;
+    Flags     |= VRING_DESC_F_WRITE;
+  } else {
+    Offset     = (UINTN) (Index - 1) * Dev->SegmentSize;
+    Desc->Addr = (UINTN) (Req->Buffer + Offset);
+    Desc->Len  = (UINT32) MIN (Req->BufferSize - Offset, Dev->SegmentSize);
+
+    //
+    // VRING_DESC_F_WRITE is interpreted from the host's point of view.
+    //
+    if (!Req->RequestIsWrite) {
+      Flags |= VRING_DESC_F_WRITE;
+    }
+  }
+  Desc->Flags = Flags;
+}
+
+
+/**
+
+  Move queued requests to the ring while there are enough free descriptors
+  for them, and notify the host.
+
+  Free descriptors are linked through their Next fields, starting at
+  VBLK_DEV.FreeDescHead. A request taken from the head of that list therefore
+  gets a descriptor chain that is linked already; only the Next field of its
+  last descriptor is stale, which the host ignores because VRING_DESC_F_NEXT is
+  clear there.
+
+  The function must be called at TPL_NOTIFY.
+
+  @param[in out] Dev  The virtio-blk device whose queued requests to submit.
+
+**/
+STATIC
+VOID
+SubmitRequests (
+  IN OUT VBLK_DEV *Dev
+  )
+{
+  VRING      *Ring;
+  VBLK_REQ   *Req;
+  UINT16     RingDescs;
+  UINT16     Head;
+  UINT16     DescIdx;
+  UINT16     Index;
+  UINT16     AvailIdx;
+  EFI_STATUS Status;
+
+  Ring     = &Dev->Ring;
+  AvailIdx = *Ring->Avail.Idx;
+
+  while (!IsListEmpty (&Dev->PendingRequests)) {
+    Req = VBLK_REQ_FROM_LINK (GetFirstNode (&Dev->PendingRequests));
+    RingDescs = (Req->Indirect != NULL) ? 1 : Req->NumDesc;
+    if (RingDescs > Dev->NumFreeDesc) {
+      break;
+    }
+    RemoveEntryList (&Req->Link);
+
+    Head    = Dev->FreeDescHead;
+    DescIdx = Head;
+    if (Req->Indirect != NULL) {
+      //
+      // virtio-0.9.5, 2.4.3 Indirect Descriptors
+      //
+      for (Index = 0; Index < Req->NumDesc; Index++) {
+        SetRequestDesc (Dev, Req, Index, &Req->Indirect[Index]);
+        Req->Indirect[Index].Next = (UINT16) (Index + 1);
+      }
+      Ring->Desc[Head].Addr  = (UINTN) Req->Indirect;
+      Ring->Desc[Head].Len   = (UINT32) (Req->NumDesc * sizeof (VRING_DESC));
+      Ring->Desc[Head].Flags = VRING_DESC_F_INDIRECT;
+    } else {
+      for (Index = 0; Index < Req->NumDesc; Index++) {
+        if (Index > 0) {
+          DescIdx = Ring->Desc[DescIdx].Next;
+        }
+        SetRequestDesc (Dev, Req, Index, &Ring->Desc[DescIdx]);
+      }
+    }
+    Dev->FreeDescHead   = Ring->Desc[DescIdx].Next;
+    Dev->NumFreeDesc   -= RingDescs;
+    Dev->InFlight[Head] = Req;
+
+    //
+    // virtio-0.9.5, 2.4.1.2 Updating the Available Ring
+    //
+    Ring->Avail.Ring[AvailIdx++ % Ring->QueueSize] = Head;
+  }
+
+  if (AvailIdx == *Ring->Avail.Idx) {
+    return;
+  }
+
+  //
+  // virtio-0.9.5, 2.4.1.3 Updating the Index Field
+  //
+  MemoryFence ();
+  *Ring->Avail.Idx = AvailIdx;
+
+  //
+  // virtio-0.9.5, 2.4.1.4 Notifying the Device -- one notification covers
+  // every request made available above. virtio-blk's only virtqueue is #0,
+  // called "requestq" (see Appendix D).
+  //
+  MemoryFence ();
+  Status = Dev->VirtIo->SetQueueNotify (Dev->VirtIo, 0);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: SetQueueNotify(): %r\n", __FUNCTION__, Status));
+  }
+}
+
+
+/**
+
+  Reap the requests that the host has completed from the used ring, report
+  the results of the tasks they belong to, and submit queued requests to the
+  descriptors that have been freed up.
+
+  The function is the notification function of VBLK_DEV.PollTimer, and it is
+  also called directly by the functions that wait for requests. It must be
+  called at TPL_NOTIFY.
+
+  @param[in] Event    The timer event, or NULL.
+
+  @param[in] Context  The VBLK_DEV to poll.
+
+**/
+
+VOID
+EFIAPI
+VirtioBlkPoll (
+  IN EFI_EVENT Event,
+  IN VOID      *Context
+  )
+{
+  VBLK_DEV  *Dev;
+  VRING     *Ring;
+  UINT16    UsedIdx;
+  UINT16    Head;
+  UINT16    Last;
+  UINT16    RingDescs;
+  UINT16    Index;
+  VBLK_REQ  *Req;
+  VBLK_TASK *Task;
+
+  Dev  = Context;
+  Ring = &Dev->Ring;
+
+  //
+  // virtio-0.9.5, 2.4.2 Receiving Used Buffers From the Device
+  //
+  MemoryFence ();
+  UsedIdx = *Ring->Used.Idx;
+  MemoryFence ();
+
+  while (Dev->LastUsedIdx != UsedIdx) {
+    Head = (UINT16) Ring->Used.UsedElem[Dev->LastUsedIdx % Ring->QueueSize].Id;
+    Dev->LastUsedIdx++;
+
+    ASSERT (Head < Ring->QueueSize);
+    Req = Dev->InFlight[Head];
+    ASSERT (Req != NULL);
+    Dev->InFlight[Head] = NULL;
+
+    //
+    // Return the descriptor chain of the request to the free list.
+    //
+    RingDescs = (Req->Indirect != NULL) ? 1 : Req->NumDesc;
+    Last = Head;
+    for (Index = 1; Index < RingDescs; Index++) {
+      Last = Ring->Desc[Last].Next;
+    }
+    Ring->Desc[Last].Next = Dev->FreeDescHead;
+    Dev->FreeDescHead     = Head;
+    Dev->NumFreeDesc     += RingDescs;
+
+    Task = Req->Task;
+    if (Req->HostStatus != VIRTIO_BLK_S_OK) {
+      Task->Status = EFI_DEVICE_ERROR;
+    }
+    FreePool (Req);
+
+    //
+    // Blocking callers own their task, and watch Task->Outstanding.
+    //
+    Task->Outstanding--;
+    if (Task->Outstanding == 0 && Task->Token != NULL) {
+      Task->Token->TransactionStatus = Task->Status;
+      gBS->SignalEvent (Task->Token->Event);
+      FreePool (Task);
+    }
+  }
+
+  SubmitRequests (Dev);
+}
+
+
+/**
+
+  Split a read / write / flush into virtio-blk requests, and queue them for
+  the host.
 
-  This is the main workhorse function. Two use cases are supported, read/write
-  and flush. The function may only be called after the request parameters have
-  been verified by
+  Two use cases are supported, read/write and flush. The function may only be
+  called after the request parameters have been verified by
   - specific checks in ReadBlocks() / WriteBlocks() / FlushBlocks(), and
   - VerifyReadWriteRequest() (for read/write only).
 
@@ -197,13 +421,20 @@ VerifyReadWriteRequest (
     @param[in] Dev             The virtio-blk device the request is targeted
                                at.
 
+    @param[in out] Task        The task that the requests belong to.
+                               Task->Token must be set by the caller; the rest
+                               of Task is initialized here. When the last
+                               request completes, VirtioBlkPoll() sets
+                               Task->Outstanding to zero, and, if Task->Token
+                               is not NULL, signals the token and frees Task.
+
   Flush request:
 
     @param[in] Lba             Must be zero.
 
     @param[in] BufferSize      Must be zero.
 
-    @param[in out] Buffer      Ignored by the function.
+    @param[in] Buffer          Ignored by the function.
 
     @param[in] RequestIsWrite  Must be TRUE.
 
@@ -216,40 +447,39 @@ VerifyReadWriteRequest (
                                is responsible to ensure this parameter is
                                positive.
 
-    @param[in out] Buffer      The guest side area to read data from the device
+    @param[in] Buffer          The guest side area to read data from the device
                                into, or write data to the device from.
 
     @param[in] RequestIsWrite  TRUE iff data transfer goes from guest to
                                device.
 
-  Return values are common to both use cases, and are appropriate to be
-  forwarded by the EFI_BLOCK_IO_PROTOCOL functions (ReadBlocks(),
-  WriteBlocks(), FlushBlocks()).
-
 
-  @retval EFI_SUCCESS          Transfer complete.
+  @retval EFI_SUCCESS           The requests have been queued.
 
-  @retval EFI_DEVICE_ERROR     Failed to notify host side via VirtIo write, or
-                               unable to parse host response, or host response
-                               is not VIRTIO_BLK_S_OK.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed. Nothing has been
+                                queued.
 
 **/
 
 STATIC
 EFI_STATUS
-EFIAPI
-SynchronousRequest (
-  IN              VBLK_DEV *Dev,
-  IN              EFI_LBA  Lba,
-  IN              UINTN    BufferSize,
-  IN OUT volatile VOID     *Buffer,
-  IN              BOOLEAN  RequestIsWrite
+QueueRequests (
+  IN OUT VBLK_DEV  *Dev,
+  IN OUT VBLK_TASK *Task,
+  IN     EFI_LBA   Lba,
+  IN     UINTN     BufferSize,
+  IN     VOID      *Buffer,
+  IN     BOOLEAN   RequestIsWrite
   )
 {
-  UINT32                  BlockSize;
-  volatile VIRTIO_BLK_REQ Request;
-  volatile UINT8          HostStatus;
-  DESC_INDICES            Indices;
+  UINT32     BlockSize;
+  LIST_ENTRY Requests;
+  LIST_ENTRY *Link;
+  VBLK_REQ   *Req;
+  UINTN      Offset;
+  UINTN      Size;
+  UINT16     NumDesc;
+  EFI_TPL    OldTpl;
 
   BlockSize = Dev->BlockIoMedia.BlockSize;
 
@@ -258,78 +488,194 @@ SynchronousRequest (
   //
   ASSERT (BlockSize > 0);
   ASSERT (BlockSize % 512 == 0);
+  ASSERT (Dev->RequestSize % BlockSize == 0);
 
   //
   // ensured by contract above, plus VerifyReadWriteRequest()
   //
   ASSERT (BufferSize % BlockSize == 0);
 
-  //
-  // Prepare virtio-blk request header, setting zero size for flush.
-  // IO Priority is homogeneously 0.
-  //
-  Request.Type   = RequestIsWrite ?
-                   (BufferSize == 0 ? VIRTIO_BLK_T_FLUSH : VIRTIO_BLK_T_OUT) :
-                   VIRTIO_BLK_T_IN;
-  Request.IoPrio = 0;
-  Request.Sector = MultU64x32(Lba, BlockSize / 512);
-
-  VirtioPrepare (&Dev->Ring, &Indices);
-
-  //
-  // preset a host status for ourselves that we do not accept as success
-  //
-  HostStatus = VIRTIO_BLK_S_IOERR;
-
-  //
-  // ensured by VirtioBlkInit() -- this predicate, in combination with the
-  // lock-step progress, ensures we don't have to track free descriptors.
-  //
-  ASSERT (Dev->Ring.QueueSize >= 3);
-
-  //
-  // virtio-blk header in first desc
-  //
-  VirtioAppendDesc (&Dev->Ring, (UINTN) &Request, sizeof Request,
-    VRING_DESC_F_NEXT, &Indices);
+  Task->Outstanding = 0;
+  Task->Status      = EFI_SUCCESS;
+  InitializeListHead (&Requests);
+
+  Offset = 0;
+  do {
+    Size    = MIN (BufferSize - Offset, Dev->RequestSize);
+    NumDesc = (UINT16) (2 + (Size + Dev->SegmentSize - 1) / Dev->SegmentSize);
+
+    Req = AllocateZeroPool (sizeof *Req +
+            (Dev->IndirectDesc ? NumDesc * sizeof (VRING_DESC) : 0));
+    if (Req == NULL) {
+      while (!IsListEmpty (&Requests)) {
+        Link = GetFirstNode (&Requests);
+        RemoveEntryList (Link);
+        FreePool (VBLK_REQ_FROM_LINK (Link));
+      }
+      return EFI_OUT_OF_RESOURCES;
+    }
 
-  //
-  // data buffer for read/write in second desc
-  //
-  if (BufferSize > 0) {
-    //
-    // From virtio-0.9.5, 2.3.2 Descriptor Table:
-    // "no descriptor chain may be more than 2^32 bytes long in total".
     //
-    // The predicate is ensured by the call contract above (for flush), or
-    // VerifyReadWriteRequest() (for read/write). It also implies that
-    // converting BufferSize to UINT32 will not truncate it.
+    // Prepare virtio-blk request header, setting zero size for flush.
+    // IO Priority is homogeneously 0.
     //
-    ASSERT (BufferSize <= SIZE_1GB);
+    Req->Signature     = VBLK_REQ_SIG;
+    Req->Task          = Task;
+    Req->Header.Type   = RequestIsWrite ?
+                         (BufferSize == 0 ? VIRTIO_BLK_T_FLUSH :
+                          VIRTIO_BLK_T_OUT) :
+                         VIRTIO_BLK_T_IN;
+    Req->Header.IoPrio = 0;
+    Req->Header.Sector = MultU64x32 (Lba + Offset / BlockSize,
+                           BlockSize / 512);
 
     //
-    // VRING_DESC_F_WRITE is interpreted from the host's point of view.
+    // preset a host status for ourselves that we do not accept as success
     //
-    VirtioAppendDesc (&Dev->Ring, (UINTN) Buffer, (UINT32) BufferSize,
-      VRING_DESC_F_NEXT | (RequestIsWrite ? 0 : VRING_DESC_F_WRITE),
-      &Indices);
+    Req->HostStatus     = VIRTIO_BLK_S_IOERR;
+    Req->RequestIsWrite = RequestIsWrite;
+    Req->NumDesc        = NumDesc;
+    Req->Buffer         = (UINT8 *) Buffer + Offset;
+    Req->BufferSize     = Size;
+    if (Dev->IndirectDesc) {
+      Req->Indirect = (VRING_DESC *) (Req + 1);
+    }
+
+    InsertTailList (&Requests, &Req->Link);
+    Task->Outstanding++;
+    Offset += Size;
+  } while (Offset < BufferSize);
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  while (!IsListEmpty (&Requests)) {
+    Link = GetFirstNode (&Requests);
+    RemoveEntryList (Link);
+    InsertTailList (&Dev->PendingRequests, Link);
   }
 
   //
-  // host status in last (second or third) desc
+  // Reap completed requests too, so that a caller keeping the ring full does
+  // not depend on the timer for freeing up descriptors.
   //
-  VirtioAppendDesc (&Dev->Ring, (UINTN) &HostStatus, sizeof HostStatus,
-    VRING_DESC_F_WRITE, &Indices);
+  VirtioBlkPoll (NULL, Dev);
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+
+/**
+
+  Wait until the requests of a task, or all requests, have completed.
+
+  @param[in out] Dev   The virtio-blk device whose used ring to poll.
+
+  @param[in]     Task  The task to wait for. If NULL, wait until every
+                       request queued on Dev has completed.
+
+**/
+
+STATIC
+VOID
+WaitForRequests (
+  IN OUT VBLK_DEV        *Dev,
+  IN     CONST VBLK_TASK *Task OPTIONAL
+  )
+{
+  UINTN   PollPeriodUsecs;
+  EFI_TPL OldTpl;
+  BOOLEAN Done;
 
   //
-  // virtio-blk's only virtqueue is #0, called "requestq" (see Appendix D).
+  // Keep slowing down until we reach a poll period of slightly above 1 ms.
   //
-  if (VirtioFlush (Dev->VirtIo, 0, &Dev->Ring, &Indices) == EFI_SUCCESS &&
-      HostStatus == VIRTIO_BLK_S_OK) {
-    return EFI_SUCCESS;
+  PollPeriodUsecs = 1;
+  for (;;) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    VirtioBlkPoll (NULL, Dev);
+    if (Task != NULL) {
+      Done = (BOOLEAN) (Task->Outstanding == 0);
+    } else {
+      Done = (BOOLEAN) (IsListEmpty (&Dev->PendingRequests) &&
+                        Dev->NumFreeDesc == Dev->Ring.QueueSize);
+    }
+    gBS->RestoreTPL (OldTpl);
+
+    if (Done) {
+      return;
+    }
+
+    gBS->Stall (PollPeriodUsecs); // calls AcpiTimerLib::MicroSecondDelay
+
+    if (PollPeriodUsecs < 1024) {
+      PollPeriodUsecs *= 2;
+    }
+  }
+}
+
+
+/**
+
+  Queue a read / write / flush request, and poll for its completion.
+
+  This is the workhorse of the blocking functions. The parameters and the
+  preconditions are those of QueueRequests(). Return values are appropriate to
+  be forwarded by the EFI_BLOCK_IO_PROTOCOL functions (ReadBlocks(),
+  WriteBlocks(), FlushBlocks()).
+
+
+  @retval EFI_SUCCESS           Transfer complete.
+
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+
+  @retval EFI_DEVICE_ERROR      The host response to some part of the transfer
+                                is not VIRTIO_BLK_S_OK.
+
+**/
+
+STATIC
+EFI_STATUS
+EFIAPI
+SynchronousRequest (
+  IN     VBLK_DEV *Dev,
+  IN     EFI_LBA  Lba,
+  IN     UINTN    BufferSize,
+  IN OUT VOID     *Buffer,
+  IN     BOOLEAN  RequestIsWrite
+  )
+{
+  VBLK_TASK  Task;
+  EFI_STATUS Status;
+
+  Task.Token = NULL;
+  Status = QueueRequests (Dev, &Task, Lba, BufferSize, Buffer, RequestIsWrite);
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
-  return EFI_DEVICE_ERROR;
+  WaitForRequests (Dev, &Task);
+  return Task.Status;
+}
+
+
+//
+// UEFI Spec 2.3.1 + Errata C, 12.8 EFI Block I/O Protocol
+// Driver Writer's Guide for UEFI 2.3.1 v1.01,
+//   24.2 Block I/O Protocol Implementations
+//
+EFI_STATUS
+EFIAPI
+VirtioBlkReset (
+  IN EFI_BLOCK_IO_PROTOCOL *This,
+  IN BOOLEAN               ExtendedVerification
+  )
+{
+  //
+  // If we managed to initialize and install the driver, then the device is
+  // working correctly. Let the requests in flight complete though.
+  //
+  WaitForRequests (VIRTIO_BLK_FROM_BLOCK_IO (This), NULL);
+  return EFI_SUCCESS;
 }
 
 
@@ -459,6 +805,9 @@ VirtioBlkWriteBlocks (
   according to EFI_BLOCK_IO_MEDIA characteristics set in VirtioBlkInit().
   Should they do nonetheless, we do nothing, successfully.
 
+  Writes queued through EFI_BLOCK_IO2_PROTOCOL are waited for first, so that
+  the flush covers them.
+
 **/
 
 EFI_STATUS
@@ -470,6 +819,8 @@ VirtioBlkFlushBlocks (
   VBLK_DEV *Dev;
 
   Dev = VIRTIO_BLK_FROM_BLOCK_IO (This);
+  WaitForRequests (Dev, NULL);
+
   return Dev->BlockIoMedia.WriteCaching ?
            SynchronousRequest (
              Dev,
@@ -482,6 +833,220 @@ VirtioBlkFlushBlocks (
 }
 
 
+/**
+
+  Queue a read or write request of EFI_BLOCK_IO2_PROTOCOL, for completion
+  through Token.
+
+  @param[in] Dev             The virtio-blk device the request is targeted at.
+
+  @param[in] Lba             Logical Block Address: number of logical blocks
+                             to skip from the beginning of the device.
+
+  @param[in out] Token       The token to signal on completion. Token->Event
+                             is not NULL.
+
+  @param[in] BufferSize      Size of buffer to transfer, in bytes.
+
+  @param[in] Buffer          The guest side area to read data from the device
+                             into, or write data to the device from.
+
+  @param[in] RequestIsWrite  TRUE iff data transfer goes from guest to
+                             device.
+
+
+  @retval EFI_SUCCESS           The request has been queued, or BufferSize is
+                                zero and Token has been signaled.
+
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+
+  @return                       Error codes from VerifyReadWriteRequest().
+
+**/
+
+STATIC
+EFI_STATUS
+NonBlockingRequest (
+  IN     VBLK_DEV            *Dev,
+  IN     EFI_LBA             Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN *Token,
+  IN     UINTN               BufferSize,
+  IN     VOID                *Buffer,
+  IN     BOOLEAN             RequestIsWrite
+  )
+{
+  VBLK_TASK  *Task;
+  EFI_STATUS Status;
+
+  if (BufferSize == 0) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+    return EFI_SUCCESS;
+  }
+
+  Status = VerifyReadWriteRequest (
+             &Dev->BlockIoMedia,
+             Lba,
+             BufferSize,
+             RequestIsWrite
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Task = AllocatePool (sizeof *Task);
+  if (Task == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Task->Token = Token;
+
+  Status = QueueRequests (Dev, Task, Lba, BufferSize, Buffer, RequestIsWrite);
+  if (EFI_ERROR (Status)) {
+    FreePool (Task);
+  }
+  return Status;
+}
+
+
+//
+// UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol
+//
+EFI_STATUS
+EFIAPI
+VirtioBlkResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL *This,
+  IN BOOLEAN                ExtendedVerification
+  )
+{
+  VBLK_DEV *Dev;
+
+  Dev = VIRTIO_BLK_FROM_BLOCK_IO2 (This);
+  return VirtioBlkReset (&Dev->BlockIo, ExtendedVerification);
+}
+
+
+/**
+
+  ReadBlocksEx() operation for virtio-blk.
+
+  See UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+  EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx().
+
+  If Token or Token->Event is NULL, the request is blocking, like
+  ReadBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  by VirtioBlkPoll() once every part of it has completed.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  OUT    VOID                   *Buffer
+  )
+{
+  VBLK_DEV *Dev;
+
+  Dev = VIRTIO_BLK_FROM_BLOCK_IO2 (This);
+  if (Token == NULL || Token->Event == NULL) {
+    return VirtioBlkReadBlocks (&Dev->BlockIo, MediaId, Lba, BufferSize,
+             Buffer);
+  }
+
+  return NonBlockingRequest (
+           Dev,
+           Lba,
+           Token,
+           BufferSize,
+           Buffer,
+           FALSE       // RequestIsWrite
+           );
+}
+
+
+/**
+
+  WriteBlocksEx() operation for virtio-blk.
+
+  See UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+  EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx().
+
+  If Token or Token->Event is NULL, the request is blocking, like
+  WriteBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  by VirtioBlkPoll() once every part of it has completed.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  )
+{
+  VBLK_DEV *Dev;
+
+  Dev = VIRTIO_BLK_FROM_BLOCK_IO2 (This);
+  if (Token == NULL || Token->Event == NULL) {
+    return VirtioBlkWriteBlocks (&Dev->BlockIo, MediaId, Lba, BufferSize,
+             Buffer);
+  }
+
+  return NonBlockingRequest (
+           Dev,
+           Lba,
+           Token,
+           BufferSize,
+           Buffer,
+           TRUE        // RequestIsWrite
+           );
+}
+
+
+/**
+
+  FlushBlocksEx() operation for virtio-blk.
+
+  See UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+  EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx().
+
+  The flush waits for all queued requests, so that it covers them too. It
+  always completes before returning; Token->Event, if any, is signaled then.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  )
+{
+  VBLK_DEV   *Dev;
+  EFI_STATUS Status;
+
+  Dev = VIRTIO_BLK_FROM_BLOCK_IO2 (This);
+  Status = VirtioBlkFlushBlocks (&Dev->BlockIo);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Token != NULL && Token->Event != NULL) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+  }
+  return EFI_SUCCESS;
+}
+
+
 /**
 
   Device probe function for this driver.
@@ -598,11 +1163,18 @@ VirtioBlkInit (
   UINT8      PhysicalBlockExp;
   UINT8      AlignmentOffset;
   UINT32     OptIoSize;
+  UINT32     SizeMax;
+  UINT32     SegMax;
+  UINT32     MaxSegments;
+  UINT32     RequestSize;
   UINT16     QueueSize;
+  UINT16     Index;
 
   PhysicalBlockExp = 0;
   AlignmentOffset = 0;
   OptIoSize = 0;
+  SizeMax = 0;
+  SegMax = 0;
 
   //
   // Execute virtio-0.9.5, 2.2.1 Device Initialization Sequence.
@@ -691,6 +1263,20 @@ VirtioBlkInit (
     }
   }
 
+  if (Features & VIRTIO_BLK_F_SIZE_MAX) {
+    Status = VIRTIO_CFG_READ (Dev, SizeMax, &SizeMax);
+    if (EFI_ERROR (Status)) {
+      goto Failed;
+    }
+  }
+
+  if (Features & VIRTIO_BLK_F_SEG_MAX) {
+    Status = VIRTIO_CFG_READ (Dev, SegMax, &SegMax);
+    if (EFI_ERROR (Status)) {
+      goto Failed;
+    }
+  }
+
   //
   // step 4b -- allocate virtqueue
   //
@@ -702,7 +1288,34 @@ VirtioBlkInit (
   if (EFI_ERROR (Status)) {
     goto Failed;
   }
-  if (QueueSize < 3) { // SynchronousRequest() uses at most three descriptors
+  if (QueueSize < 3) { // a request without data needs two descriptors, and
+                       // one with data at least three
+    Status = EFI_UNSUPPORTED;
+    goto Failed;
+  }
+
+  //
+  // With indirect descriptors, each request takes a single descriptor in the
+  // ring, whatever the number of its data segments. Otherwise the data
+  // segments must fit in the ring next to the header and the host status.
+  // More than one data segment per request is needed only if the host limits
+  // the segment size.
+  //
+  Dev->IndirectDesc = (BOOLEAN) ((Features & VIRTIO_F_RING_INDIRECT_DESC) != 0);
+  MaxSegments = Dev->IndirectDesc ? VBLK_MAX_SEGMENTS :
+                MIN (VBLK_MAX_SEGMENTS, QueueSize - 2);
+  if (SegMax > 0 && SegMax < MaxSegments) {
+    MaxSegments = SegMax;
+  }
+  if (SizeMax > 0 && SizeMax < VBLK_MAX_REQUEST_SIZE) {
+    Dev->SegmentSize = SizeMax;
+    RequestSize      = MIN (VBLK_MAX_REQUEST_SIZE, SizeMax * MaxSegments);
+  } else {
+    Dev->SegmentSize = VBLK_MAX_REQUEST_SIZE;
+    RequestSize      = VBLK_MAX_REQUEST_SIZE;
+  }
+  Dev->RequestSize = RequestSize - RequestSize % BlockSize;
+  if (Dev->RequestSize == 0) {
     Status = EFI_UNSUPPORTED;
     goto Failed;
   }
@@ -738,22 +1351,53 @@ VirtioBlkInit (
 
   //
   // step 5 -- Report understood features. There are no virtio-blk specific
-  // features to negotiate in virtio-0.9.5, plus we do not want any of the
-  // device-independent (known or unknown) VIRTIO_F_* capabilities (see
-  // Appendix B).
+  // features to negotiate in virtio-0.9.5. Of the device-independent
+  // VIRTIO_F_* capabilities (see Appendix B), we only want indirect
+  // descriptors, if the host offers them.
   //
-  Status = Dev->VirtIo->SetGuestFeatures (Dev->VirtIo, 0);
+  Status = Dev->VirtIo->SetGuestFeatures (Dev->VirtIo,
+                          Features & VIRTIO_F_RING_INDIRECT_DESC);
   if (EFI_ERROR (Status)) {
     goto ReleaseQueue;
   }
 
+  //
+  // Link all descriptors into the free list. Completed requests are reaped by
+  // polling the used ring, hence we ask the host not to interrupt us.
+  //
+  for (Index = 0; Index < QueueSize; Index++) {
+    Dev->Ring.Desc[Index].Next = (UINT16) (Index + 1);
+  }
+  Dev->FreeDescHead = 0;
+  Dev->NumFreeDesc  = QueueSize;
+  Dev->LastUsedIdx  = 0;
+  *Dev->Ring.Avail.Flags = VRING_AVAIL_F_NO_INTERRUPT;
+  InitializeListHead (&Dev->PendingRequests);
+
+  Dev->InFlight = AllocateZeroPool (QueueSize * sizeof *Dev->InFlight);
+  if (Dev->InFlight == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto ReleaseQueue;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_NOTIFY,
+                  &VirtioBlkPoll, Dev, &Dev->PollTimer);
+  if (EFI_ERROR (Status)) {
+    goto FreeInFlight;
+  }
+
+  Status = gBS->SetTimer (Dev->PollTimer, TimerPeriodic, VBLK_POLL_PERIOD);
+  if (EFI_ERROR (Status)) {
+    goto ClosePollTimer;
+  }
+
   //
   // step 6 -- initialization complete
   //
   NextDevStat |= VSTAT_DRIVER_OK;
   Status = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
   if (EFI_ERROR (Status)) {
-    goto ReleaseQueue;
+    goto ClosePollTimer;
   }
 
   //
@@ -766,6 +1410,11 @@ VirtioBlkInit (
   Dev->BlockIo.ReadBlocks            = &VirtioBlkReadBlocks;
   Dev->BlockIo.WriteBlocks           = &VirtioBlkWriteBlocks;
   Dev->BlockIo.FlushBlocks           = &VirtioBlkFlushBlocks;
+  Dev->BlockIo2.Media                = &Dev->BlockIoMedia;
+  Dev->BlockIo2.Reset                = &VirtioBlkResetEx;
+  Dev->BlockIo2.ReadBlocksEx         = &VirtioBlkReadBlocksEx;
+  Dev->BlockIo2.WriteBlocksEx        = &VirtioBlkWriteBlocksEx;
+  Dev->BlockIo2.FlushBlocksEx        = &VirtioBlkFlushBlocksEx;
   Dev->BlockIoMedia.MediaId          = 0;
   Dev->BlockIoMedia.RemovableMedia   = FALSE;
   Dev->BlockIoMedia.MediaPresent     = TRUE;
@@ -780,6 +1429,9 @@ VirtioBlkInit (
   DEBUG ((DEBUG_INFO, "%a: LbaSize=0x%x[B] NumBlocks=0x%Lx[Lba]\n",
     __FUNCTION__, Dev->BlockIoMedia.BlockSize,
     Dev->BlockIoMedia.LastBlock + 1));
+  DEBUG ((DEBUG_INFO, "%a: QueueSize=%d IndirectDesc=%d RequestSize=0x%x[B] "
+    "SegmentSize=0x%x[B]\n", __FUNCTION__, QueueSize, Dev->IndirectDesc,
+    Dev->RequestSize, Dev->SegmentSize));
 
   if (Features & VIRTIO_BLK_F_TOPOLOGY) {
     Dev->BlockIo.Revision = EFI_BLOCK_IO_PROTOCOL_REVISION3;
@@ -796,6 +1448,12 @@ VirtioBlkInit (
   }
   return EFI_SUCCESS;
 
+ClosePollTimer:
+  gBS->CloseEvent (Dev->PollTimer);
+
+FreeInFlight:
+  FreePool (Dev->InFlight);
+
 ReleaseQueue:
   VirtioRingUninit (&Dev->Ring);
 
@@ -827,6 +1485,13 @@ VirtioBlkUninit (
   IN OUT VBLK_DEV *Dev
   )
 {
+  //
+  // Let the requests in flight complete, and signal their tokens, before the
+  // ring goes away.
+  //
+  WaitForRequests (Dev, NULL);
+  gBS->CloseEvent (Dev->PollTimer);
+
   //
   // Reset the virtual device -- see virtio-0.9.5, 2.2.2.1 Device Status. When
   // VIRTIO_CFG_WRITE() returns, the host will have learned to stay away from
@@ -835,8 +1500,10 @@ VirtioBlkUninit (
   Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
 
   VirtioRingUninit (&Dev->Ring);
+  FreePool (Dev->InFlight);
 
   SetMem (&Dev->BlockIo,      sizeof Dev->BlockIo,      0x00);
+  SetMem (&Dev->BlockIo2,     sizeof Dev->BlockIo2,     0x00);
   SetMem (&Dev->BlockIoMedia, sizeof Dev->BlockIoMedia, 0x00);
 }
 
@@ -866,7 +1533,8 @@ VirtioBlkUninit (
 
   @return                       Error codes from the OpenProtocol() boot
                                 service, the VirtIo protocol, VirtioBlkInit(),
-                                or the InstallProtocolInterface() boot service.
+                                or the InstallMultipleProtocolInterfaces() boot
+                                service.
 
 **/
 
@@ -902,12 +1570,14 @@ VirtioBlkDriverBindingStart (
   }
 
   //
-  // Setup complete, attempt to export the driver instance's BlockIo interface.
+  // Setup complete, attempt to export the driver instance's BlockIo and
+  // BlockIo2 interfaces.
   //
   Dev->Signature = VBLK_SIG;
-  Status = gBS->InstallProtocolInterface (&DeviceHandle,
-                  &gEfiBlockIoProtocolGuid, EFI_NATIVE_INTERFACE,
-                  &Dev->BlockIo);
+  Status = gBS->InstallMultipleProtocolInterfaces (&DeviceHandle,
+                  &gEfiBlockIoProtocolGuid, &Dev->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid, &Dev->BlockIo2,
+                  NULL);
   if (EFI_ERROR (Status)) {
     goto UninitDev;
   }
@@ -930,7 +1600,8 @@ FreeVirtioBlk:
 
 /**
 
-  Stop driving a virtio-blk device and remove its BlockIo interface.
+  Stop driving a virtio-blk device and remove its BlockIo and BlockIo2
+  interfaces.
 
   This function replays the success path of DriverBindingStart() in reverse.
   The host side virtio-blk device is reset, so that the OS boot loader or the
@@ -981,8 +1652,10 @@ VirtioBlkDriverBindingStop (
   //
   // Handle Stop() requests for in-use driver instances gracefully.
   //
-  Status = gBS->UninstallProtocolInterface (DeviceHandle,
-                  &gEfiBlockIoProtocolGuid, &Dev->BlockIo);
+  Status = gBS->UninstallMultipleProtocolInterfaces (DeviceHandle,
+                  &gEfiBlockIoProtocolGuid, &Dev->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid, &Dev->BlockIo2,
+                  NULL);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -19,6 +19,7 @@
 #define _VIRTIO_BLK_DXE_H_
 
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/ComponentName.h>
 #include <Protocol/DriverBinding.h>
 
@@ -27,6 +28,59 @@
 
 #define VBLK_SIG SIGNATURE_32 ('V', 'B', 'L', 'K')
 
+//
+// Largest transfer that a single virtio-blk request carries. Reads and writes
+// are split into requests of at most this size, and all of them are put on the
+// ring at once, so that the host can work on them in parallel.
+//
+#define VBLK_MAX_REQUEST_SIZE SIZE_1MB
+
+//
+// Largest number of data descriptors in a single virtio-blk request. More than
+// one is only needed if the host limits the size of a segment
+// (VIRTIO_BLK_F_SIZE_MAX).
+//
+#define VBLK_MAX_SEGMENTS     256
+
+//
+// Period of the timer that reaps completed requests from the used ring.
+//
+#define VBLK_POLL_PERIOD      EFI_TIMER_PERIOD_MILLISECONDS (1)
+
+//
+// A group of virtio-blk requests that together carry out one read, write or
+// flush of the Block I/O (2) protocol. Token is NULL for blocking requests.
+//
+typedef struct {
+  EFI_BLOCK_IO2_TOKEN *Token;
+  UINTN               Outstanding; // number of requests not completed yet
+  EFI_STATUS          Status;
+} VBLK_TASK;
+
+#define VBLK_REQ_SIG SIGNATURE_32 ('V', 'B', 'R', 'Q')
+
+//
+// A single virtio-blk request: the header, the data segments and the host
+// status, each in a separate VRING_DESC. If indirect descriptors have been
+// negotiated, the request takes a single descriptor in the ring, and the
+// descriptor table of the request follows this structure in memory.
+//
+typedef struct {
+  UINT32         Signature;
+  LIST_ENTRY     Link;        // VBLK_DEV.PendingRequests, until submitted
+  VBLK_TASK      *Task;
+  VIRTIO_BLK_REQ Header;
+  volatile UINT8 HostStatus;
+  BOOLEAN        RequestIsWrite;
+  UINT16         NumDesc;     // header + data segments + host status
+  UINT8          *Buffer;
+  UINTN          BufferSize;
+  VRING_DESC     *Indirect;   // NULL if indirect descriptors are not in use
+} VBLK_REQ;
+
+#define VBLK_REQ_FROM_LINK(LinkPointer) \
+        CR (LinkPointer, VBLK_REQ, Link, VBLK_REQ_SIG)
+
 typedef struct {
   //
   // Parts of this structure are initialized / torn down in various functions
@@ -39,12 +93,25 @@ typedef struct {
   VIRTIO_DEVICE_PROTOCOL *VirtIo;              // DriverBindingStart  0
   VRING                  Ring;                 // VirtioRingInit      2
   EFI_BLOCK_IO_PROTOCOL  BlockIo;              // VirtioBlkInit       1
+  EFI_BLOCK_IO2_PROTOCOL BlockIo2;             // VirtioBlkInit       1
   EFI_BLOCK_IO_MEDIA     BlockIoMedia;         // VirtioBlkInit       1
+  BOOLEAN                IndirectDesc;         // VirtioBlkInit       1
+  UINT32                 SegmentSize;          // VirtioBlkInit       1
+  UINT32                 RequestSize;          // VirtioBlkInit       1
+  UINT16                 FreeDescHead;         // VirtioBlkInit       1
+  UINT16                 NumFreeDesc;          // VirtioBlkInit       1
+  UINT16                 LastUsedIdx;          // VirtioBlkInit       1
+  VBLK_REQ               **InFlight;           // VirtioBlkInit       1
+  LIST_ENTRY             PendingRequests;      // VirtioBlkInit       1
+  EFI_EVENT              PollTimer;            // VirtioBlkInit       1
 } VBLK_DEV;
 
 #define VIRTIO_BLK_FROM_BLOCK_IO(BlockIoPointer) \
         CR (BlockIoPointer, VBLK_DEV, BlockIo, VBLK_SIG)
 
+#define VIRTIO_BLK_FROM_BLOCK_IO2(BlockIo2Pointer) \
+        CR (BlockIo2Pointer, VBLK_DEV, BlockIo2, VBLK_SIG)
+
 
 /**
 
@@ -116,7 +183,8 @@ VirtioBlkDriverBindingSupported (
 
   @return                       Error codes from the OpenProtocol() boot
                                 service, VirtioBlkInit(), or the
-                                InstallProtocolInterface() boot service.
+                                InstallMultipleProtocolInterfaces() boot
+                                service.
 
 **/
 
@@ -131,7 +199,8 @@ VirtioBlkDriverBindingStart (
 
 /**
 
-  Stop driving a virtio-blk device and remove its BlockIo interface.
+  Stop driving a virtio-blk device and remove its BlockIo and BlockIo2
+  interfaces.
 
   This function replays the success path of DriverBindingStart() in reverse.
   The host side virtio-blk device is reset, so that the OS boot loader or the
@@ -257,6 +326,111 @@ VirtioBlkFlushBlocks (
   );
 
 
+//
+// UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol
+//
+EFI_STATUS
+EFIAPI
+VirtioBlkResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL *This,
+  IN BOOLEAN                ExtendedVerification
+  );
+
+
+/**
+
+  ReadBlocksEx() operation for virtio-blk.
+
+  See UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+  EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx().
+
+  If Token or Token->Event is NULL, the request is blocking, like
+  ReadBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  by VirtioBlkPoll() once every part of it has completed.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  OUT    VOID                   *Buffer
+  );
+
+
+/**
+
+  WriteBlocksEx() operation for virtio-blk.
+
+  See UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+  EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx().
+
+  If Token or Token->Event is NULL, the request is blocking, like
+  WriteBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  by VirtioBlkPoll() once every part of it has completed.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  );
+
+
+/**
+
+  FlushBlocksEx() operation for virtio-blk.
+
+  See UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+  EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx().
+
+  The flush waits for all queued requests, so that it covers them too. It
+  always completes before returning; Token->Event, if any, is signaled then.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  );
+
+
+/**
+
+  Reap the requests that the host has completed from the used ring, report
+  the results of the tasks they belong to, and submit queued requests to the
+  descriptors that have been freed up.
+
+  The function is the notification function of VBLK_DEV.PollTimer, and it is
+  also called directly by the functions that wait for requests. It must be
+  called at TPL_NOTIFY.
+
+  @param[in] Event    The timer event, or NULL.
+
+  @param[in] Context  The VBLK_DEV to poll.
+
+**/
+
+VOID
+EFIAPI
+VirtioBlkPoll (
+  IN EFI_EVENT Event,
+  IN VOID      *Context
+  );
+
+
 //
 // The purpose of the following scaffolding (EFI_COMPONENT_NAME_PROTOCOL and
 // EFI_COMPONENT_NAME2_PROTOCOL implementation) is to format the driver's name
@@ -7,16 +7,18 @@
 
   - No hotplug / hot-unplug.
 
-  - Although EFI_EXT_SCSI_PASS_THRU_PROTOCOL.PassThru() could be a good match
-    for multiple in-flight virtio-scsi requests, we stick to synchronous
-    requests for now.
+  - EFI_EXT_SCSI_PASS_THRU_PROTOCOL.PassThru() supports nonblocking requests.
+    Any number of them can be in flight, up to the size of the request queue;
+    the rest wait in the driver. Completed requests are reaped by a periodic
+    timer, which also signals the caller's event.
 
   - Timeouts are not supported for EFI_EXT_SCSI_PASS_THRU_PROTOCOL.PassThru().
 
   - Only one channel is supported. (At the time of this writing, host-side
     virtio-scsi supports a single channel too.)
 
-  - Only one request queue is used (for the one synchronous request).
+  - Only one request queue is used, for blocking and nonblocking requests
+    alike.
 
   - The ResetChannel() and ResetTargetLun() functions of
     EFI_EXT_SCSI_PASS_THRU_PROTOCOL are not supported (which is allowed by the
@@ -387,6 +389,273 @@ ParseResponse (
 }
 
 
+/**
+
+  Append a descriptor to the chain of a virtio-scsi request. The Next fields
+  are filled in from the free list when the request is submitted.
+
+  @param[in out] Req     The request to extend.
+
+  @param[in]     Addr    The guest address of the buffer.
+
+  @param[in]     Len     The size of the buffer, in bytes.
+
+  @param[in]     Flags   VRING_DESC_F_WRITE if the host writes the buffer, zero
+                         otherwise. VRING_DESC_F_NEXT is set by the function,
+                         as needed.
+
+**/
+STATIC
+VOID
+AppendRequestDesc (
+  IN OUT VSCSI_REQ *Req,
+  IN     UINTN     Addr,
+  IN     UINT32    Len,
+  IN     UINT16    Flags
+  )
+{
+  ASSERT (Req->NumDesc < VSCSI_MAX_DESC);
+
+  if (Req->NumDesc > 0) {
+    Req->Desc[Req->NumDesc - 1].Flags |= VRING_DESC_F_NEXT;
+  }
+  Req->Desc[Req->NumDesc].Addr  = Addr;
+  Req->Desc[Req->NumDesc].Len   = Len;
+  Req->Desc[Req->NumDesc].Flags = Flags;
+  Req->NumDesc++;
+}
+
+
+/**
+
+  Move queued requests to the ring while there are enough free descriptors
+  for them, and notify the host.
+
+  Free descriptors are linked through their Next fields, starting at
+  VSCSI_DEV.FreeDescHead. A request taken from the head of that list therefore
+  gets a descriptor chain that is linked already; only the Next field of its
+  last descriptor is stale, which the host ignores because VRING_DESC_F_NEXT is
+  clear there.
+
+  The function must be called at TPL_NOTIFY.
+
+  @param[in out] Dev  The virtio-scsi device whose queued requests to submit.
+
+**/
+STATIC
+VOID
+SubmitRequests (
+  IN OUT VSCSI_DEV *Dev
+  )
+{
+  VRING      *Ring;
+  VSCSI_REQ  *Req;
+  UINT16     Head;
+  UINT16     DescIdx;
+  UINT16     Index;
+  UINT16     AvailIdx;
+  EFI_STATUS Status;
+
+  Ring     = &Dev->Ring;
+  AvailIdx = *Ring->Avail.Idx;
+
+  while (!IsListEmpty (&Dev->PendingRequests)) {
+    Req = VSCSI_REQ_FROM_LINK (GetFirstNode (&Dev->PendingRequests));
+    if (Req->NumDesc > Dev->NumFreeDesc) {
+      break;
+    }
+    RemoveEntryList (&Req->Link);
+
+    Head    = Dev->FreeDescHead;
+    DescIdx = Head;
+    for (Index = 0; Index < Req->NumDesc; Index++) {
+      if (Index > 0) {
+        DescIdx = Ring->Desc[DescIdx].Next;
+      }
+      Ring->Desc[DescIdx].Addr  = Req->Desc[Index].Addr;
+      Ring->Desc[DescIdx].Len   = Req->Desc[Index].Len;
+      Ring->Desc[DescIdx].Flags = Req->Desc[Index].Flags;
+    }
+    Dev->FreeDescHead   = Ring->Desc[DescIdx].Next;
+    Dev->NumFreeDesc   -= Req->NumDesc;
+    Dev->InFlight[Head] = Req;
+
+    //
+    // virtio-0.9.5, 2.4.1.2 Updating the Available Ring
+    //
+    Ring->Avail.Ring[AvailIdx++ % Ring->QueueSize] = Head;
+  }
+
+  if (AvailIdx == *Ring->Avail.Idx) {
+    return;
+  }
+
+  //
+  // virtio-0.9.5, 2.4.1.3 Updating the Index Field
+  //
+  MemoryFence ();
+  *Ring->Avail.Idx = AvailIdx;
+
+  //
+  // virtio-0.9.5, 2.4.1.4 Notifying the Device -- one notification covers
+  // every request made available above.
+  //
+  MemoryFence ();
+  Status = Dev->VirtIo->SetQueueNotify (Dev->VirtIo, VIRTIO_SCSI_REQUEST_QUEUE);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: SetQueueNotify(): %r\n", __FUNCTION__, Status));
+  }
+}
+
+
+VOID
+EFIAPI
+VirtioScsiPoll (
+  IN EFI_EVENT Event,
+  IN VOID      *Context
+  )
+{
+  VSCSI_DEV  *Dev;
+  VRING      *Ring;
+  UINT16     UsedIdx;
+  UINT16     Head;
+  UINT16     Last;
+  UINT16     Index;
+  VSCSI_REQ  *Req;
+  EFI_STATUS Status;
+
+  Dev  = Context;
+  Ring = &Dev->Ring;
+
+  //
+  // virtio-0.9.5, 2.4.2 Receiving Used Buffers From the Device
+  //
+  MemoryFence ();
+  UsedIdx = *Ring->Used.Idx;
+  MemoryFence ();
+
+  while (Dev->LastUsedIdx != UsedIdx) {
+    Head = (UINT16) Ring->Used.UsedElem[Dev->LastUsedIdx % Ring->QueueSize].Id;
+    Dev->LastUsedIdx++;
+
+    ASSERT (Head < Ring->QueueSize);
+    Req = Dev->InFlight[Head];
+    ASSERT (Req != NULL);
+    Dev->InFlight[Head] = NULL;
+
+    //
+    // Return the descriptor chain of the request to the free list.
+    //
+    Last = Head;
+    for (Index = 1; Index < Req->NumDesc; Index++) {
+      Last = Ring->Desc[Last].Next;
+    }
+    Ring->Desc[Last].Next = Dev->FreeDescHead;
+    Dev->FreeDescHead     = Head;
+    Dev->NumFreeDesc     += Req->NumDesc;
+
+    //
+    // Blocking callers own their request, and parse the response themselves.
+    // For nonblocking requests, the packet is the only place to report the
+    // outcome. ParseResponse() reports VIRTIO_SCSI_S_BUSY with its return
+    // value alone, so translate that to the target status.
+    //
+    if (Req->Event == NULL) {
+      Req->Done = TRUE;
+    } else {
+      Status = ParseResponse (Req->Packet, &Req->Response);
+      if (Status == EFI_NOT_READY &&
+          Req->Packet->TargetStatus == EFI_EXT_SCSI_STATUS_TARGET_GOOD) {
+        Req->Packet->TargetStatus = EFI_EXT_SCSI_STATUS_TARGET_BUSY;
+      }
+      gBS->SignalEvent (Req->Event);
+      FreePool (Req);
+    }
+  }
+
+  SubmitRequests (Dev);
+}
+
+
+/**
+
+  Queue a virtio-scsi request for the host.
+
+  @param[in out] Dev  The virtio-scsi device to queue the request on.
+
+  @param[in out] Req  The request, with its descriptors appended.
+
+**/
+STATIC
+VOID
+QueueRequest (
+  IN OUT VSCSI_DEV *Dev,
+  IN OUT VSCSI_REQ *Req
+  )
+{
+  EFI_TPL OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  InsertTailList (&Dev->PendingRequests, &Req->Link);
+
+  //
+  // Reap completed requests too, so that a caller keeping the ring full does
+  // not depend on the timer for freeing up descriptors.
+  //
+  VirtioScsiPoll (NULL, Dev);
+  gBS->RestoreTPL (OldTpl);
+}
+
+
+/**
+
+  Wait until a blocking request, or all requests, have completed.
+
+  @param[in out] Dev  The virtio-scsi device whose used ring to poll.
+
+  @param[in]     Req  The blocking request to wait for. If NULL, wait until
+                      every request queued on Dev has completed.
+
+**/
+STATIC
+VOID
+WaitForRequests (
+  IN OUT VSCSI_DEV       *Dev,
+  IN     CONST VSCSI_REQ *Req OPTIONAL
+  )
+{
+  UINTN   PollPeriodUsecs;
+  EFI_TPL OldTpl;
+  BOOLEAN Done;
+
+  //
+  // Keep slowing down until we reach a poll period of slightly above 1 ms.
+  //
+  PollPeriodUsecs = 1;
+  for (;;) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    VirtioScsiPoll (NULL, Dev);
+    if (Req != NULL) {
+      Done = Req->Done;
+    } else {
+      Done = (BOOLEAN) (IsListEmpty (&Dev->PendingRequests) &&
+                        Dev->NumFreeDesc == Dev->Ring.QueueSize);
+    }
+    gBS->RestoreTPL (OldTpl);
+
+    if (Done) {
+      return;
+    }
+
+    gBS->Stall (PollPeriodUsecs); // calls AcpiTimerLib::MicroSecondDelay
+
+    if (PollPeriodUsecs < 1024) {
+      PollPeriodUsecs *= 2;
+    }
+  }
+}
+
+
 //
 // The next seven functions implement EFI_EXT_SCSI_PASS_THRU_PROTOCOL
 // for the virtio-scsi HBA. Refer to UEFI Spec 2.3.1 + Errata C, sections
@@ -404,82 +673,95 @@ VirtioScsiPassThru (
   IN     EFI_EVENT                                  Event   OPTIONAL
   )
 {
-  VSCSI_DEV                 *Dev;
-  UINT16                    TargetValue;
-  EFI_STATUS                Status;
-  volatile VIRTIO_SCSI_REQ  Request;
-  volatile VIRTIO_SCSI_RESP Response;
-  DESC_INDICES              Indices;
-
-  ZeroMem ((VOID*) &Request, sizeof (Request));
-  ZeroMem ((VOID*) &Response, sizeof (Response));
+  VSCSI_DEV  *Dev;
+  UINT16     TargetValue;
+  EFI_STATUS Status;
+  VSCSI_REQ  BlockingReq;
+  VSCSI_REQ  *Req;
 
   Dev = VIRTIO_SCSI_FROM_PASS_THRU (This);
   CopyMem (&TargetValue, Target, sizeof TargetValue);
 
-  Status = PopulateRequest (Dev, TargetValue, Lun, Packet, &Request);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  //
+  // A nonblocking request outlives this call, hence it lives in pool memory.
+  // If that cannot be allocated, carry out the request synchronously, and
+  // signal Event before returning.
+  //
+  Req = NULL;
+  if (Event != NULL) {
+    Req = AllocatePool (sizeof *Req);
+  }
+  if (Req == NULL) {
+    Req = &BlockingReq;
   }
+  ZeroMem (Req, sizeof *Req);
+  Req->Signature = VSCSI_REQ_SIG;
+  Req->Packet    = Packet;
+  Req->Event     = (Req == &BlockingReq) ? NULL : Event;
 
-  VirtioPrepare (&Dev->Ring, &Indices);
+  Status = PopulateRequest (Dev, TargetValue, Lun, Packet, &Req->Request);
+  if (EFI_ERROR (Status)) {
+    goto FreeRequest;
+  }
 
   //
   // preset a host status for ourselves that we do not accept as success
   //
-  Response.Response = VIRTIO_SCSI_S_FAILURE;
+  Req->Response.Response = VIRTIO_SCSI_S_FAILURE;
 
   //
-  // ensured by VirtioScsiInit() -- this predicate, in combination with the
-  // lock-step progress, ensures we don't have to track free descriptors.
+  // ensured by VirtioScsiInit() -- a request takes at most four descriptors,
+  // thus it always fits in the ring once the requests before it complete.
   //
-  ASSERT (Dev->Ring.QueueSize >= 4);
+  ASSERT (Dev->Ring.QueueSize >= VSCSI_MAX_DESC);
 
   //
   // enqueue Request
   //
-  VirtioAppendDesc (&Dev->Ring, (UINTN) &Request, sizeof Request,
-    VRING_DESC_F_NEXT, &Indices);
+  AppendRequestDesc (Req, (UINTN) &Req->Request, sizeof Req->Request, 0);
 
   //
   // enqueue "dataout" if any
   //
   if (Packet->OutTransferLength > 0) {
-    VirtioAppendDesc (&Dev->Ring, (UINTN) Packet->OutDataBuffer,
-      Packet->OutTransferLength, VRING_DESC_F_NEXT, &Indices);
+    AppendRequestDesc (Req, (UINTN) Packet->OutDataBuffer,
+      Packet->OutTransferLength, 0);
   }
 
   //
   // enqueue Response, to be written by the host
   //
-  VirtioAppendDesc (&Dev->Ring, (UINTN) &Response, sizeof Response,
-    VRING_DESC_F_WRITE | (Packet->InTransferLength > 0 ?
-                          VRING_DESC_F_NEXT : 0),
-    &Indices);
+  AppendRequestDesc (Req, (UINTN) &Req->Response, sizeof Req->Response,
+    VRING_DESC_F_WRITE);
 
   //
   // enqueue "datain" if any, to be written by the host
   //
   if (Packet->InTransferLength > 0) {
-    VirtioAppendDesc (&Dev->Ring, (UINTN) Packet->InDataBuffer,
-      Packet->InTransferLength, VRING_DESC_F_WRITE, &Indices);
+    AppendRequestDesc (Req, (UINTN) Packet->InDataBuffer,
+      Packet->InTransferLength, VRING_DESC_F_WRITE);
   }
 
-  // If kicking the host fails, we must fake a host adapter error.
-  // EFI_NOT_READY would save us the effort, but it would also suggest that the
-  // caller retry.
-  //
-  if (VirtioFlush (Dev->VirtIo, VIRTIO_SCSI_REQUEST_QUEUE, &Dev->Ring,
-        &Indices) != EFI_SUCCESS) {
-    Packet->InTransferLength  = 0;
-    Packet->OutTransferLength = 0;
-    Packet->HostAdapterStatus = EFI_EXT_SCSI_STATUS_HOST_ADAPTER_OTHER;
-    Packet->TargetStatus      = EFI_EXT_SCSI_STATUS_TARGET_GOOD;
-    Packet->SenseDataLength   = 0;
-    return EFI_DEVICE_ERROR;
+  QueueRequest (Dev, Req);
+  if (Req->Event != NULL) {
+    //
+    // VirtioScsiPoll() updates Packet and signals Event on completion.
+    //
+    return EFI_SUCCESS;
   }
 
-  return ParseResponse (Packet, &Response);
+  WaitForRequests (Dev, Req);
+  Status = ParseResponse (Packet, &Req->Response);
+  if (!EFI_ERROR (Status) && Event != NULL) {
+    gBS->SignalEvent (Event);
+  }
+  return Status;
+
+FreeRequest:
+  if (Req != &BlockingReq) {
+    FreePool (Req);
+  }
+  return Status;
 }
 
 
@@ -711,6 +993,7 @@ VirtioScsiInit (
   UINT16     MaxChannel; // for validation only
   UINT32     NumQueues;  // for validation only
   UINT16     QueueSize;
+  UINT16     Index;
 
   //
   // Execute virtio-0.9.5, 2.2.1 Device Initialization Sequence.
@@ -812,9 +1095,9 @@ VirtioScsiInit (
     goto Failed;
   }
   //
-  // VirtioScsiPassThru() uses at most four descriptors
+  // VirtioScsiPassThru() uses at most four descriptors per request
   //
-  if (QueueSize < 4) {
+  if (QueueSize < VSCSI_MAX_DESC) {
     Status = EFI_UNSUPPORTED;
     goto Failed;
   }
@@ -871,13 +1154,43 @@ VirtioScsiInit (
     goto ReleaseQueue;
   }
 
+  //
+  // Link all descriptors into the free list. Completed requests are reaped by
+  // polling the used ring, hence we ask the host not to interrupt us.
+  //
+  for (Index = 0; Index < QueueSize; Index++) {
+    Dev->Ring.Desc[Index].Next = (UINT16) (Index + 1);
+  }
+  Dev->FreeDescHead = 0;
+  Dev->NumFreeDesc  = QueueSize;
+  Dev->LastUsedIdx  = 0;
+  *Dev->Ring.Avail.Flags = VRING_AVAIL_F_NO_INTERRUPT;
+  InitializeListHead (&Dev->PendingRequests);
+
+  Dev->InFlight = AllocateZeroPool (QueueSize * sizeof *Dev->InFlight);
+  if (Dev->InFlight == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto ReleaseQueue;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_NOTIFY,
+                  &VirtioScsiPoll, Dev, &Dev->PollTimer);
+  if (EFI_ERROR (Status)) {
+    goto FreeInFlight;
+  }
+
+  Status = gBS->SetTimer (Dev->PollTimer, TimerPeriodic, VSCSI_POLL_PERIOD);
+  if (EFI_ERROR (Status)) {
+    goto ClosePollTimer;
+  }
+
   //
   // step 6 -- initialization complete
   //
   NextDevStat |= VSTAT_DRIVER_OK;
   Status = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
   if (EFI_ERROR (Status)) {
-    goto ReleaseQueue;
+    goto ClosePollTimer;
   }
 
   //
@@ -901,10 +1214,12 @@ VirtioScsiInit (
   //
   // Set both physical and logical attributes for non-RAID SCSI channel. See
   // Driver Writer's Guide for UEFI 2.3.1 v1.01, 20.1.5 Implementing Extended
-  // SCSI Pass Thru Protocol.
+  // SCSI Pass Thru Protocol. Requests with an Event are queued, and many of
+  // them can be in flight at the same time.
   //
   Dev->PassThruMode.Attributes = EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_PHYSICAL |
-                                 EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_LOGICAL;
+                                 EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_LOGICAL |
+                                 EFI_EXT_SCSI_PASS_THRU_ATTRIBUTES_NONBLOCKIO;
 
   //
   // no restriction on transfer buffer alignment
@@ -913,6 +1228,12 @@ VirtioScsiInit (
 
   return EFI_SUCCESS;
 
+ClosePollTimer:
+  gBS->CloseEvent (Dev->PollTimer);
+
+FreeInFlight:
+  FreePool (Dev->InFlight);
+
 ReleaseQueue:
   VirtioRingUninit (&Dev->Ring);
 
@@ -941,6 +1262,13 @@ VirtioScsiUninit (
   IN OUT VSCSI_DEV *Dev
   )
 {
+  //
+  // Let the requests in flight complete, and signal their events, before the
+  // ring goes away.
+  //
+  WaitForRequests (Dev, NULL);
+  gBS->CloseEvent (Dev->PollTimer);
+
   //
   // Reset the virtual device -- see virtio-0.9.5, 2.2.2.1 Device Status. When
   // VIRTIO_CFG_WRITE() returns, the host will have learned to stay away from
@@ -954,6 +1282,7 @@ VirtioScsiUninit (
   Dev->MaxSectors     = 0;
 
   VirtioRingUninit (&Dev->Ring);
+  FreePool (Dev->InFlight);
 
   SetMem (&Dev->PassThru,     sizeof Dev->PassThru,     0x00);
   SetMem (&Dev->PassThruMode, sizeof Dev->PassThruMode, 0x00);
@@ -23,6 +23,7 @@
 #include <Protocol/ScsiPassThruExt.h>
 
 #include <IndustryStandard/Virtio.h>
+#include <IndustryStandard/VirtioScsi.h>
 
 
 //
@@ -42,6 +43,39 @@
 
 #define VSCSI_SIG SIGNATURE_32 ('V', 'S', 'C', 'S')
 
+//
+// Largest number of descriptors in a single virtio-scsi request: the request
+// header, "dataout", the response and "datain".
+//
+#define VSCSI_MAX_DESC    4
+
+//
+// Period of the timer that reaps completed requests from the used ring.
+//
+#define VSCSI_POLL_PERIOD EFI_TIMER_PERIOD_MILLISECONDS (1)
+
+#define VSCSI_REQ_SIG SIGNATURE_32 ('V', 'S', 'R', 'Q')
+
+//
+// A single virtio-scsi request, carrying one Extended SCSI Pass Thru packet.
+// Event is NULL for blocking requests; their callers watch Done.
+//
+typedef struct {
+  UINT32                                     Signature;
+  LIST_ENTRY                                 Link;    // VSCSI_DEV.PendingRequests,
+                                                      // until submitted
+  EFI_EXT_SCSI_PASS_THRU_SCSI_REQUEST_PACKET *Packet;
+  EFI_EVENT                                  Event;
+  volatile BOOLEAN                           Done;
+  UINT16                                     NumDesc;
+  VRING_DESC                                 Desc[VSCSI_MAX_DESC]; // Next unused
+  volatile VIRTIO_SCSI_REQ                   Request;
+  volatile VIRTIO_SCSI_RESP                  Response;
+} VSCSI_REQ;
+
+#define VSCSI_REQ_FROM_LINK(LinkPointer) \
+        CR (LinkPointer, VSCSI_REQ, Link, VSCSI_REQ_SIG)
+
 typedef struct {
   //
   // Parts of this structure are initialized / torn down in various functions
@@ -57,6 +91,12 @@ typedef struct {
   UINT32                          MaxLun;         // VirtioScsiInit      1
   UINT32                          MaxSectors;     // VirtioScsiInit      1
   VRING                           Ring;           // VirtioRingInit      2
+  UINT16                          FreeDescHead;   // VirtioScsiInit      1
+  UINT16                          NumFreeDesc;    // VirtioScsiInit      1
+  UINT16                          LastUsedIdx;    // VirtioScsiInit      1
+  VSCSI_REQ                       **InFlight;     // VirtioScsiInit      1
+  LIST_ENTRY                      PendingRequests; // VirtioScsiInit     1
+  EFI_EVENT                       PollTimer;      // VirtioScsiInit      1
   EFI_EXT_SCSI_PASS_THRU_PROTOCOL PassThru;       // VirtioScsiInit      1
   EFI_EXT_SCSI_PASS_THRU_MODE     PassThruMode;   // VirtioScsiInit      1
 } VSCSI_DEV;
@@ -204,4 +244,33 @@ VirtioScsiGetDeviceName (
   OUT CHAR16                      **ControllerName
   );
 
+
+//
+// Completion of the requests in flight. The used ring is polled, because we
+// ask the host not to interrupt us.
+//
+
+/**
+
+  Reap the requests that the host has completed from the used ring, report
+  their results, and submit queued requests to the descriptors that have been
+  freed up.
+
+  The function is the notification function of VSCSI_DEV.PollTimer, and it is
+  also called directly by the functions that wait for requests. It must be
+  called at TPL_NOTIFY.
+
+  @param[in] Event    The timer event, or NULL.
+
+  @param[in] Context  The VSCSI_DEV to poll.
+
+**/
+
+VOID
+EFIAPI
+VirtioScsiPoll (
+  IN EFI_EVENT Event,
+  IN VOID      *Context
+  );
+
 #endif // _VIRTIO_SCSI_DXE_H_